@@ -0,0 +1,343 @@
+#include "parsegraph_Worker.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Arguments and results of one async call. Strings are copied with malloc
+// because the caller's pools are not safe to use from a worker thread.
+struct parsegraph_AsyncCall {
+    void(*cb)(void);
+    void* data;
+    int ints[3];
+    char* strings[2];
+    parsegraph_GUID guid;
+
+    int id;
+    size_t count;
+    parsegraph_List_item** items;
+    parsegraph_user_login login;
+    parsegraph_user_login* createdLogin;
+};
+
+static struct parsegraph_AsyncCall* newCall(void(*cb)(void), void* data, const char* first, const char* second)
+{
+    struct parsegraph_AsyncCall* call = calloc(1, sizeof(*call));
+    if(!call) {
+        return 0;
+    }
+    call->cb = cb;
+    call->data = data;
+    call->id = -1;
+    if((first && !(call->strings[0] = strdup(first))) || (second && !(call->strings[1] = strdup(second)))) {
+        free(call->strings[0]);
+        free(call);
+        return 0;
+    }
+    return call;
+}
+
+static void freeCall(struct parsegraph_AsyncCall* call)
+{
+    free(call->strings[0]);
+    free(call->strings[1]);
+    free(call);
+}
+
+static int submitCall(parsegraph_WorkerPool* workers, struct parsegraph_AsyncCall* call, parsegraph_WorkFunction work, parsegraph_Continuation done)
+{
+    if(!call) {
+        return APR_ENOMEM;
+    }
+    int rv = parsegraph_WorkerPool_submit(workers, work, done, call);
+    if(rv != APR_SUCCESS) {
+        freeCall(call);
+    }
+    return rv;
+}
+
+// Continuations shared by calls with the same callback type.
+
+static void finishListId(void* data, int status)
+{
+    struct parsegraph_AsyncCall* call = data;
+    if(call->cb) {
+        ((parsegraph_ListIdCallback)call->cb)(call->data, status, call->id);
+    }
+    freeCall(call);
+}
+
+static void finishListStatus(void* data, int status)
+{
+    struct parsegraph_AsyncCall* call = data;
+    if(call->cb) {
+        ((parsegraph_ListStatusCallback)call->cb)(call->data, status);
+    }
+    freeCall(call);
+}
+
+static void finishUserStatus(void* data, int status)
+{
+    struct parsegraph_AsyncCall* call = data;
+    if(call->cb) {
+        ((parsegraph_UserStatusCallback)call->cb)(call->data, status);
+    }
+    freeCall(call);
+}
+
+static void finishUserLogin(void* data, int status)
+{
+    struct parsegraph_AsyncCall* call = data;
+    if(call->cb) {
+        ((parsegraph_UserLoginCallback)call->cb)(call->data, status, call->createdLogin);
+    }
+    freeCall(call);
+}
+
+static void finishEnvironmentStatus(void* data, int status)
+{
+    struct parsegraph_AsyncCall* call = data;
+    if(call->cb) {
+        ((parsegraph_EnvironmentStatusCallback)call->cb)(call->data, status);
+    }
+    freeCall(call);
+}
+
+static void finishEnvironmentId(void* data, int status)
+{
+    struct parsegraph_AsyncCall* call = data;
+    if(call->cb) {
+        ((parsegraph_EnvironmentIdCallback)call->cb)(call->data, status, call->id);
+    }
+    freeCall(call);
+}
+
+// parsegraph_List
+
+static int runListNew(parsegraph_Session* session, void* data)
+{
+    struct parsegraph_AsyncCall* call = data;
+    return parsegraph_List_new(session, call->strings[0], &call->id);
+}
+
+int parsegraph_List_newAsync(parsegraph_WorkerPool* workers, const char* listName, parsegraph_ListIdCallback cb, void* data)
+{
+    struct parsegraph_AsyncCall* call = newCall((void(*)(void))cb, data, listName, 0);
+    return submitCall(workers, call, runListNew, finishListId);
+}
+
+static int runListAppendItem(parsegraph_Session* session, void* data)
+{
+    struct parsegraph_AsyncCall* call = data;
+    return parsegraph_List_appendItem(session, call->ints[0], call->ints[1], call->strings[0], &call->id);
+}
+
+int parsegraph_List_appendItemAsync(parsegraph_WorkerPool* workers, int listId, int typeId, const char* value, parsegraph_ListIdCallback cb, void* data)
+{
+    struct parsegraph_AsyncCall* call = newCall((void(*)(void))cb, data, value, 0);
+    if(call) {
+        call->ints[0] = listId;
+        call->ints[1] = typeId;
+    }
+    return submitCall(workers, call, runListAppendItem, finishListId);
+}
+
+static int runListListItems(parsegraph_Session* session, void* data)
+{
+    struct parsegraph_AsyncCall* call = data;
+    return parsegraph_List_listItems(session, call->ints[0], &call->items, &call->count);
+}
+
+static void finishListItems(void* data, int status)
+{
+    struct parsegraph_AsyncCall* call = data;
+    if(call->cb) {
+        ((parsegraph_ListItemsCallback)call->cb)(call->data, status, call->items, call->count);
+    }
+    freeCall(call);
+}
+
+int parsegraph_List_listItemsAsync(parsegraph_WorkerPool* workers, int listId, parsegraph_ListItemsCallback cb, void* data)
+{
+    struct parsegraph_AsyncCall* call = newCall((void(*)(void))cb, data, 0, 0);
+    if(call) {
+        call->ints[0] = listId;
+    }
+    return submitCall(workers, call, runListListItems, finishListItems);
+}
+
+static int runListLength(parsegraph_Session* session, void* data)
+{
+    struct parsegraph_AsyncCall* call = data;
+    return parsegraph_List_length(session, call->ints[0], &call->count);
+}
+
+static void finishListLength(void* data, int status)
+{
+    struct parsegraph_AsyncCall* call = data;
+    if(call->cb) {
+        ((parsegraph_ListLengthCallback)call->cb)(call->data, status, call->count);
+    }
+    freeCall(call);
+}
+
+int parsegraph_List_lengthAsync(parsegraph_WorkerPool* workers, int listId, parsegraph_ListLengthCallback cb, void* data)
+{
+    struct parsegraph_AsyncCall* call = newCall((void(*)(void))cb, data, 0, 0);
+    if(call) {
+        call->ints[0] = listId;
+    }
+    return submitCall(workers, call, runListLength, finishListLength);
+}
+
+static int runListDestroy(parsegraph_Session* session, void* data)
+{
+    struct parsegraph_AsyncCall* call = data;
+    return parsegraph_List_destroy(session, call->ints[0]);
+}
+
+int parsegraph_List_destroyAsync(parsegraph_WorkerPool* workers, int listId, parsegraph_ListStatusCallback cb, void* data)
+{
+    struct parsegraph_AsyncCall* call = newCall((void(*)(void))cb, data, 0, 0);
+    if(call) {
+        call->ints[0] = listId;
+    }
+    return submitCall(workers, call, runListDestroy, finishListStatus);
+}
+
+// parsegraph_user
+
+static int runCreateNewUser(parsegraph_Session* session, void* data)
+{
+    struct parsegraph_AsyncCall* call = data;
+    return parsegraph_createNewUser(session, call->strings[0], call->strings[1]);
+}
+
+int parsegraph_createNewUserAsync(parsegraph_WorkerPool* workers, const char* username, const char* password, parsegraph_UserStatusCallback cb, void* data)
+{
+    struct parsegraph_AsyncCall* call = newCall((void(*)(void))cb, data, username, password);
+    return submitCall(workers, call, runCreateNewUser, finishUserStatus);
+}
+
+static int runBeginUserLogin(parsegraph_Session* session, void* data)
+{
+    struct parsegraph_AsyncCall* call = data;
+    return parsegraph_beginUserLogin(session, call->strings[0], call->strings[1], &call->createdLogin);
+}
+
+int parsegraph_beginUserLoginAsync(parsegraph_WorkerPool* workers, const char* username, const char* password, parsegraph_UserLoginCallback cb, void* data)
+{
+    struct parsegraph_AsyncCall* call = newCall((void(*)(void))cb, data, username, password);
+    return submitCall(workers, call, runBeginUserLogin, finishUserLogin);
+}
+
+static int runRefreshUserLogin(parsegraph_Session* session, void* data)
+{
+    struct parsegraph_AsyncCall* call = data;
+    call->login.session_selector = call->strings[0];
+    call->login.session_token = call->strings[1];
+    int rv = parsegraph_refreshUserLogin(session, &call->login);
+    if(rv == parsegraph_OK) {
+        call->createdLogin = &call->login;
+    }
+    return rv;
+}
+
+int parsegraph_refreshUserLoginAsync(parsegraph_WorkerPool* workers, const char* selector, const char* token, parsegraph_UserLoginCallback cb, void* data)
+{
+    struct parsegraph_AsyncCall* call = newCall((void(*)(void))cb, data, selector, token);
+    return submitCall(workers, call, runRefreshUserLogin, finishUserLogin);
+}
+
+static int runGetIdForUsername(parsegraph_Session* session, void* data)
+{
+    struct parsegraph_AsyncCall* call = data;
+    return parsegraph_getIdForUsername(session, call->strings[0], &call->id);
+}
+
+static void finishUserId(void* data, int status)
+{
+    struct parsegraph_AsyncCall* call = data;
+    if(call->cb) {
+        ((parsegraph_UserIdCallback)call->cb)(call->data, status, call->id);
+    }
+    freeCall(call);
+}
+
+int parsegraph_getIdForUsernameAsync(parsegraph_WorkerPool* workers, const char* username, parsegraph_UserIdCallback cb, void* data)
+{
+    struct parsegraph_AsyncCall* call = newCall((void(*)(void))cb, data, username, 0);
+    return submitCall(workers, call, runGetIdForUsername, finishUserId);
+}
+
+// parsegraph_environment
+
+static int runCreateEnvironment(parsegraph_Session* session, void* data)
+{
+    struct parsegraph_AsyncCall* call = data;
+    return parsegraph_createEnvironment(session, call->ints[0], call->ints[1], call->ints[2], &call->guid);
+}
+
+static void finishEnvironmentGUID(void* data, int status)
+{
+    struct parsegraph_AsyncCall* call = data;
+    if(call->cb) {
+        ((parsegraph_EnvironmentGUIDCallback)call->cb)(call->data, status, &call->guid);
+    }
+    freeCall(call);
+}
+
+int parsegraph_createEnvironmentAsync(parsegraph_WorkerPool* workers, int ownerId, int rootListId, int environmentTypeId, parsegraph_EnvironmentGUIDCallback cb, void* data)
+{
+    struct parsegraph_AsyncCall* call = newCall((void(*)(void))cb, data, 0, 0);
+    if(call) {
+        call->ints[0] = ownerId;
+        call->ints[1] = rootListId;
+        call->ints[2] = environmentTypeId;
+    }
+    return submitCall(workers, call, runCreateEnvironment, finishEnvironmentGUID);
+}
+
+static int runGetEnvironmentIdForGUID(parsegraph_Session* session, void* data)
+{
+    struct parsegraph_AsyncCall* call = data;
+    return parsegraph_getEnvironmentIdForGUID(session, &call->guid, &call->id);
+}
+
+int parsegraph_getEnvironmentIdForGUIDAsync(parsegraph_WorkerPool* workers, parsegraph_GUID* env, parsegraph_EnvironmentIdCallback cb, void* data)
+{
+    struct parsegraph_AsyncCall* call = newCall((void(*)(void))cb, data, 0, 0);
+    if(call) {
+        call->guid = *env;
+    }
+    return submitCall(workers, call, runGetEnvironmentIdForGUID, finishEnvironmentId);
+}
+
+static int runGetEnvironmentRoot(parsegraph_Session* session, void* data)
+{
+    struct parsegraph_AsyncCall* call = data;
+    return parsegraph_getEnvironmentRoot(session, &call->guid, &call->id);
+}
+
+int parsegraph_getEnvironmentRootAsync(parsegraph_WorkerPool* workers, parsegraph_GUID* env, parsegraph_EnvironmentIdCallback cb, void* data)
+{
+    struct parsegraph_AsyncCall* call = newCall((void(*)(void))cb, data, 0, 0);
+    if(call) {
+        call->guid = *env;
+    }
+    return submitCall(workers, call, runGetEnvironmentRoot, finishEnvironmentId);
+}
+
+static int runSaveEnvironment(parsegraph_Session* session, void* data)
+{
+    struct parsegraph_AsyncCall* call = data;
+    return parsegraph_saveEnvironment(session, call->ints[0], &call->guid, call->strings[0]);
+}
+
+int parsegraph_saveEnvironmentAsync(parsegraph_WorkerPool* workers, int userId, parsegraph_GUID* env, const char* clientSaveState, parsegraph_EnvironmentStatusCallback cb, void* data)
+{
+    struct parsegraph_AsyncCall* call = newCall((void(*)(void))cb, data, clientSaveState, 0);
+    if(call) {
+        call->ints[0] = userId;
+        call->guid = *env;
+    }
+    return submitCall(workers, call, runSaveEnvironment, finishEnvironmentStatus);
+}
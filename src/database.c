@@ -1,63 +1,81 @@
 #include "parsegraph_environment.h"
+#include "parsegraph_Statement.h"
+#include <apr_strings.h>
+#include <string.h>
 
 parsegraph_EnvironmentStatus parsegraph_prepareEnvironmentStatements(parsegraph_Session* session)
 {
-    static const char* queries[] = {
-        "parsegraph_Environment_createEnvironment", "INSERT INTO environment(environment_guid, for_new_users, for_administrators, create_date, open_to_public, open_for_visits, open_for_modification, visit_count, owner, root_list_id, environment_type_id) VALUES(lower(hex(randomblob(4))) || '-' || lower(hex(randomblob(2))) || '-' || lower(hex(randomblob(2))) || '-' || lower(hex(randomblob(2))) || '-' || lower(hex(randomblob(6))), 0, 0, strftime('%%Y-%%m-%%dT%%H:%%M:%%f', 'now'), 0, 0, 0, 0, %d, %d, %d)", // 1
-        "parsegraph_Environment_destroyEnvironment", "DELETE FROM environment WHERE environment_guid = %s", // 2
-        "parsegraph_Environment_last_insert_rowid", "SELECT last_insert_rowid();", // 3
-        "parsegraph_Environment_getEnvironmentGUIDForId", "SELECT environment_guid FROM environment WHERE environment_id = %d", // 4
-        "parsegraph_Environment_getEnvironmentIdForGUID", "SELECT environment_id FROM environment WHERE environment_guid = %s", // 5
-        "parsegraph_Environment_getEnvironmentTitleForGUID", "SELECT environment_title FROM environment WHERE environment_guid = %s", // 6
-        "parsegraph_Environment_getEnvironmentTitleForId", "SELECT environment_title FROM environment WHERE environment_id = %d", // 7
-        "parsegraph_Environment_getSavedEnvironmentsForUser", "SELECT environment_guid, environment_title, save_date FROM saved_environment JOIN environment ON saved_environment.environment_id = environment.environment_id WHERE user_id = %d ORDER by save_date DESC", // 8
-        "parsegraph_Environment_saveEnvironment", "INSERT INTO saved_environment(environment_id, user_id, save_date, client_state) VALUES(%d, %d, datetime('now'), %s)", // 9
-        "parsegraph_Environment_getOwnedEnvironmentsForUser", "SELECT environment_guid, environment_title FROM environment WHERE owner = %d ORDER by create_date DESC", // 10
-        "parsegraph_Environment_getEnvironmentRoot", "SELECT root_list_id FROM environment WHERE environment_guid = %s", // 11
-        "parsegraph_Environment_setEnvironmentRoot", "UPDATE environment SET root_list_id = %d WHERE environment_guid = %s", // 12
-        "parsegraph_getMultislotItemAtIndex", "SELECT list_item.id FROM list_item JOIN list_item par on list_item.list_id = par.id WHERE list_item.list_id = %d AND par.type = 4 AND list_item.type = %d", // 13
-        "parsegraph_Environment_setStorageItemList", "UPDATE user SET storage_list_id = %d WHERE id = %d", // 14
-        "parsegraph_Environment_setDisposedItemList", "UPDATE user SET disposed_list_id = %d WHERE id = %d", // 15
-        "parsegraph_Environment_getStorageItemList", "SELECT storage_list_id FROM user WHERE id = %d", // 16
-        "parsegraph_Environment_getDisposedItemList", "SELECT disposed_list_id FROM user WHERE id = %d", // 17
-        "parsegraph_Environment_setMultislotPublic", "INSERT INTO public_multislot(multislot_id) VALUES(%d)", // 18
-        "parsegraph_Environment_setMultislotPrivate", "DELETE FROM public_multislot WHERE multislot_id = %d", // 19
-        "parsegraph_Environment_createMultislotPlot", "INSERT INTO multislot_plot(multislot_id, user_id, plot_index, plot_length) values(%d, %d, %d, %d)", // 20
-        "parsegraph_Environment_getMultislotInfo", "SELECT multislot_id, environment_guid, list_item.value FROM multislot JOIN environment ON multislot.environment_id = environment.environment_id JOIN list_item ON multislot.multislot_id = list_item.id WHERE id = %d", // 21
-    };
-    static int NUM_QUERIES = 21;
-
-    parsegraph_EnvironmentStatus erv = parsegraph_Environment_OK;
+    if(0 != parsegraph_prepareStatements(session, parsegraph_Statement_lastInsertRowId, parsegraph_Statement_lastInsertRowId)) {
+        return parsegraph_Environment_INTERNAL_ERROR;
+    }
+    if(0 != parsegraph_prepareStatements(session, parsegraph_Statement_Environment_destroyEnvironment, parsegraph_Statement_Environment_LAST)) {
+        return parsegraph_Environment_INTERNAL_ERROR;
+    }
+    return parsegraph_Environment_OK;
+}
+
+// Fills environment_uuid from environment_guid for environments created before it.
+static int backfillEnvironmentUUIDs(parsegraph_Session* session)
+{
     ap_dbd_t* dbd = session->dbd;
     apr_pool_t* pool = session->pool;
+    apr_dbd_results_t* res = 0;
+    int rv = apr_dbd_select(dbd->driver, pool, dbd->handle, &res,
+        "select environment_id, environment_guid from environment where environment_uuid is null", 0);
+    if(rv != 0) {
+        marla_logMessagef(session->server, "Failed to list environments without a binary GUID: %s",
+            apr_dbd_error(dbd->driver, dbd->handle, rv)
+        );
+        return rv;
+    }
 
-    for(int i = 0; i < NUM_QUERIES * 2; i += 2) {
-        const char* label = queries[i];
-        const char* query = queries[i + 1];
-
-        // Check if the statement has already been created.
-        if(NULL != apr_hash_get(dbd->prepared, label, APR_HASH_KEY_STRING)) {
-            // A statement already prepared is ignored.
+    // Read every row before updating, so the select is not left open.
+    apr_array_header_t* updates = apr_array_make(pool, 64, sizeof(const char*));
+    apr_dbd_row_t* row = 0;
+    while(0 == apr_dbd_get_row(dbd->driver, pool, res, &row, -1)) {
+        const char* id = apr_dbd_get_entry(dbd->driver, row, 0);
+        const char* text = apr_dbd_get_entry(dbd->driver, row, 1);
+        parsegraph_GUID guid;
+        parsegraph_BinaryGUID bin;
+        if(!text || strlen(text) != 36) {
+            marla_logMessagef(session->server, "Environment %s has no valid GUID to convert.", id);
+            continue;
+        }
+        memcpy(guid.value, text, sizeof guid.value);
+        if(0 != parsegraph_GUID_parse(&guid, &bin)) {
+            marla_logMessagef(session->server, "Environment %s has no valid GUID to convert.", id);
             continue;
         }
 
-        // No statement was found, so create and insert a new statement.
-        apr_dbd_prepared_t *stmt = 0;
-        int rv = apr_dbd_prepare(dbd->driver, pool, dbd->handle, query, label, &stmt);
+        // The lowercase text form without dashes is the blob's hex.
+        parsegraph_GUID_format(&bin, &guid);
+        char hex[33];
+        char* out = hex;
+        for(const char* c = guid.value; *c; ++c) {
+            if(*c != '-') {
+                *out++ = *c;
+            }
+        }
+        *out = 0;
+        APR_ARRAY_PUSH(updates, const char*) = apr_psprintf(pool,
+            session->dialect == parsegraph_Dialect_PGSQL ?
+                "update environment set environment_uuid = decode('%s', 'hex') where environment_id = %s" :
+                "update environment set environment_uuid = X'%s' where environment_id = %s",
+            hex, id
+        );
+    }
+
+    for(int i = 0; i < updates->nelts; ++i) {
+        int nrows = 0;
+        rv = apr_dbd_query(dbd->driver, dbd->handle, &nrows, APR_ARRAY_IDX(updates, i, const char*));
         if(rv != 0) {
-            marla_logMessagef(session->server,
-                "Failed preparing %s statement [%s]",
-                label,
+            marla_logMessagef(session->server, "Failed to set binary GUID of environment: %s",
                 apr_dbd_error(dbd->driver, dbd->handle, rv)
             );
-            erv = parsegraph_Environment_INTERNAL_ERROR;
-        }
-        else {
-            apr_hash_set(dbd->prepared, label, APR_HASH_KEY_STRING, stmt);
+            return rv;
         }
     }
-
-    return erv;
+    return 0;
 }
 
 parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Session* session)
@@ -73,9 +91,8 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
         return rv;
     }
 
-    rv = apr_dbd_query(
-        session->dbd->driver,
-        session->dbd->handle,
+    rv = parsegraph_schemaQuery(
+        session,
         &nrows,
         "create table if not exists environment("
             "environment_id integer primary key, "
@@ -101,9 +118,8 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
         return parsegraph_Environment_INTERNAL_ERROR;
     }
 
-    rv = apr_dbd_query(
-        session->dbd->driver,
-        session->dbd->handle,
+    rv = parsegraph_schemaQuery(
+        session,
         &nrows,
         "create table if not exists featured_environment("
             "environment_id integer primary key, "
@@ -119,9 +135,8 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
         return parsegraph_Environment_INTERNAL_ERROR;
     }
 
-    rv = apr_dbd_query(
-        session->dbd->driver,
-        session->dbd->handle,
+    rv = parsegraph_schemaQuery(
+        session,
         &nrows,
         "create table if not exists environment_tag_entry("
             "tag_id integer, "
@@ -138,9 +153,8 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
         return parsegraph_Environment_INTERNAL_ERROR;
     }
 
-    rv = apr_dbd_query(
-        session->dbd->driver,
-        session->dbd->handle,
+    rv = parsegraph_schemaQuery(
+        session,
         &nrows,
         "create table if not exists environment_tag("
             "tag_id integer, "
@@ -156,9 +170,8 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
         return parsegraph_Environment_INTERNAL_ERROR;
     }
 
-    rv = apr_dbd_query(
-        session->dbd->driver,
-        session->dbd->handle,
+    rv = parsegraph_schemaQuery(
+        session,
         &nrows,
         "create table if not exists ignored_environment("
             "environment_id integer, "
@@ -174,9 +187,8 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
         return parsegraph_Environment_INTERNAL_ERROR;
     }
 
-    rv = apr_dbd_query(
-        dbd->driver,
-        dbd->handle,
+    rv = parsegraph_schemaQuery(
+        session,
         &nrows,
         "create table if not exists environment_invite("
             "environment_id integer, "
@@ -194,9 +206,8 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
         return parsegraph_Environment_INTERNAL_ERROR;
     }
 
-    rv = apr_dbd_query(
-        dbd->driver,
-        dbd->handle,
+    rv = parsegraph_schemaQuery(
+        session,
         &nrows,
         "create table if not exists saved_environment("
             "environment_id integer, "
@@ -213,9 +224,8 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
         return parsegraph_Environment_INTERNAL_ERROR;
     }
 
-    rv = apr_dbd_query(
-        dbd->driver,
-        dbd->handle,
+    rv = parsegraph_schemaQuery(
+        session,
         &nrows,
         "create table if not exists environment_permission("
             "environment_id integer, "
@@ -233,9 +243,8 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
         return parsegraph_Environment_INTERNAL_ERROR;
     }
 
-    rv = apr_dbd_query(
-        dbd->driver,
-        dbd->handle,
+    rv = parsegraph_schemaQuery(
+        session,
         &nrows,
         "create table if not exists environment_visit("
             "environment_id integer, "
@@ -252,9 +261,8 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
         return parsegraph_Environment_INTERNAL_ERROR;
     }
 
-    rv = apr_dbd_query(
-        dbd->driver,
-        dbd->handle,
+    rv = parsegraph_schemaQuery(
+        session,
         &nrows,
         "create table if not exists parsegraph_environment_version("
             "version integer"
@@ -305,9 +313,8 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
     }
     else {
         // No version found.
-        rv = apr_dbd_query(
-            dbd->driver,
-            dbd->handle,
+        rv = parsegraph_schemaQuery(
+            session,
             &nrows,
             "insert into parsegraph_environment_version(version) values(0);"
         );
@@ -337,7 +344,7 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
             "alter table environment add environment_title text"
         };
         for(int i = 0; i < sizeof(upgrade)/sizeof(*upgrade); ++i) {
-            rv = apr_dbd_query(dbd->driver, dbd->handle, &nrows, upgrade[i]);
+            rv = parsegraph_schemaQuery(session, &nrows, upgrade[i]);
             if(rv != 0) {
                 marla_logMessagef(session->server,
                     "parsegraph_environment upgrade to version 1 command %d failed to execute: %s",
@@ -350,9 +357,8 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
         }
 
         int nrowsUpdated = 0;
-        rv = apr_dbd_query(
-            dbd->driver,
-            dbd->handle,
+        rv = parsegraph_schemaQuery(
+            session,
             &nrowsUpdated,
             "update parsegraph_environment_version set version = 1"
         );
@@ -390,7 +396,7 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
             "alter table saved_environment add client_state text",
         };
         for(int i = 0; i < sizeof(upgrade)/sizeof(*upgrade); ++i) {
-            rv = apr_dbd_query(dbd->driver, dbd->handle, &nrows, upgrade[i]);
+            rv = parsegraph_schemaQuery(session, &nrows, upgrade[i]);
             if(rv != 0) {
                 marla_logMessagef(session->server,
                     "parsegraph_environment upgrade to version 1 command %d failed to execute: %s",
@@ -403,9 +409,8 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
         }
 
         int nrowsUpdated = 0;
-        rv = apr_dbd_query(
-            dbd->driver,
-            dbd->handle,
+        rv = parsegraph_schemaQuery(
+            session,
             &nrowsUpdated,
             "update parsegraph_environment_version set version = 2"
         );
@@ -438,12 +443,13 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
             return rv;
         }
 
+        // The user upgrade also adds these, so either may run first.
         const char* upgrade[] = {
-            "alter table user add storage_list_id int",
-            "alter table user add disposed_list_id int",
+            "storage_list_id",
+            "disposed_list_id",
         };
         for(int i = 0; i < sizeof(upgrade)/sizeof(*upgrade); ++i) {
-            rv = apr_dbd_query(dbd->driver, dbd->handle, &nrows, upgrade[i]);
+            rv = parsegraph_schemaAddColumn(session, session->authSchema, "user", upgrade[i], "int");
             if(rv != 0) {
                 marla_logMessagef(session->server,
                     "parsegraph_environment upgrade to version %d command %d failed to execute: %s",
@@ -457,9 +463,8 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
         }
 
         int nrowsUpdated = 0;
-        rv = apr_dbd_query(
-            dbd->driver,
-            dbd->handle,
+        rv = parsegraph_schemaQuery(
+            session,
             &nrowsUpdated,
             "update parsegraph_environment_version set version = 3"
         );
@@ -516,7 +521,7 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
             "create table chatroom_ban(chatroom_id integer not null, user_id integer not null)" // 11
         };
         for(int i = 0; i < sizeof(upgrade)/sizeof(*upgrade); ++i) {
-            rv = apr_dbd_query(dbd->driver, dbd->handle, &nrows, upgrade[i]);
+            rv = parsegraph_schemaQuery(session, &nrows, upgrade[i]);
             if(rv != 0) {
                 marla_logMessagef(session->server,
                     "parsegraph_environment upgrade to version %d command %d failed to execute: %s",
@@ -530,9 +535,8 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
         }
 
         int nrowsUpdated = 0;
-        rv = apr_dbd_query(
-            dbd->driver,
-            dbd->handle,
+        rv = parsegraph_schemaQuery(
+            session,
             &nrowsUpdated,
             "update parsegraph_environment_version set version = 4"
         );
@@ -559,6 +563,61 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
         version = 4;
     }
 
+    if(version == 4) {
+        rv = parsegraph_beginTransaction(session, transactionName);
+        if(rv != 0) {
+            return rv;
+        }
+
+        rv = parsegraph_schemaAddColumn(session, 0, "environment", "environment_uuid", "guid blob");
+        if(rv == 0) {
+            rv = parsegraph_schemaQuery(session, &nrows,
+                "create unique index if not exists environment_uuid_index on environment(environment_uuid)");
+        }
+        if(rv != 0) {
+            marla_logMessagef(session->server,
+                "parsegraph_environment upgrade to version %d failed to execute: %s",
+                version + 1,
+                apr_dbd_error(dbd->driver, dbd->handle, rv)
+            );
+            parsegraph_rollbackTransaction(session, transactionName);
+            return -1;
+        }
+        rv = backfillEnvironmentUUIDs(session);
+        if(rv != 0) {
+            parsegraph_rollbackTransaction(session, transactionName);
+            return -1;
+        }
+
+        int nrowsUpdated = 0;
+        rv = parsegraph_schemaQuery(
+            session,
+            &nrowsUpdated,
+            "update parsegraph_environment_version set version = 5"
+        );
+        if(rv != 0) {
+            marla_logMessagef(session->server,
+                "parsegraph_environment_version version update query failed to execute: %s",
+                apr_dbd_error(dbd->driver, dbd->handle, rv)
+            );
+            parsegraph_rollbackTransaction(session, transactionName);
+            return parsegraph_ERROR;
+        }
+        if(nrowsUpdated != 1) {
+            marla_logMessagef(session->server,
+                "Unexpected number of parsegraph_environment_version rows updated: %s",
+                apr_dbd_error(dbd->driver, dbd->handle, rv)
+            );
+        }
+
+        rv = parsegraph_commitTransaction(session, transactionName);
+        if(rv != parsegraph_OK) {
+            parsegraph_rollbackTransaction(session, transactionName);
+            return rv;
+        }
+        version = 5;
+    }
+
     if(version == 99999) {
         rv = parsegraph_beginTransaction(session, transactionName);
         if(rv != 0) {
@@ -582,7 +641,7 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
             ")" // 1
         };
         for(int i = 0; i < sizeof(upgrade)/sizeof(*upgrade); ++i) {
-            rv = apr_dbd_query(dbd->driver, dbd->handle, &nrows, upgrade[i]);
+            rv = parsegraph_schemaQuery(session, &nrows, upgrade[i]);
             if(rv != 0) {
                 marla_logMessagef(session->server,
                     "parsegraph_environment upgrade to version %d command %d failed to execute: %s",
@@ -596,11 +655,10 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
         }
 
         int nrowsUpdated = 0;
-        rv = apr_dbd_query(
-            dbd->driver,
-            dbd->handle,
+        rv = parsegraph_schemaQuery(
+            session,
             &nrowsUpdated,
-            "update parsegraph_environment_version set version = 5"
+            "update parsegraph_environment_version set version = 6"
         );
         if(rv != 0) {
             marla_logMessagef(session->server,
@@ -622,7 +680,7 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
             parsegraph_rollbackTransaction(session, transactionName);
             return rv;
         }
-        version = 5;
+        version = 6;
     }
 
     return parsegraph_Environment_OK;
@@ -630,45 +688,15 @@ parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Sess
 
 parsegraph_EnvironmentStatus parsegraph_lastInsertRowId(parsegraph_Session* session, int* lastInsertedRowId)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
-    const char* queryName = "parsegraph_Environment_last_insert_rowid";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
-        marla_logMessagef(session->server,
-            "%s query was not defined.", queryName
-        );
-        return parsegraph_Environment_UNDEFINED_PREPARED_STATEMENT;
-    }
-
-    apr_dbd_results_t* lastRowid = NULL;
-    if(0 != apr_dbd_pvbselect(dbd->driver, pool, dbd->handle, &lastRowid, query, 0)) {
-        marla_logMessage(session->server,
-            "Failed to retrieve last inserted environment_id for connection."
-        );
-        return parsegraph_Environment_INTERNAL_ERROR;
-    }
-
-    apr_dbd_row_t* row = NULL;
-    if(0 != apr_dbd_get_row(dbd->driver, pool, lastRowid, &row, -1)) {
-        marla_logMessage(session->server,
-            "Failed to get row for last inserted environment_id."
-        );
-        return parsegraph_Environment_INTERNAL_ERROR;
-    }
-
-    switch(apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, lastInsertedRowId)) {
+    switch(parsegraph_lastInsertId(session, lastInsertedRowId)) {
     case APR_SUCCESS:
         break;
     case APR_ENOENT:
         *lastInsertedRowId = -1;
         break;
-    case APR_EGENERAL:
     default:
         marla_logMessage(session->server,
-            "Failed to retrieve last inserted environment_id for connection."
+            "Failed to retrieve last inserted row id for connection."
         );
         return parsegraph_Environment_INTERNAL_ERROR;
     }
@@ -0,0 +1,97 @@
+#include "parsegraph_Statement.h"
+#include <apr_strings.h>
+#include <apr_lib.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Column types that PostgreSQL spells differently. Each replacement is no
+// longer than what it replaces. The schema stores text in blob columns,
+// which PostgreSQL would return as escaped bytea, so columns that do hold
+// bytes are declared as guid blob instead.
+static const struct {
+    const char* sqlite;
+    const char* pgsql;
+} PGSQL_SCHEMA[] = {
+    { "integer primary key", "serial primary key" },
+    { "guid blob", "bytea" },
+    { "blob", "text" },
+    { 0, 0 }
+};
+
+static int isWordChar(char c)
+{
+    return apr_isalnum(c) || c == '_';
+}
+
+const char* parsegraph_translateSchema(parsegraph_Session* session, const char* sql)
+{
+    if(session->dialect != parsegraph_Dialect_PGSQL) {
+        return sql;
+    }
+
+    char* translated = apr_palloc(session->pool, strlen(sql) + 1);
+    char* out = translated;
+    const char* s = sql;
+    while(*s) {
+        int matched = 0;
+        if(s == sql || !isWordChar(s[-1])) {
+            for(int i = 0; PGSQL_SCHEMA[i].sqlite; ++i) {
+                size_t n = strlen(PGSQL_SCHEMA[i].sqlite);
+                if(!strncasecmp(s, PGSQL_SCHEMA[i].sqlite, n) && !isWordChar(s[n])) {
+                    size_t len = strlen(PGSQL_SCHEMA[i].pgsql);
+                    memcpy(out, PGSQL_SCHEMA[i].pgsql, len);
+                    out += len;
+                    s += n;
+                    matched = 1;
+                    break;
+                }
+            }
+        }
+        if(!matched) {
+            *out++ = *s++;
+        }
+    }
+    *out = 0;
+    return translated;
+}
+
+int parsegraph_schemaQuery(parsegraph_Session* session, int* nrows, const char* sql)
+{
+    ap_dbd_t* dbd = session->dbd;
+    return apr_dbd_query(dbd->driver, dbd->handle, nrows, parsegraph_translateSchema(session, sql));
+}
+
+int parsegraph_schemaAddColumn(parsegraph_Session* session, const char* schema, const char* table, const char* column, const char* type)
+{
+    ap_dbd_t* dbd = session->dbd;
+    apr_pool_t* pool = session->pool;
+    const char* sql;
+    if(session->dialect == parsegraph_Dialect_PGSQL) {
+        sql = apr_psprintf(pool, "select count(*) from information_schema.columns "
+            "where table_schema = %s and table_name = '%s' and column_name = '%s'",
+            schema ? apr_psprintf(pool, "'%s'", schema) : "current_schema()", table, column);
+    }
+    else {
+        sql = apr_psprintf(pool, "select count(*) from pragma_table_info('%s', '%s') where name = '%s'",
+            table, schema ? schema : "main", column);
+    }
+
+    apr_dbd_results_t* res = 0;
+    int rv = apr_dbd_select(dbd->driver, pool, dbd->handle, &res, sql, 0);
+    if(rv != 0) {
+        return rv;
+    }
+    int count = 0;
+    apr_dbd_row_t* row = 0;
+    while(0 == apr_dbd_get_row(dbd->driver, pool, res, &row, -1)) {
+        const char* value = apr_dbd_get_entry(dbd->driver, row, 0);
+        count = value ? atoi(value) : 0;
+    }
+    if(count > 0) {
+        return 0;
+    }
+
+    int nrows = 0;
+    return parsegraph_schemaQuery(session, &nrows, apr_psprintf(pool, "alter table %s\"%s\" add %s %s",
+        schema ? apr_pstrcat(pool, schema, ".", NULL) : "", table, column, type));
+}
@@ -1,91 +1,79 @@
 #include "parsegraph_environment.h"
+#include "parsegraph_Statement.h"
+#include "parsegraph_Shards.h"
+#include "parsegraph_Random.h"
+#include <apr_general.h>
+#include <stdlib.h>
+
+// Parses env for binding to an environment_uuid parameter. Returns 0, or -1 if env is not a GUID.
+static int parseEnvironmentUUID(parsegraph_Session* session, parsegraph_GUID* env, parsegraph_BinaryGUID* uuid)
+{
+    if(0 != parsegraph_GUID_parse(env, uuid)) {
+        marla_logMessagef(session->server, "Malformed environment GUID: %.36s", env->value);
+        return -1;
+    }
+    return 0;
+}
 
 parsegraph_EnvironmentStatus parsegraph_createEnvironment(parsegraph_Session* session, int ownerId, int rootListId, int environmentTypeId, parsegraph_GUID* createdEnv)
+{
+    if(session->shards) {
+        // The environment and its root list must both live in its shard.
+        return parsegraph_Shards_createEnvironment(session->shards, ownerId, environmentTypeId, createdEnv);
+    }
+
+    // Generate the GUID here rather than with SQL functions in the insert.
+    if(APR_SUCCESS != parsegraph_generateEnvironmentGUID(session, createdEnv)) {
+        marla_logMessagef(session->server, "Failed to generate environment GUID.");
+        return parsegraph_Environment_INTERNAL_ERROR;
+    }
+    return parsegraph_createEnvironmentWithGUID(session, createdEnv, ownerId, rootListId, environmentTypeId);
+}
+
+parsegraph_EnvironmentStatus parsegraph_createEnvironmentWithGUID(parsegraph_Session* session, parsegraph_GUID* env, int ownerId, int rootListId, int environmentTypeId)
 {
     ap_dbd_t* dbd = session->dbd;
     apr_pool_t* pool = session->pool;
-    //"parsegraph_Environment_createEnvironment", "INSERT INTO environment(environment_guid, for_new_users, for_administrators, create_date, open_to_public, open_for_visits, open_for_modification, visit_count, owner, root_list_id, environment_type_id) VALUES(lower(hex(randomblob(16))), 0, 0, strftime('%%Y-%%m-%%dT%%H:%%M:%%f', 'now'), 0, 0, 0, 0, %d, NULL, %d)", // 1
-
-    const char* queryName = "parsegraph_Environment_createEnvironment";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    const char* queryName = "parsegraph_Environment_createEnvironmentWithGUID";
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_Environment_createEnvironmentWithGUID)) {
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_Environment_INTERNAL_ERROR;
     }
-    int nrows = 0;
-    int dbrv = apr_dbd_pvbquery(
-        dbd->driver,
+    parsegraph_BinaryGUID uuid;
+    apr_size_t uuidSize = sizeof uuid.bytes;
+    if(0 != parseEnvironmentUUID(session, env, &uuid)) {
+        return parsegraph_Environment_INTERNAL_ERROR;
+    }
+    int envId;
+    int dbrv = parsegraph_insertReturning(
+        session,
         pool,
-        dbd->handle,
-        &nrows,
-        query,
+        parsegraph_Statement_Environment_createEnvironmentWithGUID,
+        &envId,
+        env->value,
+        uuid.bytes,
+        &uuidSize,
+        "environment",
+        "environment_uuid",
         &ownerId,
         &rootListId,
         &environmentTypeId
     );
-    if(dbrv != 0) {
-        marla_logMessagef(session->server,
-            "%s query failed to execute: %s", queryName,
-            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
-        );
-        return parsegraph_Environment_INTERNAL_ERROR;
-    }
-    if(nrows == 0) {
+    if(dbrv == APR_ENOENT) {
         marla_logMessagef(session->server,
             "Environment was not created despite query."
         );
         return parsegraph_Environment_INTERNAL_ERROR;
     }
-    if(nrows != 1) {
-        marla_logMessagef(session->server,
-            "Unexpected number of insertions when creating environment: %d insertion(s).", nrows
-        );
-        return parsegraph_Environment_INTERNAL_ERROR;
-    }
-
-    queryName = "parsegraph_Environment_last_insert_rowid";
-    query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
-        marla_logMessagef(session->server,
-            "%s query was not defined.", queryName
-        );
-        return parsegraph_Environment_INTERNAL_ERROR;
-    }
-
-    apr_dbd_results_t* lastRowid = NULL;
-    if(0 != apr_dbd_pvbselect(dbd->driver, pool, dbd->handle, &lastRowid, query, 0)) {
-        marla_logMessagef(session->server,
-            "Failed to retrieve last inserted environment_id for connection."
-        );
-        return parsegraph_Environment_INTERNAL_ERROR;
-    }
-
-    apr_dbd_row_t* row = NULL;
-    if(0 != apr_dbd_get_row(dbd->driver, pool, lastRowid, &row, -1)) {
-        marla_logMessagef(session->server,
-            "Failed to get row for last inserted environment_id."
-        );
-        return parsegraph_Environment_INTERNAL_ERROR;
-    }
-
-    int envId;
-    switch(apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, &envId)) {
-    case APR_SUCCESS:
-        break;
-    case APR_ENOENT:
-    case APR_EGENERAL:
-    default:
+    if(dbrv != 0) {
         marla_logMessagef(session->server,
-            "Failed to retrieve last inserted environment_id for connection."
+            "%s query failed to execute: %s", queryName,
+            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
         );
         return parsegraph_Environment_INTERNAL_ERROR;
     }
 
-    return parsegraph_getEnvironmentGUIDForId(session, envId, createdEnv);
+    return parsegraph_Environment_OK;
 }
 
 parsegraph_EnvironmentStatus parsegraph_getEnvironmentGUIDForId(parsegraph_Session* session, int environmentId, parsegraph_GUID* env)
@@ -93,10 +81,7 @@ parsegraph_EnvironmentStatus parsegraph_getEnvironmentGUIDForId(parsegraph_Sessi
     ap_dbd_t* dbd = session->dbd;
     apr_pool_t* pool = session->pool;
     const char* queryName = "parsegraph_Environment_getEnvironmentGUIDForId";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_Environment_getEnvironmentGUIDForId)) {
         marla_logMessagef(session->server,
             "%s query was not defined.", queryName
         );
@@ -104,12 +89,11 @@ parsegraph_EnvironmentStatus parsegraph_getEnvironmentGUIDForId(parsegraph_Sessi
     }
 
     apr_dbd_results_t* res = NULL;
-    int dbrv = apr_dbd_pvbselect(
-        dbd->driver,
+    int dbrv = parsegraph_pvbselect(
+        session,
         pool,
-        dbd->handle,
         &res,
-        query,
+        parsegraph_Statement_Environment_getEnvironmentGUIDForId,
         0,
         &environmentId
     );
@@ -150,21 +134,24 @@ parsegraph_EnvironmentStatus parsegraph_cloneEnvironment(parsegraph_Session* ses
 
 parsegraph_EnvironmentStatus parsegraph_destroyEnvironment(parsegraph_Session* session, parsegraph_GUID* targetedEnv)
 {
+    session = parsegraph_Session_forEnvironment(session, targetedEnv);
     ap_dbd_t* dbd = session->dbd;
     apr_pool_t* pool = session->pool;
     const char* queryName = "parsegraph_Environment_destroyEnvironment";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_Environment_destroyEnvironment)) {
         marla_logMessagef(session->server,
             "%s query was not defined.", queryName
         );
         return parsegraph_Environment_INTERNAL_ERROR;
     }
 
+    parsegraph_BinaryGUID uuid;
+    apr_size_t uuidSize = sizeof uuid.bytes;
+    if(0 != parseEnvironmentUUID(session, targetedEnv, &uuid)) {
+        return parsegraph_Environment_NOT_FOUND;
+    }
     int nrows;
-    int dbrv = apr_dbd_pvquery(dbd->driver, pool, dbd->handle, &nrows, query, targetedEnv->value);
+    int dbrv = parsegraph_pvbquery(session, pool, &nrows, parsegraph_Statement_Environment_destroyEnvironment, uuid.bytes, &uuidSize, "environment", "environment_uuid");
     if(dbrv != 0) {
         marla_logMessagef(session->server,
             "%s query failed to execute: %s", queryName,
@@ -187,6 +174,7 @@ parsegraph_EnvironmentStatus parsegraph_destroyEnvironment(parsegraph_Session* s
 
 parsegraph_EnvironmentStatus parsegraph_getEnvironmentTitleForGUID(parsegraph_Session* session, parsegraph_GUID* env, const char** titleOut)
 {
+    session = parsegraph_Session_forEnvironment(session, env);
     ap_dbd_t* dbd = session->dbd;
     apr_pool_t* pool = session->pool;
     if(!env) {
@@ -203,18 +191,20 @@ parsegraph_EnvironmentStatus parsegraph_getEnvironmentTitleForGUID(parsegraph_Se
     }
 
     const char* queryName = "parsegraph_Environment_getEnvironmentTitleForGUID";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_Environment_getEnvironmentTitleForGUID)) {
         marla_logMessagef(session->server,
             "%s query was not defined.", queryName
         );
         return parsegraph_Environment_UNDEFINED_PREPARED_STATEMENT;
     }
 
+    parsegraph_BinaryGUID uuid;
+    apr_size_t uuidSize = sizeof uuid.bytes;
+    if(0 != parseEnvironmentUUID(session, env, &uuid)) {
+        return parsegraph_Environment_NOT_FOUND;
+    }
     apr_dbd_results_t* titleRes = 0;
-    int dbrv = apr_dbd_pvselect(dbd->driver, pool, dbd->handle, &titleRes, query, 0, env->value);
+    int dbrv = parsegraph_pvbselect(session, pool, &titleRes, parsegraph_Statement_Environment_getEnvironmentTitleForGUID, 0, uuid.bytes, &uuidSize, "environment", "environment_uuid");
     if(dbrv != 0) {
         marla_logMessagef(session->server,
             "%s query failed to execute: %s", queryName,
@@ -246,15 +236,52 @@ int parsegraph_guid_init(parsegraph_GUID* guid)
     return 0;
 }
 
+int parsegraph_generateGUID(parsegraph_GUID* guid)
+{
+    parsegraph_BinaryGUID bin;
+    int rv = parsegraph_randomBytes(bin.bytes, sizeof bin.bytes);
+    if(rv != APR_SUCCESS) {
+        return rv;
+    }
+    parsegraph_GUID_format(&bin, guid);
+    return APR_SUCCESS;
+}
+
+int parsegraph_generateTimeOrderedGUID(parsegraph_GUID* guid)
+{
+    parsegraph_BinaryGUID bin;
+    int rv = parsegraph_randomBytes(bin.bytes + 8, 8);
+    if(rv != APR_SUCCESS) {
+        return rv;
+    }
+    apr_time_t now = apr_time_now();
+    apr_uint64_t ms = now / 1000;
+    unsigned int fraction = (now % 1000) * 4096 / 1000;
+    for(int i = 0; i < 6; ++i) {
+        bin.bytes[i] = (ms >> (40 - 8 * i)) & 0xff;
+    }
+    bin.bytes[6] = 0x70 | (fraction >> 8);
+    bin.bytes[7] = fraction & 0xff;
+    bin.bytes[8] = 0x80 | (bin.bytes[8] & 0x3f);
+    parsegraph_GUID_format(&bin, guid);
+    return APR_SUCCESS;
+}
+
+int parsegraph_generateEnvironmentGUID(parsegraph_Session* session, parsegraph_GUID* guid)
+{
+    if(session->timeOrderedGUIDs) {
+        return parsegraph_generateTimeOrderedGUID(guid);
+    }
+    return parsegraph_generateGUID(guid);
+}
+
 parsegraph_EnvironmentStatus parsegraph_getEnvironmentIdForGUID(parsegraph_Session* session, parsegraph_GUID* onlineEnv, int* environmentId)
 {
+    session = parsegraph_Session_forEnvironment(session, onlineEnv);
     ap_dbd_t* dbd = session->dbd;
     apr_pool_t* pool = session->pool;
     const char* queryName = "parsegraph_Environment_getEnvironmentIdForGUID";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_Environment_getEnvironmentIdForGUID)) {
          // Query was not defined.
         marla_logMessagef(session->server,
             "%s query was not defined.", queryName
@@ -262,15 +289,22 @@ parsegraph_EnvironmentStatus parsegraph_getEnvironmentIdForGUID(parsegraph_Sessi
         return parsegraph_UNDEFINED_PREPARED_STATEMENT;
     }
 
+    parsegraph_BinaryGUID uuid;
+    apr_size_t uuidSize = sizeof uuid.bytes;
+    if(0 != parseEnvironmentUUID(session, onlineEnv, &uuid)) {
+        return parsegraph_Environment_NOT_FOUND;
+    }
     apr_dbd_results_t* res = 0;
-    int dbrv = apr_dbd_pvselect(
-        dbd->driver,
+    int dbrv = parsegraph_pvbselect(
+        session,
         pool,
-        dbd->handle,
         &res,
-        query,
+        parsegraph_Statement_Environment_getEnvironmentIdForGUID,
         0,
-        &(onlineEnv->value)
+        uuid.bytes,
+        &uuidSize,
+        "environment",
+        "environment_uuid"
     );
     if(dbrv != 0) {
         marla_logMessagef(session->server,
@@ -319,13 +353,11 @@ parsegraph_EnvironmentStatus parsegraph_getEnvironmentIdForGUID(parsegraph_Sessi
 
 parsegraph_EnvironmentStatus parsegraph_saveEnvironment(parsegraph_Session* session, int userId, parsegraph_GUID* env, const char* clientSaveState)
 {
+    session = parsegraph_Session_forEnvironment(session, env);
     ap_dbd_t* dbd = session->dbd;
     apr_pool_t* pool = session->pool;
     const char* queryName = "parsegraph_Environment_saveEnvironment";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_Environment_saveEnvironment)) {
          // Query was not defined.
         marla_logMessagef(session->server,
             "%s query was not defined.", queryName
@@ -343,7 +375,7 @@ parsegraph_EnvironmentStatus parsegraph_saveEnvironment(parsegraph_Session* sess
 
     // Save the environment.
     int nrows;
-    int rv = apr_dbd_pvbquery(dbd->driver, pool, dbd->handle, &nrows, query,
+    int rv = parsegraph_pvbquery(session, pool, &nrows, parsegraph_Statement_Environment_saveEnvironment,
         &envId, &userId, clientSaveState
     );
     if(rv != 0) {
@@ -365,13 +397,16 @@ parsegraph_EnvironmentStatus parsegraph_saveEnvironment(parsegraph_Session* sess
 
 parsegraph_EnvironmentStatus parsegraph_getSavedEnvironmentGUIDs(parsegraph_Session* session, int userId, apr_dbd_results_t** savedEnvGUIDs)
 {
+    if(session->shards) {
+        marla_logMessagef(session->server,
+            "Saved environments must be listed across shards with parsegraph_listSavedEnvironments."
+        );
+        return parsegraph_Environment_INTERNAL_ERROR;
+    }
     ap_dbd_t* dbd = session->dbd;
     apr_pool_t* pool = session->pool;
     const char* queryName = "parsegraph_Environment_getSavedEnvironmentsForUser";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_Environment_getSavedEnvironmentsForUser)) {
          // Query was not defined.
         marla_logMessagef(session->server,
             "%s query was not defined.", queryName
@@ -379,12 +414,11 @@ parsegraph_EnvironmentStatus parsegraph_getSavedEnvironmentGUIDs(parsegraph_Sess
         return parsegraph_UNDEFINED_PREPARED_STATEMENT;
     }
 
-    int dbrv = apr_dbd_pvbselect(
-        dbd->driver,
+    int dbrv = parsegraph_pvbselect(
+        session,
         pool,
-        dbd->handle,
         savedEnvGUIDs,
-        query,
+        parsegraph_Statement_Environment_getSavedEnvironmentsForUser,
         0,
         &userId
     );
@@ -401,13 +435,16 @@ parsegraph_EnvironmentStatus parsegraph_getSavedEnvironmentGUIDs(parsegraph_Sess
 
 parsegraph_EnvironmentStatus parsegraph_getOwnedEnvironmentGUIDs(parsegraph_Session* session, int userId, apr_dbd_results_t** envs)
 {
+    if(session->shards) {
+        marla_logMessagef(session->server,
+            "Owned environments must be listed across shards with parsegraph_listOwnedEnvironments."
+        );
+        return parsegraph_Environment_INTERNAL_ERROR;
+    }
     ap_dbd_t* dbd = session->dbd;
     apr_pool_t* pool = session->pool;
     const char* queryName = "parsegraph_Environment_getOwnedEnvironmentsForUser";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_Environment_getOwnedEnvironmentsForUser)) {
          // Query was not defined.
         marla_logMessagef(session->server,
             "%s query was not defined.", queryName
@@ -415,12 +452,11 @@ parsegraph_EnvironmentStatus parsegraph_getOwnedEnvironmentGUIDs(parsegraph_Sess
         return parsegraph_UNDEFINED_PREPARED_STATEMENT;
     }
 
-    int dbrv = apr_dbd_pvbselect(
-        dbd->driver,
+    int dbrv = parsegraph_pvbselect(
+        session,
         pool,
-        dbd->handle,
         envs,
-        query,
+        parsegraph_Statement_Environment_getOwnedEnvironmentsForUser,
         0,
         &userId
     );
@@ -435,15 +471,76 @@ parsegraph_EnvironmentStatus parsegraph_getOwnedEnvironmentGUIDs(parsegraph_Sess
     return parsegraph_Environment_OK;
 }
 
+// Appends the environments listed by the given statement in one database.
+static parsegraph_EnvironmentStatus appendEnvironments(parsegraph_Session* session, apr_pool_t* pool, parsegraph_StatementId id, int userId, apr_array_header_t* envs)
+{
+    parsegraph_Cursor cursor;
+    if(0 != parsegraph_Cursor_open(&cursor, session, pool, id, &userId)) {
+        marla_logMessagef(session->server, "Failed to list environments for user %d.", userId);
+        return parsegraph_Environment_INTERNAL_ERROR;
+    }
+    for(;;) {
+        int dbrv = parsegraph_Cursor_next(&cursor);
+        if(dbrv == APR_EOF) {
+            break;
+        }
+        const char* guid = dbrv == APR_SUCCESS ? parsegraph_Cursor_text(&cursor, 0) : 0;
+        if(!guid) {
+            marla_logMessagef(session->server, "Failed to read environments for user %d.", userId);
+            parsegraph_Cursor_close(&cursor);
+            return parsegraph_Environment_INTERNAL_ERROR;
+        }
+        parsegraph_EnvironmentSummary* env = apr_array_push(envs);
+        strncpy(env->envGUID.value, guid, 36);
+        env->envGUID.value[36] = 0;
+        env->title = parsegraph_Cursor_text(&cursor, 1);
+        env->date = parsegraph_Cursor_text(&cursor, 2);
+    }
+    parsegraph_Cursor_close(&cursor);
+    return parsegraph_Environment_OK;
+}
+
+// Orders the most recent first; dates are stored as sortable text.
+static int compareSummaryDates(const void* a, const void* b)
+{
+    const char* da = ((const parsegraph_EnvironmentSummary*)a)->date;
+    const char* db = ((const parsegraph_EnvironmentSummary*)b)->date;
+    return strcmp(db ? db : "", da ? da : "");
+}
+
+static parsegraph_EnvironmentStatus listEnvironments(parsegraph_Session* session, apr_pool_t* pool, parsegraph_StatementId id, int userId, apr_array_header_t** envs)
+{
+    *envs = apr_array_make(pool, 8, sizeof(parsegraph_EnvironmentSummary));
+    if(!session->shards) {
+        return appendEnvironments(session, pool, id, userId, *envs);
+    }
+    for(int i = 0; i < parsegraph_Shards_count(session->shards); ++i) {
+        parsegraph_EnvironmentStatus erv = appendEnvironments(parsegraph_Shards_shard(session->shards, i), pool, id, userId, *envs);
+        if(erv != parsegraph_Environment_OK) {
+            return erv;
+        }
+    }
+    qsort((*envs)->elts, (*envs)->nelts, sizeof(parsegraph_EnvironmentSummary), compareSummaryDates);
+    return parsegraph_Environment_OK;
+}
+
+parsegraph_EnvironmentStatus parsegraph_listSavedEnvironments(parsegraph_Session* session, apr_pool_t* pool, int userId, apr_array_header_t** envs)
+{
+    return listEnvironments(session, pool, parsegraph_Statement_Environment_getSavedEnvironmentsForUser, userId, envs);
+}
+
+parsegraph_EnvironmentStatus parsegraph_listOwnedEnvironments(parsegraph_Session* session, apr_pool_t* pool, int userId, apr_array_header_t** envs)
+{
+    return listEnvironments(session, pool, parsegraph_Statement_Environment_getOwnedEnvironmentsForUser, userId, envs);
+}
+
 parsegraph_EnvironmentStatus parsegraph_getEnvironmentRoot(parsegraph_Session* session, parsegraph_GUID* env, int* rootListId)
 {
+    session = parsegraph_Session_forEnvironment(session, env);
     ap_dbd_t* dbd = session->dbd;
     apr_pool_t* pool = session->pool;
     const char* queryName = "parsegraph_Environment_getEnvironmentRoot";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_Environment_getEnvironmentRoot)) {
          // Query was not defined.
         marla_logMessagef(session->server,
             "%s query was not defined.", queryName
@@ -451,15 +548,23 @@ parsegraph_EnvironmentStatus parsegraph_getEnvironmentRoot(parsegraph_Session* s
         return parsegraph_Environment_UNDEFINED_PREPARED_STATEMENT;
     }
 
+    parsegraph_BinaryGUID uuid;
+    apr_size_t uuidSize = sizeof uuid.bytes;
+    if(0 != parseEnvironmentUUID(session, env, &uuid)) {
+        *rootListId = -1;
+        return parsegraph_Environment_NOT_FOUND;
+    }
     apr_dbd_results_t* res = 0;
-    int dbrv = apr_dbd_pvbselect(
-        dbd->driver,
+    int dbrv = parsegraph_pvbselect(
+        session,
         pool,
-        dbd->handle,
         &res,
-        query,
+        parsegraph_Statement_Environment_getEnvironmentRoot,
         0,
-        env->value
+        uuid.bytes,
+        &uuidSize,
+        "environment",
+        "environment_uuid"
     );
     if(dbrv != 0) {
         marla_logMessagef(session->server,
@@ -508,6 +613,7 @@ parsegraph_EnvironmentStatus parsegraph_getEnvironmentRoot(parsegraph_Session* s
 
 parsegraph_EnvironmentStatus parsegraph_setEnvironmentRoot(parsegraph_Session* session, parsegraph_GUID* env, int listId)
 {
+    session = parsegraph_Session_forEnvironment(session, env);
     ap_dbd_t* dbd = session->dbd;
     apr_pool_t* pool = session->pool;
     const char* transactionName = "parsegraph_setEnvironmentRoot";
@@ -516,10 +622,7 @@ parsegraph_EnvironmentStatus parsegraph_setEnvironmentRoot(parsegraph_Session* s
     }
 
     const char* queryName = "parsegraph_Environment_setEnvironmentRoot";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_Environment_setEnvironmentRoot)) {
          // Query was not defined.
         marla_logMessagef(session->server,
             "%s query was not defined.", queryName
@@ -528,15 +631,23 @@ parsegraph_EnvironmentStatus parsegraph_setEnvironmentRoot(parsegraph_Session* s
         return parsegraph_Environment_UNDEFINED_PREPARED_STATEMENT;
     }
 
+    parsegraph_BinaryGUID uuid;
+    apr_size_t uuidSize = sizeof uuid.bytes;
+    if(0 != parseEnvironmentUUID(session, env, &uuid)) {
+        parsegraph_rollbackTransaction(session, transactionName);
+        return parsegraph_Environment_NOT_FOUND;
+    }
     int nrows;
-    int dbrv = apr_dbd_pvbquery(
-        dbd->driver,
+    int dbrv = parsegraph_pvbquery(
+        session,
         pool,
-        dbd->handle,
         &nrows,
-        query,
+        parsegraph_Statement_Environment_setEnvironmentRoot,
         &listId,
-        env->value
+        uuid.bytes,
+        &uuidSize,
+        "environment",
+        "environment_uuid"
     );
     if(dbrv != 0) {
         marla_logMessagef(session->server,
@@ -0,0 +1,126 @@
+#include "parsegraph_environment.h"
+#include <string.h>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+// Copies the 32 hex digits of a GUID's text form to hex, skipping its dashes.
+static void gatherDigits(const char* in, char* hex)
+{
+    memcpy(hex, in, 8);
+    memcpy(hex + 8, in + 9, 4);
+    memcpy(hex + 12, in + 14, 4);
+    memcpy(hex + 16, in + 19, 4);
+    memcpy(hex + 20, in + 24, 12);
+}
+
+#if !defined(__SSSE3__)
+static int hexValue(char c)
+{
+    if(c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20;
+    if(c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+#endif
+
+int parsegraph_GUID_parse(const parsegraph_GUID* guid, parsegraph_BinaryGUID* bin)
+{
+    const char* in = guid->value;
+    if(in[8] != '-' || in[13] != '-' || in[18] != '-' || in[23] != '-' || in[36] != 0) {
+        return -1;
+    }
+    char hex[32];
+    gatherDigits(in, hex);
+
+#if defined(__SSSE3__)
+    __m128i pairs[2];
+    for(int i = 0; i < 2; ++i) {
+        __m128i c = _mm_loadu_si128((const __m128i*)(hex + 16 * i));
+        __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+        __m128i isDigit = _mm_and_si128(
+            _mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+            _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1))
+        );
+        __m128i isLetter = _mm_and_si128(
+            _mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+            _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1))
+        );
+        if(_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) != 0xffff) {
+            return -1;
+        }
+        __m128i nibbles = _mm_or_si128(
+            _mm_and_si128(isDigit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+            _mm_and_si128(isLetter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10)))
+        );
+        // Each 16-bit lane becomes 16 times its first digit plus its second.
+        pairs[i] = _mm_maddubs_epi16(nibbles, _mm_set1_epi16(0x0110));
+    }
+    _mm_storeu_si128((__m128i*)bin->bytes, _mm_packus_epi16(pairs[0], pairs[1]));
+#else
+    for(int i = 0; i < 16; ++i) {
+        int high = hexValue(hex[2 * i]);
+        int low = hexValue(hex[2 * i + 1]);
+        if(high < 0 || low < 0) {
+            return -1;
+        }
+        bin->bytes[i] = (high << 4) | low;
+    }
+#endif
+    return 0;
+}
+
+void parsegraph_GUID_format(const parsegraph_BinaryGUID* bin, parsegraph_GUID* guid)
+{
+    char hex[32];
+#if defined(__SSSE3__)
+    const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i v = _mm_loadu_si128((const __m128i*)bin->bytes);
+    __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+    __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(v, mask));
+    _mm_storeu_si128((__m128i*)hex, _mm_unpacklo_epi8(high, low));
+    _mm_storeu_si128((__m128i*)(hex + 16), _mm_unpackhi_epi8(high, low));
+#else
+    static const char* digits = "0123456789abcdef";
+    for(int i = 0; i < 16; ++i) {
+        hex[2 * i] = digits[bin->bytes[i] >> 4];
+        hex[2 * i + 1] = digits[bin->bytes[i] & 0xf];
+    }
+#endif
+
+    char* out = guid->value;
+    memcpy(out, hex, 8);
+    out[8] = '-';
+    memcpy(out + 9, hex + 8, 4);
+    out[13] = '-';
+    memcpy(out + 14, hex + 12, 4);
+    out[18] = '-';
+    memcpy(out + 19, hex + 16, 4);
+    out[23] = '-';
+    memcpy(out + 24, hex + 20, 12);
+    out[36] = 0;
+}
+
+int parsegraph_BinaryGUID_equal(const parsegraph_BinaryGUID* a, const parsegraph_BinaryGUID* b)
+{
+    apr_uint64_t aw[2], bw[2];
+    memcpy(aw, a->bytes, sizeof aw);
+    memcpy(bw, b->bytes, sizeof bw);
+    return aw[0] == bw[0] && aw[1] == bw[1];
+}
+
+unsigned int parsegraph_BinaryGUID_hash(const char* key, apr_ssize_t* klen)
+{
+    // Random GUIDs are already uniform, so folding their words suffices.
+    apr_uint64_t words[2];
+    memcpy(words, key, sizeof words);
+    *klen = sizeof words;
+    apr_uint64_t folded = words[0] ^ words[1];
+    return (unsigned int)(folded ^ (folded >> 32));
+}
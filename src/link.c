@@ -8,6 +8,7 @@ parsegraph_EnvironmentStatus parsegraph_createEnvironmentLink(parsegraph_Session
     }
 
     if(parsegraph_List_OK != parsegraph_List_newItem(session, -1, parsegraph_BlockType_EnvironmentLink, env->value, createdItemId)) {
+        parsegraph_rollbackTransaction(session, transactionName);
         return parsegraph_Environment_INTERNAL_ERROR;
     }
 
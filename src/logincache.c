@@ -0,0 +1,543 @@
+#include "parsegraph_LoginCache.h"
+#include <apr_hash.h>
+#include <apr_strings.h>
+#include <apr_thread_mutex.h>
+#include <apr_thread_proc.h>
+#include <apr_atomic.h>
+#include <apr_shm.h>
+#include <openssl/sha.h>
+#include <openssl/crypto.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+// Longer selectors and usernames are never cached.
+#define SELECTOR_MAX 64
+#define USERNAME_MAX 64
+
+struct parsegraph_LoginCacheEntry {
+    char selector[SELECTOR_MAX + 1];
+    unsigned char tokenDigest[SHA256_DIGEST_LENGTH];
+    char username[USERNAME_MAX + 1];
+    int userId;
+    apr_time_t expires;
+
+    // Neighbors in recency order, or the next free entry.
+    struct parsegraph_LoginCacheEntry* prev;
+    struct parsegraph_LoginCacheEntry* next;
+};
+
+// Entries of a shared cache live in buckets of a fixed number of slots.
+#define SHARED_WAYS 8
+#define SHARED_MAGIC 0x70674c44
+
+// How many times a slot or bucket is retried before its writer is given up
+// on. Writes take well under a microsecond, so only a writer that died or
+// was descheduled mid-write exhausts these.
+#define SHARED_READ_SPINS 1000
+#define SHARED_LOCK_SPINS 1000
+
+struct parsegraph_SharedLoginSlot {
+    // Odd while the slot is being written.
+    volatile apr_uint32_t seq;
+
+    // Set when read, and cleared as the eviction clock passes.
+    volatile apr_uint32_t referenced;
+
+    apr_uint32_t flags;
+    int userId;
+    apr_time_t expires;
+    unsigned char tokenDigest[SHA256_DIGEST_LENGTH];
+    char selector[SELECTOR_MAX + 1];
+    char username[USERNAME_MAX + 1];
+};
+
+#define SHARED_SLOT_USED 1
+
+struct parsegraph_SharedLoginBucket {
+    // The pid of the process whose writer holds the bucket, or 0. Readers
+    // never take it.
+    volatile apr_uint32_t lock;
+    apr_uint32_t hand;
+    struct parsegraph_SharedLoginSlot slots[SHARED_WAYS];
+};
+
+struct parsegraph_SharedLoginTable {
+    apr_uint32_t magic;
+    apr_uint32_t nbuckets;
+    apr_interval_time_t ttl;
+    struct parsegraph_SharedLoginBucket buckets[];
+};
+
+struct parsegraph_LoginCache {
+    apr_pool_t* pool;
+
+    // The table in shared memory, or NULL if this cache is private to the process.
+    apr_shm_t* shm;
+    struct parsegraph_SharedLoginTable* shared;
+
+    apr_thread_mutex_t* lock;
+    apr_interval_time_t ttl;
+
+    // Entries by selector.
+    apr_hash_t* index;
+
+    // All entries are allocated up front; unused ones are on the free list.
+    int capacity;
+    int size;
+    struct parsegraph_LoginCacheEntry* entries;
+    struct parsegraph_LoginCacheEntry* free;
+
+    // Most recently used first.
+    struct parsegraph_LoginCacheEntry* head;
+    struct parsegraph_LoginCacheEntry* tail;
+
+    // Counted per process, even for a shared cache, so that processes do not
+    // contend for the same cache line on every lookup.
+    volatile apr_uint64_t hits;
+    volatile apr_uint64_t misses;
+    volatile apr_uint64_t evictions;
+};
+
+parsegraph_LoginCache* parsegraph_LoginCache_new(apr_pool_t* parent, int capacity, apr_interval_time_t ttl)
+{
+    apr_pool_t* pool;
+    if(capacity <= 0 || APR_SUCCESS != apr_pool_create(&pool, parent)) {
+        return 0;
+    }
+    parsegraph_LoginCache* cache = apr_pcalloc(pool, sizeof(*cache));
+    cache->pool = pool;
+    cache->ttl = ttl;
+    cache->capacity = capacity;
+    if(APR_SUCCESS != apr_thread_mutex_create(&cache->lock, APR_THREAD_MUTEX_DEFAULT, pool)) {
+        apr_pool_destroy(pool);
+        return 0;
+    }
+    cache->index = apr_hash_make(pool);
+    cache->entries = apr_pcalloc(pool, sizeof(struct parsegraph_LoginCacheEntry) * capacity);
+    for(int i = 0; i < capacity; ++i) {
+        cache->entries[i].next = i + 1 < capacity ? &cache->entries[i + 1] : 0;
+    }
+    cache->free = cache->entries;
+    return cache;
+}
+
+void parsegraph_LoginCache_destroy(parsegraph_LoginCache* cache)
+{
+    apr_pool_destroy(cache->pool);
+}
+
+static void detachEntry(parsegraph_LoginCache* cache, struct parsegraph_LoginCacheEntry* entry)
+{
+    if(entry->prev) {
+        entry->prev->next = entry->next;
+    }
+    else {
+        cache->head = entry->next;
+    }
+    if(entry->next) {
+        entry->next->prev = entry->prev;
+    }
+    else {
+        cache->tail = entry->prev;
+    }
+    entry->prev = 0;
+    entry->next = 0;
+}
+
+static void pushFront(parsegraph_LoginCache* cache, struct parsegraph_LoginCacheEntry* entry)
+{
+    entry->prev = 0;
+    entry->next = cache->head;
+    if(cache->head) {
+        cache->head->prev = entry;
+    }
+    else {
+        cache->tail = entry;
+    }
+    cache->head = entry;
+}
+
+static void removeEntry(parsegraph_LoginCache* cache, struct parsegraph_LoginCacheEntry* entry)
+{
+    apr_hash_set(cache->index, entry->selector, APR_HASH_KEY_STRING, 0);
+    detachEntry(cache, entry);
+    entry->selector[0] = 0;
+    entry->next = cache->free;
+    cache->free = entry;
+    --cache->size;
+}
+
+static void digestToken(const char* token, unsigned char* digest)
+{
+    SHA256((const unsigned char*)token, strlen(token), digest);
+}
+
+static apr_uint32_t hashSelector(const char* selector)
+{
+    apr_uint32_t hash = 2166136261u;
+    for(const char* c = selector; *c; ++c) {
+        hash ^= (unsigned char)*c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void beginWrite(struct parsegraph_SharedLoginSlot* slot)
+{
+    apr_atomic_inc32(&slot->seq);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void endWrite(struct parsegraph_SharedLoginSlot* slot)
+{
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    apr_atomic_inc32(&slot->seq);
+}
+
+// Clears slots left mid-write by a writer that died holding the bucket.
+static void repairBucket(struct parsegraph_SharedLoginBucket* bucket)
+{
+    for(int i = 0; i < SHARED_WAYS; ++i) {
+        struct parsegraph_SharedLoginSlot* slot = &bucket->slots[i];
+        if(apr_atomic_read32(&slot->seq) & 1) {
+            slot->flags = 0;
+            slot->selector[0] = 0;
+            endWrite(slot);
+        }
+    }
+}
+
+/**
+ * Locks the bucket for this process. A bucket held by a process that no
+ * longer exists is taken over. If wait is zero, gives up and returns -1 when
+ * a live writer holds the bucket for too long; otherwise returns 0.
+ */
+static int lockBucket(struct parsegraph_SharedLoginBucket* bucket, int wait)
+{
+    apr_uint32_t self = (apr_uint32_t)getpid();
+    for(;;) {
+        for(int i = 0; i < SHARED_LOCK_SPINS; ++i) {
+            apr_uint32_t owner = apr_atomic_cas32(&bucket->lock, self, 0);
+            if(owner == 0) {
+                return 0;
+            }
+            if(owner != self && kill((pid_t)owner, 0) != 0 && errno == ESRCH
+                && owner == apr_atomic_cas32(&bucket->lock, self, owner)) {
+                repairBucket(bucket);
+                return 0;
+            }
+            apr_thread_yield();
+        }
+        if(!wait) {
+            return -1;
+        }
+    }
+}
+
+static void unlockBucket(struct parsegraph_SharedLoginBucket* bucket)
+{
+    apr_atomic_set32(&bucket->lock, 0);
+}
+
+// Copies a consistent snapshot of the slot, retrying while it is written.
+// Returns 0, or -1 if the slot was being written for too long.
+static int readSlot(struct parsegraph_SharedLoginSlot* slot, struct parsegraph_SharedLoginSlot* copy)
+{
+    for(int i = 0; i < SHARED_READ_SPINS; ++i) {
+        apr_uint32_t seq = apr_atomic_read32(&slot->seq);
+        if(seq & 1) {
+            apr_thread_yield();
+            continue;
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        memcpy(copy, (const void*)slot, sizeof(*copy));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(seq == apr_atomic_read32(&slot->seq)) {
+            copy->selector[SELECTOR_MAX] = 0;
+            copy->username[USERNAME_MAX] = 0;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int sharedGet(parsegraph_LoginCache* cache, apr_pool_t* pool, const char* selector, const unsigned char* digest, const char** username, int* userId)
+{
+    struct parsegraph_SharedLoginTable* table = cache->shared;
+    struct parsegraph_SharedLoginBucket* bucket = &table->buckets[hashSelector(selector) % table->nbuckets];
+    apr_time_t now = apr_time_now();
+    for(int i = 0; i < SHARED_WAYS; ++i) {
+        struct parsegraph_SharedLoginSlot copy;
+        if(0 != readSlot(&bucket->slots[i], &copy)) {
+            // Stuck mid-write, so let the database answer instead.
+            break;
+        }
+        if(!(copy.flags & SHARED_SLOT_USED) || strcmp(copy.selector, selector)) {
+            continue;
+        }
+        if(copy.expires <= now || CRYPTO_memcmp(copy.tokenDigest, digest, SHA256_DIGEST_LENGTH)) {
+            break;
+        }
+        if(!bucket->slots[i].referenced) {
+            apr_atomic_set32(&bucket->slots[i].referenced, 1);
+        }
+        *username = apr_pstrdup(pool, copy.username);
+        *userId = copy.userId;
+        apr_atomic_inc64(&cache->hits);
+        return APR_SUCCESS;
+    }
+    apr_atomic_inc64(&cache->misses);
+    return APR_ENOENT;
+}
+
+static void sharedPut(parsegraph_LoginCache* cache, const char* selector, const unsigned char* digest, const char* username, int userId)
+{
+    struct parsegraph_SharedLoginTable* table = cache->shared;
+    struct parsegraph_SharedLoginBucket* bucket = &table->buckets[hashSelector(selector) % table->nbuckets];
+    apr_time_t now = apr_time_now();
+    if(0 != lockBucket(bucket, 0)) {
+        // Caching is optional; the login is found in the database instead.
+        return;
+    }
+
+    // Reuse the selector's slot, or an empty or expired one.
+    struct parsegraph_SharedLoginSlot* slot = 0;
+    for(int i = 0; i < SHARED_WAYS; ++i) {
+        struct parsegraph_SharedLoginSlot* candidate = &bucket->slots[i];
+        if((candidate->flags & SHARED_SLOT_USED) && !strcmp(candidate->selector, selector)) {
+            slot = candidate;
+            break;
+        }
+        if(!slot && (!(candidate->flags & SHARED_SLOT_USED) || candidate->expires <= now)) {
+            slot = candidate;
+        }
+    }
+    if(!slot) {
+        // Evict the first slot the clock finds unreferenced.
+        for(;;) {
+            struct parsegraph_SharedLoginSlot* candidate = &bucket->slots[bucket->hand];
+            bucket->hand = (bucket->hand + 1) % SHARED_WAYS;
+            if(!apr_atomic_read32(&candidate->referenced)) {
+                slot = candidate;
+                break;
+            }
+            apr_atomic_set32(&candidate->referenced, 0);
+        }
+        apr_atomic_inc64(&cache->evictions);
+    }
+
+    beginWrite(slot);
+    slot->flags = SHARED_SLOT_USED;
+    slot->userId = userId;
+    slot->expires = now + table->ttl;
+    memcpy(slot->tokenDigest, digest, SHA256_DIGEST_LENGTH);
+    strcpy(slot->selector, selector);
+    strcpy(slot->username, username);
+    endWrite(slot);
+    apr_atomic_set32(&slot->referenced, 0);
+
+    unlockBucket(bucket);
+}
+
+// Removes the logins of the given user, or every login if username is NULL.
+// Waits for each bucket, since a login must not outlive its logout.
+static void sharedRemove(struct parsegraph_SharedLoginTable* table, const char* username)
+{
+    for(apr_uint32_t b = 0; b < table->nbuckets; ++b) {
+        struct parsegraph_SharedLoginBucket* bucket = &table->buckets[b];
+        lockBucket(bucket, 1);
+        for(int i = 0; i < SHARED_WAYS; ++i) {
+            struct parsegraph_SharedLoginSlot* slot = &bucket->slots[i];
+            if(!(slot->flags & SHARED_SLOT_USED) || (username && strcmp(slot->username, username))) {
+                continue;
+            }
+            beginWrite(slot);
+            slot->flags = 0;
+            slot->selector[0] = 0;
+            endWrite(slot);
+        }
+        unlockBucket(bucket);
+    }
+}
+
+static void sharedStats(parsegraph_LoginCache* cache, parsegraph_LoginCacheStats* stats)
+{
+    struct parsegraph_SharedLoginTable* table = cache->shared;
+    stats->hits = apr_atomic_read64(&cache->hits);
+    stats->misses = apr_atomic_read64(&cache->misses);
+    stats->evictions = apr_atomic_read64(&cache->evictions);
+    stats->size = 0;
+    apr_time_t now = apr_time_now();
+    for(apr_uint32_t b = 0; b < table->nbuckets; ++b) {
+        for(int i = 0; i < SHARED_WAYS; ++i) {
+            struct parsegraph_SharedLoginSlot copy;
+            if(0 == readSlot(&table->buckets[b].slots[i], &copy) && (copy.flags & SHARED_SLOT_USED) && copy.expires > now) {
+                ++stats->size;
+            }
+        }
+    }
+}
+
+parsegraph_LoginCache* parsegraph_LoginCache_newShared(apr_pool_t* parent, int capacity, apr_interval_time_t ttl, const char* filename)
+{
+    apr_pool_t* pool;
+    if(capacity <= 0 || APR_SUCCESS != apr_pool_create(&pool, parent)) {
+        return 0;
+    }
+    apr_uint32_t nbuckets = (capacity + SHARED_WAYS - 1) / SHARED_WAYS;
+    apr_size_t size = sizeof(struct parsegraph_SharedLoginTable) + sizeof(struct parsegraph_SharedLoginBucket) * nbuckets;
+
+    parsegraph_LoginCache* cache = apr_pcalloc(pool, sizeof(*cache));
+    cache->pool = pool;
+    cache->ttl = ttl;
+    cache->capacity = nbuckets * SHARED_WAYS;
+    if(filename) {
+        // Replace a segment left behind by a process that did not clean up.
+        apr_shm_remove(filename, pool);
+    }
+    if(APR_SUCCESS != apr_shm_create(&cache->shm, size, filename, pool)) {
+        apr_pool_destroy(pool);
+        return 0;
+    }
+    cache->shared = apr_shm_baseaddr_get(cache->shm);
+    memset(cache->shared, 0, size);
+    cache->shared->nbuckets = nbuckets;
+    cache->shared->ttl = ttl;
+    cache->shared->magic = SHARED_MAGIC;
+    return cache;
+}
+
+parsegraph_LoginCache* parsegraph_LoginCache_attachShared(apr_pool_t* parent, const char* filename)
+{
+    apr_pool_t* pool;
+    if(APR_SUCCESS != apr_pool_create(&pool, parent)) {
+        return 0;
+    }
+    parsegraph_LoginCache* cache = apr_pcalloc(pool, sizeof(*cache));
+    cache->pool = pool;
+    if(APR_SUCCESS != apr_shm_attach(&cache->shm, filename, pool)) {
+        apr_pool_destroy(pool);
+        return 0;
+    }
+    cache->shared = apr_shm_baseaddr_get(cache->shm);
+    if(cache->shared->magic != SHARED_MAGIC
+        || apr_shm_size_get(cache->shm) < sizeof(struct parsegraph_SharedLoginTable) + sizeof(struct parsegraph_SharedLoginBucket) * cache->shared->nbuckets) {
+        apr_shm_detach(cache->shm);
+        apr_pool_destroy(pool);
+        return 0;
+    }
+    cache->ttl = cache->shared->ttl;
+    cache->capacity = cache->shared->nbuckets * SHARED_WAYS;
+    return cache;
+}
+
+int parsegraph_LoginCache_get(parsegraph_LoginCache* cache, apr_pool_t* pool, const char* selector, const char* token, const char** username, int* userId)
+{
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    digestToken(token, digest);
+    if(cache->shared) {
+        return sharedGet(cache, pool, selector, digest, username, userId);
+    }
+
+    apr_thread_mutex_lock(cache->lock);
+    struct parsegraph_LoginCacheEntry* entry = apr_hash_get(cache->index, selector, APR_HASH_KEY_STRING);
+    if(entry && entry->expires <= apr_time_now()) {
+        removeEntry(cache, entry);
+        entry = 0;
+    }
+    if(!entry || CRYPTO_memcmp(entry->tokenDigest, digest, sizeof(digest))) {
+        ++cache->misses;
+        apr_thread_mutex_unlock(cache->lock);
+        return APR_ENOENT;
+    }
+    detachEntry(cache, entry);
+    pushFront(cache, entry);
+    *username = apr_pstrdup(pool, entry->username);
+    *userId = entry->userId;
+    ++cache->hits;
+    apr_thread_mutex_unlock(cache->lock);
+    return APR_SUCCESS;
+}
+
+void parsegraph_LoginCache_put(parsegraph_LoginCache* cache, const char* selector, const char* token, const char* username, int userId)
+{
+    if(strlen(selector) > SELECTOR_MAX || strlen(username) > USERNAME_MAX) {
+        return;
+    }
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    digestToken(token, digest);
+    if(cache->shared) {
+        sharedPut(cache, selector, digest, username, userId);
+        return;
+    }
+
+    apr_thread_mutex_lock(cache->lock);
+    struct parsegraph_LoginCacheEntry* entry = apr_hash_get(cache->index, selector, APR_HASH_KEY_STRING);
+    if(entry) {
+        detachEntry(cache, entry);
+    }
+    else {
+        if(!cache->free) {
+            removeEntry(cache, cache->tail);
+            ++cache->evictions;
+        }
+        entry = cache->free;
+        cache->free = entry->next;
+        strcpy(entry->selector, selector);
+        apr_hash_set(cache->index, entry->selector, APR_HASH_KEY_STRING, entry);
+        ++cache->size;
+    }
+    memcpy(entry->tokenDigest, digest, sizeof(digest));
+    strcpy(entry->username, username);
+    entry->userId = userId;
+    entry->expires = apr_time_now() + cache->ttl;
+    pushFront(cache, entry);
+    apr_thread_mutex_unlock(cache->lock);
+}
+
+void parsegraph_LoginCache_removeUser(parsegraph_LoginCache* cache, const char* username)
+{
+    if(cache->shared) {
+        sharedRemove(cache->shared, username);
+        return;
+    }
+    apr_thread_mutex_lock(cache->lock);
+    struct parsegraph_LoginCacheEntry* entry = cache->head;
+    while(entry) {
+        struct parsegraph_LoginCacheEntry* next = entry->next;
+        if(!strcmp(entry->username, username)) {
+            removeEntry(cache, entry);
+        }
+        entry = next;
+    }
+    apr_thread_mutex_unlock(cache->lock);
+}
+
+void parsegraph_LoginCache_clear(parsegraph_LoginCache* cache)
+{
+    if(cache->shared) {
+        sharedRemove(cache->shared, 0);
+        return;
+    }
+    apr_thread_mutex_lock(cache->lock);
+    while(cache->head) {
+        removeEntry(cache, cache->head);
+    }
+    apr_thread_mutex_unlock(cache->lock);
+}
+
+void parsegraph_LoginCache_stats(parsegraph_LoginCache* cache, parsegraph_LoginCacheStats* stats)
+{
+    if(cache->shared) {
+        sharedStats(cache, stats);
+        return;
+    }
+    apr_thread_mutex_lock(cache->lock);
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->size = cache->size;
+    apr_thread_mutex_unlock(cache->lock);
+}
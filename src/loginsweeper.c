@@ -0,0 +1,110 @@
+#include "parsegraph_LoginSweeper.h"
+#include "parsegraph_user.h"
+#include <apr_thread_proc.h>
+#include <apr_thread_mutex.h>
+#include <apr_thread_cond.h>
+
+struct parsegraph_LoginSweeper {
+    apr_pool_t* pool;
+    parsegraph_Session* session;
+    apr_thread_t* thread;
+    apr_interval_time_t interval;
+    int batchSize;
+
+    // Guards the fields below.
+    apr_thread_mutex_t* lock;
+    apr_thread_cond_t* wakeup;
+    int stopping;
+    int woken;
+    apr_uint64_t swept;
+};
+
+static void* APR_THREAD_FUNC runSweeper(apr_thread_t* thread, void* arg)
+{
+    parsegraph_LoginSweeper* sweeper = arg;
+    apr_thread_mutex_lock(sweeper->lock);
+    while(!sweeper->stopping) {
+        if(!sweeper->woken) {
+            apr_thread_cond_timedwait(sweeper->wakeup, sweeper->lock, sweeper->interval);
+        }
+        if(sweeper->stopping) {
+            break;
+        }
+        sweeper->woken = 0;
+        apr_thread_mutex_unlock(sweeper->lock);
+
+        int swept = 0;
+        parsegraph_sweepExpiredLogins(sweeper->session, sweeper->batchSize, 0, &swept);
+
+        apr_thread_mutex_lock(sweeper->lock);
+        sweeper->swept += swept;
+    }
+    apr_thread_mutex_unlock(sweeper->lock);
+    apr_thread_exit(thread, APR_SUCCESS);
+    return 0;
+}
+
+parsegraph_LoginSweeper* parsegraph_LoginSweeper_start(apr_pool_t* parent, marla_Server* server, const char* driverName, const char* params, apr_interval_time_t expiry, apr_interval_time_t revocationLifetime, apr_interval_time_t interval, int batchSize)
+{
+    apr_pool_t* pool;
+    if(expiry <= 0 || interval <= 0 || batchSize <= 0 || APR_SUCCESS != apr_pool_create(&pool, parent)) {
+        return 0;
+    }
+    parsegraph_LoginSweeper* sweeper = apr_pcalloc(pool, sizeof(*sweeper));
+    sweeper->pool = pool;
+    sweeper->interval = interval;
+    sweeper->batchSize = batchSize;
+    if(APR_SUCCESS != apr_thread_mutex_create(&sweeper->lock, APR_THREAD_MUTEX_DEFAULT, pool)
+        || APR_SUCCESS != apr_thread_cond_create(&sweeper->wakeup, pool)) {
+        marla_logMessagef(server, "Failed creating login sweeper locks.");
+        apr_pool_destroy(pool);
+        return 0;
+    }
+
+    sweeper->session = parsegraph_Session_open(server, driverName, params);
+    if(!sweeper->session) {
+        marla_logMessagef(server, "Failed opening login sweeper connection.");
+        apr_pool_destroy(pool);
+        return 0;
+    }
+    parsegraph_Session_useNativeSQLite(sweeper->session);
+    parsegraph_Session_setLoginExpiry(sweeper->session, expiry);
+    parsegraph_Session_setRevocationLifetime(sweeper->session, revocationLifetime > 0 ? revocationLifetime : expiry);
+
+    if(APR_SUCCESS != apr_thread_create(&sweeper->thread, 0, runSweeper, sweeper, pool)) {
+        marla_logMessagef(server, "Failed starting login sweeper.");
+        parsegraph_Session_close(sweeper->session);
+        apr_pool_destroy(pool);
+        return 0;
+    }
+    return sweeper;
+}
+
+void parsegraph_LoginSweeper_stop(parsegraph_LoginSweeper* sweeper)
+{
+    apr_thread_mutex_lock(sweeper->lock);
+    sweeper->stopping = 1;
+    apr_thread_cond_signal(sweeper->wakeup);
+    apr_thread_mutex_unlock(sweeper->lock);
+
+    apr_status_t threadrv;
+    apr_thread_join(&threadrv, sweeper->thread);
+    parsegraph_Session_close(sweeper->session);
+    apr_pool_destroy(sweeper->pool);
+}
+
+void parsegraph_LoginSweeper_wake(parsegraph_LoginSweeper* sweeper)
+{
+    apr_thread_mutex_lock(sweeper->lock);
+    sweeper->woken = 1;
+    apr_thread_cond_signal(sweeper->wakeup);
+    apr_thread_mutex_unlock(sweeper->lock);
+}
+
+apr_uint64_t parsegraph_LoginSweeper_swept(parsegraph_LoginSweeper* sweeper)
+{
+    apr_thread_mutex_lock(sweeper->lock);
+    apr_uint64_t swept = sweeper->swept;
+    apr_thread_mutex_unlock(sweeper->lock);
+    return swept;
+}
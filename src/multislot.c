@@ -1,4 +1,5 @@
 #include "parsegraph_environment.h"
+#include "parsegraph_Statement.h"
 
 parsegraph_EnvironmentStatus parsegraph_placeStorageItemInMultislot(parsegraph_Session* session, int userId, int refId, int multislotId, int multislotIndex)
 {
@@ -78,19 +79,17 @@ parsegraph_EnvironmentStatus parsegraph_setMultislotPublic(parsegraph_Session* s
     }
 
     const char* queryName = "parsegraph_Environment_setMultislotPublic";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_Environment_setMultislotPublic)) {
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         parsegraph_rollbackTransaction(session, transactionName);
         return parsegraph_Environment_INTERNAL_ERROR;
     }
     int nrows = 0;
-    int dbrv = apr_dbd_pvbquery(
-        dbd->driver,
+    int dbrv = parsegraph_pvbquery(
+        session,
         pool,
-        dbd->handle,
         &nrows,
-        query,
+        parsegraph_Statement_Environment_setMultislotPublic,
         &multislotId
     );
     if(dbrv != 0) {
@@ -138,18 +137,16 @@ parsegraph_EnvironmentStatus parsegraph_setMultislotPrivate(parsegraph_Session*
     apr_pool_t* pool = session->pool;
     ap_dbd_t* dbd = session->dbd;
     const char* queryName = "parsegraph_Environment_setMultislotPrivate";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_Environment_setMultislotPrivate)) {
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_Environment_INTERNAL_ERROR;
     }
     int nrows = 0;
-    int dbrv = apr_dbd_pvbquery(
-        dbd->driver,
+    int dbrv = parsegraph_pvbquery(
+        session,
         pool,
-        dbd->handle,
         &nrows,
-        query,
+        parsegraph_Statement_Environment_setMultislotPrivate,
         &multislotId
     );
     if(dbrv != 0) {
@@ -184,8 +181,7 @@ parsegraph_EnvironmentStatus parsegraph_createMultislotPlot(parsegraph_Session*
     }
 
     const char* queryName = "parsegraph_Environment_createMultislotPlot";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_Environment_createMultislotPlot)) {
         marla_logMessagef(session->server,
             "%s query was not defined.", queryName
         );
@@ -193,35 +189,22 @@ parsegraph_EnvironmentStatus parsegraph_createMultislotPlot(parsegraph_Session*
         return parsegraph_Environment_INTERNAL_ERROR;
     }
 
-    int nrows;
-    int dbrv = apr_dbd_pvbquery(dbd->driver, pool, dbd->handle, &nrows, query, &multislotId, &userId, &plotIndex, &plotLength);
-    if(dbrv != 0) {
-        marla_logMessagef(session->server,
-            "%s query failed to execute: %s", queryName,
-            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
-        );
-        parsegraph_rollbackTransaction(session, transactionName);
-        return parsegraph_Environment_INTERNAL_ERROR;
-    }
-    if(nrows != 1) {
+    int dbrv = parsegraph_insertReturning(session, pool, parsegraph_Statement_Environment_createMultislotPlot, multislotPlotId, &multislotId, &userId, &plotIndex, &plotLength);
+    if(dbrv == APR_ENOENT) {
         marla_logMessagef(session->server,
-            "Unexpected number of insertions when running %s: %d updates.", queryName, nrows
+            "Multislot plot was not created despite query."
         );
         parsegraph_rollbackTransaction(session, transactionName);
         return parsegraph_Environment_INTERNAL_ERROR;
     }
-
-    if(parsegraph_Environment_OK != parsegraph_lastInsertRowId(session, multislotPlotId)) {
+    if(dbrv != 0) {
         marla_logMessagef(session->server,
-            "Failed to retrieve plot id."
+            "%s query failed to execute: %s", queryName,
+            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
         );
         parsegraph_rollbackTransaction(session, transactionName);
         return parsegraph_Environment_INTERNAL_ERROR;
     }
-    if(*multislotPlotId == -1) {
-        parsegraph_rollbackTransaction(session, transactionName);
-        return parsegraph_Environment_INTERNAL_ERROR;
-    }
 
     parsegraph_multislot_info multislotInfo;
     parsegraph_EnvironmentStatus erv = parsegraph_getMultislotInfo(session, multislotId, &multislotInfo);
@@ -256,20 +239,18 @@ parsegraph_EnvironmentStatus parsegraph_getMultislotItemAtIndex(parsegraph_Sessi
     }
 
     const char* queryName = "parsegraph_getMultislotItemAtIndex";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_getMultislotItemAtIndex)) {
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         parsegraph_rollbackTransaction(session, transactionName);
         return parsegraph_Environment_INTERNAL_ERROR;
     }
 
     apr_dbd_results_t* itemsWithIndex = 0;
-    int dbrv = apr_dbd_pvbselect(
-        dbd->driver,
+    int dbrv = parsegraph_pvbselect(
+        session,
         pool,
-        dbd->handle,
         &itemsWithIndex,
-        query,
+        parsegraph_Statement_getMultislotItemAtIndex,
         0,
         &multislotId,
         &multislotIndex
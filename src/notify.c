@@ -1,6 +1,16 @@
 #include "parsegraph_environment.h"
 
-parsegraph_EnvironmentStatus parsegraph_notifyEnvironment(parsegraph_Session* session, parsegraph_GUID* env, enum parsegraph_EnvironmentEvent eventType, void* data)
+struct parsegraph_PendingEvent {
+    int isUserEvent;
+    parsegraph_GUID env;
+    int userId;
+    enum parsegraph_EnvironmentEvent eventType;
+    int hasData;
+    int data;
+};
+typedef struct parsegraph_PendingEvent parsegraph_PendingEvent;
+
+static void deliverEnvironmentEvent(parsegraph_Session* session, parsegraph_GUID* env, enum parsegraph_EnvironmentEvent eventType, void* data)
 {
     switch(eventType) {
     case parsegraph_Event_UserEnteredEnvironment:
@@ -18,10 +28,9 @@ parsegraph_EnvironmentStatus parsegraph_notifyEnvironment(parsegraph_Session* se
     case parsegraph_Event_ItemPushedInStorage:
         break;
     }
-    return parsegraph_Environment_OK;
 }
 
-parsegraph_EnvironmentStatus parsegraph_notifyUser(parsegraph_Session* session, int userId, enum parsegraph_EnvironmentEvent eventType, void* data)
+static void deliverUserEvent(parsegraph_Session* session, int userId, enum parsegraph_EnvironmentEvent eventType, void* data)
 {
     switch(eventType) {
     case parsegraph_Event_UserEnteredEnvironment:
@@ -37,9 +46,85 @@ parsegraph_EnvironmentStatus parsegraph_notifyUser(parsegraph_Session* session,
     case parsegraph_Event_ItemPushedInStorage:
         break;
     case parsegraph_Event_EnvironmentRootSet:
+        break;
+    }
+}
+
+static parsegraph_PendingEvent* queueEvent(parsegraph_Session* session, enum parsegraph_EnvironmentEvent eventType, void* data)
+{
+    if(!session->pendingEvents) {
+        session->pendingEvents = apr_array_make(session->statePool, 8, sizeof(parsegraph_PendingEvent));
+    }
+    parsegraph_PendingEvent* event = apr_array_push(session->pendingEvents);
+    memset(event, 0, sizeof(*event));
+    event->eventType = eventType;
+    // Event data is an int owned by the caller's stack, so copy it now.
+    if(data) {
+        event->hasData = 1;
+        event->data = *(int*)data;
+    }
+    return event;
+}
+
+parsegraph_EnvironmentStatus parsegraph_notifyEnvironment(parsegraph_Session* session, parsegraph_GUID* env, enum parsegraph_EnvironmentEvent eventType, void* data)
+{
+    if(session->transactionDepth == 0) {
+        deliverEnvironmentEvent(session, env, eventType, data);
+        return parsegraph_Environment_OK;
+    }
+
+    parsegraph_PendingEvent* event = queueEvent(session, eventType, data);
+    event->isUserEvent = 0;
+    memcpy(&event->env, env, sizeof(event->env));
+    return parsegraph_Environment_OK;
+}
+
+parsegraph_EnvironmentStatus parsegraph_notifyUser(parsegraph_Session* session, int userId, enum parsegraph_EnvironmentEvent eventType, void* data)
+{
+    if(eventType == parsegraph_Event_EnvironmentRootSet) {
         marla_logMessagef(session->server,
             "User cannot be notified of this event type.");
         return parsegraph_Environment_INTERNAL_ERROR;
     }
+
+    if(session->transactionDepth == 0) {
+        deliverUserEvent(session, userId, eventType, data);
+        return parsegraph_Environment_OK;
+    }
+
+    parsegraph_PendingEvent* event = queueEvent(session, eventType, data);
+    event->isUserEvent = 1;
+    event->userId = userId;
     return parsegraph_Environment_OK;
 }
+
+int parsegraph_countPendingEvents(parsegraph_Session* session)
+{
+    return session->pendingEvents ? session->pendingEvents->nelts : 0;
+}
+
+void parsegraph_flushPendingEvents(parsegraph_Session* session)
+{
+    apr_array_header_t* events = session->pendingEvents;
+    if(!events || events->nelts == 0) {
+        return;
+    }
+
+    // Detach the queue so that deliveries which open their own transactions
+    // queue into a fresh array instead of the one being iterated.
+    session->pendingEvents = 0;
+    for(int i = 0; i < events->nelts; ++i) {
+        parsegraph_PendingEvent* event = &APR_ARRAY_IDX(events, i, parsegraph_PendingEvent);
+        void* data = event->hasData ? &event->data : 0;
+        if(event->isUserEvent) {
+            deliverUserEvent(session, event->userId, event->eventType, data);
+        }
+        else {
+            deliverEnvironmentEvent(session, &event->env, event->eventType, data);
+        }
+    }
+    apr_array_clear(events);
+    if(!session->pendingEvents) {
+        session->pendingEvents = events;
+    }
+}
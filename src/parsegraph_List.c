@@ -1,4 +1,5 @@
 #include "parsegraph_List.h"
+#include "parsegraph_Statement.h"
 #include <openssl/sha.h>
 #include <apr_strings.h>
 #include <apr_lib.h>
@@ -26,65 +27,14 @@ parsegraph_ListStatus parsegraph_List_prepareStatements(
     parsegraph_Session* session
 )
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     const char* transactionName = "parsegraph_List_prepareStatements";
     if(0 != parsegraph_beginTransaction(session, transactionName)) {
         return parsegraph_List_FAILED_TO_EXECUTE;
     }
 
-    static const char* queries[] = {
-        "parsegraph_List_new", "INSERT INTO list_item(value) VALUES(%s)", // 1
-        "parsegraph_List_getID", "SELECT id from list_item WHERE list_id IS NULL AND value = %s", // 2
-        "parsegraph_List_getName", "SELECT value, type from list_item WHERE id = %d", // 3
-        "parsegraph_List_destroy", "DELETE FROM list_item WHERE list_id IS NULL AND id = %d", // 4
-        "parsegraph_List_newItem", "INSERT INTO list_item(list_id, type, value, prev, next) VALUES(%d, %d, %s, NULL, NULL)", // 5
-        "parsegraph_List_getLastId", "SELECT last_insert_rowid()", // 6
-        "parsegraph_List_append", "UPDATE list_item SET next = %d WHERE list_id = %d and next IS NULL AND id IS NOT %d", // 7
-        "parsegraph_List_prepend", "UPDATE list_item SET prev = %d WHERE list_id = %d and prev IS NULL AND id IS NOT %d", // 8
-        "parsegraph_List_truncate", "DELETE FROM list_item WHERE list_id = %d", // 9
-        "parsegraph_List_getHead", "SELECT id FROM list_item WHERE list_id = %d and prev IS NULL", // 10
-        "parsegraph_List_getTail", "SELECT id FROM list_item WHERE list_id = %d and next IS NULL", // 11
-        "parsegraph_List_setPrev", "UPDATE list_item SET prev = %d WHERE id = %d", // 12
-        "parsegraph_List_setNext", "UPDATE list_item SET next = %d WHERE id = %d", // 13
-        "parsegraph_List_getNext", "SELECT next FROM list_item WHERE id = %d", // 14
-        "parsegraph_List_getPrev", "SELECT prev FROM list_item WHERE id = %d", // 15
-        "parsegraph_List_updateItem", "UPDATE list_item SET type = %d, value = %s WHERE id = %d", // 16
-        "parsegraph_List_removeItem", "UPDATE list_item SET next = NULL, prev = NULL WHERE id = %d", // 17
-        "parsegraph_List_destroyItem", "DELETE FROM list_item WHERE id = %d", // 18
-        "parsegraph_List_listItems", "SELECT id, next, prev, value, type FROM list_item WHERE list_id = %d", // 19
-        "parsegraph_List_length", "SELECT COUNT(*) from list_item WHERE list_id IS %d", // 20
-        "parsegraph_List_getListId", "SELECT list_id FROM list_item WHERE id = %d", // 21
-        "parsegraph_List_clearNext", "UPDATE list_item SET next = NULL WHERE id = %d", // 22
-        "parsegraph_List_clearPrev", "UPDATE list_item SET prev = NULL WHERE id = %d", // 23
-        "parsegraph_List_setValue", "UPDATE list_item SET value = %s WHERE id = %d", // 24
-        "parsegraph_List_setType", "UPDATE list_item SET type = %d WHERE id = %d", // 25
-        "parsegraph_List_reparentItems", "UPDATE list_item SET list_id = %d WHERE list_id = %d", // 26
-        "parsegraph_List_setList", "UPDATE list_item SET list_id = %d WHERE id = %d", // 27
-    };
-    static int NUM_QUERIES = 27;
-    for(int i = 0; i < NUM_QUERIES * 2; i += 2) {
-        const char* label = queries[i];
-        const char* query = queries[i + 1];
-
-        // Check if the statement has already been created.
-        if(NULL != apr_hash_get(dbd->prepared, label, APR_HASH_KEY_STRING)) {
-            // A statement already prepared is ignored.
-            break;
-        }
-
-        // No statement was found, so create and insert a new statement.
-        apr_dbd_prepared_t *stmt;
-        int rv = apr_dbd_prepare(dbd->driver, pool, dbd->handle, query, label, &stmt);
-        if(rv) {
-            marla_logMessagef(session->server, "Failed preparing %s statement [%s]",
-                label,
-                apr_dbd_error(dbd->driver, dbd->handle, rv)
-            );
-            parsegraph_rollbackTransaction(session, transactionName);
-            return parsegraph_List_FAILED_TO_PREPARE_STATEMENT;
-        }
-        apr_hash_set(dbd->prepared, label, APR_HASH_KEY_STRING, stmt);
+    if(0 != parsegraph_prepareStatements(session, parsegraph_Statement_lastInsertRowId, parsegraph_Statement_List_LAST)) {
+        parsegraph_rollbackTransaction(session, transactionName);
+        return parsegraph_List_FAILED_TO_PREPARE_STATEMENT;
     }
 
     if(0 != parsegraph_commitTransaction(session, transactionName)) {
@@ -100,9 +50,8 @@ parsegraph_ListStatus parsegraph_List_upgradeTables(
 {
     ap_dbd_t* dbd = session->dbd;
     int nrows;
-    int rv = apr_dbd_query(
-        dbd->driver,
-        dbd->handle,
+    int rv = parsegraph_schemaQuery(
+        session,
         &nrows,
         "create table if not exists transaction_log(name text, level int)"
     );
@@ -119,9 +68,8 @@ parsegraph_ListStatus parsegraph_List_upgradeTables(
         return parsegraph_List_FAILED_TO_EXECUTE;
     }
 
-    rv = apr_dbd_query(
-        dbd->driver,
-        dbd->handle,
+    rv = parsegraph_schemaQuery(
+        session,
         &nrows,
         "CREATE TABLE IF NOT EXISTS list_item("
             "id integer primary key, "
@@ -211,87 +159,32 @@ parsegraph_ListStatus parsegraph_List_new(parsegraph_Session* session, const cha
 
     // Insert the new list into the database.
     const char* queryName = "parsegraph_List_new";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_new)) {
          // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         parsegraph_rollbackTransaction(session, transactionName);
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
 
-    int nrows = 0;
-    rv = apr_dbd_pvquery(
-        dbd->driver,
-        pool,
-        dbd->handle,
-        &nrows,
-        query,
-        listName
-    );
-    if(rv != 0) {
-        marla_logMessagef(session->server,
-            "%s query failed to execute. Error: %s", queryName,
-            apr_dbd_error(dbd->driver, dbd->handle, rv)
-        );
-        parsegraph_rollbackTransaction(session, transactionName);
-        return parsegraph_List_FAILED_TO_EXECUTE;
-    }
-    if(nrows == 0) {
+    int newId;
+    rv = parsegraph_insertReturning(session, pool, parsegraph_Statement_List_new, &newId, listName);
+    if(rv == APR_ENOENT) {
         marla_logMessagef(session->server,
             "List '%s' was not inserted despite query.", listName
         );
         parsegraph_rollbackTransaction(session, transactionName);
         return parsegraph_List_FAILED_TO_EXECUTE;
     }
-    if(nrows != 1) {
+    if(rv != 0) {
         marla_logMessagef(session->server,
-            "Unexpected number of insertions for %s. Got %d insertion(s)", listName, nrows
+            "%s query failed to execute. Error: %s", queryName,
+            apr_dbd_error(dbd->driver, dbd->handle, rv)
         );
         parsegraph_rollbackTransaction(session, transactionName);
         return parsegraph_List_FAILED_TO_EXECUTE;
     }
-
     if(listId) {
-        queryName = "parsegraph_List_getLastId";
-        query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-        if(query == NULL) {
-             // Query was not defined.
-            marla_logMessagef(session->server,
-                "%s query was not defined.", queryName
-            );
-            parsegraph_rollbackTransaction(session, transactionName);
-            return parsegraph_List_UNDEFINED_PREPARED_QUERY;
-        }
-        apr_dbd_results_t* res = NULL;
-        rv = apr_dbd_pvselect(dbd->driver, pool, dbd->handle, &res, query, 0);
-        if(0 != rv) {
-            marla_logMessagef(session->server,
-                "Failed to get last id for just-created list item."
-            );
-            parsegraph_rollbackTransaction(session, transactionName);
-            return parsegraph_List_FAILED_TO_EXECUTE;
-        }
-        // Get the resulting row.
-        apr_dbd_row_t* row;
-        int dbrv = apr_dbd_get_row(dbd->driver, pool, res, &row, -1);
-        if(dbrv != 0) {
-            marla_logMessagef(session->server,
-                "Failed to execute query to retrieve ID for just-created list item."
-            );
-            parsegraph_rollbackTransaction(session, transactionName);
-            return parsegraph_List_FAILED_TO_EXECUTE;
-        }
-        // Get the ID.
-        apr_status_t datumrv = apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, listId);
-        if(datumrv != 0) {
-            marla_logMessagef(session->server,
-                "Failed to retrieve ID for just-created list."
-            );
-            parsegraph_rollbackTransaction(session, transactionName);
-            return parsegraph_List_FAILED_TO_EXECUTE;
-        }
+        *listId = newId;
     }
 
     if(0 != parsegraph_commitTransaction(session, transactionName)) {
@@ -303,28 +196,21 @@ parsegraph_ListStatus parsegraph_List_new(parsegraph_Session* session, const cha
 
 parsegraph_ListStatus parsegraph_List_getID(parsegraph_Session* session, const char* listName, int* listId)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     *listId = -1;
 
-    // Get the result list.
-    apr_dbd_results_t* res = NULL;
-    parsegraph_ListStatus rv = parsegraph_List_getList(session, &res, listName);
-    if(parsegraph_List_isSeriousError(rv)) {
-        marla_logMessagef(session->server, "Failed to query for list named '%s'.", listName);
-        return rv;
-    }
-
-    // Get the resulting row.
-    apr_dbd_row_t* row;
-    int dbrv = apr_dbd_get_row(dbd->driver, pool, res, &row, -1);
-    if(dbrv != 0) {
-        return parsegraph_List_OK;
+    const char* queryName = "parsegraph_List_getID";
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_getID)) {
+         // Query was not defined.
+        marla_logMessagef(session->server, "%s query was not defined.", queryName);
+        return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
-
-    // Get the ID.
-    apr_status_t datumrv = apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, listId);
-    if(datumrv != 0) {
+    switch(parsegraph_selectInt(session, session->pool, parsegraph_Statement_List_getID, listId, listName)) {
+    case APR_SUCCESS:
+        break;
+    case APR_ENOENT:
+        *listId = -1;
+        break;
+    default:
         marla_logMessagef(session->server, "Failed to retrieve ID for list named '%s'.", listName);
         *listId = -1;
         return parsegraph_List_FAILED_TO_EXECUTE;
@@ -341,20 +227,16 @@ parsegraph_ListStatus parsegraph_List_getList(
     ap_dbd_t* dbd = session->dbd;
     // Get and run the query.
     const char* queryName = "parsegraph_List_getID";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_getID)) {
          // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
-    int rv = apr_dbd_pvselect(
-        dbd->driver,
+    int rv = parsegraph_pvselect(
+        session,
         pool,
-        dbd->handle,
         res,
-        query,
+        parsegraph_Statement_List_getID,
         0,
         listName
     );
@@ -370,160 +252,86 @@ parsegraph_ListStatus parsegraph_List_getList(
 
 parsegraph_ListStatus parsegraph_List_getHead(parsegraph_Session* session, int listId, int* itemId)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     *itemId = -1;
 
     // Get and run the query.
-    apr_dbd_results_t* res = NULL;
     const char* queryName = "parsegraph_List_getHead";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_getHead)) {
          // Query was not defined.
-        marla_logMessagef(session->server,
-            "%s query was not defined.", queryName
-        );
+        marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
-    if(0 != apr_dbd_pvbselect(
-        dbd->driver,
-        pool,
-        dbd->handle,
-        &res,
-        query,
-        0,
-        &listId
-    )) {
-        marla_logMessagef(session->server,
-            "Failed to run query to get head of list %d", listId
-        );
-        return parsegraph_List_FAILED_TO_EXECUTE;
-    }
-
-    // Get the resulting row.
-    apr_dbd_row_t* row;
-    int dbrv = apr_dbd_get_row(dbd->driver, pool, res, &row, -1);
-    if(dbrv != 0) {
-        return parsegraph_List_OK;
-    }
-
-    switch(apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, itemId)) {
+    switch(parsegraph_selectInt(session, session->pool, parsegraph_Statement_List_getHead, itemId, &listId)) {
     case APR_SUCCESS:
         break;
     case APR_ENOENT:
         *itemId = -1;
         break;
-    case APR_EGENERAL:
-        marla_logMessagef(session->server,
-            "Failed to retrieve ID for head of list %d", listId
-        );
+    default:
+        marla_logMessagef(session->server, "Failed to run query to get head of list %d", listId);
         *itemId = -1;
         return parsegraph_List_FAILED_TO_EXECUTE;
     }
-
     return parsegraph_List_OK;
 }
 
 parsegraph_ListStatus parsegraph_List_getTail(parsegraph_Session* session, int listId, int* itemId)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     *itemId = -1;
 
     // Get and run the query.
-    apr_dbd_results_t* res = NULL;
     const char* queryName = "parsegraph_List_getTail";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_getTail)) {
          // Query was not defined.
-        marla_logMessagef(session->server,
-            "%s query was not defined.", queryName
-        );
+        marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
-    if(0 != apr_dbd_pvbselect(
-        dbd->driver,
-        pool,
-        dbd->handle,
-        &res,
-        query,
-        0,
-        &listId
-    )) {
-        marla_logMessagef(session->server,
-            "Failed to run query to get tail of list %d", listId
-        );
-        return parsegraph_List_FAILED_TO_EXECUTE;
-    }
-
-    // Get the resulting row.
-    apr_dbd_row_t* row;
-    int dbrv = apr_dbd_get_row(dbd->driver, pool, res, &row, -1);
-    if(dbrv != 0) {
-        return parsegraph_List_OK;
-    }
-
-    switch(apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, itemId)) {
+    switch(parsegraph_selectInt(session, session->pool, parsegraph_Statement_List_getTail, itemId, &listId)) {
     case APR_SUCCESS:
         break;
     case APR_ENOENT:
         *itemId = -1;
         break;
-    case APR_EGENERAL:
-        marla_logMessagef(session->server,
-            "Failed to retrieve ID for tail of list %d", listId
-        );
+    default:
+        marla_logMessagef(session->server, "Failed to run query to get tail of list %d", listId);
         *itemId = -1;
         return parsegraph_List_FAILED_TO_EXECUTE;
     }
-
     return parsegraph_List_OK;
 }
 
 parsegraph_ListStatus parsegraph_List_getName(parsegraph_Session* session, int listId, const char** listName, int* typeId)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     // Get and run the query.
-    apr_dbd_results_t* res = NULL;
     const char* queryName = "parsegraph_List_getName";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_getName)) {
          // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
-    int rv = apr_dbd_pvbselect(
-        dbd->driver,
-        pool,
-        dbd->handle,
-        &res,
-        query,
-        0,
-        &listId
-    );
-    if(0 != rv) {
+    parsegraph_Cursor cursor;
+    if(0 != parsegraph_Cursor_open(&cursor, session, session->pool, parsegraph_Statement_List_getName, &listId)) {
         marla_logMessagef(session->server, "Failed to query for list named %d.", listId);
         return parsegraph_List_FAILED_TO_EXECUTE;
     }
 
     // Get the resulting row.
-    apr_dbd_row_t* row;
-    int dbrv = apr_dbd_get_row(dbd->driver, pool, res, &row, -1);
-    if(dbrv != 0) {
+    int dbrv = parsegraph_Cursor_next(&cursor);
+    if(dbrv != APR_SUCCESS) {
+        parsegraph_Cursor_close(&cursor);
         *listName = 0;
+        if(dbrv != APR_EOF) {
+            marla_logMessagef(session->server, "Failed to read list named %d.", listId);
+            return parsegraph_List_FAILED_TO_EXECUTE;
+        }
         return parsegraph_List_OK;
     }
 
     // Get the name.
-    *listName = apr_dbd_get_entry(dbd->driver, row, 0);
+    *listName = parsegraph_Cursor_text(&cursor, 0);
 
     // Get the type.
-    switch(apr_dbd_datum_get(dbd->driver, row, 1, APR_DBD_TYPE_INT, typeId)) {
+    switch(parsegraph_Cursor_int(&cursor, 1, typeId)) {
     case APR_SUCCESS:
         break;
     case APR_ENOENT:
@@ -531,55 +339,31 @@ parsegraph_ListStatus parsegraph_List_getName(parsegraph_Session* session, int l
         break;
     default:
         marla_logMessagef(session->server, "Failed to retrieve type ID.");
+        parsegraph_Cursor_close(&cursor);
         return parsegraph_List_FAILED_TO_EXECUTE;
     }
+    parsegraph_Cursor_close(&cursor);
     return parsegraph_List_OK;
 }
 
 parsegraph_ListStatus parsegraph_List_getNext(parsegraph_Session* session, int itemId, int* nextId)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     // Get and run the query.
-    apr_dbd_results_t* res = NULL;
     const char* queryName = "parsegraph_List_getNext";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_getNext)) {
          // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
-    int rv = apr_dbd_pvbselect(
-        dbd->driver,
-        pool,
-        dbd->handle,
-        &res,
-        query,
-        0,
-        &itemId
-    );
-    if(0 != rv) {
-        marla_logMessagef(session->server, "Failed to query next for list item %d.", itemId);
-        return parsegraph_List_FAILED_TO_EXECUTE;
-    }
-
-    // Get the resulting row.
-    apr_dbd_row_t* row;
-    int dbrv = apr_dbd_get_row(dbd->driver, pool, res, &row, -1);
-    if(dbrv != 0) {
-        *nextId = -1;
-        return parsegraph_List_OK;
-    }
-
-    // Get the ID.
-    switch(apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, nextId)) {
+    switch(parsegraph_selectInt(session, session->pool, parsegraph_Statement_List_getNext, nextId, &itemId)) {
     case APR_SUCCESS:
         break;
     case APR_ENOENT:
         *nextId = -1;
         break;
     default:
-        marla_logMessagef(session->server, "Failed to retrieve next ID.");
+        marla_logMessagef(session->server, "Failed to query next for list item %d.", itemId);
+        *nextId = -1;
         return parsegraph_List_FAILED_TO_EXECUTE;
     }
     return parsegraph_List_OK;
@@ -587,48 +371,22 @@ parsegraph_ListStatus parsegraph_List_getNext(parsegraph_Session* session, int i
 
 parsegraph_ListStatus parsegraph_List_getListId(parsegraph_Session* session, int itemId, int* listId)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     // Get and run the query.
-    apr_dbd_results_t* res = NULL;
     const char* queryName = "parsegraph_List_getListId";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_getListId)) {
          // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
-    int rv = apr_dbd_pvbselect(
-        dbd->driver,
-        pool,
-        dbd->handle,
-        &res,
-        query,
-        0,
-        &itemId
-    );
-    if(0 != rv) {
-        marla_logMessagef(session->server, "Failed to query prev for list item %d.", itemId);
-        return parsegraph_List_FAILED_TO_EXECUTE;
-    }
-
-    // Get the resulting row.
-    apr_dbd_row_t* row;
-    int dbrv = apr_dbd_get_row(dbd->driver, pool, res, &row, -1);
-    if(dbrv != 0) {
-        *listId = -1;
-        return parsegraph_List_OK;
-    }
-
-    // Get the ID.
-    switch(apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, listId)) {
+    switch(parsegraph_selectInt(session, session->pool, parsegraph_Statement_List_getListId, listId, &itemId)) {
     case APR_SUCCESS:
         break;
     case APR_ENOENT:
         *listId = -1;
         break;
     default:
-        marla_logMessagef(session->server, "Failed to retrieve list ID.");
+        marla_logMessagef(session->server, "Failed to query list for list item %d.", itemId);
+        *listId = -1;
         return parsegraph_List_FAILED_TO_EXECUTE;
     }
     return parsegraph_List_OK;
@@ -636,48 +394,22 @@ parsegraph_ListStatus parsegraph_List_getListId(parsegraph_Session* session, int
 
 parsegraph_ListStatus parsegraph_List_getPrev(parsegraph_Session* session, int itemId, int* prevId)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     // Get and run the query.
-    apr_dbd_results_t* res = NULL;
     const char* queryName = "parsegraph_List_getPrev";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_getPrev)) {
          // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
-    int rv = apr_dbd_pvbselect(
-        dbd->driver,
-        pool,
-        dbd->handle,
-        &res,
-        query,
-        0,
-        &itemId
-    );
-    if(0 != rv) {
-        marla_logMessagef(session->server, "Failed to query for list named %d.", itemId);
-        return parsegraph_List_FAILED_TO_EXECUTE;
-    }
-
-    // Get the resulting row.
-    apr_dbd_row_t* row;
-    int dbrv = apr_dbd_get_row(dbd->driver, pool, res, &row, -1);
-    if(dbrv != 0) {
-        *prevId = -1;
-        return parsegraph_List_OK;
-    }
-
-    // Get the ID.
-    switch(apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, prevId)) {
+    switch(parsegraph_selectInt(session, session->pool, parsegraph_Statement_List_getPrev, prevId, &itemId)) {
     case APR_SUCCESS:
         break;
     case APR_ENOENT:
         *prevId = -1;
         break;
     default:
-        marla_logMessagef(session->server, "Failed to retrieve previous ID.");
+        marla_logMessagef(session->server, "Failed to query prev for list item %d.", itemId);
+        *prevId = -1;
         return parsegraph_List_FAILED_TO_EXECUTE;
     }
     return parsegraph_List_OK;
@@ -686,7 +418,6 @@ parsegraph_ListStatus parsegraph_List_getPrev(parsegraph_Session* session, int i
 parsegraph_ListStatus parsegraph_List_destroy(parsegraph_Session* session, int listId)
 {
     apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     const char* transactionName = "parsegraph_List_destroy";
     if(0 != parsegraph_beginTransaction(session, transactionName)) {
         return parsegraph_List_FAILED_TO_EXECUTE;
@@ -704,15 +435,14 @@ parsegraph_ListStatus parsegraph_List_destroy(parsegraph_Session* session, int l
 
     // Get and run the query.
     const char* queryName = "parsegraph_List_destroy";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_destroy)) {
          // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         parsegraph_rollbackTransaction(session, transactionName);
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
     int nrows = 0;
-    rv = apr_dbd_pvbquery(dbd->driver, pool, dbd->handle, &nrows, query, &listId);
+    rv = parsegraph_pvbquery(session, pool, &nrows, parsegraph_Statement_List_destroy, &listId);
     if(0 != rv) {
         marla_logMessagef(session->server, "Failed to destroy list %d.", listId);
         parsegraph_rollbackTransaction(session, transactionName);
@@ -735,49 +465,25 @@ parsegraph_ListStatus parsegraph_List_destroy(parsegraph_Session* session, int l
 
 parsegraph_ListStatus parsegraph_List_length(parsegraph_Session* session, int listId, size_t* count)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     *count = 0;
 
     // Get and run the query.
-    apr_dbd_results_t* res = NULL;
     const char* queryName = "parsegraph_List_length";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_length)) {
          // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
-    int rv = apr_dbd_pvbselect(
-        dbd->driver,
-        pool,
-        dbd->handle,
-        &res,
-        query,
-        0,
-        &listId
-    );
-    if(0 != rv) {
-        marla_logMessagef(session->server, "Failed to query for list named %d.", listId);
-        return parsegraph_List_FAILED_TO_EXECUTE;
-    }
-
-    // Get the resulting row.
-    apr_dbd_row_t* row;
-    int dbrv = apr_dbd_get_row(dbd->driver, pool, res, &row, -1);
-    if(dbrv != 0) {
-        return parsegraph_List_OK;
-    }
-
-    // Get the ID.
-    switch(apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_ULONG, count)) {
+    int length = 0;
+    switch(parsegraph_selectInt(session, session->pool, parsegraph_Statement_List_length, &length, &listId)) {
     case APR_SUCCESS:
+        *count = length;
         break;
     case APR_ENOENT:
         *count = 0;
         break;
     default:
-        marla_logMessagef(session->server, "Failed to retrieve next ID.");
+        marla_logMessagef(session->server, "Failed to query length of list %d.", listId);
         return parsegraph_List_FAILED_TO_EXECUTE;
     }
     return parsegraph_List_OK;
@@ -794,64 +500,27 @@ parsegraph_ListStatus parsegraph_List_newItem(parsegraph_Session* session, int l
 
     // Get and run the query.
     const char* queryName = "parsegraph_List_newItem";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_newItem)) {
         // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         parsegraph_rollbackTransaction(session, transactionName);
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
-    int nrows = 0;
-    int rv = apr_dbd_pvbquery(dbd->driver, pool, dbd->handle, &nrows, query, &listId, &typeId, value);
+    int newId;
+    int rv = parsegraph_insertReturning(session, pool, parsegraph_Statement_List_newItem, &newId, &listId, &typeId, value);
     if(0 != rv) {
         marla_logMessagef(session->server,
             "Failed to create new list item under ID %d. DB error %d - %s", listId,
             rv, apr_dbd_error(dbd->driver, dbd->handle, rv)
         );
         parsegraph_rollbackTransaction(session, transactionName);
+        if(itemId) {
+            *itemId = -1;
+        }
         return parsegraph_List_FAILED_TO_EXECUTE;
     }
-    if(1 != nrows) {
-        marla_logMessagef(session->server,
-            "Unexpected number of items added: %d", nrows
-        );
-        parsegraph_rollbackTransaction(session, transactionName);
-        return parsegraph_List_FAILED_TO_EXECUTE;
-    }
-
-    // Now get the ID.
     if(itemId) {
-        queryName = "parsegraph_List_getLastId";
-        query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-        if(query == NULL) {
-             // Query was not defined.
-            marla_logMessagef(session->server, "%s query was not defined.", queryName);
-            parsegraph_rollbackTransaction(session, transactionName);
-            return parsegraph_List_UNDEFINED_PREPARED_QUERY;
-        }
-        apr_dbd_results_t* res = NULL;
-        rv = apr_dbd_pvselect(dbd->driver, pool, dbd->handle, &res, query, 0);
-        if(0 != rv) {
-            marla_logMessagef(session->server, "Failed to destroy list %d.", listId);
-            parsegraph_rollbackTransaction(session, transactionName);
-            return parsegraph_List_FAILED_TO_EXECUTE;
-        }
-        // Get the resulting row.
-        apr_dbd_row_t* row;
-        int dbrv = apr_dbd_get_row(dbd->driver, pool, res, &row, -1);
-        if(dbrv != 0) {
-            marla_logMessagef(session->server, "Failed to execute query to retrieve ID for just-created list item.");
-            parsegraph_rollbackTransaction(session, transactionName);
-            return parsegraph_List_FAILED_TO_EXECUTE;
-        }
-        // Get the ID.
-        apr_status_t datumrv = apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, itemId);
-        if(datumrv != 0) {
-            marla_logMessagef(session->server, "Failed to retrieve ID for just-created list item.");
-            parsegraph_rollbackTransaction(session, transactionName);
-            *itemId = -1;
-            return parsegraph_List_FAILED_TO_EXECUTE;
-        }
+        *itemId = newId;
     }
 
     if(0 != parsegraph_commitTransaction(session, transactionName)) {
@@ -1187,7 +856,6 @@ parsegraph_ListStatus parsegraph_List_prependItem(parsegraph_Session* session, i
 parsegraph_ListStatus parsegraph_List_truncate(parsegraph_Session* session, int listId, int* numRemoved)
 {
     apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     const char* transactionName = "parsegraph_List_truncate";
     if(0 != parsegraph_beginTransaction(session, transactionName)) {
         return parsegraph_List_FAILED_TO_EXECUTE;
@@ -1225,15 +893,14 @@ parsegraph_ListStatus parsegraph_List_truncate(parsegraph_Session* session, int
     }
 
     const char* queryName = "parsegraph_List_truncate";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_truncate)) {
         // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         parsegraph_rollbackTransaction(session, transactionName);
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
     int nrows = 0;
-    rv = apr_dbd_pvbquery(dbd->driver, pool, dbd->handle, &nrows, query, &listId);
+    rv = parsegraph_pvbquery(session, pool, &nrows, parsegraph_Statement_List_truncate, &listId);
     if(0 != rv) {
         marla_logMessagef(session->server,
             "Failed to run query to truncate list %d.", listId
@@ -1256,16 +923,14 @@ parsegraph_ListStatus parsegraph_List_truncate(parsegraph_Session* session, int
 parsegraph_ListStatus parsegraph_List_updateItem(parsegraph_Session* session, int itemId, int typeId, const char* value)
 {
     apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     const char* queryName = "parsegraph_List_updateItem";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_updateItem)) {
          // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
     int nrows = 0;
-    int rv = apr_dbd_pvbquery(dbd->driver, pool, dbd->handle, &nrows, query, typeId, value, &itemId);
+    int rv = parsegraph_pvbquery(session, pool, &nrows, parsegraph_Statement_List_updateItem, typeId, value, &itemId);
     if(0 != rv) {
         marla_logMessagef(session->server,
             "Failed to run query to set value for list item %d.", itemId
@@ -1283,7 +948,6 @@ parsegraph_ListStatus parsegraph_List_updateItem(parsegraph_Session* session, in
 parsegraph_ListStatus parsegraph_List_removeItem(parsegraph_Session* session, int itemId)
 {
     apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     const char* transactionName = "parsegraph_List_removeItem";
     if(0 != parsegraph_beginTransaction(session, transactionName)) {
         return parsegraph_List_FAILED_TO_EXECUTE;
@@ -1316,8 +980,7 @@ parsegraph_ListStatus parsegraph_List_removeItem(parsegraph_Session* session, in
     }
 
     const char* queryName = "parsegraph_List_removeItem";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_removeItem)) {
          // Query was not defined.
         marla_logMessagef(session->server,
             "%s query was not defined.", queryName
@@ -1326,7 +989,7 @@ parsegraph_ListStatus parsegraph_List_removeItem(parsegraph_Session* session, in
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
     int nrows = 0;
-    rv = apr_dbd_pvbquery(dbd->driver, pool, dbd->handle, &nrows, query, &itemId);
+    rv = parsegraph_pvbquery(session, pool, &nrows, parsegraph_Statement_List_removeItem, &itemId);
     if(0 != rv) {
         marla_logMessagef(session->server,
             "Failed to run query to remove list item %d.", itemId
@@ -1347,7 +1010,6 @@ parsegraph_ListStatus parsegraph_List_removeItem(parsegraph_Session* session, in
 parsegraph_ListStatus parsegraph_List_destroyItem(parsegraph_Session* session, int itemId)
 {
     apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     const char* transactionName = "parsegraph_List_destroyItem";
     if(0 != parsegraph_beginTransaction(session, transactionName)) {
         return parsegraph_List_FAILED_TO_EXECUTE;
@@ -1367,8 +1029,7 @@ parsegraph_ListStatus parsegraph_List_destroyItem(parsegraph_Session* session, i
     }
 
     const char* queryName = "parsegraph_List_destroyItem";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_destroyItem)) {
          // Query was not defined.
         marla_logMessagef(session->server,
             "%s query was not defined.", queryName
@@ -1377,7 +1038,7 @@ parsegraph_ListStatus parsegraph_List_destroyItem(parsegraph_Session* session, i
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
     int nrows = 0;
-    int rv = apr_dbd_pvbquery(dbd->driver, pool, dbd->handle, &nrows, query, &itemId);
+    int rv = parsegraph_pvbquery(session, pool, &nrows, parsegraph_Statement_List_destroyItem, &itemId);
     if(0 != rv) {
         marla_logMessagef(session->server,
             "Failed to run query to destroy list item %d.", itemId
@@ -1403,16 +1064,14 @@ parsegraph_ListStatus parsegraph_List_destroyItem(parsegraph_Session* session, i
 parsegraph_ListStatus parsegraph_List_listItems(parsegraph_Session* session, int listId, parsegraph_List_item*** values, size_t* nvalues)
 {
     apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     const char* queryName = "parsegraph_List_listItems";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_listItems)) {
          // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
-    apr_dbd_results_t* res = NULL;
-    int rv = apr_dbd_pvbselect(dbd->driver, pool, dbd->handle, &res, query, 0, &listId);
+    parsegraph_Cursor cursor;
+    int rv = parsegraph_Cursor_open(&cursor, session, pool, parsegraph_Statement_List_listItems, &listId);
     if(0 != rv) {
         marla_logMessagef(session->server, "Failed to run query to get list %d.", listId);
         return parsegraph_List_FAILED_TO_EXECUTE;
@@ -1423,19 +1082,24 @@ parsegraph_ListStatus parsegraph_List_listItems(parsegraph_Session* session, int
     // Get the resulting row.
     parsegraph_List_item* head = 0;
     while(1) {
-        apr_dbd_row_t* row;
-        int dbrv = apr_dbd_get_row(dbd->driver, pool, res, &row, -1);
-        if(dbrv == -1) {
+        int dbrv = parsegraph_Cursor_next(&cursor);
+        if(dbrv == APR_EOF) {
             break;
         }
+        if(dbrv != APR_SUCCESS) {
+            marla_logMessagef(session->server, "Failed to read items of list %d.", listId);
+            parsegraph_Cursor_close(&cursor);
+            return parsegraph_List_FAILED_TO_EXECUTE;
+        }
 
         int itemId;
-        if(0 != apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, &itemId)) {
+        if(0 != parsegraph_Cursor_int(&cursor, 0, &itemId)) {
             marla_logMessagef(session->server, "Failed to run query to get list %d.", listId);
+            parsegraph_Cursor_close(&cursor);
             return parsegraph_List_FAILED_TO_EXECUTE;
         }
         int nextId;
-        switch(apr_dbd_datum_get(dbd->driver, row, 1, APR_DBD_TYPE_INT, &nextId)) {
+        switch(parsegraph_Cursor_int(&cursor, 1, &nextId)) {
         case APR_SUCCESS:
             break;
         case APR_ENOENT:
@@ -1443,10 +1107,11 @@ parsegraph_ListStatus parsegraph_List_listItems(parsegraph_Session* session, int
             break;
         default:
             marla_logMessagef(session->server, "Failed to run query to get list %d item %d.", listId, itemId);
+            parsegraph_Cursor_close(&cursor);
             return parsegraph_List_FAILED_TO_EXECUTE;
         }
         int prevId;
-        switch(apr_dbd_datum_get(dbd->driver, row, 2, APR_DBD_TYPE_INT, &prevId)) {
+        switch(parsegraph_Cursor_int(&cursor, 2, &prevId)) {
         case APR_SUCCESS:
             break;
         case APR_ENOENT:
@@ -1454,11 +1119,12 @@ parsegraph_ListStatus parsegraph_List_listItems(parsegraph_Session* session, int
             break;
         default:
             marla_logMessagef(session->server, "Failed to get list %d item %d prev.", listId, itemId);
+            parsegraph_Cursor_close(&cursor);
             return parsegraph_List_FAILED_TO_EXECUTE;
         }
-        const char* value = apr_dbd_get_entry(dbd->driver, row, 3);
+        const char* value = parsegraph_Cursor_text(&cursor, 3);
         int typeId;
-        switch(apr_dbd_datum_get(dbd->driver, row, 4, APR_DBD_TYPE_INT, &typeId)) {
+        switch(parsegraph_Cursor_int(&cursor, 4, &typeId)) {
         case APR_SUCCESS:
             break;
         case APR_ENOENT:
@@ -1466,6 +1132,7 @@ parsegraph_ListStatus parsegraph_List_listItems(parsegraph_Session* session, int
             break;
         default:
             marla_logMessagef(session->server, "Failed to get list %d item %d type.", listId, itemId);
+            parsegraph_Cursor_close(&cursor);
             return parsegraph_List_FAILED_TO_EXECUTE;
         }
         parsegraph_List_item* itemData;
@@ -1479,6 +1146,7 @@ parsegraph_ListStatus parsegraph_List_listItems(parsegraph_Session* session, int
             head = itemData;
         }
     }
+    parsegraph_Cursor_close(&cursor);
 
     *nvalues = apr_hash_count(items);
     *values = apr_palloc(pool, *nvalues*sizeof(parsegraph_List_item*));
@@ -1495,28 +1163,22 @@ parsegraph_ListStatus parsegraph_List_listItems(parsegraph_Session* session, int
     return parsegraph_List_OK;
 }
 
-parsegraph_ListStatus parsegraph_List_setPrev(parsegraph_Session* session, int targetId, int prevId)
+// Points the given column of the target item at linkId, or clears it if linkId is -1.
+static parsegraph_ListStatus setLink(parsegraph_Session* session, int targetId, int linkId, parsegraph_StatementId setId, parsegraph_StatementId clearId, const char* column)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     if(targetId == -1) {
         return parsegraph_List_OK;
     }
-
-    const char* queryName = "parsegraph_List_setPrev";
-    if(prevId == -1) {
-        queryName = "parsegraph_List_clearPrev";
+    int nrows = 0;
+    int rv;
+    if(linkId == -1) {
+        rv = parsegraph_pvbquery(session, session->pool, &nrows, clearId, &targetId);
     }
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
-         // Query was not defined.
-        marla_logMessagef(session->server, "%s query was not defined.", queryName);
-        return parsegraph_List_UNDEFINED_PREPARED_QUERY;
+    else {
+        rv = parsegraph_pvbquery(session, session->pool, &nrows, setId, &linkId, &targetId);
     }
-    int nrows = 0;
-    int rv = apr_dbd_pvbquery(dbd->driver, pool, dbd->handle, &nrows, query, &prevId, &targetId);
     if(0 != rv) {
-        marla_logMessagef(session->server, "Failed to run query to set prev to list item %d.", prevId);
+        marla_logMessagef(session->server, "Failed to run query to set %s of list item %d to %d.", column, targetId, linkId);
         return parsegraph_List_FAILED_TO_EXECUTE;
     }
     if(nrows > 1) {
@@ -1525,55 +1187,33 @@ parsegraph_ListStatus parsegraph_List_setPrev(parsegraph_Session* session, int t
     return parsegraph_List_OK;
 }
 
-parsegraph_ListStatus parsegraph_List_setNext(parsegraph_Session* session, int targetId, int nextId)
+parsegraph_ListStatus parsegraph_List_setPrev(parsegraph_Session* session, int targetId, int prevId)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
-    if(targetId == -1) {
-        return parsegraph_List_OK;
-    }
+    return setLink(session, targetId, prevId, parsegraph_Statement_List_setPrev, parsegraph_Statement_List_clearPrev, "prev");
+}
 
-    const char* queryName = "parsegraph_List_setNext";
-    if(nextId == -1) {
-        queryName = "parsegraph_List_clearPrev";
-    }
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
-         // Query was not defined.
-        marla_logMessagef(session->server, "%s query was not defined.", queryName);
-        return parsegraph_List_UNDEFINED_PREPARED_QUERY;
-    }
-    int nrows = 0;
-    int rv = apr_dbd_pvbquery(dbd->driver, pool, dbd->handle, &nrows, query, &nextId, &targetId);
-    if(0 != rv) {
-        marla_logMessagef(session->server, "Failed to run query to set next to list item %d.", nextId);
-        return parsegraph_List_FAILED_TO_EXECUTE;
-    }
-    if(nrows > 1) {
-        marla_logMessagef(session->server, "Unexpected number of rows updated: %d", nrows);
-    }
-    return parsegraph_List_OK;
+parsegraph_ListStatus parsegraph_List_setNext(parsegraph_Session* session, int targetId, int nextId)
+{
+    return setLink(session, targetId, nextId, parsegraph_Statement_List_setNext, parsegraph_Statement_List_clearNext, "next");
 }
 
 parsegraph_ListStatus parsegraph_List_setList(parsegraph_Session* session, int refId, int listId)
 {
     apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     const char* transactionName = "parsegraph_List_setList";
     if(0 != parsegraph_beginTransaction(session, transactionName)) {
         return parsegraph_List_FAILED_TO_EXECUTE;
     }
 
     const char* queryName = "parsegraph_List_setList";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_setList)) {
          // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         parsegraph_rollbackTransaction(session, transactionName);
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
     int nrows = 0;
-    int rv = apr_dbd_pvbquery(dbd->driver, pool, dbd->handle, &nrows, query, &listId, &refId);
+    int rv = parsegraph_pvbquery(session, pool, &nrows, parsegraph_Statement_List_setList, &listId, &refId);
     if(0 != rv) {
         marla_logMessagef(session->server, "Failed to run query to set list_id to list item %d.", listId);
         parsegraph_rollbackTransaction(session, transactionName);
@@ -1597,14 +1237,13 @@ parsegraph_ListStatus parsegraph_List_setType(parsegraph_Session* session, int i
     apr_pool_t* pool = session->pool;
     ap_dbd_t* dbd = session->dbd;
     const char* queryName = "parsegraph_List_setType";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_setType)) {
          // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
     int nrows = 0;
-    int rv = apr_dbd_pvbquery(dbd->driver, pool, dbd->handle, &nrows, query, &typeId, &itemId);
+    int rv = parsegraph_pvbquery(session, pool, &nrows, parsegraph_Statement_List_setType, &typeId, &itemId);
     if(0 != rv) {
         marla_logMessagef(session->server,
             "Failed to run query to set type of list item %d. %s]",
@@ -1625,8 +1264,7 @@ parsegraph_ListStatus parsegraph_List_setValue(parsegraph_Session* session, int
     apr_pool_t* pool = session->pool;
     ap_dbd_t* dbd = session->dbd;
     const char* queryName = "parsegraph_List_setValue";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_setValue)) {
          // Query was not defined.
         marla_logMessagef(session->server,
             "%s query was not defined.", queryName
@@ -1634,7 +1272,7 @@ parsegraph_ListStatus parsegraph_List_setValue(parsegraph_Session* session, int
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
     int nrows = 0;
-    int rv = apr_dbd_pvbquery(dbd->driver, pool, dbd->handle, &nrows, query, value, &itemId);
+    int rv = parsegraph_pvbquery(session, pool, &nrows, parsegraph_Statement_List_setValue, value, &itemId);
     if(0 != rv) {
         marla_logMessagef(session->server,
             "Failed to run query to set value of list item %d. %s]", itemId, apr_dbd_error(dbd->driver, dbd->handle, rv)
@@ -1652,10 +1290,8 @@ parsegraph_ListStatus parsegraph_List_setValue(parsegraph_Session* session, int
 parsegraph_ListStatus parsegraph_List_reparentItems(parsegraph_Session* session, int refId, int newParentId)
 {
     apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
     const char* queryName = "parsegraph_List_reparentItems";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_List_reparentItems)) {
          // Query was not defined.
         marla_logMessagef(session->server,
             "%s query was not defined.", queryName
@@ -1663,7 +1299,7 @@ parsegraph_ListStatus parsegraph_List_reparentItems(parsegraph_Session* session,
         return parsegraph_List_UNDEFINED_PREPARED_QUERY;
     }
     int nrows = 0;
-    int rv = apr_dbd_pvbquery(dbd->driver, pool, dbd->handle, &nrows, query, &newParentId, &refId);
+    int rv = parsegraph_pvbquery(session, pool, &nrows, parsegraph_Statement_List_reparentItems, &newParentId, &refId);
     if(0 != rv) {
         marla_logMessagef(session->server,
             "Failed to run query to reparent items."
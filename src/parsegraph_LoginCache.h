@@ -0,0 +1,73 @@
+#ifndef parsegraph_LoginCache_INCLUDED
+#define parsegraph_LoginCache_INCLUDED
+
+#include <apr_pools.h>
+#include <apr_time.h>
+
+/**
+ * A bounded, least-recently-used cache of refreshed logins, keyed by session
+ * selector. Each entry keeps a digest of the session token rather than the
+ * token itself, with the login's username, user id, and expiry time.
+ *
+ * The cache may be shared by sessions on different threads. Logins ended in
+ * another process are not seen by a private cache until their entries
+ * expire, so the time to live bounds how long a login may outlast its logout
+ * there. A shared cache is seen by every process that uses it, such as the
+ * children of a prefork server.
+ */
+typedef struct parsegraph_LoginCache parsegraph_LoginCache;
+
+struct parsegraph_LoginCacheStats {
+    apr_uint64_t hits;
+    apr_uint64_t misses;
+    apr_uint64_t evictions;
+    int size;
+};
+typedef struct parsegraph_LoginCacheStats parsegraph_LoginCacheStats;
+
+/**
+ * Creates a cache of up to capacity logins, each kept for at most ttl.
+ * Returns NULL on failure.
+ */
+parsegraph_LoginCache* parsegraph_LoginCache_new(apr_pool_t* parent, int capacity, apr_interval_time_t ttl);
+
+/**
+ * Creates a cache whose entries are in shared memory, so that it is shared
+ * with every process forked after it is created. If filename is not NULL,
+ * the memory is also named by that file so that other processes may attach
+ * to it. Entries are kept in buckets of eight, and each bucket evicts by a
+ * clock over its entries. Readers never block, and writers lock only the
+ * bucket they change. A reader that finds an entry stuck mid-write misses
+ * and falls back to the database, a writer that cannot lock its bucket
+ * soon skips caching, and a bucket left locked by a process that exited is
+ * taken over. Returns NULL on failure.
+ */
+parsegraph_LoginCache* parsegraph_LoginCache_newShared(apr_pool_t* parent, int capacity, apr_interval_time_t ttl, const char* filename);
+
+// Attaches to a shared cache created with a filename by another process. Returns NULL on failure.
+parsegraph_LoginCache* parsegraph_LoginCache_attachShared(apr_pool_t* parent, const char* filename);
+
+// Destroys a private cache, or detaches from a shared one. The creator of a shared cache removes it.
+void parsegraph_LoginCache_destroy(parsegraph_LoginCache* cache);
+
+/**
+ * Looks up the login with the given selector and token. On a hit, the
+ * username is copied into pool. Returns APR_SUCCESS, or APR_ENOENT if no
+ * unexpired entry matches both.
+ */
+int parsegraph_LoginCache_get(parsegraph_LoginCache* cache, apr_pool_t* pool, const char* selector, const char* token, const char** username, int* userId);
+
+// Adds or replaces the login with the given selector, evicting the least recently used login if full.
+void parsegraph_LoginCache_put(parsegraph_LoginCache* cache, const char* selector, const char* token, const char* username, int userId);
+
+// Removes every login of the given user.
+void parsegraph_LoginCache_removeUser(parsegraph_LoginCache* cache, const char* username);
+
+// Removes every login.
+void parsegraph_LoginCache_clear(parsegraph_LoginCache* cache);
+
+// Hits, misses, and evictions of a shared cache are those of this process
+// only; the size covers every process.
+void parsegraph_LoginCache_stats(parsegraph_LoginCache* cache, parsegraph_LoginCacheStats* stats);
+
+#endif // parsegraph_LoginCache_INCLUDED
@@ -0,0 +1,34 @@
+#ifndef parsegraph_LoginSweeper_INCLUDED
+#define parsegraph_LoginSweeper_INCLUDED
+
+#include <apr_pools.h>
+#include <apr_time.h>
+#include <marla.h>
+
+/**
+ * A thread that deletes expired logins from the login table, and old login
+ * revocations. It has its own connection, and sweeps with
+ * parsegraph_sweepExpiredLogins once every interval, so that no request
+ * waits on the deletions.
+ */
+typedef struct parsegraph_LoginSweeper parsegraph_LoginSweeper;
+
+/**
+ * Opens a connection with the given apr_dbd driver and parameters, and
+ * starts sweeping logins unused for longer than expiry, batchSize rows at a
+ * time. Login revocations are pruned once older than revocationLifetime,
+ * which must be at least the lifetime of any signed logins, or expiry if it
+ * is 0. Returns NULL on failure.
+ */
+parsegraph_LoginSweeper* parsegraph_LoginSweeper_start(apr_pool_t* parent, marla_Server* server, const char* driverName, const char* params, apr_interval_time_t expiry, apr_interval_time_t revocationLifetime, apr_interval_time_t interval, int batchSize);
+
+// Stops the thread, waiting for a sweep in progress, and closes its connection.
+void parsegraph_LoginSweeper_stop(parsegraph_LoginSweeper* sweeper);
+
+// Sweeps now rather than at the end of the current interval.
+void parsegraph_LoginSweeper_wake(parsegraph_LoginSweeper* sweeper);
+
+// Returns the number of logins deleted so far.
+apr_uint64_t parsegraph_LoginSweeper_swept(parsegraph_LoginSweeper* sweeper);
+
+#endif // parsegraph_LoginSweeper_INCLUDED
@@ -0,0 +1,80 @@
+#ifndef parsegraph_Profile_INCLUDED
+#define parsegraph_Profile_INCLUDED
+
+#include <apr_pools.h>
+#include "parsegraph_Session.h"
+
+/**
+ * SQLite connection settings applied when a connection is opened. Each
+ * setting is left at SQLite's default unless it has been set.
+ *
+ * Settings are read from a file of "key = value" lines, with # comments,
+ * and from environment variables. The keys and their variables are:
+ *
+ *   journal_mode   PARSEGRAPH_JOURNAL_MODE   DELETE, TRUNCATE, PERSIST, MEMORY, WAL or OFF
+ *   synchronous    PARSEGRAPH_SYNCHRONOUS    OFF, NORMAL, FULL or EXTRA
+ *   cache_size     PARSEGRAPH_CACHE_SIZE     pages, or KiB if negative
+ *   mmap_size      PARSEGRAPH_MMAP_SIZE      bytes
+ *   temp_store     PARSEGRAPH_TEMP_STORE     DEFAULT, FILE or MEMORY
+ *   busy_timeout   PARSEGRAPH_BUSY_TIMEOUT   milliseconds
+ *   auth_database  PARSEGRAPH_AUTH_DATABASE  path of a database for the user tables
+ *
+ * PARSEGRAPH_PROFILE names a file that is read before the other variables.
+ */
+struct parsegraph_Profile {
+    const char* journalMode;
+    const char* synchronous;
+    const char* tempStore;
+    int hasCacheSize;
+    int cacheSize;
+    int hasMmapSize;
+    apr_int64_t mmapSize;
+    int hasBusyTimeout;
+    int busyTimeout;
+    const char* authDatabase;
+};
+typedef struct parsegraph_Profile parsegraph_Profile;
+
+// Leaves every setting at SQLite's default.
+void parsegraph_Profile_init(parsegraph_Profile* profile);
+
+// Sets the recommended settings for a server: WAL, synchronous NORMAL, a
+// 64 MiB page cache, 256 MiB of mmap, in-memory temp tables, and a 5 second
+// busy timeout.
+void parsegraph_Profile_tuned(parsegraph_Profile* profile);
+
+// Sets one setting by key. Returns APR_SUCCESS, or APR_EINVAL if the key or value is not valid.
+// Paths are not copied.
+int parsegraph_Profile_set(parsegraph_Profile* profile, const char* key, const char* value);
+
+// Reads settings from the named file. Strings are allocated from pool.
+int parsegraph_Profile_load(parsegraph_Profile* profile, apr_pool_t* pool, const char* path);
+
+// Reads PARSEGRAPH_PROFILE and the setting variables.
+int parsegraph_Profile_loadEnvironment(parsegraph_Profile* profile, apr_pool_t* pool);
+
+/**
+ * Applies the profile to the session's connection, attaching the auth
+ * database first so that its settings match. Connections that are not
+ * SQLite are left unchanged. Returns APR_SUCCESS, or the status of the first
+ * setting that failed.
+ */
+int parsegraph_Profile_apply(parsegraph_Session* session, parsegraph_Profile* profile);
+
+/**
+ * Applies the profile configured by the environment to the session's
+ * connection, unless an earlier session on the same connection already
+ * did. The environment is read once per process, on first use. Returns
+ * APR_SUCCESS, or the status of reading or applying the profile.
+ */
+int parsegraph_Profile_applyConfigured(parsegraph_Session* session);
+
+/**
+ * Reads the configured profile from the environment again, so that each
+ * connection gets it applied by its next session. Strings of the old
+ * profile are freed, so this must not run while other threads create
+ * sessions. Returns the status of reading it.
+ */
+int parsegraph_Profile_reloadEnvironment(void);
+
+#endif // parsegraph_Profile_INCLUDED
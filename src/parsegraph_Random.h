@@ -0,0 +1,18 @@
+#ifndef parsegraph_Random_INCLUDED
+#define parsegraph_Random_INCLUDED
+
+#include <apr_errno.h>
+
+/**
+ * Fills buf with len bytes from a cryptographically secure generator.
+ *
+ * Each thread keeps its own buffer of random bytes, refilled from OpenSSL's
+ * generator in large chunks, so that salts, session tokens and GUIDs do not
+ * each cost a system call. Bytes are erased from the buffer as they are
+ * handed out, and a forked child discards the buffer it inherited rather
+ * than repeat its parent's bytes. Returns APR_SUCCESS, or APR_EGENERAL if
+ * the generator failed.
+ */
+apr_status_t parsegraph_randomBytes(void* buf, apr_size_t len);
+
+#endif // parsegraph_Random_INCLUDED
@@ -0,0 +1,73 @@
+#ifndef parsegraph_RateLimiter_INCLUDED
+#define parsegraph_RateLimiter_INCLUDED
+
+#include <apr_pools.h>
+#include <apr_time.h>
+#include <marla.h>
+
+/**
+ * A token-bucket rate limiter of fixed size, keyed by a kind and a key, such
+ * as a username, user id, or remote address. Each key may take up to burst
+ * tokens at once, and regains tokens at the given rate.
+ *
+ * Keys are hashed into shards that each have their own lock and a fixed
+ * number of buckets. A key may occupy any of four buckets in its shard;
+ * when all four are taken, the one used least recently is given up, so
+ * memory never grows and idle keys are forgotten first. A forgotten key
+ * starts again with a full bucket. Keys are told apart only by a 64-bit
+ * hash.
+ *
+ * The limiter may be shared by sessions on different threads.
+ */
+typedef struct parsegraph_RateLimiter parsegraph_RateLimiter;
+
+struct parsegraph_RateLimiterStats {
+    apr_uint64_t allowed;
+    apr_uint64_t limited;
+    apr_uint64_t evictions;
+    int size;
+};
+typedef struct parsegraph_RateLimiterStats parsegraph_RateLimiterStats;
+
+/**
+ * Creates a limiter of up to capacity keys, each allowed burst tokens at
+ * once and a new token every interval. Returns NULL on failure.
+ */
+parsegraph_RateLimiter* parsegraph_RateLimiter_new(apr_pool_t* parent, int capacity, int burst, apr_interval_time_t interval);
+
+void parsegraph_RateLimiter_destroy(parsegraph_RateLimiter* limiter);
+
+/**
+ * Takes a token for the given key. Returns APR_SUCCESS, or APR_EAGAIN if
+ * the key has no tokens left.
+ */
+int parsegraph_RateLimiter_take(parsegraph_RateLimiter* limiter, const char* kind, const void* key, apr_size_t keyLen);
+
+/**
+ * Returns APR_SUCCESS if the key has a token, or APR_EAGAIN if it has none,
+ * without taking one. Callers limited by several keys check each before
+ * taking from any, so that a refusal by one does not spend the others.
+ * Concurrent takers may still spend the token between the check and the
+ * take.
+ */
+int parsegraph_RateLimiter_peek(parsegraph_RateLimiter* limiter, const char* kind, const void* key, apr_size_t keyLen);
+
+// Takes a token for the given user id.
+int parsegraph_RateLimiter_takeUser(parsegraph_RateLimiter* limiter, const char* kind, int userId);
+
+// Forgets every key.
+void parsegraph_RateLimiter_clear(parsegraph_RateLimiter* limiter);
+
+void parsegraph_RateLimiter_stats(parsegraph_RateLimiter* limiter, parsegraph_RateLimiterStats* stats);
+
+// Logs the limiter's stats to the server under the given name.
+void parsegraph_RateLimiter_logStats(parsegraph_RateLimiter* limiter, marla_Server* server, const char* name);
+
+/**
+ * Logs the limiter's stats under the given name at most once every interval,
+ * from whichever thread takes a token after the interval has passed. An
+ * interval of zero stops logging.
+ */
+void parsegraph_RateLimiter_setLogging(parsegraph_RateLimiter* limiter, marla_Server* server, const char* name, apr_interval_time_t interval);
+
+#endif // parsegraph_RateLimiter_INCLUDED
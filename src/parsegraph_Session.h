@@ -1,18 +1,253 @@
 #ifndef parsegraph_Session_INCLUDED
 #define parsegraph_Session_INCLUDED
 #include <apr_pools.h>
+#include <apr_time.h>
 #include <apr_dbd.h>
+#include <apr_tables.h>
+#include <apr_hash.h>
 #include <mod_dbd.h>
 #include <marla.h>
 
+// SQL dialects that the statement catalog and schema are written for.
+enum parsegraph_Dialect {
+    parsegraph_Dialect_SQLITE = 0,
+    parsegraph_Dialect_PGSQL
+};
+typedef enum parsegraph_Dialect parsegraph_Dialect;
+
 struct parsegraph_Session {
+// Results of calls on this session are allocated from pool, which may be
+// cleared between requests. State kept across requests, such as prepared
+// statements, is allocated from statePool, of which pool is a child.
 apr_pool_t* pool;
+apr_pool_t* statePool;
 ap_dbd_t* dbd;
 marla_Server* server;
+
+// The dialect of this session's driver.
+parsegraph_Dialect dialect;
+
+// Prepared statements, indexed by parsegraph_StatementId and filled lazily.
+apr_dbd_prepared_t** statements;
+struct parsegraph_StatementStats* statementStats;
+
+// Whether INSERT ... RETURNING is available: 1 if so, -1 if not, and 0
+// until parsegraph_supportsInsertReturning has checked.
+int insertReturning;
+
+// Native SQLite statements, or NULL when statements run through apr_dbd.
+struct parsegraph_SQLite* sqlite;
+
+// Read-only connections used for SELECTs while no transaction is open, or NULL.
+struct parsegraph_SessionPool* readers;
+
+// This session's slot in the parsegraph_SessionPool that owns it, or -1.
+int poolIndex;
+
+// Cache of refreshed logins shared with other sessions, or NULL.
+struct parsegraph_LoginCache* loginCache;
+
+// Signer of logins that need no login row, or NULL.
+struct parsegraph_SignedLogins* signedLogins;
+
+// Limiter of login attempts by username and remote address, or NULL.
+struct parsegraph_RateLimiter* loginLimiter;
+
+// Index of usernames kept current as users are created and removed, or NULL.
+struct parsegraph_UsernameIndex* usernameIndex;
+
+// Address of the client this session is serving, or NULL if unknown.
+const char* remoteAddress;
+
+// How long a login may go unused before it expires, or 0 if logins do not expire.
+apr_interval_time_t loginExpiry;
+
+// How long login revocations are kept when the session has no signer, or 0 to keep them.
+apr_interval_time_t revocationLifetime;
+
+// PBKDF2 iterations of new password hashes.
+int passwordIterations;
+
+// Whether new environment GUIDs are time-ordered rather than fully random.
+int timeOrderedGUIDs;
+
+// Shards holding environment data, or NULL if this session holds it all.
+struct parsegraph_Shards* shards;
+
+// Schema name of the attached database holding the user tables, or NULL
+// if they are in the main database.
+const char* authSchema;
+
+// Users loaded by parsegraph_loadUser, keyed by username and by id, and the
+// pool that holds them, or NULL unless memoization is on.
+apr_pool_t* userMemoPool;
+apr_hash_t* usersByName;
+apr_hash_t* usersById;
+
+// Number of open savepoints on this session's connection.
+int transactionDepth;
+
+// Events queued by parsegraph_notifyEnvironment and parsegraph_notifyUser
+// while a transaction is open, and the queue length at each open savepoint.
+apr_array_header_t* pendingEvents;
+apr_array_header_t* pendingEventMarks;
+
+// Changes to the username index held until the outermost commit, and their
+// count at each open savepoint.
+apr_array_header_t* pendingUsernames;
+apr_array_header_t* pendingUsernameMarks;
+
+// The unmanaged pool that owns this session's own connection, or NULL when
+// the session was created on a caller's connection.
+apr_pool_t* connectionPool;
 };
 typedef struct parsegraph_Session parsegraph_Session;
 
+// Creates a session on the given connection, such as one from mod_dbd, and
+// applies the connection profile from the environment to the connection if
+// no earlier session on it has. Returns NULL if the profile cannot be read
+// or applied.
 parsegraph_Session* parsegraph_Session_new(apr_pool_t* parent, ap_dbd_t* dbd);
 void parsegraph_Session_destroy(parsegraph_Session* session);
 
+/**
+ * Frees the results of earlier calls on this session by clearing its pool,
+ * so that a session reused across requests does not grow. Nothing returned
+ * by those calls may be used afterwards.
+ */
+void parsegraph_Session_clear(parsegraph_Session* session);
+
+/**
+ * Opens a new connection with the given apr_dbd driver and parameters and
+ * returns a session that owns it. The connection lives in its own unmanaged
+ * pool, so the session may be used from any single thread at a time. As
+ * with parsegraph_Session_new, the connection profile from the environment
+ * is applied to it. Returns NULL on failure.
+ */
+parsegraph_Session* parsegraph_Session_open(marla_Server* server, const char* driverName, const char* params);
+
+// Destroys a session returned by parsegraph_Session_open and closes its connection.
+void parsegraph_Session_close(parsegraph_Session* session);
+
+/**
+ * Runs this session's statements directly against the SQLite connection
+ * underlying its sqlite3 apr_dbd handle. Returns APR_ENOTIMPL for other
+ * drivers or when libparsegraph was built without SQLite.
+ */
+int parsegraph_Session_useNativeSQLite(parsegraph_Session* session);
+
+/**
+ * Routes this session's read-only statements to sessions checked out of the
+ * given pool while no transaction is open on this session. The readers must
+ * use the same driver and database as this session, and the pool must
+ * outlive it. Several sessions may share one pool of readers.
+ */
+void parsegraph_Session_setReaders(parsegraph_Session* session, struct parsegraph_SessionPool* readers);
+
+/**
+ * Attaches the SQLite database at path as the home of the user and login
+ * tables, so that logins and content writes take different database
+ * locks. This must be done on every connection before
+ * parsegraph_upgradeUserTables, and the main database must not have user
+ * tables of its own. Sessions created while the connection profile names an
+ * auth database attach it themselves. A session on a connection that another
+ * session already attached it to uses the attached database. Returns
+ * APR_ENOTIMPL for drivers other than sqlite3.
+ */
+int parsegraph_Session_attachAuthDatabase(parsegraph_Session* session, const char* path);
+
+/**
+ * Makes the session's connection refuse writes. Suitable as the warmup
+ * function of a pool of readers.
+ */
+int parsegraph_Session_makeReadOnly(parsegraph_Session* session, void* data);
+
+/**
+ * Answers login refreshes from the given cache when possible, and keeps it
+ * up to date as logins end. The cache must outlive the session.
+ */
+void parsegraph_Session_setLoginCache(parsegraph_Session* session, struct parsegraph_LoginCache* cache);
+
+/**
+ * Issues signed logins with the given signer, and revokes them in it as
+ * logins end. The signer must outlive the session.
+ */
+void parsegraph_Session_setSignedLogins(parsegraph_Session* session, struct parsegraph_SignedLogins* logins);
+
+/**
+ * Refuses logins with parsegraph_RATE_LIMITED once the given limiter has
+ * no tokens left for their username, or for the session's remote address,
+ * before any password or database work is done. The limiter must outlive
+ * the session.
+ */
+void parsegraph_Session_setLoginLimiter(parsegraph_Session* session, struct parsegraph_RateLimiter* limiter);
+
+// Sets the address of the client this session is serving, or NULL. The address must outlive its use.
+void parsegraph_Session_setRemoteAddress(parsegraph_Session* session, const char* address);
+
+/**
+ * Keeps the given username index current as this session creates and
+ * removes users. The index must outlive the session.
+ */
+void parsegraph_Session_setUsernameIndex(parsegraph_Session* session, struct parsegraph_UsernameIndex* index);
+
+/**
+ * Expires logins unused for longer than the given time, or never if it is 0.
+ * A login cache set on the session should keep entries for at most a
+ * quarter of it, so that logins in use are recorded as used before they
+ * would be swept.
+ */
+void parsegraph_Session_setLoginExpiry(parsegraph_Session* session, apr_interval_time_t expiry);
+
+/**
+ * Prunes login revocations older than the given time when sweeping logins
+ * without a signer, or never if it is 0. It must be at least the lifetime
+ * of signed logins issued by any process using the database.
+ */
+void parsegraph_Session_setRevocationLifetime(parsegraph_Session* session, apr_interval_time_t lifetime);
+
+/**
+ * Sets the PBKDF2 iterations of new password hashes. Sessions start with
+ * PARSEGRAPH_PASSWORD_ITERATIONS if it is set, or parsegraph_PASSWORD_ITERATIONS.
+ * Passwords hashed with a different count are rehashed when next used to log in.
+ */
+void parsegraph_Session_setPasswordIterations(parsegraph_Session* session, int iterations);
+
+/**
+ * Sets whether new environments get time-ordered GUIDs, which keep inserts
+ * at the end of the GUID index, instead of fully random ones. Sessions start
+ * with time-ordered GUIDs if PARSEGRAPH_GUID_ORDER is "time".
+ */
+void parsegraph_Session_setTimeOrderedGUIDs(parsegraph_Session* session, int timeOrdered);
+
+/**
+ * Routes environment functions given a GUID on this session to the shard
+ * holding that environment. The shards must outlive the session.
+ */
+void parsegraph_Session_setShards(parsegraph_Session* session, struct parsegraph_Shards* shards);
+
+/**
+ * Remembers users loaded on this session until parsegraph_Session_endUserMemo,
+ * so that a request checking several things about a user loads it once.
+ * Changes made through this session forget the users they may affect, as
+ * does rolling back a transaction, but changes made elsewhere are not seen
+ * until the memo ends. Meant to bracket a single request.
+ */
+void parsegraph_Session_beginUserMemo(parsegraph_Session* session);
+void parsegraph_Session_endUserMemo(parsegraph_Session* session);
+
+// Forgets every user remembered by this session, if any.
+void parsegraph_Session_forgetUsers(parsegraph_Session* session);
+
+struct parsegraph_GUID;
+
+/**
+ * Returns the session holding the given environment's data: its shard if
+ * the session has shards, or otherwise the session itself.
+ */
+parsegraph_Session* parsegraph_Session_forEnvironment(parsegraph_Session* session, struct parsegraph_GUID* env);
+
+void parsegraph_Session_enterTransaction(parsegraph_Session* session);
+void parsegraph_Session_leaveTransaction(parsegraph_Session* session, int committed);
+
 #endif // parsegraph_Session_INCLUDED
@@ -0,0 +1,57 @@
+#ifndef parsegraph_SessionPool_INCLUDED
+#define parsegraph_SessionPool_INCLUDED
+
+#include <apr_pools.h>
+#include <apr_time.h>
+#include <marla.h>
+#include "parsegraph_Session.h"
+
+/**
+ * A fixed set of sessions, each with its own connection, shared between
+ * threads. Checkout and checkin are lock-free; a session is used by one
+ * thread at a time between the two.
+ */
+typedef struct parsegraph_SessionPool parsegraph_SessionPool;
+
+// Called once for each new connection, after the catalog is prepared.
+// A non-zero return fails parsegraph_SessionPool_new.
+typedef int(*parsegraph_SessionWarmup)(parsegraph_Session* session, void* data);
+
+// Checkout counters, with times in microseconds.
+struct parsegraph_SessionPoolStats {
+    apr_uint64_t checkouts;
+    apr_uint64_t waits;
+    apr_uint64_t timeouts;
+    apr_uint64_t totalWait;
+    apr_uint64_t maxWait;
+};
+typedef struct parsegraph_SessionPoolStats parsegraph_SessionPoolStats;
+
+/**
+ * Opens nsessions connections with the given apr_dbd driver and parameters,
+ * prepares every catalog statement on each, and runs warmup if not NULL.
+ * Returns NULL if any connection fails.
+ */
+parsegraph_SessionPool* parsegraph_SessionPool_new(apr_pool_t* parent, marla_Server* server, const char* driverName, const char* params, int nsessions, parsegraph_SessionWarmup warmup, void* warmupData);
+
+// Closes every session. No session may be checked out.
+void parsegraph_SessionPool_destroy(parsegraph_SessionPool* sessions);
+
+/**
+ * Checks out an idle session, waiting up to timeout for one to be returned.
+ * A negative timeout waits indefinitely. Returns APR_SUCCESS or APR_TIMEUP.
+ */
+int parsegraph_SessionPool_checkout(parsegraph_SessionPool* sessions, apr_interval_time_t timeout, parsegraph_Session** session);
+
+/**
+ * Returns a session obtained from parsegraph_SessionPool_checkout, and
+ * clears its pool. Nothing allocated from the session's pool may be used
+ * afterwards.
+ */
+void parsegraph_SessionPool_checkin(parsegraph_SessionPool* sessions, parsegraph_Session* session);
+
+int parsegraph_SessionPool_size(parsegraph_SessionPool* sessions);
+
+void parsegraph_SessionPool_stats(parsegraph_SessionPool* sessions, parsegraph_SessionPoolStats* stats);
+
+#endif // parsegraph_SessionPool_INCLUDED
@@ -0,0 +1,59 @@
+#ifndef parsegraph_Shards_INCLUDED
+#define parsegraph_Shards_INCLUDED
+
+#include <apr_pools.h>
+#include <marla.h>
+#include "parsegraph_Session.h"
+#include "parsegraph_environment.h"
+
+/**
+ * A global database for users and logins, and a fixed number of shard
+ * databases for environments. An environment and its lists live in the
+ * shard chosen by a hash of its GUID, so writes to environments in
+ * different shards do not contend for the same database lock.
+ *
+ * Every database gets the full schema. Users, logins, and per-user lists
+ * are kept in the global database. The number of shards must not change
+ * once environments have been created.
+ *
+ * Each database has one session, so the shards are used by one thread at a
+ * time. Multithreaded hosts open one set of shards per thread.
+ */
+typedef struct parsegraph_Shards parsegraph_Shards;
+
+/**
+ * Opens the global database and nshards shard databases with the given
+ * apr_dbd driver. The parameters for shard i are shardParams with its first
+ * %d replaced by i, such as "environments-%d.sqlite"; nothing else in them
+ * is treated as a format. The global session routes environment functions
+ * to the shards. Returns NULL on failure, or if shardParams has no %d.
+ */
+parsegraph_Shards* parsegraph_Shards_open(apr_pool_t* parent, marla_Server* server, const char* driverName, const char* globalParams, const char* shardParams, int nshards);
+
+// Closes every database.
+void parsegraph_Shards_close(parsegraph_Shards* shards);
+
+int parsegraph_Shards_count(parsegraph_Shards* shards);
+
+// Returns the session of the global database.
+parsegraph_Session* parsegraph_Shards_global(parsegraph_Shards* shards);
+
+// Returns the session of the given shard.
+parsegraph_Session* parsegraph_Shards_shard(parsegraph_Shards* shards, int index);
+
+// Returns the index of the shard holding the given environment.
+int parsegraph_Shards_indexFor(parsegraph_Shards* shards, parsegraph_GUID* env);
+
+// Returns the session of the shard holding the given environment.
+parsegraph_Session* parsegraph_Shards_forEnvironment(parsegraph_Shards* shards, parsegraph_GUID* env);
+
+// Creates or upgrades the tables of every database.
+int parsegraph_Shards_upgradeTables(parsegraph_Shards* shards);
+
+/**
+ * Creates an environment with a new GUID, and its root list, in the shard
+ * chosen by that GUID.
+ */
+parsegraph_EnvironmentStatus parsegraph_Shards_createEnvironment(parsegraph_Shards* shards, int ownerId, int environmentTypeId, parsegraph_GUID* createdEnv);
+
+#endif // parsegraph_Shards_INCLUDED
@@ -0,0 +1,60 @@
+#ifndef parsegraph_SignedLogins_INCLUDED
+#define parsegraph_SignedLogins_INCLUDED
+
+#include <apr_pools.h>
+#include <apr_time.h>
+#include "parsegraph_user.h"
+
+/**
+ * Issues and verifies session values that need no login row. A signed value
+ * carries a user id, the user's login generation, and an expiry time, with
+ * an HMAC-SHA256 of the three under a server key. Verifying one is pure CPU
+ * work except for a periodic reload of the login_revocation table, or a
+ * lookup of the user's generation if it has never loaded.
+ *
+ * Ending a user's logins increments that user's login generation, which
+ * revokes every value issued before. Other processes see the revocation
+ * when they next reload the table, so the refresh interval bounds how long
+ * a signed value may outlast its logout there.
+ *
+ * The signer may be shared by sessions on different threads.
+ */
+typedef struct parsegraph_SignedLogins parsegraph_SignedLogins;
+
+/**
+ * Creates a signer with the given key. Values are valid for lifetime after
+ * they are issued, and revocations are reloaded every refreshInterval.
+ * Returns NULL on failure.
+ */
+parsegraph_SignedLogins* parsegraph_SignedLogins_new(apr_pool_t* parent, const unsigned char* key, size_t keyLen, apr_interval_time_t lifetime, apr_interval_time_t refreshInterval);
+
+void parsegraph_SignedLogins_destroy(parsegraph_SignedLogins* logins);
+
+/**
+ * Returns a signed session value for the given user and login generation,
+ * allocated from pool.
+ */
+const char* parsegraph_SignedLogins_sign(parsegraph_SignedLogins* logins, apr_pool_t* pool, int userId, int generation);
+
+/**
+ * Verifies the given session value, reloading revocations with the session
+ * if they are older than the refresh interval. Returns parsegraph_OK with
+ * the value's user id, parsegraph_SESSION_MALFORMED if the value is not a
+ * signed value, parsegraph_SESSION_DOES_NOT_MATCH if its signature is wrong,
+ * or parsegraph_SESSION_DOES_NOT_EXIST if it has expired or been revoked.
+ */
+parsegraph_UserStatus parsegraph_SignedLogins_verify(parsegraph_SignedLogins* logins, parsegraph_Session* session, const char* sessionValue, int* userId);
+
+// Reloads revocations from the session's database.
+parsegraph_UserStatus parsegraph_SignedLogins_refresh(parsegraph_SignedLogins* logins, parsegraph_Session* session);
+
+/**
+ * Deletes revocations older than the signer's lifetime, which every value
+ * issued before them has outlived.
+ */
+parsegraph_UserStatus parsegraph_SignedLogins_prune(parsegraph_SignedLogins* logins, parsegraph_Session* session, int* pruned);
+
+// Makes the next verification reload revocations.
+void parsegraph_SignedLogins_invalidate(parsegraph_SignedLogins* logins);
+
+#endif // parsegraph_SignedLogins_INCLUDED
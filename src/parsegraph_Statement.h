@@ -0,0 +1,211 @@
+#ifndef parsegraph_Statement_INCLUDED
+#define parsegraph_Statement_INCLUDED
+
+#include <apr_dbd.h>
+#include <apr_time.h>
+#include <stdio.h>
+#include "parsegraph_Session.h"
+
+// Every SQL statement used by libparsegraph. Each statement is prepared at most
+// once per session, on first use, into a dense array indexed by this enum.
+enum parsegraph_StatementId {
+    parsegraph_Statement_lastInsertRowId = 0,
+
+    // parsegraph_List
+    parsegraph_Statement_List_new,
+    parsegraph_Statement_List_getID,
+    parsegraph_Statement_List_getName,
+    parsegraph_Statement_List_destroy,
+    parsegraph_Statement_List_newItem,
+    parsegraph_Statement_List_append,
+    parsegraph_Statement_List_prepend,
+    parsegraph_Statement_List_truncate,
+    parsegraph_Statement_List_getHead,
+    parsegraph_Statement_List_getTail,
+    parsegraph_Statement_List_setPrev,
+    parsegraph_Statement_List_setNext,
+    parsegraph_Statement_List_getNext,
+    parsegraph_Statement_List_getPrev,
+    parsegraph_Statement_List_updateItem,
+    parsegraph_Statement_List_removeItem,
+    parsegraph_Statement_List_destroyItem,
+    parsegraph_Statement_List_listItems,
+    parsegraph_Statement_List_length,
+    parsegraph_Statement_List_getListId,
+    parsegraph_Statement_List_clearNext,
+    parsegraph_Statement_List_clearPrev,
+    parsegraph_Statement_List_setValue,
+    parsegraph_Statement_List_setType,
+    parsegraph_Statement_List_reparentItems,
+    parsegraph_Statement_List_setList,
+    parsegraph_Statement_List_LAST = parsegraph_Statement_List_setList,
+
+    // parsegraph_user
+    parsegraph_Statement_user_getUser,
+    parsegraph_Statement_user_createNewUser,
+    parsegraph_Statement_user_beginUserLogin,
+    parsegraph_Statement_user_endUserLogin,
+    parsegraph_Statement_user_listUsers,
+    parsegraph_Statement_user_listUsersAfter,
+    parsegraph_Statement_user_removeUser,
+    parsegraph_Statement_user_removeLoginRevocation,
+    parsegraph_Statement_user_refreshUserLogin,
+    parsegraph_Statement_user_setUserProfile,
+    parsegraph_Statement_user_changeUserPassword,
+    parsegraph_Statement_user_grantSuperadmin,
+    parsegraph_Statement_user_revokeSuperadmin,
+    parsegraph_Statement_user_banUser,
+    parsegraph_Statement_user_unbanUser,
+    parsegraph_Statement_user_allowSubscription,
+    parsegraph_Statement_user_disallowSubscription,
+    parsegraph_Statement_user_loadUser,
+    parsegraph_Statement_user_loadUserById,
+    parsegraph_Statement_user_revokeLogins,
+    parsegraph_Statement_user_getLoginGeneration,
+    parsegraph_Statement_user_listLoginRevocations,
+    parsegraph_Statement_user_pruneLoginRevocations,
+    parsegraph_Statement_user_touchLogin,
+    parsegraph_Statement_user_sweepLogins,
+    parsegraph_Statement_user_LAST = parsegraph_Statement_user_sweepLogins,
+
+    // parsegraph_environment
+    parsegraph_Statement_Environment_destroyEnvironment,
+    parsegraph_Statement_Environment_getEnvironmentGUIDForId,
+    parsegraph_Statement_Environment_getEnvironmentIdForGUID,
+    parsegraph_Statement_Environment_getEnvironmentTitleForGUID,
+    parsegraph_Statement_Environment_getEnvironmentTitleForId,
+    parsegraph_Statement_Environment_getSavedEnvironmentsForUser,
+    parsegraph_Statement_Environment_saveEnvironment,
+    parsegraph_Statement_Environment_getOwnedEnvironmentsForUser,
+    parsegraph_Statement_Environment_getEnvironmentRoot,
+    parsegraph_Statement_Environment_setEnvironmentRoot,
+    parsegraph_Statement_getMultislotItemAtIndex,
+    parsegraph_Statement_Environment_setStorageItemList,
+    parsegraph_Statement_Environment_setDisposedItemList,
+    parsegraph_Statement_Environment_setMultislotPublic,
+    parsegraph_Statement_Environment_setMultislotPrivate,
+    parsegraph_Statement_Environment_createMultislotPlot,
+    parsegraph_Statement_Environment_getMultislotInfo,
+    parsegraph_Statement_Environment_createEnvironmentWithGUID,
+    parsegraph_Statement_Environment_LAST = parsegraph_Statement_Environment_createEnvironmentWithGUID,
+
+    parsegraph_Statement_COUNT
+};
+typedef enum parsegraph_StatementId parsegraph_StatementId;
+
+#define parsegraph_MAX_STATEMENT_ARGS 32
+
+// Execution counters kept for each statement of a session, including those
+// it ran on its readers. Rows returned count the rows read by cursors, and
+// the size of result sets that know it when they are selected.
+struct parsegraph_StatementStats {
+    apr_uint64_t calls;
+    apr_uint64_t errors;
+    apr_time_t totalTime;
+    apr_time_t maxTime;
+    apr_uint64_t rowsReturned;
+    apr_uint64_t rowsAffected;
+};
+typedef struct parsegraph_StatementStats parsegraph_StatementStats;
+
+const char* parsegraph_nameStatement(parsegraph_StatementId id);
+const char* parsegraph_Statement_sql(parsegraph_StatementId id);
+apr_dbd_prepared_t* parsegraph_getStatement(parsegraph_Session* session, parsegraph_StatementId id);
+
+// Returns non-zero if the given statement can be run on the session. Sessions
+// using the native SQLite backend prepare statements as they are first run,
+// so this does not prepare an apr_dbd statement for them.
+int parsegraph_hasStatement(parsegraph_Session* session, parsegraph_StatementId id);
+
+// Prepares the given range of statements for the backend the session runs
+// them on. Returns the number that failed.
+int parsegraph_prepareStatements(parsegraph_Session* session, parsegraph_StatementId first, parsegraph_StatementId last);
+
+// Returns the SQL this session prepares for the given statement.
+const char* parsegraph_preparedStatementSql(parsegraph_Session* session, parsegraph_StatementId id);
+
+// Forgets the statements this session has used. Statements published in the
+// connection's prepared statement table stay there for later sessions, since
+// the connection owns them. Called when the session is destroyed.
+void parsegraph_releaseStatements(parsegraph_Session* session);
+
+// Counterparts of apr_dbd_pvquery, apr_dbd_pvselect, apr_dbd_pvbquery and
+// apr_dbd_pvbselect that run a catalog statement on the session's connection
+// and record its execution in the session's statement stats.
+int parsegraph_pvquery(parsegraph_Session* session, apr_pool_t* pool, int* nrows, parsegraph_StatementId id, ...);
+int parsegraph_pvselect(parsegraph_Session* session, apr_pool_t* pool, apr_dbd_results_t** res, parsegraph_StatementId id, int random, ...);
+int parsegraph_pvbquery(parsegraph_Session* session, apr_pool_t* pool, int* nrows, parsegraph_StatementId id, ...);
+int parsegraph_pvbselect(parsegraph_Session* session, apr_pool_t* pool, apr_dbd_results_t** res, parsegraph_StatementId id, int random, ...);
+
+// Reads the rows of a catalog statement one at a time. Cursors are owned by
+// the caller and use the native SQLite backend when the session has it.
+struct parsegraph_Cursor {
+    parsegraph_Session* session;
+    apr_pool_t* pool;
+    parsegraph_StatementId id;
+    apr_dbd_results_t* res;
+    apr_dbd_row_t* row;
+    void* stmt;
+    int ownsStmt;
+    int rows;
+    int failed;
+    apr_time_t start;
+
+    // The pool the cursor's session was checked out from, if it is a reader.
+    struct parsegraph_SessionPool* readers;
+
+    // The session the cursor was opened on, whose stats record it.
+    parsegraph_Session* origin;
+};
+typedef struct parsegraph_Cursor parsegraph_Cursor;
+
+// Binds the given binary arguments, as for parsegraph_pvbselect.
+int parsegraph_Cursor_open(parsegraph_Cursor* cursor, parsegraph_Session* session, apr_pool_t* pool, parsegraph_StatementId id, ...);
+
+// Returns APR_SUCCESS if a row was read, APR_EOF if no rows remain, or another
+// value on error.
+int parsegraph_Cursor_next(parsegraph_Cursor* cursor);
+
+// Returns APR_SUCCESS, APR_ENOENT if the column is NULL, or APR_EGENERAL.
+int parsegraph_Cursor_int(parsegraph_Cursor* cursor, int col, int* value);
+
+// Returns the column's text, allocated from the cursor's pool, or NULL.
+const char* parsegraph_Cursor_text(parsegraph_Cursor* cursor, int col);
+
+void parsegraph_Cursor_close(parsegraph_Cursor* cursor);
+
+// Selects the first column of the first row as an integer. Returns APR_ENOENT
+// if there was no row or the value was NULL.
+int parsegraph_selectInt(parsegraph_Session* session, apr_pool_t* pool, parsegraph_StatementId id, int* value, ...);
+
+// Retrieves the row id of the last row inserted on the session's connection.
+int parsegraph_lastInsertId(parsegraph_Session* session, int* id);
+
+// Returns non-zero if the session's connection supports INSERT ... RETURNING.
+// The result is detected on first use and kept for the life of the session.
+int parsegraph_supportsInsertReturning(parsegraph_Session* session);
+
+// Runs an INSERT from the catalog with the given binary arguments and
+// retrieves the new row's id. The statement's RETURNING clause is used when
+// the connection supports it, so the id comes back with the insert itself;
+// otherwise it is taken from the connection afterwards. Returns APR_ENOENT
+// if no row was inserted.
+int parsegraph_insertReturning(parsegraph_Session* session, apr_pool_t* pool, parsegraph_StatementId id, int* rowId, ...);
+
+// Rewrites schema SQL, which is written for SQLite, into the session's
+// dialect. The result is allocated from the session's pool.
+const char* parsegraph_translateSchema(parsegraph_Session* session, const char* sql);
+
+// Runs schema SQL on the session's connection in the session's dialect, as
+// apr_dbd_query would.
+int parsegraph_schemaQuery(parsegraph_Session* session, int* nrows, const char* sql);
+
+// Adds a column to a table in the named schema, or the main one if schema is
+// NULL, unless the table already has it. Returns 0, or the apr_dbd error.
+int parsegraph_schemaAddColumn(parsegraph_Session* session, const char* schema, const char* table, const char* column, const char* type);
+
+parsegraph_StatementStats* parsegraph_Stats_get(parsegraph_Session* session, parsegraph_StatementId id);
+void parsegraph_Stats_reset(parsegraph_Session* session);
+void parsegraph_Stats_dump(parsegraph_Session* session, FILE* sink);
+
+#endif // parsegraph_Statement_INCLUDED
@@ -0,0 +1,54 @@
+#ifndef parsegraph_UsernameIndex_INCLUDED
+#define parsegraph_UsernameIndex_INCLUDED
+
+#include <apr_pools.h>
+#include <apr_tables.h>
+#include "parsegraph_user.h"
+
+/**
+ * An in-memory index of usernames, sorted without regard to case, for
+ * finding users by the start of their names, as when inviting them. The
+ * index is loaded once from the database and then kept current by the
+ * sessions it is set on as they create and remove users. Changes made within
+ * a transaction reach the index when the outermost transaction commits, and
+ * are dropped if it rolls back. Users created or removed elsewhere are not
+ * seen until it is loaded again.
+ *
+ * The index may be shared by sessions on different threads. Searches take
+ * a read lock and cost a binary search plus the matches returned.
+ */
+typedef struct parsegraph_UsernameIndex parsegraph_UsernameIndex;
+
+// Creates an empty index. Returns NULL on failure.
+parsegraph_UsernameIndex* parsegraph_UsernameIndex_new(apr_pool_t* parent);
+
+void parsegraph_UsernameIndex_destroy(parsegraph_UsernameIndex* index);
+
+// Replaces the index's contents with every user in the session's database.
+parsegraph_UserStatus parsegraph_UsernameIndex_load(parsegraph_UsernameIndex* index, parsegraph_Session* session);
+
+// Adds the given user, or changes the id of a user with the same name.
+void parsegraph_UsernameIndex_add(parsegraph_UsernameIndex* index, const char* username, int userId);
+
+void parsegraph_UsernameIndex_remove(parsegraph_UsernameIndex* index, const char* username);
+
+/**
+ * Finds up to limit users whose names start with the given prefix, ignoring
+ * case, in the index's order. The results are an array of
+ * parsegraph_UserSummary allocated from pool.
+ */
+void parsegraph_UsernameIndex_search(parsegraph_UsernameIndex* index, apr_pool_t* pool, const char* prefix, int limit, apr_array_header_t** users);
+
+int parsegraph_UsernameIndex_size(parsegraph_UsernameIndex* index);
+
+// Adds or removes a user in the session's index, if it has one, now or when
+// the session's outermost transaction commits.
+void parsegraph_indexUsername(parsegraph_Session* session, const char* username, int userId);
+void parsegraph_unindexUsername(parsegraph_Session* session, const char* username);
+
+int parsegraph_countPendingUsernames(parsegraph_Session* session);
+
+// Applies the changes held for the outermost commit.
+void parsegraph_flushPendingUsernames(parsegraph_Session* session);
+
+#endif // parsegraph_UsernameIndex_INCLUDED
@@ -0,0 +1,105 @@
+#ifndef parsegraph_Worker_INCLUDED
+#define parsegraph_Worker_INCLUDED
+
+#include <apr_pools.h>
+#include <marla.h>
+#include "parsegraph_Session.h"
+#include "parsegraph_List.h"
+#include "parsegraph_user.h"
+#include "parsegraph_environment.h"
+
+/**
+ * A pool of worker threads that run libparsegraph calls off the event loop.
+ *
+ * Each worker owns its own database connection and parsegraph_Session. Work
+ * is queued with parsegraph_WorkerPool_submit or one of the async calls below.
+ * When it finishes, its continuation is queued for the event loop and the
+ * pool's wakeup descriptor becomes readable. The loop polls that descriptor
+ * and calls parsegraph_WorkerPool_dispatch, which runs the waiting
+ * continuations on the loop's thread.
+ *
+ * Each job runs with its own pool as its worker session's pool, so results
+ * produced by a worker are allocated from that pool. They remain valid
+ * until the job's continuation returns; continuations copy out whatever
+ * they keep.
+ */
+typedef struct parsegraph_WorkerPool parsegraph_WorkerPool;
+
+// Runs on a worker thread. Its return value is passed to the continuation.
+typedef int(*parsegraph_WorkFunction)(parsegraph_Session* session, void* data);
+
+// Runs on the thread that calls parsegraph_WorkerPool_dispatch.
+typedef void(*parsegraph_Continuation)(void* data, int status);
+
+/**
+ * Starts nworkers threads, each connected to the database named by params
+ * using the given apr_dbd driver. Returns NULL if any worker fails to start.
+ */
+parsegraph_WorkerPool* parsegraph_WorkerPool_new(apr_pool_t* parent, marla_Server* server, const char* driverName, const char* params, int nworkers);
+
+/**
+ * Finishes the queued work, stops the workers, and runs the remaining
+ * continuations on the calling thread.
+ */
+void parsegraph_WorkerPool_destroy(parsegraph_WorkerPool* workers);
+
+/**
+ * Queues work for the next idle worker. done may be NULL. Returns APR_SUCCESS,
+ * APR_EAGAIN if the queue is at its limit, or APR_EINVAL once the pool is
+ * shutting down.
+ */
+int parsegraph_WorkerPool_submit(parsegraph_WorkerPool* workers, parsegraph_WorkFunction work, parsegraph_Continuation done, void* data);
+
+/**
+ * Limits how many submitted calls may wait for a worker, or removes the
+ * limit if it is 0. Logins spend most of their time deriving password
+ * hashes, so a pool kept for them with a small limit lets a burst of logins
+ * be refused quickly, rather than queueing behind each other while other
+ * work waits.
+ */
+void parsegraph_WorkerPool_setQueueLimit(parsegraph_WorkerPool* workers, int limit);
+
+// Returns a non-blocking descriptor that is readable while continuations are waiting.
+int parsegraph_WorkerPool_fd(parsegraph_WorkerPool* workers);
+
+// Runs every waiting continuation and returns how many were run.
+int parsegraph_WorkerPool_dispatch(parsegraph_WorkerPool* workers);
+
+// Returns the number of submitted calls whose continuations have not yet run.
+int parsegraph_WorkerPool_pending(parsegraph_WorkerPool* workers);
+
+// Async variants of the List, User and Environment calls. Each callback
+// receives the call's data pointer, its status, and its results. String
+// arguments are copied, so callers need not keep them alive. Results are
+// valid until the callback returns.
+
+typedef void(*parsegraph_ListIdCallback)(void* data, parsegraph_ListStatus rv, int id);
+typedef void(*parsegraph_ListStatusCallback)(void* data, parsegraph_ListStatus rv);
+typedef void(*parsegraph_ListItemsCallback)(void* data, parsegraph_ListStatus rv, parsegraph_List_item** items, size_t nitems);
+typedef void(*parsegraph_ListLengthCallback)(void* data, parsegraph_ListStatus rv, size_t length);
+
+int parsegraph_List_newAsync(parsegraph_WorkerPool* workers, const char* listName, parsegraph_ListIdCallback cb, void* data);
+int parsegraph_List_appendItemAsync(parsegraph_WorkerPool* workers, int listId, int typeId, const char* value, parsegraph_ListIdCallback cb, void* data);
+int parsegraph_List_listItemsAsync(parsegraph_WorkerPool* workers, int listId, parsegraph_ListItemsCallback cb, void* data);
+int parsegraph_List_lengthAsync(parsegraph_WorkerPool* workers, int listId, parsegraph_ListLengthCallback cb, void* data);
+int parsegraph_List_destroyAsync(parsegraph_WorkerPool* workers, int listId, parsegraph_ListStatusCallback cb, void* data);
+
+typedef void(*parsegraph_UserStatusCallback)(void* data, parsegraph_UserStatus rv);
+typedef void(*parsegraph_UserLoginCallback)(void* data, parsegraph_UserStatus rv, parsegraph_user_login* login);
+typedef void(*parsegraph_UserIdCallback)(void* data, parsegraph_UserStatus rv, int userId);
+
+int parsegraph_createNewUserAsync(parsegraph_WorkerPool* workers, const char* username, const char* password, parsegraph_UserStatusCallback cb, void* data);
+int parsegraph_beginUserLoginAsync(parsegraph_WorkerPool* workers, const char* username, const char* password, parsegraph_UserLoginCallback cb, void* data);
+int parsegraph_refreshUserLoginAsync(parsegraph_WorkerPool* workers, const char* selector, const char* token, parsegraph_UserLoginCallback cb, void* data);
+int parsegraph_getIdForUsernameAsync(parsegraph_WorkerPool* workers, const char* username, parsegraph_UserIdCallback cb, void* data);
+
+typedef void(*parsegraph_EnvironmentStatusCallback)(void* data, parsegraph_EnvironmentStatus rv);
+typedef void(*parsegraph_EnvironmentGUIDCallback)(void* data, parsegraph_EnvironmentStatus rv, parsegraph_GUID* env);
+typedef void(*parsegraph_EnvironmentIdCallback)(void* data, parsegraph_EnvironmentStatus rv, int id);
+
+int parsegraph_createEnvironmentAsync(parsegraph_WorkerPool* workers, int ownerId, int rootListId, int environmentTypeId, parsegraph_EnvironmentGUIDCallback cb, void* data);
+int parsegraph_getEnvironmentIdForGUIDAsync(parsegraph_WorkerPool* workers, parsegraph_GUID* env, parsegraph_EnvironmentIdCallback cb, void* data);
+int parsegraph_getEnvironmentRootAsync(parsegraph_WorkerPool* workers, parsegraph_GUID* env, parsegraph_EnvironmentIdCallback cb, void* data);
+int parsegraph_saveEnvironmentAsync(parsegraph_WorkerPool* workers, int userId, parsegraph_GUID* env, const char* clientSaveState, parsegraph_EnvironmentStatusCallback cb, void* data);
+
+#endif // parsegraph_Worker_INCLUDED
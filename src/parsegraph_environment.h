@@ -47,12 +47,51 @@ typedef struct parsegraph_GUID {
     char value[37];
 } parsegraph_GUID;
 int parsegraph_guid_init(parsegraph_GUID* guid);
+
+// Fills guid with a new random GUID in the same form as generated ones.
+int parsegraph_generateGUID(parsegraph_GUID* guid);
+
+/**
+ * Fills guid with a GUID laid out as a version 7 UUID: 48 bits of Unix time
+ * in milliseconds, 12 bits of the time within that millisecond, and 62
+ * random bits. GUIDs created later sort after earlier ones, so that new
+ * environments are added at the end of the GUID index.
+ */
+int parsegraph_generateTimeOrderedGUID(parsegraph_GUID* guid);
+
+// Fills guid with a new environment GUID of the kind the session is set to create.
+int parsegraph_generateEnvironmentGUID(parsegraph_Session* session, parsegraph_GUID* guid);
 int parsegraph_guidsEqual(parsegraph_GUID* a, parsegraph_GUID* b);
 
+/**
+ * A GUID's 16 bytes, in the order their hex digits appear in its text form.
+ * Environments are looked up by this form in the environment_uuid column.
+ */
+typedef struct parsegraph_BinaryGUID {
+    unsigned char bytes[16];
+} parsegraph_BinaryGUID;
+
+// Parses a GUID's text form, in either case. Returns 0, or -1 if it is not a GUID.
+int parsegraph_GUID_parse(const parsegraph_GUID* guid, parsegraph_BinaryGUID* bin);
+
+// Writes the lowercase text form of a GUID.
+void parsegraph_GUID_format(const parsegraph_BinaryGUID* bin, parsegraph_GUID* guid);
+
+int parsegraph_BinaryGUID_equal(const parsegraph_BinaryGUID* a, const parsegraph_BinaryGUID* b);
+
+// Hashes 16-byte GUID keys, for apr_hash_make_custom.
+unsigned int parsegraph_BinaryGUID_hash(const char* key, apr_ssize_t* klen);
+
 parsegraph_EnvironmentStatus parsegraph_prepareEnvironmentStatements(parsegraph_Session* session);
 parsegraph_EnvironmentStatus parsegraph_upgradeEnvironmentTables(parsegraph_Session* session);
 
+// Creates an environment with a new GUID. If the session has shards, the
+// environment is created with a new root list in its shard, and rootListId
+// is not used.
 parsegraph_EnvironmentStatus parsegraph_createEnvironment(parsegraph_Session* session, int ownerId, int rootListId, int environmentTypeId, parsegraph_GUID* createdEnv);
+// Creates an environment with a GUID chosen by the caller, such as one that
+// was used to choose the session's shard.
+parsegraph_EnvironmentStatus parsegraph_createEnvironmentWithGUID(parsegraph_Session* session, parsegraph_GUID* env, int ownerId, int rootListId, int environmentTypeId);
 parsegraph_EnvironmentStatus parsegraph_cloneEnvironment(parsegraph_Session* session, parsegraph_GUID* clonedEnv, parsegraph_GUID* createdEnv);
 parsegraph_EnvironmentStatus parsegraph_destroyEnvironment(parsegraph_Session* session, parsegraph_GUID* targetedEnv);
 parsegraph_EnvironmentStatus parsegraph_getEnvironmentGUIDForId(parsegraph_Session* session, int environmentId, parsegraph_GUID* env);
@@ -66,12 +105,28 @@ typedef struct parsegraph_EnvironmentData {
     const char* text;
 } parsegraph_EnvironmentData;
 
+// Lists the session's database only, and fails if the session has shards.
 // "SELECT environment_guid, environment_title, save_date FROM saved_environment JOIN environment ON saved_environment.environment_id = environment.environment_id WHERE user_id = %d ORDER by save_date DESC", // 9
 parsegraph_EnvironmentStatus parsegraph_getSavedEnvironmentGUIDs(parsegraph_Session* session, int userId, apr_dbd_results_t** savedEnvGUIDs);
 parsegraph_EnvironmentStatus parsegraph_saveEnvironment(parsegraph_Session* session, int userId, parsegraph_GUID* env, const char* clientSaveState);
 
+// Lists the session's database only, and fails if the session has shards.
 parsegraph_EnvironmentStatus parsegraph_getOwnedEnvironmentGUIDs(parsegraph_Session* session, int userId, apr_dbd_results_t** savedEnvGUIDs);
 
+typedef struct parsegraph_EnvironmentSummary {
+    parsegraph_GUID envGUID;
+    const char* title;
+    const char* date;
+} parsegraph_EnvironmentSummary;
+
+/**
+ * Lists the user's saved or owned environments, from every shard if the
+ * session has shards, as arrays of parsegraph_EnvironmentSummary allocated
+ * from pool, the most recently saved or created first.
+ */
+parsegraph_EnvironmentStatus parsegraph_listSavedEnvironments(parsegraph_Session* session, apr_pool_t* pool, int userId, apr_array_header_t** envs);
+parsegraph_EnvironmentStatus parsegraph_listOwnedEnvironments(parsegraph_Session* session, apr_pool_t* pool, int userId, apr_array_header_t** envs);
+
 parsegraph_EnvironmentStatus parsegraph_getEnvironmentRoot(parsegraph_Session* session, parsegraph_GUID* env, int* rootListId);
 parsegraph_EnvironmentStatus parsegraph_setEnvironmentRoot(parsegraph_Session* session, parsegraph_GUID* env, int listId);
 parsegraph_EnvironmentStatus parsegraph_setStorageItemList(parsegraph_Session* session, int userId, int storageItemList);
@@ -137,6 +192,8 @@ parsegraph_EnvironmentStatus parsegraph_getMultislotInfo(parsegraph_Session* ses
 
 parsegraph_EnvironmentStatus parsegraph_notifyEnvironment(parsegraph_Session* session, parsegraph_GUID* env, enum parsegraph_EnvironmentEvent eventType, void* data);
 parsegraph_EnvironmentStatus parsegraph_notifyUser(parsegraph_Session* session, int userId, enum parsegraph_EnvironmentEvent eventType, void* data);
+int parsegraph_countPendingEvents(parsegraph_Session* session);
+void parsegraph_flushPendingEvents(parsegraph_Session* session);
 parsegraph_EnvironmentStatus parsegraph_pushItemIntoStorage(parsegraph_Session* session, int userId, int itemId);
 parsegraph_EnvironmentStatus parsegraph_createEnvironmentLink(parsegraph_Session* session, int userId, parsegraph_GUID* env, int* createdLink);
 
@@ -1,15 +1,33 @@
 #include "parsegraph_user.h"
 #include "parsegraph_List.h"
 #include "parsegraph_environment.h"
+#include "parsegraph_Profile.h"
 #include <stdio.h>
+#include <string.h>
 
 static parsegraph_Session* session = NULL;
 
 int main(int argc, const char* const* argv)
 {
+    // A profile's journal mode is stored in the database, so installing with
+    // one keeps it for every later connection.
+    const char* profilePath = 0;
+    int useProfile = 0;
+    if(argc >= 2 && !strcmp(argv[1], "--profile")) {
+        useProfile = 1;
+        if(argc >= 5) {
+            profilePath = argv[2];
+            argv += 2;
+            argc -= 2;
+        }
+        else {
+            argv += 1;
+            argc -= 1;
+        }
+    }
     if(argc < 3) {
         fprintf(stderr, "parsegraph " parsegraph_FULL_VERSION "\n");
-        fprintf(stderr, "usage: parsegraph_install {database_type} {connection_string}\n");
+        fprintf(stderr, "usage: parsegraph_install [--profile [profile_file]] {database_type} {connection_string}\n");
         return -1;
     }
     // Initialize the APR.
@@ -48,9 +66,32 @@ int main(int argc, const char* const* argv)
         return -1;
     }
     dbd->prepared = apr_hash_make(pool);
+    dbd->pool = pool;
 
     session = parsegraph_Session_new(pool, dbd);
 
+    if(useProfile) {
+        // Use the given profile, or the tuned profile and the environment.
+        parsegraph_Profile profile;
+        parsegraph_Profile_init(&profile);
+        if(profilePath) {
+            rv = parsegraph_Profile_load(&profile, pool, profilePath);
+        }
+        else {
+            parsegraph_Profile_tuned(&profile);
+            rv = parsegraph_Profile_loadEnvironment(&profile, pool);
+        }
+        if(rv != APR_SUCCESS) {
+            fprintf(stderr, "Failed reading connection profile, APR status of %d.\n", rv);
+            return -1;
+        }
+        rv = parsegraph_Profile_apply(session, &profile);
+        if(rv != 0) {
+            fprintf(stderr, "Failed applying connection profile, status of %d.\n", rv);
+            return -1;
+        }
+    }
+
     rv = parsegraph_upgradeUserTables(session);
     if(rv != 0) {
         fprintf(stderr, "Failed upgrading user tables, APR status of %d.\n", rv);
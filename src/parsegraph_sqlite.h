@@ -0,0 +1,26 @@
+#ifndef parsegraph_sqlite_INCLUDED
+#define parsegraph_sqlite_INCLUDED
+
+#include "parsegraph_config.h"
+#include "parsegraph_Statement.h"
+
+#ifdef HAVE_SQLITE3
+
+// Native SQLite backend used by sessions on the sqlite3 apr_dbd driver once
+// parsegraph_Session_useNativeSQLite has succeeded. Statements run directly
+// against the connection's sqlite3 handle, so they share its transactions.
+
+// Prepares the given statement without running it. Returns 0 on success.
+int parsegraph_SQLite_prepare(parsegraph_Session* session, parsegraph_StatementId id);
+int parsegraph_SQLite_query(parsegraph_Session* session, parsegraph_StatementId id, int binary, int* nrows, const void** args, int nargs);
+int parsegraph_SQLite_open(parsegraph_Cursor* cursor, const void** args, int nargs);
+int parsegraph_SQLite_next(parsegraph_Cursor* cursor);
+int parsegraph_SQLite_int(parsegraph_Cursor* cursor, int col, int* value);
+const char* parsegraph_SQLite_text(parsegraph_Cursor* cursor, int col);
+void parsegraph_SQLite_close(parsegraph_Cursor* cursor);
+int parsegraph_SQLite_lastInsertId(parsegraph_Session* session, int* id);
+int parsegraph_SQLite_supportsReturning(parsegraph_Session* session);
+
+#endif // HAVE_SQLITE3
+
+#endif // parsegraph_sqlite_INCLUDED
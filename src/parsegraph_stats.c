@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Reads statement stats written by parsegraph_Stats_dump, merges lines with
+// the same statement label, and prints them ordered by the chosen column.
+
+struct StatementTotals {
+    char label[128];
+    unsigned long calls;
+    unsigned long errors;
+    long totalTime;
+    long maxTime;
+    unsigned long rowsReturned;
+    unsigned long rowsAffected;
+};
+
+static struct StatementTotals* totals = 0;
+static size_t numTotals = 0;
+static size_t capTotals = 0;
+static const char* sortKey = "total";
+
+static struct StatementTotals* findTotals(const char* label)
+{
+    for(size_t i = 0; i < numTotals; ++i) {
+        if(!strcmp(totals[i].label, label)) {
+            return &totals[i];
+        }
+    }
+    if(numTotals == capTotals) {
+        capTotals = capTotals ? capTotals * 2 : 64;
+        totals = realloc(totals, capTotals * sizeof(*totals));
+        if(!totals) {
+            fprintf(stderr, "Out of memory.\n");
+            exit(-1);
+        }
+    }
+    struct StatementTotals* t = &totals[numTotals++];
+    memset(t, 0, sizeof(*t));
+    snprintf(t->label, sizeof(t->label), "%s", label);
+    return t;
+}
+
+static int readDump(FILE* input, const char* name)
+{
+    char line[512];
+    int lineno = 0;
+    while(fgets(line, sizeof(line), input)) {
+        ++lineno;
+        char label[128];
+        unsigned long calls, errors, rowsReturned, rowsAffected;
+        long totalTime, maxTime;
+        if(line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if(7 != sscanf(line, "%127s %lu %lu %ld %ld %lu %lu", label, &calls, &errors, &totalTime, &maxTime, &rowsReturned, &rowsAffected)) {
+            fprintf(stderr, "%s:%d: Ignoring malformed line.\n", name, lineno);
+            continue;
+        }
+        struct StatementTotals* t = findTotals(label);
+        t->calls += calls;
+        t->errors += errors;
+        t->totalTime += totalTime;
+        if(maxTime > t->maxTime) {
+            t->maxTime = maxTime;
+        }
+        t->rowsReturned += rowsReturned;
+        t->rowsAffected += rowsAffected;
+    }
+    return 0;
+}
+
+static double sortValue(const struct StatementTotals* t)
+{
+    if(!strcmp(sortKey, "calls")) {
+        return t->calls;
+    }
+    if(!strcmp(sortKey, "errors")) {
+        return t->errors;
+    }
+    if(!strcmp(sortKey, "max")) {
+        return t->maxTime;
+    }
+    if(!strcmp(sortKey, "mean")) {
+        return t->calls ? (double)t->totalTime / t->calls : 0;
+    }
+    if(!strcmp(sortKey, "rows")) {
+        return t->rowsReturned + t->rowsAffected;
+    }
+    return t->totalTime;
+}
+
+static int compareTotals(const void* a, const void* b)
+{
+    double av = sortValue(a);
+    double bv = sortValue(b);
+    if(av < bv) {
+        return 1;
+    }
+    if(av > bv) {
+        return -1;
+    }
+    return strcmp(((const struct StatementTotals*)a)->label, ((const struct StatementTotals*)b)->label);
+}
+
+static void usage()
+{
+    fprintf(stderr, "parsegraph " parsegraph_FULL_VERSION "\n");
+    fprintf(stderr, "usage: parsegraph_stats [-s calls|errors|total|max|mean|rows] [-n count] [stats_file...]\n");
+    fprintf(stderr, "Stats files are written by parsegraph_Stats_dump, or appended by each session when PARSEGRAPH_STATS_FILE is set.\n");
+}
+
+int main(int argc, const char* const* argv)
+{
+    int limit = -1;
+    int numFiles = 0;
+    for(int i = 1; i < argc; ++i) {
+        if(!strcmp(argv[i], "-s") && i + 1 < argc) {
+            sortKey = argv[++i];
+        }
+        else if(!strcmp(argv[i], "-n") && i + 1 < argc) {
+            limit = atoi(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+            usage();
+            return 0;
+        }
+        else if(argv[i][0] == '-' && argv[i][1] != 0) {
+            usage();
+            return -1;
+        }
+        else {
+            ++numFiles;
+            if(!strcmp(argv[i], "-")) {
+                readDump(stdin, "stdin");
+                continue;
+            }
+            FILE* input = fopen(argv[i], "r");
+            if(!input) {
+                fprintf(stderr, "Failed opening %s.\n", argv[i]);
+                return -1;
+            }
+            readDump(input, argv[i]);
+            fclose(input);
+        }
+    }
+    if(numFiles == 0) {
+        readDump(stdin, "stdin");
+    }
+
+    qsort(totals, numTotals, sizeof(*totals), compareTotals);
+
+    printf("%-52s %10s %8s %12s %10s %10s %10s %10s\n", "statement", "calls", "errors", "total_ms", "mean_us", "max_us", "returned", "affected");
+    for(size_t i = 0; i < numTotals && (limit < 0 || (int)i < limit); ++i) {
+        struct StatementTotals* t = &totals[i];
+        printf("%-52s %10lu %8lu %12.3f %10.1f %10ld %10lu %10lu\n",
+            t->label,
+            t->calls,
+            t->errors,
+            t->totalTime / 1000.0,
+            t->calls ? (double)t->totalTime / t->calls : 0.0,
+            t->maxTime,
+            t->rowsReturned,
+            t->rowsAffected
+        );
+    }
+    free(totals);
+    return 0;
+}
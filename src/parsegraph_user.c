@@ -1,10 +1,23 @@
 #include "parsegraph_user.h"
+#include "parsegraph_Statement.h"
+#include "parsegraph_LoginCache.h"
+#include "parsegraph_SignedLogins.h"
+#include "parsegraph_Random.h"
+#include "parsegraph_RateLimiter.h"
+#include "parsegraph_UsernameIndex.h"
 #include <marla.h>
 
 #include <openssl/sha.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
 #include <apr_strings.h>
 #include <apr_lib.h>
 #include <apr_base64.h>
+#include <apr_thread_proc.h>
+#include <stdlib.h>
+
+// Prefix of password hashes derived with PBKDF2. Older hashes have no prefix.
+#define PBKDF2_PREFIX "$pbkdf2-sha256$"
 
 const char* parsegraph_nameUserStatus(parsegraph_UserStatus rv)
 {
@@ -26,6 +39,7 @@ const char* parsegraph_nameUserStatus(parsegraph_UserStatus rv)
     case parsegraph_SESSION_MALFORMED: return "Session was malformed.";
     case parsegraph_INVALID_PASSWORD: return "Invalid password.";
     case parsegraph_UNDEFINED_PREPARED_STATEMENT: return "A needed prepared statement was undefined.";
+    case parsegraph_RATE_LIMITED: return "Too many attempts; try again later.";
     }
     return "Unknown status.";
 }
@@ -47,6 +61,7 @@ int parsegraph_isSeriousUserError(parsegraph_UserStatus rv)
     case parsegraph_USERNAME_NO_NONPRINTABLE:
     case parsegraph_USER_DOES_NOT_EXIST:
     case parsegraph_SESSION_DOES_NOT_EXIST:
+    case parsegraph_RATE_LIMITED:
         return 0;
     case parsegraph_UNDEFINED_PREPARED_STATEMENT:
     case parsegraph_ERROR:
@@ -77,6 +92,8 @@ int parsegraph_userStatusToHttp(parsegraph_UserStatus rv)
     case parsegraph_SESSION_DOES_NOT_EXIST:
     case parsegraph_INVALID_PASSWORD:
         return HTTP_UNAUTHORIZED;
+    case parsegraph_RATE_LIMITED:
+        return HTTP_TOO_MANY_REQUESTS;
     case parsegraph_SESSION_DOES_NOT_MATCH:
     case parsegraph_UNDEFINED_PREPARED_STATEMENT:
     case parsegraph_ERROR:
@@ -87,54 +104,64 @@ int parsegraph_userStatusToHttp(parsegraph_UserStatus rv)
 
 parsegraph_UserStatus parsegraph_prepareLoginStatements(parsegraph_Session* session)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
-    static const char* queries[] = {
-        "parsegraph_user_getUser", "SELECT id, password, password_salt, profile FROM user WHERE username = %s", // 1
-        "parsegraph_user_createNewUser", "INSERT INTO user(username, password, password_salt) VALUES(%s, %s, %s)", // 2
-        "parsegraph_user_beginUserLogin", "INSERT INTO login(username, selector, token) VALUES(%s, %s, %s)", // 3
-        "parsegraph_user_endUserLogin", "DELETE FROM login WHERE username = %s", // 4
-        "parsegraph_user_listUsers", "SELECT id, username FROM user", // 5
-        "parsegraph_user_removeUser", "DELETE FROM user WHERE username = %s", // 6
-        "parsegraph_user_refreshUserLogin", "SELECT username FROM login WHERE selector = %s AND token = %s", // 7
-        "parsegraph_user_setUserProfile", "UPDATE user SET profile = %pDt WHERE username = %s", // 8
-        "parsegraph_user_changeUserPassword", "UPDATE user SET password = %s, password_salt = %s WHERE username = %s", // 9
-        "parsegraph_user_grantSuperadmin", "UPDATE user SET is_super_admin = 1 WHERE username = %s", // 10
-        "parsegraph_user_revokeSuperadmin", "UPDATE user SET is_super_admin = 0 WHERE username = %s", // 11
-        "parsegraph_user_banUser", "UPDATE user SET is_banned = 1 WHERE username = %s", // 12
-        "parsegraph_user_unbanUser", "UPDATE user SET is_banned = 0 WHERE username = %s", // 13
-        "parsegraph_user_allowSubscription", "UPDATE user SET allow_subscription = 1 WHERE username = %s", // 14
-        "parsegraph_user_disallowSubscription", "UPDATE user SET allow_subscription = 0 WHERE username = %s", // 15
-        "parsegraph_user_allowsSubscription", "SELECT allow_subscription FROM user WHERE username = %s", // 16
-        "parsegraph_user_isBanned", "SELECT is_banned FROM user WHERE username = %s", // 17
-        "parsegraph_user_hasSuperadmin", "SELECT is_super_admin FROM user WHERE username = %s" // 18
-    };
-    static int NUM_QUERIES = 18;
+    if(0 != parsegraph_prepareStatements(session, parsegraph_Statement_user_getUser, parsegraph_Statement_user_LAST)) {
+        return parsegraph_ERROR;
+    }
+
+    return parsegraph_OK;
+}
+
+// Returns the base64 SHA-256 of the given session token, which is all the login table keeps of it.
+static const char* hashSessionToken(apr_pool_t* pool, const char* session_token)
+{
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256((const unsigned char*)session_token, strlen(session_token), digest);
+    char* encoded = apr_palloc(pool, apr_base64_encode_len(SHA256_DIGEST_LENGTH));
+    apr_base64_encode(encoded, (const char*)digest, SHA256_DIGEST_LENGTH);
+    return encoded;
+}
 
-    for(int i = 0; i < NUM_QUERIES * 2; i += 2) {
-        const char* label = queries[i];
-        const char* query = queries[i + 1];
+// Fills token_hash from the raw token of logins begun before it, and forgets the raw tokens.
+static int backfillLoginTokenHashes(parsegraph_Session* session)
+{
+    ap_dbd_t* dbd = session->dbd;
+    apr_pool_t* pool = session->pool;
+    apr_dbd_results_t* res = 0;
+    int rv = apr_dbd_select(dbd->driver, pool, dbd->handle, &res,
+        "select id, token from login where token is not null", 0);
+    if(rv != 0) {
+        marla_logMessagef(session->server, "Failed to list logins without a token hash: %s",
+            apr_dbd_error(dbd->driver, dbd->handle, rv)
+        );
+        return rv;
+    }
 
-        // Check if the statement has already been created.
-        if(NULL != apr_hash_get(dbd->prepared, label, APR_HASH_KEY_STRING)) {
-            // A statement already prepared is ignored.
+    // Read every row before updating, so the select is not left open.
+    apr_array_header_t* updates = apr_array_make(pool, 64, sizeof(const char*));
+    apr_dbd_row_t* row = 0;
+    while(0 == apr_dbd_get_row(dbd->driver, pool, res, &row, -1)) {
+        const char* id = apr_dbd_get_entry(dbd->driver, row, 0);
+        const char* token = apr_dbd_get_entry(dbd->driver, row, 1);
+        if(!id || !token) {
             continue;
         }
+        APR_ARRAY_PUSH(updates, const char*) = apr_psprintf(pool,
+            "update login set token_hash = '%s', token = null where id = %s",
+            hashSessionToken(pool, token), id
+        );
+    }
 
-        // No statement was found, so create and insert a new statement.
-        apr_dbd_prepared_t *stmt;
-        int rv = apr_dbd_prepare(dbd->driver, pool, dbd->handle, query, label, &stmt);
-        if(rv) {
-            marla_logMessagef(session->server, "Failed preparing %s statement [%s]",
-                label,
+    for(int i = 0; i < updates->nelts; ++i) {
+        int nrows = 0;
+        rv = apr_dbd_query(dbd->driver, dbd->handle, &nrows, APR_ARRAY_IDX(updates, i, const char*));
+        if(rv != 0) {
+            marla_logMessagef(session->server, "Failed to set token hash of login: %s",
                 apr_dbd_error(dbd->driver, dbd->handle, rv)
             );
-            return parsegraph_ERROR;
+            return rv;
         }
-        apr_hash_set(dbd->prepared, label, APR_HASH_KEY_STRING, stmt);
     }
-
-    return parsegraph_OK;
+    return 0;
 }
 
 parsegraph_UserStatus parsegraph_upgradeUserTables(parsegraph_Session* session)
@@ -142,9 +169,8 @@ parsegraph_UserStatus parsegraph_upgradeUserTables(parsegraph_Session* session)
     apr_pool_t* pool = session->pool;
     ap_dbd_t* dbd = session->dbd;
     int nrows;
-    int rv = apr_dbd_query(
-        dbd->driver,
-        dbd->handle,
+    int rv = parsegraph_schemaQuery(
+        session,
         &nrows,
         "create table if not exists transaction_log(name text, level int)"
     );
@@ -155,6 +181,9 @@ parsegraph_UserStatus parsegraph_upgradeUserTables(parsegraph_Session* session)
         return parsegraph_ERROR;
     }
 
+    // User tables go in the attached auth database, if there is one.
+    const char* schema = session->authSchema ? apr_pstrcat(pool, session->authSchema, ".", NULL) : "";
+
     const char* transactionName = "parsegraph_upgradeUserTables";
 
     rv = parsegraph_beginTransaction(session, transactionName);
@@ -162,18 +191,17 @@ parsegraph_UserStatus parsegraph_upgradeUserTables(parsegraph_Session* session)
         return rv;
     }
 
-    rv = apr_dbd_query(
-        dbd->driver,
-        dbd->handle,
+    rv = parsegraph_schemaQuery(
+        session,
         &nrows,
-        "create table if not exists user("
+        apr_pstrcat(pool, "create table if not exists ", schema, "\"user\"("
             "id integer primary key, "
             "username blob unique, "
             "email blob, "
             "password blob, "
             "password_salt blob, "
             "profile text"
-        ")"
+        ")", NULL)
     );
     if(rv != 0) {
         marla_logMessagef(
@@ -184,16 +212,15 @@ parsegraph_UserStatus parsegraph_upgradeUserTables(parsegraph_Session* session)
         return parsegraph_ERROR;
     }
 
-    rv = apr_dbd_query(
-        dbd->driver,
-        dbd->handle,
+    rv = parsegraph_schemaQuery(
+        session,
         &nrows,
-        "create table if not exists login("
+        apr_pstrcat(pool, "create table if not exists ", schema, "login("
             "id integer primary key, "
             "username blob, "
             "selector blob, "
             "token blob"
-        ")"
+        ")", NULL)
     );
     if(rv != 0) {
         marla_logMessagef(
@@ -204,13 +231,12 @@ parsegraph_UserStatus parsegraph_upgradeUserTables(parsegraph_Session* session)
         return parsegraph_ERROR;
     }
 
-    rv = apr_dbd_query(
-        dbd->driver,
-        dbd->handle,
+    rv = parsegraph_schemaQuery(
+        session,
         &nrows,
-        "create table if not exists parsegraph_user_version("
+        apr_pstrcat(pool, "create table if not exists ", schema, "parsegraph_user_version("
             "version integer"
-        ")"
+        ")", NULL)
     );
     if(rv != 0) {
         marla_logMessagef(
@@ -257,9 +283,8 @@ parsegraph_UserStatus parsegraph_upgradeUserTables(parsegraph_Session* session)
     }
     else {
         // No version found.
-        rv = apr_dbd_query(
-            dbd->driver,
-            dbd->handle,
+        rv = parsegraph_schemaQuery(
+            session,
             &nrows,
             "insert into parsegraph_user_version(version) values(0);"
         );
@@ -275,13 +300,13 @@ parsegraph_UserStatus parsegraph_upgradeUserTables(parsegraph_Session* session)
 
     if(version == 0) {
         const char* upgrade[] = {
-            "alter table user add is_super_admin integer",
-            "alter table user add is_banned integer",
-            "alter table user add create_date text",
-            "alter table user add allow_subscription integer",
+            "alter table \"user\" add is_super_admin integer",
+            "alter table \"user\" add is_banned integer",
+            "alter table \"user\" add create_date text",
+            "alter table \"user\" add allow_subscription integer",
         };
         for(int i = 0; i < sizeof(upgrade)/sizeof(*upgrade); ++i) {
-            rv = apr_dbd_query(dbd->driver, dbd->handle, &nrows, upgrade[i]);
+            rv = parsegraph_schemaQuery(session, &nrows, upgrade[i]);
             if(rv != 0) {
                 marla_logMessagef(
                     session->server, "parsegraph_user upgrade to version 1 command %d failed to execute: %s",
@@ -294,9 +319,8 @@ parsegraph_UserStatus parsegraph_upgradeUserTables(parsegraph_Session* session)
         }
 
         int nrowsUpdated = 0;
-        rv = apr_dbd_query(
-            dbd->driver,
-            dbd->handle,
+        rv = parsegraph_schemaQuery(
+            session,
             &nrowsUpdated,
             "update parsegraph_user_version set version = 1"
         );
@@ -324,7 +348,7 @@ parsegraph_UserStatus parsegraph_upgradeUserTables(parsegraph_Session* session)
             "alter table login add online_environment_id integer"
         };
         for(int i = 0; i < sizeof(upgrade)/sizeof(*upgrade); ++i) {
-            rv = apr_dbd_query(dbd->driver, dbd->handle, &nrows, upgrade[i]);
+            rv = parsegraph_schemaQuery(session, &nrows, upgrade[i]);
             if(rv != 0) {
                 marla_logMessagef(
                     session->server, "parsegraph_user upgrade to version 2 command %d failed to execute: %s",
@@ -337,9 +361,8 @@ parsegraph_UserStatus parsegraph_upgradeUserTables(parsegraph_Session* session)
         }
 
         int nrowsUpdated = 0;
-        rv = apr_dbd_query(
-            dbd->driver,
-            dbd->handle,
+        rv = parsegraph_schemaQuery(
+            session,
             &nrowsUpdated,
             "update parsegraph_user_version set version = 2"
         );
@@ -376,7 +399,7 @@ parsegraph_UserStatus parsegraph_upgradeUserTables(parsegraph_Session* session)
         const char* upgrade[] = {
         };
         for(int i = 0; i < sizeof(upgrade)/sizeof(*upgrade); ++i) {
-            rv = apr_dbd_query(dbd->driver, dbd->handle, &nrows, upgrade[i]);
+            rv = parsegraph_schemaQuery(session, &nrows, upgrade[i]);
             if(rv != 0) {
                 marla_logMessagef(
                     session->server, "parsegraph_user upgrade to version 3 command %d failed to execute: %s",
@@ -389,9 +412,8 @@ parsegraph_UserStatus parsegraph_upgradeUserTables(parsegraph_Session* session)
         }
 
         int nrowsUpdated = 0;
-        rv = apr_dbd_query(
-            dbd->driver,
-            dbd->handle,
+        rv = parsegraph_schemaQuery(
+            session,
             &nrowsUpdated,
             "update parsegraph_user_version set version = 3"
         );
@@ -412,6 +434,226 @@ parsegraph_UserStatus parsegraph_upgradeUserTables(parsegraph_Session* session)
 
         version = 3;
     }
+    if(version == 3) {
+        const char* upgrade[] = {
+            apr_pstrcat(pool, "create table if not exists ", schema, "login_revocation("
+                "user_id integer primary key, "
+                "generation integer not null"
+            ")", NULL)
+        };
+        for(int i = 0; i < sizeof(upgrade)/sizeof(*upgrade); ++i) {
+            rv = parsegraph_schemaQuery(session, &nrows, upgrade[i]);
+            if(rv != 0) {
+                marla_logMessagef(
+                    session->server, "parsegraph_user upgrade to version 4 command %d failed to execute: %s",
+                    i,
+                    apr_dbd_error(dbd->driver, dbd->handle, rv)
+                );
+                parsegraph_rollbackTransaction(session, transactionName);
+                return -1;
+            }
+        }
+
+        int nrowsUpdated = 0;
+        rv = parsegraph_schemaQuery(
+            session,
+            &nrowsUpdated,
+            "update parsegraph_user_version set version = 4"
+        );
+        if(rv != 0) {
+            marla_logMessagef(
+                session->server, "parsegraph_user_version version update query failed to execute: %s",
+                apr_dbd_error(dbd->driver, dbd->handle, rv)
+            );
+            parsegraph_rollbackTransaction(session, transactionName);
+            return parsegraph_ERROR;
+        }
+        if(nrowsUpdated != 1) {
+            marla_logMessagef(
+                session->server, "Unexpected number of parsegraph_user_version rows updated: %s",
+                apr_dbd_error(dbd->driver, dbd->handle, rv)
+            );
+        }
+
+        version = 4;
+    }
+    if(version == 4) {
+        const char* upgrade[] = {
+            "alter table login add token_hash text",
+            apr_pstrcat(pool, "create unique index if not exists ", schema, "login_selector on login(selector)", NULL)
+        };
+        for(int i = 0; i < sizeof(upgrade)/sizeof(*upgrade); ++i) {
+            rv = parsegraph_schemaQuery(session, &nrows, upgrade[i]);
+            if(rv != 0) {
+                marla_logMessagef(
+                    session->server, "parsegraph_user upgrade to version 5 command %d failed to execute: %s",
+                    i,
+                    apr_dbd_error(dbd->driver, dbd->handle, rv)
+                );
+                parsegraph_rollbackTransaction(session, transactionName);
+                return -1;
+            }
+        }
+
+        // Raw tokens cannot be hashed in SQL, so existing logins are hashed here.
+        rv = backfillLoginTokenHashes(session);
+        if(rv != 0) {
+            parsegraph_rollbackTransaction(session, transactionName);
+            return -1;
+        }
+
+        int nrowsUpdated = 0;
+        rv = parsegraph_schemaQuery(
+            session,
+            &nrowsUpdated,
+            "update parsegraph_user_version set version = 5"
+        );
+        if(rv != 0) {
+            marla_logMessagef(
+                session->server, "parsegraph_user_version version update query failed to execute: %s",
+                apr_dbd_error(dbd->driver, dbd->handle, rv)
+            );
+            parsegraph_rollbackTransaction(session, transactionName);
+            return parsegraph_ERROR;
+        }
+        if(nrowsUpdated != 1) {
+            marla_logMessagef(
+                session->server, "Unexpected number of parsegraph_user_version rows updated: %s",
+                apr_dbd_error(dbd->driver, dbd->handle, rv)
+            );
+        }
+
+        version = 5;
+    }
+    if(version == 5) {
+        const char* now = apr_psprintf(pool, "%" APR_TIME_T_FMT, apr_time_sec(apr_time_now()));
+        const char* upgrade[] = {
+            "alter table login add created integer",
+            "alter table login add last_seen integer",
+            apr_pstrcat(pool, "update login set created = ", now, ", last_seen = ", now, NULL),
+            apr_pstrcat(pool, "create index if not exists ", schema, "login_last_seen on login(last_seen)", NULL)
+        };
+        for(int i = 0; i < sizeof(upgrade)/sizeof(*upgrade); ++i) {
+            rv = parsegraph_schemaQuery(session, &nrows, upgrade[i]);
+            if(rv != 0) {
+                marla_logMessagef(
+                    session->server, "parsegraph_user upgrade to version 6 command %d failed to execute: %s",
+                    i,
+                    apr_dbd_error(dbd->driver, dbd->handle, rv)
+                );
+                parsegraph_rollbackTransaction(session, transactionName);
+                return -1;
+            }
+        }
+
+        int nrowsUpdated = 0;
+        rv = parsegraph_schemaQuery(
+            session,
+            &nrowsUpdated,
+            "update parsegraph_user_version set version = 6"
+        );
+        if(rv != 0) {
+            marla_logMessagef(
+                session->server, "parsegraph_user_version version update query failed to execute: %s",
+                apr_dbd_error(dbd->driver, dbd->handle, rv)
+            );
+            parsegraph_rollbackTransaction(session, transactionName);
+            return parsegraph_ERROR;
+        }
+        if(nrowsUpdated != 1) {
+            marla_logMessagef(
+                session->server, "Unexpected number of parsegraph_user_version rows updated: %s",
+                apr_dbd_error(dbd->driver, dbd->handle, rv)
+            );
+        }
+
+        version = 6;
+    }
+    if(version == 6) {
+        // The environment upgrade also adds these, so either may run first.
+        const char* upgrade[] = {
+            "storage_list_id",
+            "disposed_list_id",
+        };
+        for(int i = 0; i < sizeof(upgrade)/sizeof(*upgrade); ++i) {
+            rv = parsegraph_schemaAddColumn(session, session->authSchema, "user", upgrade[i], "int");
+            if(rv != 0) {
+                marla_logMessagef(
+                    session->server, "parsegraph_user upgrade to version 7 command %d failed to execute: %s",
+                    i,
+                    apr_dbd_error(dbd->driver, dbd->handle, rv)
+                );
+                parsegraph_rollbackTransaction(session, transactionName);
+                return -1;
+            }
+        }
+
+        int nrowsUpdated = 0;
+        rv = parsegraph_schemaQuery(
+            session,
+            &nrowsUpdated,
+            "update parsegraph_user_version set version = 7"
+        );
+        if(rv != 0) {
+            marla_logMessagef(
+                session->server, "parsegraph_user_version version update query failed to execute: %s",
+                apr_dbd_error(dbd->driver, dbd->handle, rv)
+            );
+            parsegraph_rollbackTransaction(session, transactionName);
+            return parsegraph_ERROR;
+        }
+        if(nrowsUpdated != 1) {
+            marla_logMessagef(
+                session->server, "Unexpected number of parsegraph_user_version rows updated: %s",
+                apr_dbd_error(dbd->driver, dbd->handle, rv)
+            );
+        }
+
+        version = 7;
+    }
+    if(version == 7) {
+        // Revocations older than the signed-login lifetime can then be pruned.
+        const char* now = apr_psprintf(pool, "%" APR_TIME_T_FMT, apr_time_sec(apr_time_now()));
+        const char* upgrade[] = {
+            apr_pstrcat(pool, "alter table ", schema, "login_revocation add revoked integer", NULL),
+            apr_pstrcat(pool, "update ", schema, "login_revocation set revoked = ", now, NULL)
+        };
+        for(int i = 0; i < sizeof(upgrade)/sizeof(*upgrade); ++i) {
+            rv = parsegraph_schemaQuery(session, &nrows, upgrade[i]);
+            if(rv != 0) {
+                marla_logMessagef(
+                    session->server, "parsegraph_user upgrade to version 8 command %d failed to execute: %s",
+                    i,
+                    apr_dbd_error(dbd->driver, dbd->handle, rv)
+                );
+                parsegraph_rollbackTransaction(session, transactionName);
+                return -1;
+            }
+        }
+
+        int nrowsUpdated = 0;
+        rv = parsegraph_schemaQuery(
+            session,
+            &nrowsUpdated,
+            "update parsegraph_user_version set version = 8"
+        );
+        if(rv != 0) {
+            marla_logMessagef(
+                session->server, "parsegraph_user_version version update query failed to execute: %s",
+                apr_dbd_error(dbd->driver, dbd->handle, rv)
+            );
+            parsegraph_rollbackTransaction(session, transactionName);
+            return parsegraph_ERROR;
+        }
+        if(nrowsUpdated != 1) {
+            marla_logMessagef(
+                session->server, "Unexpected number of parsegraph_user_version rows updated: %s",
+                apr_dbd_error(dbd->driver, dbd->handle, rv)
+            );
+        }
+
+        version = 8;
+    }
 
     rv = parsegraph_commitTransaction(session, transactionName);
     if(rv != parsegraph_OK) {
@@ -478,7 +720,7 @@ parsegraph_UserStatus parsegraph_createPasswordSalt(parsegraph_Session* session,
 {
     apr_pool_t* pool = session->pool;
     char* password_salt = apr_pcalloc(pool, salt_len);
-    if(0 != apr_generate_random_bytes((unsigned char*)password_salt, salt_len)) {
+    if(0 != parsegraph_randomBytes(password_salt, salt_len)) {
         marla_logMessagef(session->server, "Failed to generate password salt.");
         return parsegraph_ERROR;
     }
@@ -488,19 +730,9 @@ parsegraph_UserStatus parsegraph_createPasswordSalt(parsegraph_Session* session,
     return parsegraph_OK;
 }
 
-parsegraph_UserStatus parsegraph_encryptPassword(parsegraph_Session* session, const char* password, size_t password_size, char** password_hash_encoded, const char* password_salt_encoded, size_t password_salt_encoded_size)
+// Hashes the legacy format, a single SHA-256 of the password followed by its encoded salt.
+static char* legacyPasswordHash(apr_pool_t* pool, const char* password, size_t password_size, const char* password_salt_encoded, size_t password_salt_encoded_size)
 {
-    apr_pool_t* pool = session->pool;
-    // Validate arguments.
-    if(!password_hash_encoded) {
-        marla_logMessagef(session->server, "password_hash_encoded must not be null.");
-        return parsegraph_ERROR;
-    }
-    if(!password_salt_encoded) {
-        marla_logMessagef(session->server, "password_salt_encoded must not be null.");
-        return parsegraph_ERROR;
-    }
-
     char* password_hash_input = apr_pcalloc(pool, password_size + password_salt_encoded_size);
     memcpy(password_hash_input, password, password_size);
     memcpy(password_hash_input + password_size, password_salt_encoded, password_salt_encoded_size);
@@ -512,16 +744,85 @@ parsegraph_UserStatus parsegraph_encryptPassword(parsegraph_Session* session, co
         (unsigned char*)password_hash
     );
 
-    // Create the password + password salt hash.
-    *password_hash_encoded = (char*)apr_pcalloc(pool, apr_base64_encode_len(
+    char* password_hash_encoded = (char*)apr_pcalloc(pool, apr_base64_encode_len(
         SHA256_DIGEST_LENGTH
     ) + 1);
     apr_base64_encode(
-        *password_hash_encoded,
+        password_hash_encoded,
         password_hash,
         SHA256_DIGEST_LENGTH
     );
+    return password_hash_encoded;
+}
+
+// Hashes the current format, "$pbkdf2-sha256$<iterations>$<base64 hash>".
+static char* pbkdf2PasswordHash(apr_pool_t* pool, const char* password, size_t password_size, const char* password_salt_encoded, size_t password_salt_encoded_size, int iterations)
+{
+    unsigned char password_hash[SHA256_DIGEST_LENGTH];
+    if(1 != PKCS5_PBKDF2_HMAC(password, password_size,
+        (const unsigned char*)password_salt_encoded, password_salt_encoded_size,
+        iterations, EVP_sha256(), SHA256_DIGEST_LENGTH, password_hash)) {
+        return 0;
+    }
+    char* encoded = apr_palloc(pool, apr_base64_encode_len(SHA256_DIGEST_LENGTH));
+    apr_base64_encode(encoded, (const char*)password_hash, SHA256_DIGEST_LENGTH);
+    return apr_psprintf(pool, "%s%d$%s", PBKDF2_PREFIX, iterations, encoded);
+}
+
+parsegraph_UserStatus parsegraph_encryptPassword(parsegraph_Session* session, const char* password, size_t password_size, char** password_hash_encoded, const char* password_salt_encoded, size_t password_salt_encoded_size)
+{
+    apr_pool_t* pool = session->pool;
+    // Validate arguments.
+    if(!password_hash_encoded) {
+        marla_logMessagef(session->server, "password_hash_encoded must not be null.");
+        return parsegraph_ERROR;
+    }
+    if(!password_salt_encoded) {
+        marla_logMessagef(session->server, "password_salt_encoded must not be null.");
+        return parsegraph_ERROR;
+    }
+
+    *password_hash_encoded = pbkdf2PasswordHash(pool, password, password_size, password_salt_encoded, password_salt_encoded_size, session->passwordIterations);
+    if(!*password_hash_encoded) {
+        marla_logMessagef(session->server, "Failed to derive password hash.");
+        return parsegraph_ERROR;
+    }
+
+    return parsegraph_OK;
+}
+
+parsegraph_UserStatus parsegraph_verifyPassword(parsegraph_Session* session, const char* password, size_t password_size, const char* password_hash_encoded, const char* password_salt_encoded, int* needsRehash)
+{
+    apr_pool_t* pool = session->pool;
+    if(!password_hash_encoded || !password_salt_encoded) {
+        marla_logMessagef(session->server, "Stored password hash and salt must not be null.");
+        return parsegraph_ERROR;
+    }
+    size_t password_salt_encoded_size = strlen(password_salt_encoded);
+
+    const char* computed;
+    if(!strncmp(password_hash_encoded, PBKDF2_PREFIX, strlen(PBKDF2_PREFIX))) {
+        int iterations = atoi(password_hash_encoded + strlen(PBKDF2_PREFIX));
+        if(iterations <= 0) {
+            marla_logMessagef(session->server, "Stored password hash is malformed.");
+            return parsegraph_ERROR;
+        }
+        computed = pbkdf2PasswordHash(pool, password, password_size, password_salt_encoded, password_salt_encoded_size, iterations);
+        *needsRehash = iterations != session->passwordIterations;
+    }
+    else {
+        computed = legacyPasswordHash(pool, password, password_size, password_salt_encoded, password_salt_encoded_size);
+        *needsRehash = 1;
+    }
+    if(!computed) {
+        marla_logMessagef(session->server, "Failed to derive password hash.");
+        return parsegraph_ERROR;
+    }
 
+    size_t hash_size = strlen(computed);
+    if(strlen(password_hash_encoded) != hash_size || CRYPTO_memcmp(computed, password_hash_encoded, hash_size)) {
+        return parsegraph_INVALID_PASSWORD;
+    }
     return parsegraph_OK;
 }
 
@@ -532,6 +833,8 @@ const int parsegraph_PASSWORD_MAX_LENGTH = 255;
 const int parsegraph_PASSWORD_SALT_LENGTH = 12;
 const int parsegraph_SELECTOR_LENGTH = 32;
 const int parsegraph_TOKEN_LENGTH = 128;
+const int parsegraph_PASSWORD_ITERATIONS = 100000;
+const int parsegraph_USER_PAGE_MAX_SIZE = 1024;
 
 const char* parsegraph_constructSessionString(parsegraph_Session* session, const char* session_selector, const char* session_token)
 {
@@ -612,24 +915,23 @@ parsegraph_UserStatus parsegraph_createNewUser(
         return rv;
     }
     char* password_hash_encoded;
-    parsegraph_encryptPassword(session, password, password_size, &password_hash_encoded, password_salt_encoded, strlen(password_salt_encoded));
-
-    // Insert the new user into the database.
+    rv = parsegraph_encryptPassword(session, password, password_size, &password_hash_encoded, password_salt_encoded, strlen(password_salt_encoded));
+    if(rv != parsegraph_OK) {
+        return rv;
+    }
+
+    // Insert the new user into the database.
     const char* queryName = "parsegraph_user_createNewUser";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_createNewUser)) {
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_ERROR;
     }
     int nrows = 0;
-    dbrv = apr_dbd_pvquery(
-        dbd->driver,
+    dbrv = parsegraph_pvquery(
+        session,
         pool,
-        dbd->handle,
         &nrows,
-        query,
+        parsegraph_Statement_user_createNewUser,
         username,
         password_hash_encoded,
         password_salt_encoded
@@ -654,6 +956,16 @@ parsegraph_UserStatus parsegraph_createNewUser(
         return parsegraph_ERROR;
     }
 
+    if(session->usernameIndex) {
+        int userId;
+        if(0 == parsegraph_lastInsertId(session, &userId)) {
+            parsegraph_indexUsername(session, username, userId);
+        }
+        else {
+            marla_logMessagef(session->server, "Failed to get the id of new user %s for the username index.", username);
+        }
+    }
+
     return parsegraph_OK;
 }
 
@@ -706,28 +1018,28 @@ parsegraph_UserStatus parsegraph_changeUserPassword(
         return parsegraph_ERROR;
     }
     char* password_hash_encoded;
-    parsegraph_encryptPassword(session, password, password_size, &password_hash_encoded, password_salt_encoded, strlen(password_salt_encoded));
+    rv = parsegraph_encryptPassword(session, password, password_size, &password_hash_encoded, password_salt_encoded, strlen(password_salt_encoded));
+    if(rv != parsegraph_OK) {
+        return rv;
+    }
 
     // Change the password.
     const char* queryName = "parsegraph_user_changeUserPassword";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_changeUserPassword)) {
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_ERROR;
     }
     int nrows = 0;
-    dbrv = apr_dbd_pvquery(
-        dbd->driver,
+    dbrv = parsegraph_pvquery(
+        session,
         pool,
-        dbd->handle,
         &nrows,
-        query,
+        parsegraph_Statement_user_changeUserPassword,
         password_hash_encoded,
         password_salt_encoded,
         username
     );
+    parsegraph_Session_forgetUsers(session);
     if(dbrv != 0) {
         marla_logMessagef(session->server, "%s query failed to execute: %s", queryName,
             apr_dbd_error(dbd->driver, dbd->handle, dbrv)
@@ -771,24 +1083,45 @@ parsegraph_UserStatus parsegraph_removeUser(
         return rv;
     }
 
+    // Without a signer, no signed login can need the user's revocation. With
+    // one, it is kept until pruned, since a later user may reuse the id.
+    int nrows = 0;
+    int dbrv;
+    if(!session->signedLogins) {
+        dbrv = parsegraph_pvquery(
+            session,
+            pool,
+            &nrows,
+            parsegraph_Statement_user_removeLoginRevocation,
+            username
+        );
+        if(dbrv != 0) {
+            marla_logMessagef(session->server,
+                "Failed to remove login revocation [%s]",
+                apr_dbd_error(dbd->driver, dbd->handle, dbrv)
+            );
+            return parsegraph_ERROR;
+        }
+    }
+
     // Remove the user.
     const char* queryName = "parsegraph_user_removeUser";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_removeUser)) {
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_UNDEFINED_PREPARED_STATEMENT;
     }
-    int nrows = 0;
-    int dbrv = apr_dbd_pvquery(
-        dbd->driver,
+    nrows = 0;
+    dbrv = parsegraph_pvquery(
+        session,
         pool,
-        dbd->handle,
         &nrows,
-        query,
+        parsegraph_Statement_user_removeUser,
         username
     );
+    parsegraph_Session_forgetUsers(session);
+    if(dbrv == 0) {
+        parsegraph_unindexUsername(session, username);
+    }
 
     // Confirm removal result.
     if(dbrv != 0) {
@@ -818,12 +1151,12 @@ parsegraph_UserStatus parsegraph_generateLogin(parsegraph_Session* session, cons
     apr_pool_t* pool = session->pool;
     // Generate the selector and token.
     char* selector = apr_pcalloc(pool, parsegraph_SELECTOR_LENGTH);
-    if(0 != apr_generate_random_bytes((unsigned char*)selector, parsegraph_SELECTOR_LENGTH)) {
+    if(0 != parsegraph_randomBytes(selector, parsegraph_SELECTOR_LENGTH)) {
         marla_logMessagef(session->server, "Failed to generate selector.");
         return parsegraph_ERROR;
     }
     char* token = apr_pcalloc(pool, parsegraph_TOKEN_LENGTH);
-    if(0 != apr_generate_random_bytes((unsigned char*)token, parsegraph_TOKEN_LENGTH)) {
+    if(0 != parsegraph_randomBytes(token, parsegraph_TOKEN_LENGTH)) {
         marla_logMessagef(session->server, "Failed to generate token.");
         return parsegraph_ERROR;
     }
@@ -878,26 +1211,27 @@ parsegraph_UserStatus parsegraph_refreshUserLogin(parsegraph_Session* session, s
     }
     createdLogin->username = 0;
 
+    if(session->loginCache && APR_SUCCESS == parsegraph_LoginCache_get(session->loginCache, pool,
+        createdLogin->session_selector, createdLogin->session_token,
+        &createdLogin->username, &createdLogin->userId)) {
+        return parsegraph_OK;
+    }
+
     const char* queryName = "parsegraph_user_refreshUserLogin";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_refreshUserLogin)) {
          // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_UNDEFINED_PREPARED_STATEMENT;
     }
 
     apr_dbd_results_t* res = 0;
-    int dbrv = apr_dbd_pvselect(
-        dbd->driver,
+    int dbrv = parsegraph_pvselect(
+        session,
         pool,
-        dbd->handle,
         &res,
-        query,
+        parsegraph_Statement_user_refreshUserLogin,
         0,
-        createdLogin->session_selector,
-        createdLogin->session_token
+        createdLogin->session_selector
     );
     if(dbrv != 0) {
         marla_logMessagef(session->server, "%s query failed to execute: [%s]", queryName, apr_dbd_error(dbd->driver, dbd->handle, dbrv));
@@ -916,6 +1250,15 @@ parsegraph_UserStatus parsegraph_refreshUserLogin(parsegraph_Session* session, s
         return parsegraph_SESSION_DOES_NOT_EXIST;
     }
 
+    // Compare the token's hash without leaking how much of it matched.
+    const char* token_hash = apr_dbd_get_entry(dbd->driver, row, 2);
+    const char* expected_hash = hashSessionToken(pool, createdLogin->session_token);
+    size_t hash_size = strlen(expected_hash);
+    if(!token_hash || strlen(token_hash) != hash_size || CRYPTO_memcmp(token_hash, expected_hash, hash_size)) {
+        while(-1 != apr_dbd_get_row(dbd->driver, pool, res, &row, -1));
+        return parsegraph_SESSION_DOES_NOT_MATCH;
+    }
+
     // Retrieve the canonical username.
     const char* username = apr_dbd_get_entry(
         dbd->driver,
@@ -931,7 +1274,103 @@ parsegraph_UserStatus parsegraph_refreshUserLogin(parsegraph_Session* session, s
     if(rv != parsegraph_OK) {
         return rv;
     }
+    int userId;
+    if(APR_SUCCESS != apr_dbd_datum_get(dbd->driver, row, 1, APR_DBD_TYPE_INT, &userId)) {
+        marla_logMessagef(session->server, "Failed to retrieve user id for login.");
+        return parsegraph_ERROR;
+    }
+    apr_int64_t lastSeen = 0;
+    if(APR_SUCCESS != apr_dbd_datum_get(dbd->driver, row, 3, APR_DBD_TYPE_LONGLONG, &lastSeen)) {
+        lastSeen = 0;
+    }
+
+    // Finish reading the results so the statement is reset.
+    while(-1 != apr_dbd_get_row(dbd->driver, pool, res, &row, -1));
+
+    if(session->loginExpiry > 0) {
+        apr_int64_t now = apr_time_sec(apr_time_now());
+        apr_int64_t expiry = apr_time_sec(session->loginExpiry);
+        if(lastSeen + expiry <= now) {
+            return parsegraph_SESSION_DOES_NOT_EXIST;
+        }
+
+        // Record the use at most four times per expiry period.
+        if(now - lastSeen >= expiry / 4) {
+            int nrows = 0;
+            dbrv = parsegraph_pvquery(
+                session,
+                pool,
+                &nrows,
+                parsegraph_Statement_user_touchLogin,
+                apr_psprintf(pool, "%" APR_INT64_T_FMT, now),
+                createdLogin->session_selector
+            );
+            if(dbrv != 0) {
+                marla_logMessagef(session->server, "Failed to record use of login [%s]", apr_dbd_error(dbd->driver, dbd->handle, dbrv));
+                return parsegraph_ERROR;
+            }
+        }
+    }
+
     createdLogin->username = username;
+    createdLogin->userId = userId;
+    if(session->loginCache) {
+        parsegraph_LoginCache_put(session->loginCache,
+            createdLogin->session_selector, createdLogin->session_token,
+            username, userId);
+    }
+    return parsegraph_OK;
+}
+
+/**
+ * Checks the password of the given user, whose username and password are
+ * valid. The check derives a key, so it is done outside of transactions.
+ * needsRehash is set if the stored hash should be replaced with
+ * rehashPassword once any transaction has ended.
+ */
+static parsegraph_UserStatus checkUserPassword(parsegraph_Session* session, const char* username, const char* password, size_t password_size, int* userId, int* needsRehash)
+{
+    parsegraph_UserRecord* user;
+    parsegraph_UserStatus rv = parsegraph_loadUser(session, username, &user);
+    if(parsegraph_OK != rv) {
+        return rv;
+    }
+    *userId = user->id;
+
+    *needsRehash = 0;
+    return parsegraph_verifyPassword(session, password, password_size, user->passwordHash, user->passwordSalt, needsRehash);
+}
+
+// Moves a hash in an older format or strength to the current one. The login
+// already succeeded, so a failure here only delays the upgrade.
+static void rehashPassword(parsegraph_Session* session, const char* username, const char* password)
+{
+    if(parsegraph_OK != parsegraph_changeUserPassword(session, username, password)) {
+        marla_logMessagef(session->server, "Failed to rehash the password of %s.", username);
+    }
+}
+
+// Takes a login attempt from the session's limiter for the username and the remote address.
+static parsegraph_UserStatus checkLoginRate(parsegraph_Session* session, const char* username, size_t username_size)
+{
+    parsegraph_RateLimiter* limiter = session->loginLimiter;
+    if(!limiter) {
+        return parsegraph_OK;
+    }
+    const char* address = session->remoteAddress;
+
+    // Check both before taking either, so an address over its limit does not
+    // also spend the username's attempts, nor the reverse.
+    if(APR_SUCCESS != parsegraph_RateLimiter_peek(limiter, "username", username, username_size)
+        || (address && APR_SUCCESS != parsegraph_RateLimiter_peek(limiter, "address", address, strlen(address)))) {
+        return parsegraph_RATE_LIMITED;
+    }
+    if(APR_SUCCESS != parsegraph_RateLimiter_take(limiter, "username", username, username_size)) {
+        return parsegraph_RATE_LIMITED;
+    }
+    if(address && APR_SUCCESS != parsegraph_RateLimiter_take(limiter, "address", address, strlen(address))) {
+        return parsegraph_RATE_LIMITED;
+    }
     return parsegraph_OK;
 }
 
@@ -959,124 +1398,55 @@ parsegraph_UserStatus parsegraph_beginUserLogin(
         return rv;
     }
 
-    rv = parsegraph_beginTransaction(session, transactionName);
-    if(rv != parsegraph_OK) {
-        return rv;
-    }
-
-    // Check for an existing user.
-    apr_dbd_results_t* res = NULL;
-    rv = parsegraph_getUser(
-        session, &res, username
-    );
+    rv = checkLoginRate(session, username, username_size);
     if(parsegraph_OK != rv) {
-        parsegraph_rollbackTransaction(session, transactionName);
         return rv;
     }
-    apr_dbd_row_t* row;
-    int dbrv = apr_dbd_get_row(
-        dbd->driver,
-        pool,
-        res,
-        &row,
-        -1
-    );
-    if(dbrv != 0) {
-        parsegraph_rollbackTransaction(session, transactionName);
-        return parsegraph_USER_DOES_NOT_EXIST;
-    }
 
+    // Check the password before the transaction, so the key derivation does
+    // not hold the database lock.
     int user_id;
-    switch(apr_dbd_datum_get(
-        dbd->driver,
-        row,
-        0,
-        APR_DBD_TYPE_INT,
-        &user_id
-    )) {
-    case APR_SUCCESS:
-        break;
-    case APR_ENOENT:
-        marla_logMessagef(session->server, "user_id must not be null for %s", username);
-        parsegraph_rollbackTransaction(session, transactionName);
-        return parsegraph_ERROR;
-    case APR_EGENERAL:
-        marla_logMessagef(session->server, "Failed to retrieve user_id for %s", username);
-        parsegraph_rollbackTransaction(session, transactionName);
-        return parsegraph_ERROR;
-    }
-
-    const char* password_salt_encoded = apr_dbd_get_entry(
-        dbd->driver,
-        row,
-        2
-    );
-    if(!password_salt_encoded) {
-        marla_logMessagef(session->server, "password_salt_encoded must not be null.");
-        parsegraph_rollbackTransaction(session, transactionName);
-        return parsegraph_ERROR;
-    }
-
-    char* password_hash_encoded;
-    if(0 != parsegraph_encryptPassword(session, password, password_size, &password_hash_encoded, password_salt_encoded, strlen(password_salt_encoded))) {
-        marla_logMessagef(session->server, "Failed to generate encrypted password.");
-        parsegraph_rollbackTransaction(session, transactionName);
-        return parsegraph_ERROR;
+    int needsRehash;
+    rv = checkUserPassword(session, username, password, password_size, &user_id, &needsRehash);
+    if(parsegraph_OK != rv) {
+        return rv;
     }
 
-    const char* expected_hash_encoded = apr_dbd_get_entry(
-        dbd->driver,
-        row,
-        1
-    );
-    if(!expected_hash_encoded) {
-        marla_logMessagef(session->server, "Expected_hash must not be null.");
-        parsegraph_rollbackTransaction(session, transactionName);
-        return parsegraph_ERROR;
-    }
-    if(0 != strcmp(expected_hash_encoded, (const char*)password_hash_encoded)) {
-        // Given password doesn't match the password in the database.
-        parsegraph_rollbackTransaction(session, transactionName);
-        return parsegraph_INVALID_PASSWORD;
+    rv = parsegraph_beginTransaction(session, transactionName);
+    if(rv != parsegraph_OK) {
+        return rv;
     }
 
     // Passwords match, so create a login.
+    int dbrv;
     rv = parsegraph_generateLogin(session, username, createdLogin);
     if(parsegraph_OK != rv) {
         parsegraph_rollbackTransaction(session, transactionName);
         return rv;
     }
-    int userId;
-    parsegraph_UserStatus idRV = parsegraph_getIdForUsername(session, username, &userId);
-    if(parsegraph_isSeriousUserError(idRV)) {
-        marla_logMessagef(session->server, "Failed to retrieve ID for generated login.");
-        parsegraph_rollbackTransaction(session, transactionName);
-        return idRV;
-    }
-    (*createdLogin)->userId = userId;
+    (*createdLogin)->userId = user_id;
 
     // Insert the new login into the database.
     const char* queryName = "parsegraph_user_beginUserLogin";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_beginUserLogin)) {
          // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         parsegraph_rollbackTransaction(session, transactionName);
         return parsegraph_UNDEFINED_PREPARED_STATEMENT;
     }
 
+    const char* now = apr_psprintf(pool, "%" APR_TIME_T_FMT, apr_time_sec(apr_time_now()));
     int nrows = 0;
-    dbrv = apr_dbd_pvquery(
-        dbd->driver,
+    dbrv = parsegraph_pvquery(
+        session,
         pool,
-        dbd->handle,
         &nrows,
-        query,
+        parsegraph_Statement_user_beginUserLogin,
         username,
         (*createdLogin)->session_selector,
-        (*createdLogin)->session_token
+        hashSessionToken(pool, (*createdLogin)->session_token),
+        now,
+        now
     );
     if(dbrv != 0) {
         marla_logMessagef(session->server,
@@ -1105,6 +1475,9 @@ parsegraph_UserStatus parsegraph_beginUserLogin(
         parsegraph_rollbackTransaction(session, transactionName);
         return rv;
     }
+    if(needsRehash) {
+        rehashPassword(session, username, password);
+    }
     return parsegraph_OK;
 }
 
@@ -1126,20 +1499,21 @@ parsegraph_UserStatus parsegraph_endUserLogin(
 
     // Remove the login into the database.
     const char* queryName = "parsegraph_user_endUserLogin";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_endUserLogin)) {
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_UNDEFINED_PREPARED_STATEMENT;
     }
 
-    int dbrv = apr_dbd_pvquery(
-        dbd->driver,
+    // Forget cached logins first, so a failed query cannot leave them usable.
+    if(session->loginCache) {
+        parsegraph_LoginCache_removeUser(session->loginCache, username);
+    }
+
+    int dbrv = parsegraph_pvquery(
+        session,
         pool,
-        dbd->handle,
         logins_ended,
-        query,
+        parsegraph_Statement_user_endUserLogin,
         username
     );
     if(dbrv != 0) {
@@ -1149,6 +1523,200 @@ parsegraph_UserStatus parsegraph_endUserLogin(
         );
         return parsegraph_ERROR;
     }
+
+    // Revoke signed logins issued before now. The generation becomes at
+    // least the current time, so it still exceeds those issued before if
+    // the revocation is pruned and the user's logins are ended again.
+    if(!session->signedLogins) {
+        return parsegraph_OK;
+    }
+    int nrows = 0;
+    const char* now = apr_psprintf(pool, "%" APR_TIME_T_FMT, apr_time_sec(apr_time_now()));
+    dbrv = parsegraph_pvquery(
+        session,
+        pool,
+        &nrows,
+        parsegraph_Statement_user_revokeLogins,
+        now,
+        now,
+        username
+    );
+    if(dbrv != 0) {
+        marla_logMessagef(session->server,
+            "Failed to revoke signed logins [%s]",
+            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
+        );
+        return parsegraph_ERROR;
+    }
+    parsegraph_SignedLogins_invalidate(session->signedLogins);
+    return parsegraph_OK;
+}
+
+parsegraph_UserStatus parsegraph_sweepExpiredLogins(
+    parsegraph_Session* session,
+    int batchSize,
+    int maxBatches,
+    int* logins_swept)
+{
+    ap_dbd_t* dbd = session->dbd;
+    *logins_swept = 0;
+    if(session->transactionDepth > 0) {
+        marla_logMessagef(session->server, "Expired logins must not be swept within a transaction.");
+        return parsegraph_ERROR;
+    }
+    int revocationsPruned;
+    if(session->signedLogins) {
+        if(parsegraph_OK != parsegraph_SignedLogins_prune(session->signedLogins, session, &revocationsPruned)) {
+            return parsegraph_ERROR;
+        }
+    }
+    else if(session->revocationLifetime > 0) {
+        if(parsegraph_OK != parsegraph_pruneLoginRevocations(session, session->revocationLifetime, &revocationsPruned)) {
+            return parsegraph_ERROR;
+        }
+    }
+    if(session->loginExpiry <= 0) {
+        return parsegraph_OK;
+    }
+
+    // Sweeps run repeatedly on long-lived sessions, so allocate from a pool of their own.
+    apr_pool_t* pool;
+    if(APR_SUCCESS != apr_pool_create(&pool, session->pool)) {
+        return parsegraph_ERROR;
+    }
+    parsegraph_UserStatus rv = parsegraph_OK;
+
+    const char* cutoff = apr_psprintf(pool, "%" APR_INT64_T_FMT, apr_time_sec(apr_time_now() - session->loginExpiry));
+    for(int batch = 0; maxBatches <= 0 || batch < maxBatches; ++batch) {
+        // Each batch commits alone, so the write lock is released between them.
+        int nrows = 0;
+        int dbrv = parsegraph_pvbquery(
+            session,
+            pool,
+            &nrows,
+            parsegraph_Statement_user_sweepLogins,
+            cutoff,
+            &batchSize
+        );
+        if(dbrv != 0) {
+            marla_logMessagef(session->server,
+                "Failed to sweep expired logins [%s]",
+                apr_dbd_error(dbd->driver, dbd->handle, dbrv)
+            );
+            rv = parsegraph_ERROR;
+            break;
+        }
+        *logins_swept += nrows;
+        if(nrows < batchSize) {
+            break;
+        }
+        apr_thread_yield();
+    }
+    apr_pool_destroy(pool);
+    return rv;
+}
+
+parsegraph_UserStatus parsegraph_pruneLoginRevocations(
+    parsegraph_Session* session,
+    apr_interval_time_t lifetime,
+    int* pruned)
+{
+    ap_dbd_t* dbd = session->dbd;
+    *pruned = 0;
+    const char* cutoff = apr_psprintf(session->pool, "%" APR_TIME_T_FMT, apr_time_sec(apr_time_now() - lifetime));
+    int dbrv = parsegraph_pvquery(session, session->pool, pruned, parsegraph_Statement_user_pruneLoginRevocations, cutoff);
+    if(dbrv != 0) {
+        marla_logMessagef(session->server, "Failed to prune login revocations [%s]", apr_dbd_error(dbd->driver, dbd->handle, dbrv));
+        return parsegraph_ERROR;
+    }
+    return parsegraph_OK;
+}
+
+parsegraph_UserStatus parsegraph_getLoginGeneration(
+    parsegraph_Session* session,
+    int userId,
+    int* generation)
+{
+    apr_pool_t* pool = session->pool;
+    ap_dbd_t* dbd = session->dbd;
+    apr_dbd_results_t* res = 0;
+    int dbrv = parsegraph_pvbselect(
+        session,
+        pool,
+        &res,
+        parsegraph_Statement_user_getLoginGeneration,
+        0,
+        &userId
+    );
+    if(dbrv != 0) {
+        marla_logMessagef(session->server,
+            "Failed to get login generation [%s]",
+            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
+        );
+        return parsegraph_ERROR;
+    }
+
+    // Users whose logins were never ended have no row.
+    *generation = 0;
+    apr_dbd_row_t* row = 0;
+    if(0 == apr_dbd_get_row(dbd->driver, pool, res, &row, -1)) {
+        if(APR_SUCCESS != apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, generation)) {
+            marla_logMessagef(session->server, "Failed to retrieve login generation.");
+            while(-1 != apr_dbd_get_row(dbd->driver, pool, res, &row, -1));
+            return parsegraph_ERROR;
+        }
+        while(-1 != apr_dbd_get_row(dbd->driver, pool, res, &row, -1));
+    }
+    return parsegraph_OK;
+}
+
+parsegraph_UserStatus parsegraph_beginSignedUserLogin(
+    parsegraph_Session* session,
+    const char* username,
+    const char* password,
+    const char** sessionValue)
+{
+    if(!session->signedLogins) {
+        marla_logMessagef(session->server, "No signer was set for signed logins.");
+        return parsegraph_ERROR;
+    }
+
+    size_t username_size;
+    parsegraph_UserStatus rv = parsegraph_validateUsername(session, username, &username_size);
+    if(parsegraph_OK != rv) {
+        return rv;
+    }
+    size_t password_size;
+    rv = parsegraph_validatePassword(session, password, &password_size);
+    if(parsegraph_OK != rv) {
+        return rv;
+    }
+
+    rv = checkLoginRate(session, username, username_size);
+    if(parsegraph_OK != rv) {
+        return rv;
+    }
+
+    int userId;
+    int needsRehash;
+    rv = checkUserPassword(session, username, password, password_size, &userId, &needsRehash);
+    if(parsegraph_OK != rv) {
+        return rv;
+    }
+    if(needsRehash) {
+        rehashPassword(session, username, password);
+    }
+    int generation;
+    rv = parsegraph_getLoginGeneration(session, userId, &generation);
+    if(parsegraph_OK != rv) {
+        return rv;
+    }
+
+    *sessionValue = parsegraph_SignedLogins_sign(session->signedLogins, session->pool, userId, generation);
+    if(!*sessionValue) {
+        marla_logMessagef(session->server, "Failed to sign login for %s.", username);
+        return parsegraph_ERROR;
+    }
     return parsegraph_OK;
 }
 
@@ -1160,69 +1728,266 @@ parsegraph_UserStatus parsegraph_listUsers(
     ap_dbd_t* dbd = session->dbd;
     // Get and run the query.
     const char* queryName = "parsegraph_user_listUsers";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_listUsers)) {
         marla_logMessagef(session->server,
             "%s query was not defined.", queryName
         );
         return parsegraph_UNDEFINED_PREPARED_STATEMENT;
     }
-    int dbrv = apr_dbd_pvselect(
-        dbd->driver,
+    int dbrv = parsegraph_pvselect(
+        session,
         pool,
-        dbd->handle,
         res,
-        query,
+        parsegraph_Statement_user_listUsers,
         0
     );
     if(dbrv != 0) {
-        marla_logMessagef(session->server,
-            "Failed to list users [%s]",
+        marla_logMessagef(session->server,
+            "Failed to list users [%s]",
+            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
+        );
+        return parsegraph_ERROR;
+    }
+    return parsegraph_OK;
+}
+
+parsegraph_UserStatus parsegraph_listUsersAfter(
+    parsegraph_Session* session,
+    apr_pool_t* pool,
+    int afterId,
+    int limit,
+    apr_array_header_t** users)
+{
+    const char* queryName = "parsegraph_user_listUsersAfter";
+    if(limit <= 0) {
+        marla_logMessagef(session->server, "Users must be listed at least one at a time, not %d.", limit);
+        return parsegraph_ERROR;
+    }
+    if(limit > parsegraph_USER_PAGE_MAX_SIZE) {
+        limit = parsegraph_USER_PAGE_MAX_SIZE;
+    }
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_listUsersAfter)) {
+        marla_logMessagef(session->server, "%s query was not defined.", queryName);
+        return parsegraph_UNDEFINED_PREPARED_STATEMENT;
+    }
+    parsegraph_Cursor cursor;
+    if(0 != parsegraph_Cursor_open(&cursor, session, pool, parsegraph_Statement_user_listUsersAfter, &afterId, &limit)) {
+        marla_logMessagef(session->server, "Failed to list users after %d.", afterId);
+        return parsegraph_ERROR;
+    }
+
+    *users = apr_array_make(pool, limit, sizeof(parsegraph_UserSummary));
+    for(;;) {
+        int dbrv = parsegraph_Cursor_next(&cursor);
+        if(dbrv == APR_EOF) {
+            break;
+        }
+        parsegraph_UserSummary* user = apr_array_push(*users);
+        if(dbrv != APR_SUCCESS || 0 != parsegraph_Cursor_int(&cursor, 0, &user->id)) {
+            marla_logMessagef(session->server, "Failed to read users after %d.", afterId);
+            parsegraph_Cursor_close(&cursor);
+            return parsegraph_ERROR;
+        }
+        user->username = parsegraph_Cursor_text(&cursor, 1);
+    }
+    parsegraph_Cursor_close(&cursor);
+    return parsegraph_OK;
+}
+
+parsegraph_UserStatus parsegraph_UserIterator_open(parsegraph_UserIterator* iter, parsegraph_Session* session, int pageSize)
+{
+    if(pageSize <= 0 || APR_SUCCESS != apr_pool_create(&iter->pool, session->pool)) {
+        return parsegraph_ERROR;
+    }
+    iter->session = session;
+    // Pages are never longer than listUsersAfter returns, or a full page would look like the last.
+    iter->pageSize = pageSize > parsegraph_USER_PAGE_MAX_SIZE ? parsegraph_USER_PAGE_MAX_SIZE : pageSize;
+    iter->lastId = 0;
+    iter->page = 0;
+    iter->index = 0;
+    return parsegraph_OK;
+}
+
+parsegraph_UserStatus parsegraph_UserIterator_next(parsegraph_UserIterator* iter, parsegraph_UserSummary** user)
+{
+    if(iter->page && iter->index == iter->page->nelts) {
+        if(iter->page->nelts < iter->pageSize) {
+            // A short page was the last.
+            *user = 0;
+            return parsegraph_OK;
+        }
+        iter->page = 0;
+    }
+    if(!iter->page) {
+        apr_pool_clear(iter->pool);
+        parsegraph_UserStatus rv = parsegraph_listUsersAfter(iter->session, iter->pool, iter->lastId, iter->pageSize, &iter->page);
+        if(parsegraph_OK != rv) {
+            iter->page = 0;
+            return rv;
+        }
+        iter->index = 0;
+        if(iter->page->nelts == 0) {
+            *user = 0;
+            return parsegraph_OK;
+        }
+    }
+    *user = &APR_ARRAY_IDX(iter->page, iter->index++, parsegraph_UserSummary);
+    iter->lastId = (*user)->id;
+    return parsegraph_OK;
+}
+
+void parsegraph_UserIterator_close(parsegraph_UserIterator* iter)
+{
+    apr_pool_destroy(iter->pool);
+}
+
+parsegraph_UserStatus parsegraph_getUser(
+    parsegraph_Session* session,
+    apr_dbd_results_t** res,
+    const char* username)
+{
+    apr_pool_t* pool = session->pool;
+    ap_dbd_t* dbd = session->dbd;
+    // Get and run the query.
+    const char* queryName = "parsegraph_user_getUser";
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_getUser)) {
+         // Query was not defined.
+        marla_logMessagef(session->server,
+            "%s query was not defined.", queryName
+        );
+        return parsegraph_UNDEFINED_PREPARED_STATEMENT;
+    }
+    int dbrv = parsegraph_pvselect(
+        session,
+        pool,
+        res,
+        parsegraph_Statement_user_getUser,
+        0,
+        username
+    );
+    if(0 != dbrv) {
+        marla_logMessagef(session->server,
+            "Failed to list users [%s]",
+            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
+        );
+        return parsegraph_ERROR;
+    }
+    return parsegraph_OK;
+}
+
+// Reads the user in the first row of res, remembering it if the session memoizes users.
+static parsegraph_UserStatus readUserRecord(parsegraph_Session* session, apr_pool_t* pool, apr_dbd_results_t* res, parsegraph_UserRecord** record)
+{
+    ap_dbd_t* dbd = session->dbd;
+    apr_dbd_row_t* row = NULL;
+    if(0 != apr_dbd_get_row(dbd->driver, pool, res, &row, -1)) {
+        return parsegraph_USER_DOES_NOT_EXIST;
+    }
+
+    parsegraph_UserRecord* user = apr_pcalloc(pool, sizeof(*user));
+    user->username = apr_dbd_get_entry(dbd->driver, row, 1);
+    user->passwordHash = apr_dbd_get_entry(dbd->driver, row, 2);
+    user->passwordSalt = apr_dbd_get_entry(dbd->driver, row, 3);
+    user->profile = apr_dbd_get_entry(dbd->driver, row, 4);
+
+    // Integer columns, with the value of each when it is null.
+    struct {
+        int col;
+        int* value;
+        int nullValue;
+    } ints[] = {
+        { 0, &user->id, -1 },
+        { 5, &user->isSuperAdmin, 0 },
+        { 6, &user->isBanned, 0 },
+        { 7, &user->allowsSubscription, 0 },
+        { 8, &user->storageListId, -1 },
+        { 9, &user->disposedListId, -1 }
+    };
+    for(int i = 0; i < sizeof(ints)/sizeof(*ints); ++i) {
+        switch(apr_dbd_datum_get(dbd->driver, row, ints[i].col, APR_DBD_TYPE_INT, ints[i].value)) {
+        case APR_SUCCESS:
+            break;
+        case APR_ENOENT:
+            *ints[i].value = ints[i].nullValue;
+            break;
+        default:
+            marla_logMessagef(session->server, "Failed to retrieve column %d of user.", ints[i].col);
+            while(-1 != apr_dbd_get_row(dbd->driver, pool, res, &row, -1));
+            return parsegraph_ERROR;
+        }
+    }
+
+    // Finish reading the results so the statement is reset.
+    while(-1 != apr_dbd_get_row(dbd->driver, pool, res, &row, -1));
+
+    if(session->userMemoPool) {
+        apr_hash_set(session->usersByName, user->username, APR_HASH_KEY_STRING, user);
+        apr_hash_set(session->usersById, &user->id, sizeof(int), user);
+    }
+    *record = user;
+    return parsegraph_OK;
+}
+
+parsegraph_UserStatus parsegraph_loadUser(
+    parsegraph_Session* session,
+    const char* username,
+    parsegraph_UserRecord** record)
+{
+    if(session->userMemoPool) {
+        parsegraph_UserRecord* user = apr_hash_get(session->usersByName, username, APR_HASH_KEY_STRING);
+        if(user) {
+            *record = user;
+            return parsegraph_OK;
+        }
+    }
+
+    apr_pool_t* pool = session->userMemoPool ? session->userMemoPool : session->pool;
+    ap_dbd_t* dbd = session->dbd;
+    const char* queryName = "parsegraph_user_loadUser";
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_loadUser)) {
+        marla_logMessagef(session->server, "%s query was not defined.", queryName);
+        return parsegraph_UNDEFINED_PREPARED_STATEMENT;
+    }
+    apr_dbd_results_t* res = NULL;
+    int dbrv = parsegraph_pvselect(session, pool, &res, parsegraph_Statement_user_loadUser, 0, username);
+    if(dbrv != 0) {
+        marla_logMessagef(session->server, "%s query failed to execute: [%s]", queryName,
             apr_dbd_error(dbd->driver, dbd->handle, dbrv)
         );
         return parsegraph_ERROR;
     }
-    return parsegraph_OK;
+    return readUserRecord(session, pool, res, record);
 }
 
-parsegraph_UserStatus parsegraph_getUser(
+parsegraph_UserStatus parsegraph_loadUserById(
     parsegraph_Session* session,
-    apr_dbd_results_t** res,
-    const char* username)
+    int userId,
+    parsegraph_UserRecord** record)
 {
-    apr_pool_t* pool = session->pool;
+    if(session->userMemoPool) {
+        parsegraph_UserRecord* user = apr_hash_get(session->usersById, &userId, sizeof(int));
+        if(user) {
+            *record = user;
+            return parsegraph_OK;
+        }
+    }
+
+    apr_pool_t* pool = session->userMemoPool ? session->userMemoPool : session->pool;
     ap_dbd_t* dbd = session->dbd;
-    // Get and run the query.
-    const char* queryName = "parsegraph_user_getUser";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
-         // Query was not defined.
-        marla_logMessagef(session->server,
-            "%s query was not defined.", queryName
-        );
+    const char* queryName = "parsegraph_user_loadUserById";
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_loadUserById)) {
+        marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_UNDEFINED_PREPARED_STATEMENT;
     }
-    int dbrv = apr_dbd_pvselect(
-        dbd->driver,
-        pool,
-        dbd->handle,
-        res,
-        query,
-        0,
-        username
-    );
-    if(0 != dbrv) {
-        marla_logMessagef(session->server,
-            "Failed to list users [%s]",
+    apr_dbd_results_t* res = NULL;
+    int dbrv = parsegraph_pvbselect(session, pool, &res, parsegraph_Statement_user_loadUserById, 0, &userId);
+    if(dbrv != 0) {
+        marla_logMessagef(session->server, "%s query failed to execute: [%s]", queryName,
             apr_dbd_error(dbd->driver, dbd->handle, dbrv)
         );
         return parsegraph_ERROR;
     }
-    return parsegraph_OK;
+    return readUserRecord(session, pool, res, record);
 }
 
 parsegraph_UserStatus parsegraph_getIdForUsername(
@@ -1230,44 +1995,13 @@ parsegraph_UserStatus parsegraph_getIdForUsername(
     const char* username,
     int* user_id)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
-    apr_dbd_results_t* res = NULL;
-    parsegraph_UserStatus rv = parsegraph_getUser(
-        session, &res, username
-    );
+    parsegraph_UserRecord* user;
+    parsegraph_UserStatus rv = parsegraph_loadUser(session, username, &user);
     if(parsegraph_OK != rv) {
         return rv;
     }
-
-    apr_dbd_row_t* row;
-    int dbrv = apr_dbd_get_row(
-        dbd->driver,
-        pool,
-        res,
-        &row,
-        -1
-    );
-    if(dbrv != 0) {
-        return parsegraph_USER_DOES_NOT_EXIST;
-    }
-
-    switch(apr_dbd_datum_get(
-        dbd->driver,
-        row,
-        0,
-        APR_DBD_TYPE_INT,
-        user_id
-    )) {
-    case APR_SUCCESS:
-        return parsegraph_OK;
-    case APR_ENOENT:
-    default:
-        marla_logMessagef(session->server,
-            "Failed to retrieve ID for username [%s]", username
-        );
-        return 500;
-    }
+    *user_id = user->id;
+    return parsegraph_OK;
 }
 
 parsegraph_UserStatus parsegraph_getUserProfile(
@@ -1275,38 +2009,13 @@ parsegraph_UserStatus parsegraph_getUserProfile(
     const char* username,
     const char** profile)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
-    apr_dbd_results_t* res = NULL;
-    parsegraph_UserStatus rv = parsegraph_getUser(session, &res, username);
+    parsegraph_UserRecord* user;
+    parsegraph_UserStatus rv = parsegraph_loadUser(session, username, &user);
     if(rv != parsegraph_OK) {
         // Failed to query for user.
         return rv;
     }
-
-    apr_dbd_row_t* row;
-    int dbrv = apr_dbd_get_row(
-        dbd->driver,
-        pool,
-        res,
-        &row,
-        -1
-    );
-    if(dbrv != 0) {
-        return parsegraph_USER_DOES_NOT_EXIST;
-    }
-
-    *profile = apr_dbd_get_entry(
-        dbd->driver,
-        row,
-        3
-    );
-    if(profile == 0) {
-        marla_logMessagef(session->server,
-            "Failed to retrieve profile for username."
-        );
-        return parsegraph_ERROR;
-    }
+    *profile = user->profile;
     return parsegraph_OK;
 }
 
@@ -1319,10 +2028,7 @@ parsegraph_UserStatus parsegraph_setUserProfile(
     ap_dbd_t* dbd = session->dbd;
     // Set the profile
     const char* queryName = "parsegraph_user_setUserProfile";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_setUserProfile)) {
         marla_logMessagef(session->server,
             "%s query was not defined.",
             queryName
@@ -1330,15 +2036,15 @@ parsegraph_UserStatus parsegraph_setUserProfile(
         return parsegraph_UNDEFINED_PREPARED_STATEMENT;
     }
     int nrows = 0;
-    int dbrv = apr_dbd_pvquery(
-        dbd->driver,
+    int dbrv = parsegraph_pvquery(
+        session,
         pool,
-        dbd->handle,
         &nrows,
-        query,
+        parsegraph_Statement_user_setUserProfile,
         profile,
         username
     );
+    parsegraph_Session_forgetUsers(session);
 
     // Confirm result.
     if(dbrv != 0) {
@@ -1370,10 +2076,7 @@ parsegraph_UserStatus parsegraph_grantSuperadmin(parsegraph_Session* session, co
     ap_dbd_t* dbd = session->dbd;
     // Set the profile
     const char* queryName = "parsegraph_user_grantSuperadmin";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_grantSuperadmin)) {
         marla_logMessagef(session->server,
             "%s query was not defined.",
             queryName
@@ -1381,14 +2084,14 @@ parsegraph_UserStatus parsegraph_grantSuperadmin(parsegraph_Session* session, co
         return parsegraph_UNDEFINED_PREPARED_STATEMENT;
     }
     int nrows = 0;
-    int dbrv = apr_dbd_pvquery(
-        dbd->driver,
+    int dbrv = parsegraph_pvquery(
+        session,
         pool,
-        dbd->handle,
         &nrows,
-        query,
+        parsegraph_Statement_user_grantSuperadmin,
         username
     );
+    parsegraph_Session_forgetUsers(session);
 
     // Confirm result.
     if(dbrv != 0) {
@@ -1416,59 +2119,13 @@ parsegraph_UserStatus parsegraph_grantSuperadmin(parsegraph_Session* session, co
 
 parsegraph_UserStatus parsegraph_hasSuperadmin(parsegraph_Session* session, const char* username, int* hasSuperadmin)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
-    // Set the profile
-    const char* queryName = "parsegraph_user_hasSuperadmin";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
-        marla_logMessagef(session->server,
-            "%s query was not defined.",
-            queryName
-        );
-        return parsegraph_UNDEFINED_PREPARED_STATEMENT;
-    }
-    apr_dbd_results_t* res = NULL;
-    int dbrv = apr_dbd_pvselect(
-        dbd->driver,
-        pool,
-        dbd->handle,
-        &res,
-        query,
-        0,
-        username
-    );
-    // Confirm result.
-    if(dbrv != 0) {
-        marla_logMessagef(session->server,
-            "Query failed to execute. [%s]",
-            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
-        );
-        return parsegraph_ERROR;
-    }
-
-    apr_dbd_row_t* row = NULL;
-    if(0 != apr_dbd_get_row(dbd->driver, pool, res, &row, -1)) {
-        *hasSuperadmin= 0;
-        return parsegraph_USER_DOES_NOT_EXIST;
-    }
-
-    switch(apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, hasSuperadmin)) {
-    case APR_SUCCESS:
-        break;
-    case APR_ENOENT:
+    parsegraph_UserRecord* user;
+    parsegraph_UserStatus rv = parsegraph_loadUser(session, username, &user);
+    if(rv != parsegraph_OK) {
         *hasSuperadmin = 0;
-        break;
-    case APR_EGENERAL:
-        marla_logMessagef(session->server,
-            "Query failed to execute. [%s]",
-            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
-        );
-        return parsegraph_ERROR;
+        return rv;
     }
-
+    *hasSuperadmin = user->isSuperAdmin;
     return parsegraph_OK;
 }
 
@@ -1478,10 +2135,7 @@ parsegraph_UserStatus parsegraph_revokeSuperadmin(parsegraph_Session* session, c
     ap_dbd_t* dbd = session->dbd;
     // Set the profile
     const char* queryName = "parsegraph_user_revokeSuperadmin";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_revokeSuperadmin)) {
         marla_logMessagef(session->server,
             "%s query was not defined.",
             queryName
@@ -1489,14 +2143,14 @@ parsegraph_UserStatus parsegraph_revokeSuperadmin(parsegraph_Session* session, c
         return parsegraph_UNDEFINED_PREPARED_STATEMENT;
     }
     int nrows = 0;
-    int dbrv = apr_dbd_pvquery(
-        dbd->driver,
+    int dbrv = parsegraph_pvquery(
+        session,
         pool,
-        dbd->handle,
         &nrows,
-        query,
+        parsegraph_Statement_user_revokeSuperadmin,
         username
     );
+    parsegraph_Session_forgetUsers(session);
 
     // Confirm result.
     if(dbrv != 0) {
@@ -1528,10 +2182,7 @@ parsegraph_UserStatus parsegraph_banUser(parsegraph_Session* session, const char
     ap_dbd_t* dbd = session->dbd;
     // Set the profile
     const char* queryName = "parsegraph_user_banUser";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_banUser)) {
         marla_logMessagef(session->server,
             "%s query was not defined.",
             queryName
@@ -1539,14 +2190,14 @@ parsegraph_UserStatus parsegraph_banUser(parsegraph_Session* session, const char
         return parsegraph_UNDEFINED_PREPARED_STATEMENT;
     }
     int nrows = 0;
-    int dbrv = apr_dbd_pvquery(
-        dbd->driver,
+    int dbrv = parsegraph_pvquery(
+        session,
         pool,
-        dbd->handle,
         &nrows,
-        query,
+        parsegraph_Statement_user_banUser,
         username
     );
+    parsegraph_Session_forgetUsers(session);
 
     // Confirm result.
     if(dbrv != 0) {
@@ -1570,59 +2221,13 @@ parsegraph_UserStatus parsegraph_banUser(parsegraph_Session* session, const char
 
 parsegraph_UserStatus parsegraph_isBanned(parsegraph_Session* session, const char* username, int* isBanned)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
-    // Set the profile
-    const char* queryName = "parsegraph_user_isBanned";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
-        marla_logMessagef(session->server,
-            "%s query was not defined.",
-            queryName
-        );
-        return parsegraph_UNDEFINED_PREPARED_STATEMENT;
-    }
-    apr_dbd_results_t* res = NULL;
-    int dbrv = apr_dbd_pvselect(
-        dbd->driver,
-        pool,
-        dbd->handle,
-        &res,
-        query,
-        0,
-        username
-    );
-    // Confirm result.
-    if(dbrv != 0) {
-        marla_logMessagef(session->server,
-            "Query failed to execute. [%s]",
-            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
-        );
-        return parsegraph_ERROR;
-    }
-
-    apr_dbd_row_t* row = NULL;
-    if(0 != apr_dbd_get_row(dbd->driver, pool, res, &row, -1)) {
-        *isBanned = 0;
-        return parsegraph_USER_DOES_NOT_EXIST;
-    }
-
-    switch(apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, isBanned)) {
-    case APR_SUCCESS:
-        break;
-    case APR_ENOENT:
+    parsegraph_UserRecord* user;
+    parsegraph_UserStatus rv = parsegraph_loadUser(session, username, &user);
+    if(rv != parsegraph_OK) {
         *isBanned = 0;
-        break;
-    case APR_EGENERAL:
-        marla_logMessagef(session->server,
-            "Query failed to execute. [%s]",
-            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
-        );
-        return parsegraph_ERROR;
+        return rv;
     }
-
+    *isBanned = user->isBanned;
     return parsegraph_OK;
 }
 
@@ -1632,10 +2237,7 @@ parsegraph_UserStatus parsegraph_unbanUser(parsegraph_Session* session, const ch
     ap_dbd_t* dbd = session->dbd;
     // Set the profile
     const char* queryName = "parsegraph_user_unbanUser";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_unbanUser)) {
         marla_logMessagef(session->server,
             "%s query was not defined.",
             queryName
@@ -1643,14 +2245,14 @@ parsegraph_UserStatus parsegraph_unbanUser(parsegraph_Session* session, const ch
         return parsegraph_UNDEFINED_PREPARED_STATEMENT;
     }
     int nrows = 0;
-    int dbrv = apr_dbd_pvquery(
-        dbd->driver,
+    int dbrv = parsegraph_pvquery(
+        session,
         pool,
-        dbd->handle,
         &nrows,
-        query,
+        parsegraph_Statement_user_unbanUser,
         username
     );
+    parsegraph_Session_forgetUsers(session);
 
     // Confirm result.
     if(dbrv != 0) {
@@ -1682,10 +2284,7 @@ parsegraph_UserStatus parsegraph_allowSubscription(parsegraph_Session* session,
     ap_dbd_t* dbd = session->dbd;
     // Set the profile
     const char* queryName = "parsegraph_user_allowSubscription";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_allowSubscription)) {
         marla_logMessagef(session->server,
             "%s query was not defined.",
             queryName
@@ -1693,14 +2292,14 @@ parsegraph_UserStatus parsegraph_allowSubscription(parsegraph_Session* session,
         return parsegraph_UNDEFINED_PREPARED_STATEMENT;
     }
     int nrows = 0;
-    int dbrv = apr_dbd_pvquery(
-        dbd->driver,
+    int dbrv = parsegraph_pvquery(
+        session,
         pool,
-        dbd->handle,
         &nrows,
-        query,
+        parsegraph_Statement_user_allowSubscription,
         username
     );
+    parsegraph_Session_forgetUsers(session);
 
     // Confirm result.
     if(dbrv != 0) {
@@ -1728,59 +2327,13 @@ parsegraph_UserStatus parsegraph_allowSubscription(parsegraph_Session* session,
 
 parsegraph_UserStatus parsegraph_allowsSubscription(parsegraph_Session* session, const char* username, int* allowsSubscription)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
-    // Set the profile
-    const char* queryName = "parsegraph_user_allowsSubscription";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
-        marla_logMessagef(session->server,
-            "%s query was not defined.",
-            queryName
-        );
-        return parsegraph_UNDEFINED_PREPARED_STATEMENT;
-    }
-    apr_dbd_results_t* res = NULL;
-    int dbrv = apr_dbd_pvselect(
-        dbd->driver,
-        pool,
-        dbd->handle,
-        &res,
-        query,
-        0,
-        username
-    );
-    // Confirm result.
-    if(dbrv != 0) {
-        marla_logMessagef(session->server,
-            "Query failed to execute. [%s]",
-            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
-        );
-        return parsegraph_ERROR;
-    }
-
-    apr_dbd_row_t* row = NULL;
-    if(0 != apr_dbd_get_row(dbd->driver, pool, res, &row, -1)) {
-        *allowsSubscription = 0;
-        return parsegraph_USER_DOES_NOT_EXIST;
-    }
-
-    switch(apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, allowsSubscription)) {
-    case APR_SUCCESS:
-        break;
-    case APR_ENOENT:
+    parsegraph_UserRecord* user;
+    parsegraph_UserStatus rv = parsegraph_loadUser(session, username, &user);
+    if(rv != parsegraph_OK) {
         *allowsSubscription = 0;
-        break;
-    case APR_EGENERAL:
-        marla_logMessagef(session->server,
-            "Query failed to execute. [%s]",
-            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
-        );
-        return parsegraph_ERROR;
+        return rv;
     }
-
+    *allowsSubscription = user->allowsSubscription;
     return parsegraph_OK;
 }
 
@@ -1789,10 +2342,7 @@ parsegraph_UserStatus parsegraph_disallowSubscription(parsegraph_Session* sessio
     apr_pool_t* pool = session->pool;
     ap_dbd_t* dbd = session->dbd;
     const char* queryName = "parsegraph_user_disallowSubscription";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_user_disallowSubscription)) {
         marla_logMessagef(session->server,
             "%s query was not defined.",
             queryName
@@ -1800,14 +2350,14 @@ parsegraph_UserStatus parsegraph_disallowSubscription(parsegraph_Session* sessio
         return parsegraph_UNDEFINED_PREPARED_STATEMENT;
     }
     int nrows = 0;
-    int dbrv = apr_dbd_pvquery(
-        dbd->driver,
+    int dbrv = parsegraph_pvquery(
+        session,
         pool,
-        dbd->handle,
         &nrows,
-        query,
+        parsegraph_Statement_user_disallowSubscription,
         username
     );
+    parsegraph_Session_forgetUsers(session);
 
     // Confirm result.
     if(dbrv != 0) {
@@ -1833,6 +2383,39 @@ parsegraph_UserStatus parsegraph_disallowSubscription(parsegraph_Session* sessio
     return parsegraph_OK;
 }
 
+static int runTransactionControl(parsegraph_Session* session, const char* sql)
+{
+    ap_dbd_t* dbd = session->dbd;
+    int nrows = 0;
+    int dbrv = apr_dbd_query(dbd->driver, dbd->handle, &nrows, sql);
+    if(dbrv != 0) {
+        marla_logMessagef(session->server,
+            "Failed to run %s. [%s]", sql,
+            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
+        );
+    }
+    return dbrv;
+}
+
+// SQLite opens a transaction for the outermost savepoint; PostgreSQL needs
+// an explicit block around them.
+static int beginOutermostTransaction(parsegraph_Session* session)
+{
+    if(session->dialect != parsegraph_Dialect_PGSQL || session->transactionDepth > 0) {
+        return 0;
+    }
+    return runTransactionControl(session, "BEGIN");
+}
+
+// Ends the block if depth, the savepoint depth being left, is the outermost.
+static int endOutermostTransaction(parsegraph_Session* session, int depth)
+{
+    if(session->dialect != parsegraph_Dialect_PGSQL || depth > 1) {
+        return 0;
+    }
+    return runTransactionControl(session, "COMMIT");
+}
+
 parsegraph_UserStatus parsegraph_beginTransaction(parsegraph_Session* session, const char* transactionName)
 {
     ap_dbd_t* dbd = session->dbd;
@@ -1841,7 +2424,12 @@ parsegraph_UserStatus parsegraph_beginTransaction(parsegraph_Session* session, c
     //);
     int nrows = 0;
     char buf[1024];
-    if(0 > snprintf(buf, sizeof(buf), "SAVEPOINT '%s'", transactionName)) {
+    if(0 > snprintf(buf, sizeof(buf), "SAVEPOINT \"%s\"", transactionName)) {
+        return parsegraph_ERROR;
+    }
+
+    // PostgreSQL only allows savepoints within a transaction block.
+    if(0 != beginOutermostTransaction(session)) {
         return parsegraph_ERROR;
     }
     int dbrv = apr_dbd_query(
@@ -1854,6 +2442,9 @@ parsegraph_UserStatus parsegraph_beginTransaction(parsegraph_Session* session, c
             "Failed to create savepoint for transaction. [%s]",
             apr_dbd_error(dbd->driver, dbd->handle, dbrv)
         );
+        if(session->dialect == parsegraph_Dialect_PGSQL && session->transactionDepth == 0) {
+            runTransactionControl(session, "ROLLBACK");
+        }
         return parsegraph_ERROR;
     }
 
@@ -1870,6 +2461,7 @@ parsegraph_UserStatus parsegraph_beginTransaction(parsegraph_Session* session, c
             "Encountered database error while inserting transaction named %s into the log. Internal database error %d: %s", transactionName, dbrv, apr_dbd_error(dbd->driver, dbd->handle, dbrv));
         return parsegraph_ERROR;
     }
+    parsegraph_Session_enterTransaction(session);
     return parsegraph_OK;
 }
 
@@ -1901,7 +2493,7 @@ parsegraph_UserStatus parsegraph_commitTransaction(parsegraph_Session* session,
         return parsegraph_ERROR;
     }
 
-    if(0 > snprintf(buf, sizeof(buf), "RELEASE '%s'", transactionName)) {
+    if(0 > snprintf(buf, sizeof(buf), "RELEASE \"%s\"", transactionName)) {
         return parsegraph_ERROR;
     }
     dbrv = apr_dbd_query(
@@ -1918,6 +2510,14 @@ parsegraph_UserStatus parsegraph_commitTransaction(parsegraph_Session* session,
         return parsegraph_ERROR;
     }
 
+    // Deliver queued notifications only once the outermost transaction has
+    // committed, and drop them if it could not be.
+    if(0 != endOutermostTransaction(session, session->transactionDepth)) {
+        parsegraph_Session_leaveTransaction(session, 0);
+        return parsegraph_ERROR;
+    }
+    parsegraph_Session_leaveTransaction(session, 1);
+
     return parsegraph_OK;
 }
 
@@ -1927,9 +2527,15 @@ parsegraph_UserStatus parsegraph_rollbackTransaction(parsegraph_Session* session
     //marla_logMessagef(session->server,
         //"Rolling back transaction %s", transactionName
     //);
+
+    // Notifications raised within this savepoint are dropped even if the
+    // rollback itself fails.
+    int depth = session->transactionDepth;
+    parsegraph_Session_leaveTransaction(session, 0);
+
     int nrows = 0;
     char buf[1024];
-    if(0 > snprintf(buf, sizeof(buf), "ROLLBACK TO '%s'", transactionName)) {
+    if(0 > snprintf(buf, sizeof(buf), "ROLLBACK TO \"%s\"", transactionName)) {
         marla_logMessagef(session->server,
             "Failed to roll back transaction %s!", transactionName
         );
@@ -1950,7 +2556,7 @@ parsegraph_UserStatus parsegraph_rollbackTransaction(parsegraph_Session* session
         return parsegraph_ERROR;
     }
 
-    if(0 > snprintf(buf, sizeof(buf), "RELEASE '%s'", transactionName)) {
+    if(0 > snprintf(buf, sizeof(buf), "RELEASE \"%s\"", transactionName)) {
         return -1;
     }
     dbrv = apr_dbd_query(
@@ -1982,6 +2588,10 @@ parsegraph_UserStatus parsegraph_rollbackTransaction(parsegraph_Session* session
         return parsegraph_ERROR;
     }
 
+    if(0 != endOutermostTransaction(session, depth)) {
+        return parsegraph_ERROR;
+    }
+
     //marla_logMessagef(session->server,
         //"Rolled back transaction %s.", transactionName
     //);
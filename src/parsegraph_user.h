@@ -20,7 +20,8 @@ enum parsegraph_UserStatus {
     parsegraph_USER_DOES_NOT_EXIST,
     parsegraph_USER_ALREADY_EXISTS,
     parsegraph_INVALID_PASSWORD,
-    parsegraph_UNDEFINED_PREPARED_STATEMENT
+    parsegraph_UNDEFINED_PREPARED_STATEMENT,
+    parsegraph_RATE_LIMITED
 };
 typedef enum parsegraph_UserStatus parsegraph_UserStatus;
 
@@ -49,9 +50,19 @@ extern const int parsegraph_PASSWORD_MAX_LENGTH;
  */
 extern const int parsegraph_PASSWORD_SALT_LENGTH;
 
+/**
+ * The default number of PBKDF2 iterations of new password hashes.
+ */
+extern const int parsegraph_PASSWORD_ITERATIONS;
+
 extern const int parsegraph_SELECTOR_LENGTH;
 extern const int parsegraph_TOKEN_LENGTH;
 
+/**
+ * The most users listed in one page by parsegraph_listUsersAfter.
+ */
+extern const int parsegraph_USER_PAGE_MAX_SIZE;
+
 const char* parsegraph_constructSessionString(parsegraph_Session* session, const char* session_selector, const char* session_token);
 parsegraph_UserStatus parsegraph_deconstructSessionString(parsegraph_Session* session, const char* sessionValue, const char** session_selector, const char** session_token);
 
@@ -128,12 +139,65 @@ parsegraph_UserStatus parsegraph_beginUserLogin(
     struct parsegraph_user_login** createdLogin
 );
 
+/**
+ * Ends every login of the given user. If the session has signed logins,
+ * also revokes the user's signed logins.
+ */
 parsegraph_UserStatus parsegraph_endUserLogin(
     parsegraph_Session* session,
     const char* username,
     int* logins_ended
 );
 
+/**
+ * Begins a login for the given user, using the given password, that needs
+ * no login row. The sessionValue is signed by the session's signer and
+ * allocated from its pool. Ending the user's logins revokes it.
+ */
+parsegraph_UserStatus parsegraph_beginSignedUserLogin(
+    parsegraph_Session* session,
+    const char* username,
+    const char* password,
+    const char** sessionValue
+);
+
+/**
+ * Deletes logins unused for longer than the session's login expiry, in
+ * statements of at most batchSize rows that each commit alone, and stops
+ * after maxBatches of them unless maxBatches is 0. Also prunes login
+ * revocations older than the lifetime of the session's signed logins, or
+ * its revocation lifetime if it has no signer. Must not be called within a
+ * transaction.
+ */
+parsegraph_UserStatus parsegraph_sweepExpiredLogins(
+    parsegraph_Session* session,
+    int batchSize,
+    int maxBatches,
+    int* logins_swept
+);
+
+/**
+ * Deletes login revocations made longer than lifetime ago, which every
+ * signed login issued before them has outlived if lifetime is at least
+ * their lifetime.
+ */
+parsegraph_UserStatus parsegraph_pruneLoginRevocations(
+    parsegraph_Session* session,
+    apr_interval_time_t lifetime,
+    int* pruned
+);
+
+/**
+ * Returns the given user's login generation, which signed logins carry to
+ * detect their revocation. It is 0 until the user's logins are ended, and
+ * then increases each time they are.
+ */
+parsegraph_UserStatus parsegraph_getLoginGeneration(
+    parsegraph_Session* session,
+    int userId,
+    int* generation
+);
+
 /**
  * Given the created login, validate and refresh its entry in the database.
  *
@@ -147,13 +211,64 @@ parsegraph_UserStatus parsegraph_refreshUserLogin(
 
 /**
  * Returns res, allocated from the given pool, the list of all users in the
- * given database.
+ * given database. Listings of many users should use parsegraph_listUsersAfter
+ * or a parsegraph_UserIterator instead.
  */
 parsegraph_UserStatus parsegraph_listUsers(
     parsegraph_Session* session,
     apr_dbd_results_t** res
 );
 
+struct parsegraph_UserSummary {
+    int id;
+    const char* username;
+};
+typedef struct parsegraph_UserSummary parsegraph_UserSummary;
+
+/**
+ * Lists up to limit users with ids greater than afterId, in id order, as an
+ * array of parsegraph_UserSummary allocated from pool. Listing after 0
+ * starts from the first user, and listing after the last id of a page
+ * continues from there, so each page costs the same however deep it is.
+ * Limits above parsegraph_USER_PAGE_MAX_SIZE list that many, and limits
+ * below 1 are an error.
+ */
+parsegraph_UserStatus parsegraph_listUsersAfter(
+    parsegraph_Session* session,
+    apr_pool_t* pool,
+    int afterId,
+    int limit,
+    apr_array_header_t** users
+);
+
+/**
+ * Reads every user in id order, a page at a time, so that memory stays
+ * constant however many users there are. Iterators are owned by the caller.
+ * Users added or removed while iterating may or may not be seen.
+ */
+struct parsegraph_UserIterator {
+    parsegraph_Session* session;
+
+    // Holds the current page, and is cleared before the next is read.
+    apr_pool_t* pool;
+    int pageSize;
+    int lastId;
+    apr_array_header_t* page;
+    int index;
+};
+typedef struct parsegraph_UserIterator parsegraph_UserIterator;
+
+// Page sizes above parsegraph_USER_PAGE_MAX_SIZE read pages of that size.
+parsegraph_UserStatus parsegraph_UserIterator_open(parsegraph_UserIterator* iter, parsegraph_Session* session, int pageSize);
+
+/**
+ * Sets user to the next user, or NULL once all have been read. The user is
+ * valid until the page after it is read.
+ */
+parsegraph_UserStatus parsegraph_UserIterator_next(parsegraph_UserIterator* iter, parsegraph_UserSummary** user);
+
+void parsegraph_UserIterator_close(parsegraph_UserIterator* iter);
+
 /**
  * Returns whether the named user is in the given database.
  */
@@ -163,6 +278,38 @@ parsegraph_UserStatus parsegraph_getUser(
     const char* username
 );
 
+struct parsegraph_UserRecord {
+    int id;
+    const char* username;
+    const char* passwordHash;
+    const char* passwordSalt;
+    const char* profile;
+    int isSuperAdmin;
+    int isBanned;
+    int allowsSubscription;
+
+    // The user's storage and disposed item lists, or -1 if not yet made.
+    int storageListId;
+    int disposedListId;
+};
+typedef struct parsegraph_UserRecord parsegraph_UserRecord;
+
+/**
+ * Loads the named user's row in one query. Returns parsegraph_OK with the
+ * record, or parsegraph_USER_DOES_NOT_EXIST. While the session memoizes
+ * users, the record is shared with later loads and must not be changed.
+ */
+parsegraph_UserStatus parsegraph_loadUser(
+    parsegraph_Session* session,
+    const char* username,
+    parsegraph_UserRecord** record);
+
+// Loads the user with the given id, as parsegraph_loadUser.
+parsegraph_UserStatus parsegraph_loadUserById(
+    parsegraph_Session* session,
+    int userId,
+    parsegraph_UserRecord** record);
+
 parsegraph_UserStatus parsegraph_getIdForUsername(
     parsegraph_Session* session,
     const char* username,
@@ -173,7 +320,20 @@ parsegraph_UserStatus parsegraph_setUserProfile(parsegraph_Session* session, con
 parsegraph_UserStatus parsegraph_validateUsername(parsegraph_Session* session, const char* username, size_t* username_size);
 parsegraph_UserStatus parsegraph_validatePassword(parsegraph_Session* session, const char* password, size_t* password_size);
 parsegraph_UserStatus parsegraph_createPasswordSalt(parsegraph_Session* session, size_t salt_len, char** password_salt_encoded);
+
+/**
+ * Hashes the password with PBKDF2-HMAC-SHA256 and the session's number of
+ * iterations, as "$pbkdf2-sha256$<iterations>$<base64 hash>".
+ */
 parsegraph_UserStatus parsegraph_encryptPassword(parsegraph_Session* session, const char* password, size_t password_size, char** password_hash_encoded, const char* password_salt_encoded, size_t password_salt_size);
+
+/**
+ * Checks the password against a stored hash in the current format or the
+ * older unprefixed SHA-256 format. Returns parsegraph_OK if it matches, and
+ * sets needsRehash if the stored hash is not in the current format and
+ * strength. Returns parsegraph_INVALID_PASSWORD if it does not match.
+ */
+parsegraph_UserStatus parsegraph_verifyPassword(parsegraph_Session* session, const char* password, size_t password_size, const char* password_hash_encoded, const char* password_salt_encoded, int* needsRehash);
 parsegraph_UserStatus parsegraph_generateLogin(parsegraph_Session* session, const char* username, struct parsegraph_user_login** createdLogin);
 parsegraph_UserStatus parsegraph_changeUserPassword(
     parsegraph_Session* session,
@@ -0,0 +1,327 @@
+#include "parsegraph_Profile.h"
+#include <apr_strings.h>
+#include <apr_file_io.h>
+#include <apr_lib.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char* JOURNAL_MODES[] = { "DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF", 0 };
+static const char* SYNCHRONOUS_MODES[] = { "OFF", "NORMAL", "FULL", "EXTRA", 0 };
+static const char* TEMP_STORES[] = { "DEFAULT", "FILE", "MEMORY", 0 };
+
+static const struct {
+    const char* key;
+    const char* variable;
+} PROFILE_VARIABLES[] = {
+    { "journal_mode", "PARSEGRAPH_JOURNAL_MODE" },
+    { "synchronous", "PARSEGRAPH_SYNCHRONOUS" },
+    { "cache_size", "PARSEGRAPH_CACHE_SIZE" },
+    { "mmap_size", "PARSEGRAPH_MMAP_SIZE" },
+    { "temp_store", "PARSEGRAPH_TEMP_STORE" },
+    { "busy_timeout", "PARSEGRAPH_BUSY_TIMEOUT" },
+    { "auth_database", "PARSEGRAPH_AUTH_DATABASE" },
+    { 0, 0 }
+};
+
+// The profile configured by the environment, read once per process and
+// again on each reload.
+static pthread_mutex_t configuredLock = PTHREAD_MUTEX_INITIALIZER;
+static apr_pool_t* configuredPool = 0;
+static parsegraph_Profile configuredProfile;
+static int configuredStatus = APR_SUCCESS;
+
+// Counts loads of the configured profile, so a connection can tell whether
+// it has the current one. Zero until the first load.
+static apr_uint32_t configuredGeneration = 0;
+
+// Used on a connection's pool to record the generation applied to it.
+static const char* APPLIED_KEY = "parsegraph_Profile_applied";
+
+void parsegraph_Profile_init(parsegraph_Profile* profile)
+{
+    memset(profile, 0, sizeof(*profile));
+}
+
+void parsegraph_Profile_tuned(parsegraph_Profile* profile)
+{
+    profile->journalMode = "WAL";
+    profile->synchronous = "NORMAL";
+    profile->tempStore = "MEMORY";
+    profile->hasCacheSize = 1;
+    profile->cacheSize = -65536;
+    profile->hasMmapSize = 1;
+    profile->mmapSize = 268435456;
+    profile->hasBusyTimeout = 1;
+    profile->busyTimeout = 5000;
+}
+
+// Returns the canonical spelling of value if it names one of the choices.
+static const char* findChoice(const char** choices, const char* value)
+{
+    for(int i = 0; choices[i]; ++i) {
+        if(!strcasecmp(choices[i], value)) {
+            return choices[i];
+        }
+    }
+    return 0;
+}
+
+static int parseInteger(const char* value, apr_int64_t* out)
+{
+    char* end;
+    apr_int64_t n = apr_strtoi64(value, &end, 10);
+    if(end == value || *end != 0) {
+        return APR_EINVAL;
+    }
+    *out = n;
+    return APR_SUCCESS;
+}
+
+int parsegraph_Profile_set(parsegraph_Profile* profile, const char* key, const char* value)
+{
+    apr_int64_t n;
+    if(!strcmp(key, "journal_mode")) {
+        profile->journalMode = findChoice(JOURNAL_MODES, value);
+        return profile->journalMode ? APR_SUCCESS : APR_EINVAL;
+    }
+    if(!strcmp(key, "synchronous")) {
+        profile->synchronous = findChoice(SYNCHRONOUS_MODES, value);
+        return profile->synchronous ? APR_SUCCESS : APR_EINVAL;
+    }
+    if(!strcmp(key, "temp_store")) {
+        profile->tempStore = findChoice(TEMP_STORES, value);
+        return profile->tempStore ? APR_SUCCESS : APR_EINVAL;
+    }
+    if(!strcmp(key, "cache_size")) {
+        if(parseInteger(value, &n) || n < -2147483647 || n > 2147483647) {
+            return APR_EINVAL;
+        }
+        profile->hasCacheSize = 1;
+        profile->cacheSize = (int)n;
+        return APR_SUCCESS;
+    }
+    if(!strcmp(key, "mmap_size")) {
+        if(parseInteger(value, &n) || n < 0) {
+            return APR_EINVAL;
+        }
+        profile->hasMmapSize = 1;
+        profile->mmapSize = n;
+        return APR_SUCCESS;
+    }
+    if(!strcmp(key, "busy_timeout")) {
+        if(parseInteger(value, &n) || n < 0 || n > 2147483647) {
+            return APR_EINVAL;
+        }
+        profile->hasBusyTimeout = 1;
+        profile->busyTimeout = (int)n;
+        return APR_SUCCESS;
+    }
+    if(!strcmp(key, "auth_database")) {
+        if(!*value) {
+            return APR_EINVAL;
+        }
+        profile->authDatabase = value;
+        return APR_SUCCESS;
+    }
+    return APR_EINVAL;
+}
+
+static char* trim(char* s)
+{
+    while(apr_isspace(*s)) {
+        ++s;
+    }
+    char* end = s + strlen(s);
+    while(end > s && apr_isspace(end[-1])) {
+        --end;
+    }
+    *end = 0;
+    return s;
+}
+
+int parsegraph_Profile_load(parsegraph_Profile* profile, apr_pool_t* pool, const char* path)
+{
+    apr_file_t* file;
+    int rv = apr_file_open(&file, path, APR_FOPEN_READ | APR_FOPEN_BUFFERED, APR_OS_DEFAULT, pool);
+    if(rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    char line[256];
+    while(APR_SUCCESS == apr_file_gets(line, sizeof(line), file)) {
+        char* comment = strchr(line, '#');
+        if(comment) {
+            *comment = 0;
+        }
+        char* key = trim(line);
+        if(!*key) {
+            continue;
+        }
+        char* value = strchr(key, '=');
+        if(!value) {
+            rv = APR_EINVAL;
+            break;
+        }
+        *value++ = 0;
+        rv = parsegraph_Profile_set(profile, trim(key), apr_pstrdup(pool, trim(value)));
+        if(rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    apr_file_close(file);
+    return rv;
+}
+
+int parsegraph_Profile_loadEnvironment(parsegraph_Profile* profile, apr_pool_t* pool)
+{
+    const char* path = getenv("PARSEGRAPH_PROFILE");
+    if(path && *path) {
+        int rv = parsegraph_Profile_load(profile, pool, path);
+        if(rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    for(int i = 0; PROFILE_VARIABLES[i].key; ++i) {
+        const char* value = getenv(PROFILE_VARIABLES[i].variable);
+        if(!value || !*value) {
+            continue;
+        }
+        int rv = parsegraph_Profile_set(profile, PROFILE_VARIABLES[i].key, value);
+        if(rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    return APR_SUCCESS;
+}
+
+static int runPragma(parsegraph_Session* session, const char* pragma)
+{
+    ap_dbd_t* dbd = session->dbd;
+
+    // Some pragmas report their new value as a row, so run them as selects.
+    apr_dbd_results_t* res = 0;
+    int rv = apr_dbd_select(dbd->driver, session->pool, dbd->handle, &res, pragma, 0);
+    if(rv != 0) {
+        marla_logMessagef(session->server, "Failed to apply %s: %s", pragma,
+            apr_dbd_error(dbd->driver, dbd->handle, rv)
+        );
+        return rv;
+    }
+    apr_dbd_row_t* row;
+    while(-1 != apr_dbd_get_row(dbd->driver, session->pool, res, &row, -1));
+    return 0;
+}
+
+// Runs a pragma that takes a schema on the main database and on the attached
+// auth database, if any.
+static int runSchemaPragma(parsegraph_Session* session, const char* pragma)
+{
+    int rv = runPragma(session, apr_pstrcat(session->pool, "PRAGMA main.", pragma, NULL));
+    if(rv == 0 && session->authSchema) {
+        rv = runPragma(session, apr_pstrcat(session->pool, "PRAGMA ", session->authSchema, ".", pragma, NULL));
+    }
+    return rv;
+}
+
+int parsegraph_Profile_apply(parsegraph_Session* session, parsegraph_Profile* profile)
+{
+    ap_dbd_t* dbd = session->dbd;
+    if(strcmp(apr_dbd_name(dbd->driver), "sqlite3")) {
+        return APR_SUCCESS;
+    }
+
+    apr_pool_t* pool = session->pool;
+    int rv = APR_SUCCESS;
+
+    // The busy timeout goes first so that switching the journal mode waits
+    // for other connections.
+    if(profile->hasBusyTimeout && !rv) {
+        rv = runPragma(session, apr_psprintf(pool, "PRAGMA busy_timeout = %d", profile->busyTimeout));
+    }
+    if(profile->authDatabase && !rv) {
+        rv = parsegraph_Session_attachAuthDatabase(session, profile->authDatabase);
+    }
+    if(profile->journalMode && !rv) {
+        rv = runSchemaPragma(session, apr_pstrcat(pool, "journal_mode = ", profile->journalMode, NULL));
+    }
+    if(profile->synchronous && !rv) {
+        rv = runSchemaPragma(session, apr_pstrcat(pool, "synchronous = ", profile->synchronous, NULL));
+    }
+    if(profile->hasCacheSize && !rv) {
+        rv = runSchemaPragma(session, apr_psprintf(pool, "cache_size = %d", profile->cacheSize));
+    }
+    if(profile->hasMmapSize && !rv) {
+        rv = runSchemaPragma(session, apr_psprintf(pool, "mmap_size = %" APR_INT64_T_FMT, profile->mmapSize));
+    }
+    if(profile->tempStore && !rv) {
+        rv = runPragma(session, apr_pstrcat(pool, "PRAGMA temp_store = ", profile->tempStore, NULL));
+    }
+    return rv;
+}
+
+// Reads the configured profile from the environment. The caller holds configuredLock.
+static int loadConfigured(void)
+{
+    apr_pool_t* pool;
+    int rv = apr_pool_create_unmanaged(&pool);
+    if(rv != APR_SUCCESS) {
+        return rv;
+    }
+    parsegraph_Profile profile;
+    parsegraph_Profile_init(&profile);
+    rv = parsegraph_Profile_loadEnvironment(&profile, pool);
+    if(configuredPool) {
+        apr_pool_destroy(configuredPool);
+    }
+    configuredPool = pool;
+    configuredProfile = profile;
+    configuredStatus = rv;
+    ++configuredGeneration;
+    return rv;
+}
+
+int parsegraph_Profile_reloadEnvironment(void)
+{
+    pthread_mutex_lock(&configuredLock);
+    int rv = loadConfigured();
+    pthread_mutex_unlock(&configuredLock);
+    return rv;
+}
+
+int parsegraph_Profile_applyConfigured(parsegraph_Session* session)
+{
+    pthread_mutex_lock(&configuredLock);
+    int rv = configuredGeneration == 0 ? loadConfigured() : configuredStatus;
+    parsegraph_Profile profile = configuredProfile;
+    apr_uint32_t generation = configuredGeneration;
+    pthread_mutex_unlock(&configuredLock);
+    if(rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    ap_dbd_t* dbd = session->dbd;
+    apr_uint32_t* applied = 0;
+    if(dbd->pool) {
+        apr_pool_userdata_get((void**)&applied, APPLIED_KEY, dbd->pool);
+    }
+    if(applied && *applied == generation) {
+        // An earlier session on this connection applied it, and attached
+        // the auth database if there is one.
+        if(profile.authDatabase && !strcmp(apr_dbd_name(dbd->driver), "sqlite3")) {
+            session->authSchema = "auth";
+        }
+        return APR_SUCCESS;
+    }
+
+    rv = parsegraph_Profile_apply(session, &profile);
+    if(rv == APR_SUCCESS && dbd->pool) {
+        if(!applied) {
+            applied = apr_palloc(dbd->pool, sizeof(*applied));
+            apr_pool_userdata_setn(applied, APPLIED_KEY, 0, dbd->pool);
+        }
+        *applied = generation;
+    }
+    return rv;
+}
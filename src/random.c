@@ -0,0 +1,69 @@
+#include "parsegraph_Random.h"
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
+#include <pthread.h>
+#include <string.h>
+
+#define parsegraph_RANDOM_BUFFER_SIZE 4096
+
+struct parsegraph_RandomBuffer {
+    unsigned char bytes[parsegraph_RANDOM_BUFFER_SIZE];
+
+    // Offset of the first unused byte.
+    apr_size_t next;
+
+    // The fork generation the buffer was filled in, or 0 if it was never filled.
+    unsigned int generation;
+};
+
+static _Thread_local struct parsegraph_RandomBuffer parsegraph_randomBuffer;
+
+// Counts forks, so a child can tell its buffer was inherited without asking
+// for its pid on every draw. Only written by a child before it has threads.
+static unsigned int parsegraph_forkGeneration = 1;
+static pthread_once_t parsegraph_forkHandlerOnce = PTHREAD_ONCE_INIT;
+
+static void countFork(void)
+{
+    ++parsegraph_forkGeneration;
+}
+
+static void registerForkHandler(void)
+{
+    pthread_atfork(0, 0, countFork);
+}
+
+apr_status_t parsegraph_randomBytes(void* buf, apr_size_t len)
+{
+    pthread_once(&parsegraph_forkHandlerOnce, registerForkHandler);
+    struct parsegraph_RandomBuffer* buffer = &parsegraph_randomBuffer;
+    if(buffer->generation != parsegraph_forkGeneration) {
+        // Never filled, or filled by the parent of a forked process.
+        OPENSSL_cleanse(buffer->bytes, sizeof buffer->bytes);
+        buffer->next = sizeof buffer->bytes;
+        buffer->generation = parsegraph_forkGeneration;
+    }
+
+    // Requests larger than the buffer go straight to the generator.
+    if(len >= sizeof buffer->bytes) {
+        return RAND_bytes(buf, (int)len) == 1 ? APR_SUCCESS : APR_EGENERAL;
+    }
+
+    unsigned char* out = buf;
+    while(len > 0) {
+        if(buffer->next == sizeof buffer->bytes) {
+            if(RAND_bytes(buffer->bytes, sizeof buffer->bytes) != 1) {
+                return APR_EGENERAL;
+            }
+            buffer->next = 0;
+        }
+        apr_size_t avail = sizeof buffer->bytes - buffer->next;
+        apr_size_t n = len < avail ? len : avail;
+        memcpy(out, buffer->bytes + buffer->next, n);
+        OPENSSL_cleanse(buffer->bytes + buffer->next, n);
+        buffer->next += n;
+        out += n;
+        len -= n;
+    }
+    return APR_SUCCESS;
+}
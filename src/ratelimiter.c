@@ -0,0 +1,226 @@
+#include "parsegraph_RateLimiter.h"
+#include <apr_strings.h>
+#include <apr_thread_mutex.h>
+#include <string.h>
+
+#define MAX_SHARDS 16
+#define WAYS 4
+
+// A bucket kept as the time at which it will have no tokens taken, so that
+// refilling needs no work until the key is used again.
+struct parsegraph_RateLimiterSlot {
+    // Zero if the slot is unused.
+    apr_uint64_t hash;
+    apr_time_t refilled;
+};
+
+struct parsegraph_RateLimiterShard {
+    apr_thread_mutex_t* lock;
+    struct parsegraph_RateLimiterSlot* slots;
+    int size;
+    apr_uint64_t allowed;
+    apr_uint64_t limited;
+    apr_uint64_t evictions;
+
+    // Keeps shards that are locked by different threads off each other's cache lines.
+    char padding[64];
+};
+
+struct parsegraph_RateLimiter {
+    apr_pool_t* pool;
+    apr_interval_time_t interval;
+
+    // How far ahead of now a bucket may be refilled while it still has a token.
+    apr_interval_time_t tolerance;
+
+    int nshards;
+    int nsets;
+    struct parsegraph_RateLimiterShard shards[MAX_SHARDS];
+
+    // Where and how often stats are logged, if server is set. The thread
+    // that takes logLock when a log is due writes it.
+    marla_Server* server;
+    const char* name;
+    apr_interval_time_t logInterval;
+    volatile apr_time_t nextLog;
+    apr_thread_mutex_t* logLock;
+};
+
+parsegraph_RateLimiter* parsegraph_RateLimiter_new(apr_pool_t* parent, int capacity, int burst, apr_interval_time_t interval)
+{
+    apr_pool_t* pool;
+    if(capacity <= 0 || burst <= 0 || interval <= 0 || APR_SUCCESS != apr_pool_create(&pool, parent)) {
+        return 0;
+    }
+    parsegraph_RateLimiter* limiter = apr_pcalloc(pool, sizeof(*limiter));
+    limiter->pool = pool;
+    limiter->interval = interval;
+    limiter->tolerance = (burst - 1) * interval;
+
+    // Use fewer shards for small limiters, so each still has a full set of ways.
+    limiter->nshards = 1;
+    while(limiter->nshards < MAX_SHARDS && limiter->nshards * 2 * WAYS <= capacity) {
+        limiter->nshards *= 2;
+    }
+    limiter->nsets = capacity / (limiter->nshards * WAYS);
+    if(limiter->nsets < 1) {
+        limiter->nsets = 1;
+    }
+    if(APR_SUCCESS != apr_thread_mutex_create(&limiter->logLock, APR_THREAD_MUTEX_DEFAULT, pool)) {
+        apr_pool_destroy(pool);
+        return 0;
+    }
+    for(int i = 0; i < limiter->nshards; ++i) {
+        struct parsegraph_RateLimiterShard* shard = &limiter->shards[i];
+        if(APR_SUCCESS != apr_thread_mutex_create(&shard->lock, APR_THREAD_MUTEX_DEFAULT, pool)) {
+            apr_pool_destroy(pool);
+            return 0;
+        }
+        shard->slots = apr_pcalloc(pool, sizeof(struct parsegraph_RateLimiterSlot) * limiter->nsets * WAYS);
+    }
+    return limiter;
+}
+
+void parsegraph_RateLimiter_destroy(parsegraph_RateLimiter* limiter)
+{
+    apr_pool_destroy(limiter->pool);
+}
+
+static apr_uint64_t hashBytes(apr_uint64_t hash, const void* data, apr_size_t len)
+{
+    const unsigned char* c = data;
+    for(apr_size_t i = 0; i < len; ++i) {
+        hash ^= c[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static void logStatsIfDue(parsegraph_RateLimiter* limiter, apr_time_t now)
+{
+    if(!limiter->server || now < limiter->nextLog || APR_SUCCESS != apr_thread_mutex_trylock(limiter->logLock)) {
+        return;
+    }
+    if(now >= limiter->nextLog) {
+        limiter->nextLog = now + limiter->logInterval;
+        parsegraph_RateLimiter_logStats(limiter, limiter->server, limiter->name);
+    }
+    apr_thread_mutex_unlock(limiter->logLock);
+}
+
+// Takes a token for the key if take is set, or only checks for one otherwise.
+static int consume(parsegraph_RateLimiter* limiter, const char* kind, const void* key, apr_size_t keyLen, int take)
+{
+    apr_uint64_t hash = hashBytes(14695981039346656037ull, kind, strlen(kind) + 1);
+    hash = hashBytes(hash, key, keyLen);
+    if(hash == 0) {
+        hash = 1;
+    }
+    struct parsegraph_RateLimiterShard* shard = &limiter->shards[(hash >> 32) % limiter->nshards];
+    apr_time_t now = apr_time_now();
+
+    apr_thread_mutex_lock(shard->lock);
+    struct parsegraph_RateLimiterSlot* set = shard->slots + (hash % limiter->nsets) * WAYS;
+    struct parsegraph_RateLimiterSlot* slot = 0;
+    struct parsegraph_RateLimiterSlot* victim = set;
+    for(int i = 0; i < WAYS; ++i) {
+        if(set[i].hash == hash) {
+            slot = &set[i];
+            break;
+        }
+        // Prefer an unused slot, and then the one refilled the longest.
+        if(victim->hash != 0 && (set[i].hash == 0 || set[i].refilled < victim->refilled)) {
+            victim = &set[i];
+        }
+    }
+    if(!slot && !take) {
+        // A key without a bucket has every token.
+        apr_thread_mutex_unlock(shard->lock);
+        return APR_SUCCESS;
+    }
+    if(!slot) {
+        if(victim->hash == 0) {
+            ++shard->size;
+        }
+        else {
+            ++shard->evictions;
+        }
+        slot = victim;
+        slot->hash = hash;
+        slot->refilled = now;
+    }
+
+    apr_time_t refilled = slot->refilled > now ? slot->refilled : now;
+    int rv = refilled - now > limiter->tolerance ? APR_EAGAIN : APR_SUCCESS;
+    if(take) {
+        if(rv == APR_SUCCESS) {
+            slot->refilled = refilled + limiter->interval;
+            ++shard->allowed;
+        }
+        else {
+            ++shard->limited;
+        }
+    }
+    apr_thread_mutex_unlock(shard->lock);
+    logStatsIfDue(limiter, now);
+    return rv;
+}
+
+int parsegraph_RateLimiter_take(parsegraph_RateLimiter* limiter, const char* kind, const void* key, apr_size_t keyLen)
+{
+    return consume(limiter, kind, key, keyLen, 1);
+}
+
+int parsegraph_RateLimiter_peek(parsegraph_RateLimiter* limiter, const char* kind, const void* key, apr_size_t keyLen)
+{
+    return consume(limiter, kind, key, keyLen, 0);
+}
+
+int parsegraph_RateLimiter_takeUser(parsegraph_RateLimiter* limiter, const char* kind, int userId)
+{
+    return parsegraph_RateLimiter_take(limiter, kind, &userId, sizeof(userId));
+}
+
+void parsegraph_RateLimiter_clear(parsegraph_RateLimiter* limiter)
+{
+    for(int i = 0; i < limiter->nshards; ++i) {
+        struct parsegraph_RateLimiterShard* shard = &limiter->shards[i];
+        apr_thread_mutex_lock(shard->lock);
+        memset(shard->slots, 0, sizeof(struct parsegraph_RateLimiterSlot) * limiter->nsets * WAYS);
+        shard->size = 0;
+        apr_thread_mutex_unlock(shard->lock);
+    }
+}
+
+void parsegraph_RateLimiter_stats(parsegraph_RateLimiter* limiter, parsegraph_RateLimiterStats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    for(int i = 0; i < limiter->nshards; ++i) {
+        struct parsegraph_RateLimiterShard* shard = &limiter->shards[i];
+        apr_thread_mutex_lock(shard->lock);
+        stats->allowed += shard->allowed;
+        stats->limited += shard->limited;
+        stats->evictions += shard->evictions;
+        stats->size += shard->size;
+        apr_thread_mutex_unlock(shard->lock);
+    }
+}
+
+void parsegraph_RateLimiter_logStats(parsegraph_RateLimiter* limiter, marla_Server* server, const char* name)
+{
+    parsegraph_RateLimiterStats stats;
+    parsegraph_RateLimiter_stats(limiter, &stats);
+    marla_logMessagef(server, "%s rate limiter: %" APR_UINT64_T_FMT " allowed, %" APR_UINT64_T_FMT " limited, %" APR_UINT64_T_FMT " evicted, %d keys",
+        name, stats.allowed, stats.limited, stats.evictions, stats.size
+    );
+}
+
+void parsegraph_RateLimiter_setLogging(parsegraph_RateLimiter* limiter, marla_Server* server, const char* name, apr_interval_time_t interval)
+{
+    apr_thread_mutex_lock(limiter->logLock);
+    limiter->name = apr_pstrdup(limiter->pool, name);
+    limiter->logInterval = interval;
+    limiter->nextLog = apr_time_now() + interval;
+    limiter->server = interval > 0 ? server : 0;
+    apr_thread_mutex_unlock(limiter->logLock);
+}
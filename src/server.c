@@ -1,5 +1,6 @@
 #include "parsegraph_environment.h"
 #include "parsegraph_user.h"
+#include "parsegraph_RateLimiter.h"
 #include "marla.h"
 
 struct parsegraph_LiveClientEvent {
@@ -20,14 +21,20 @@ parsegraph_LiveClientEvent* last_event;
 typedef struct parsegraph_LiveClient parsegraph_LiveClient;
 
 enum parsegraph_JoinEnvironmentResult {
-parsegraph_JoinEnvironment_OK
-}
+parsegraph_JoinEnvironment_OK,
+parsegraph_JoinEnvironment_NOT_FOUND,
+parsegraph_JoinEnvironment_BANNED,
+parsegraph_JoinEnvironment_FLOODED
+};
 
 struct parsegraph_LiveEnvironmentServer {
 apr_pool_t* pool;
 ap_dbd_t* dbd;
 apr_hash_t* users;
 apr_hash_t* environments;
+
+// Limiter of join attempts by user id.
+parsegraph_RateLimiter* joins;
 };
 typedef struct parsegraph_LiveEnvironmentServer parsegraph_LiveEnvironmentServer;
 
@@ -38,11 +45,17 @@ enum parsegraph_JoinEnvironmentResult parsegraph_joinEnvironment(
     parsegraph_user_login* login,
     parsegraph_LiveClient** client
 ) {
+    if(APR_SUCCESS != parsegraph_RateLimiter_takeUser(server->joins, "join", login->userId)) {
+        return parsegraph_JoinEnvironment_FLOODED;
+    }
     if(parsegraph_bannedFromEnvironment(server->pool, server->dbd, env, login->userId)) {
         return parsegraph_JoinEnvironment_BANNED;
     }
-    if(parsegraph_attemptingJoin(server->pool, server->dbd, env, login->userId)) {
-        return parsegraph_JoinEnvironment_FLOODED;
+
+    // Reject malformed environments before anything is allocated or registered.
+    parsegraph_BinaryGUID envKey;
+    if(0 != parsegraph_GUID_parse(env, &envKey)) {
+        return parsegraph_JoinEnvironment_NOT_FOUND;
     }
 
     *client = malloc(sizeof parsegraph_LiveClient);
@@ -59,10 +72,11 @@ enum parsegraph_JoinEnvironmentResult parsegraph_joinEnvironment(
         apr_hash_set(server->users, login->userId, sizeof(login->userId), clients);
     }
 
-    parsegraph_EnvironmentWorld* world = apr_hash_get(server->environments, env->value, 36);
+    parsegraph_EnvironmentWorld* world = apr_hash_get(server->environments, envKey.bytes, sizeof envKey.bytes);
     if(!world) {
         world = parsegraph_EnvironmentWorld_new();
-        apr_hash_set(server->environments, env->value, 36, world);
+        parsegraph_BinaryGUID* key = apr_pmemdup(server->pool, &envKey, sizeof envKey);
+        apr_hash_set(server->environments, key->bytes, sizeof key->bytes, world);
     }
 
     parsegraph_ClientList_addClient(clients, client);
@@ -86,15 +100,34 @@ marla_WriteResult parsegraph_LiveClient_writeEvents(parsegraph_LiveClient* clien
     return marla_WriteResult_CONTINUE;
 }
 
+// Each user may join up to JOIN_BURST times at once, and once more every JOIN_INTERVAL.
+#define JOIN_LIMITER_CAPACITY 65536
+#define JOIN_BURST 5
+#define JOIN_INTERVAL apr_time_from_sec(2)
+
 parsegraph_LiveEnvironmentServer* parsegraph_LiveEnvironmentServer_new(apr_pool_t* pool)
 {
     parsegraph_LiveEnvironmentServer* server = malloc(sizeof *server);
+    if(!server) {
+        return 0;
+    }
     server->pool = pool;
     server->users = apr_hash_make(pool);
-    server->environments = apr_hash_make(pool);
+    server->environments = apr_hash_make_custom(pool, parsegraph_BinaryGUID_hash);
+    server->joins = parsegraph_RateLimiter_new(pool, JOIN_LIMITER_CAPACITY, JOIN_BURST, JOIN_INTERVAL);
+    if(!server->joins) {
+        free(server);
+        return 0;
+    }
     return server;
 }
 
+void parsegraph_LiveEnvironmentServer_destroy(parsegraph_LiveEnvironmentServer* server)
+{
+    parsegraph_RateLimiter_destroy(server->joins);
+    free(server);
+}
+
 static marla_WriteResult writeEnvironment(marla_Connection* cxn, parsegraph_GUID* env, int* handlerTotal)
 {
     int* handlerTotal = handlerData;
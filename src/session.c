@@ -1,21 +1,366 @@
 #include "parsegraph_Session.h"
+#include "parsegraph_environment.h"
+#include "parsegraph_Statement.h"
+#include "parsegraph_Profile.h"
+#include "parsegraph_Shards.h"
+#include "parsegraph_user.h"
+#include "parsegraph_UsernameIndex.h"
+#include <apr_strings.h>
+#include <string.h>
 
 parsegraph_Session* parsegraph_Session_new(apr_pool_t* parent, ap_dbd_t* dbd)
 {
     parsegraph_Session* session = malloc(sizeof(*session));
-    int rv = apr_pool_create(&session->pool, parent);
+    if(!session) {
+        return 0;
+    }
+    int rv = apr_pool_create(&session->statePool, parent);
+    if(rv == APR_SUCCESS) {
+        rv = apr_pool_create(&session->pool, session->statePool);
+        if(rv != APR_SUCCESS) {
+            apr_pool_destroy(session->statePool);
+        }
+    }
     if(rv != APR_SUCCESS) {
         fprintf(stderr, "Failed creating memory pool. APR status of %d.\n", rv);
+        free(session);
         return 0;
     }
 
     session->dbd = dbd;
+    session->server = 0;
+    session->dialect = strcmp(apr_dbd_name(dbd->driver), "pgsql") ? parsegraph_Dialect_SQLITE : parsegraph_Dialect_PGSQL;
+    session->statements = apr_pcalloc(session->statePool, sizeof(apr_dbd_prepared_t*) * parsegraph_Statement_COUNT);
+    session->sqlite = 0;
+    session->insertReturning = 0;
+    session->statementStats = apr_pcalloc(session->statePool, sizeof(parsegraph_StatementStats) * parsegraph_Statement_COUNT);
+    session->transactionDepth = 0;
+    session->pendingEvents = 0;
+    session->pendingEventMarks = apr_array_make(session->statePool, 8, sizeof(int));
+    session->pendingUsernames = 0;
+    session->pendingUsernameMarks = apr_array_make(session->statePool, 8, sizeof(int));
+    session->connectionPool = 0;
+    session->readers = 0;
+    session->poolIndex = -1;
+    session->shards = 0;
+    session->loginCache = 0;
+    session->signedLogins = 0;
+    session->loginLimiter = 0;
+    session->usernameIndex = 0;
+    session->remoteAddress = 0;
+    session->loginExpiry = 0;
+    session->revocationLifetime = 0;
+    session->passwordIterations = parsegraph_PASSWORD_ITERATIONS;
+    const char* iterations = getenv("PARSEGRAPH_PASSWORD_ITERATIONS");
+    if(iterations && atoi(iterations) > 0) {
+        session->passwordIterations = atoi(iterations);
+    }
+    const char* guidOrder = getenv("PARSEGRAPH_GUID_ORDER");
+    session->timeOrderedGUIDs = guidOrder && !strcmp(guidOrder, "time");
+    session->authSchema = 0;
+    session->userMemoPool = 0;
+    session->usersByName = 0;
+    session->usersById = 0;
+
+    // Apply the connection profile configured for this process, however the
+    // connection was opened. Connections reused across requests, as under
+    // mod_dbd, only have it applied by their first session.
+    rv = parsegraph_Profile_applyConfigured(session);
+    if(rv != APR_SUCCESS) {
+        fprintf(stderr, "Failed to apply the configured connection profile. Status of %d.\n", rv);
+        apr_pool_destroy(session->statePool);
+        free(session);
+        return 0;
+    }
+    apr_pool_clear(session->pool);
 
     return session;
 }
 
 void parsegraph_Session_destroy(parsegraph_Session* session)
 {
-    apr_pool_destroy(session->pool);
+    // Append this session's statement stats for parsegraph_stats to collect.
+    const char* statsPath = getenv("PARSEGRAPH_STATS_FILE");
+    if(statsPath && *statsPath) {
+        FILE* sink = fopen(statsPath, "a");
+        if(sink) {
+            // Buffer the whole dump so concurrent processes append whole lines.
+            char buf[16384];
+            setvbuf(sink, buf, _IOFBF, sizeof(buf));
+            parsegraph_Stats_dump(session, sink);
+            fclose(sink);
+        }
+    }
+
+    parsegraph_releaseStatements(session);
+    apr_pool_destroy(session->statePool);
     free(session);
 }
+
+void parsegraph_Session_clear(parsegraph_Session* session)
+{
+    apr_pool_clear(session->pool);
+}
+
+parsegraph_Session* parsegraph_Session_open(marla_Server* server, const char* driverName, const char* params)
+{
+    apr_pool_t* pool;
+    if(APR_SUCCESS != apr_pool_create_unmanaged(&pool)) {
+        return 0;
+    }
+    ap_dbd_t* dbd = apr_pcalloc(pool, sizeof(*dbd));
+    int rv = apr_dbd_get_driver(pool, driverName, &dbd->driver);
+    if(rv != APR_SUCCESS) {
+        marla_logMessagef(server, "Failed loading %s DBD driver, APR status of %d.", driverName, rv);
+        apr_pool_destroy(pool);
+        return 0;
+    }
+    rv = apr_dbd_open(dbd->driver, pool, params, &dbd->handle);
+    if(rv != APR_SUCCESS) {
+        marla_logMessagef(server, "Failed connecting to database, APR status of %d.", rv);
+        apr_pool_destroy(pool);
+        return 0;
+    }
+    dbd->prepared = apr_hash_make(pool);
+    dbd->pool = pool;
+
+    parsegraph_Session* session = parsegraph_Session_new(pool, dbd);
+    if(!session) {
+        marla_logMessagef(server, "Failed creating a session for the database.");
+        apr_dbd_close(dbd->driver, dbd->handle);
+        apr_pool_destroy(pool);
+        return 0;
+    }
+    session->server = server;
+    session->connectionPool = pool;
+    return session;
+}
+
+void parsegraph_Session_close(parsegraph_Session* session)
+{
+    apr_pool_t* pool = session->connectionPool;
+    ap_dbd_t* dbd = session->dbd;
+    parsegraph_Session_destroy(session);
+    if(pool) {
+        apr_dbd_close(dbd->driver, dbd->handle);
+        apr_pool_destroy(pool);
+    }
+}
+
+void parsegraph_Session_setReaders(parsegraph_Session* session, struct parsegraph_SessionPool* readers)
+{
+    session->readers = readers;
+}
+
+void parsegraph_Session_setLoginCache(parsegraph_Session* session, struct parsegraph_LoginCache* cache)
+{
+    session->loginCache = cache;
+}
+
+void parsegraph_Session_setSignedLogins(parsegraph_Session* session, struct parsegraph_SignedLogins* logins)
+{
+    session->signedLogins = logins;
+}
+
+void parsegraph_Session_setLoginLimiter(parsegraph_Session* session, struct parsegraph_RateLimiter* limiter)
+{
+    session->loginLimiter = limiter;
+}
+
+void parsegraph_Session_setUsernameIndex(parsegraph_Session* session, struct parsegraph_UsernameIndex* index)
+{
+    session->usernameIndex = index;
+}
+
+void parsegraph_Session_setRemoteAddress(parsegraph_Session* session, const char* address)
+{
+    session->remoteAddress = address;
+}
+
+void parsegraph_Session_setLoginExpiry(parsegraph_Session* session, apr_interval_time_t expiry)
+{
+    session->loginExpiry = expiry;
+}
+
+void parsegraph_Session_setRevocationLifetime(parsegraph_Session* session, apr_interval_time_t lifetime)
+{
+    session->revocationLifetime = lifetime;
+}
+
+void parsegraph_Session_setPasswordIterations(parsegraph_Session* session, int iterations)
+{
+    session->passwordIterations = iterations;
+}
+
+void parsegraph_Session_setTimeOrderedGUIDs(parsegraph_Session* session, int timeOrdered)
+{
+    session->timeOrderedGUIDs = timeOrdered;
+}
+
+void parsegraph_Session_setShards(parsegraph_Session* session, struct parsegraph_Shards* shards)
+{
+    session->shards = shards;
+}
+
+void parsegraph_Session_beginUserMemo(parsegraph_Session* session)
+{
+    if(session->userMemoPool || APR_SUCCESS != apr_pool_create(&session->userMemoPool, session->statePool)) {
+        return;
+    }
+    session->usersByName = apr_hash_make(session->userMemoPool);
+    session->usersById = apr_hash_make(session->userMemoPool);
+}
+
+void parsegraph_Session_endUserMemo(parsegraph_Session* session)
+{
+    if(!session->userMemoPool) {
+        return;
+    }
+    apr_pool_destroy(session->userMemoPool);
+    session->userMemoPool = 0;
+    session->usersByName = 0;
+    session->usersById = 0;
+}
+
+void parsegraph_Session_forgetUsers(parsegraph_Session* session)
+{
+    if(!session->userMemoPool) {
+        return;
+    }
+    apr_hash_clear(session->usersByName);
+    apr_hash_clear(session->usersById);
+}
+
+parsegraph_Session* parsegraph_Session_forEnvironment(parsegraph_Session* session, parsegraph_GUID* env)
+{
+    if(!session->shards || !env) {
+        return session;
+    }
+    return parsegraph_Shards_forEnvironment(session->shards, env);
+}
+
+int parsegraph_Session_attachAuthDatabase(parsegraph_Session* session, const char* path)
+{
+    ap_dbd_t* dbd = session->dbd;
+    apr_pool_t* pool = session->pool;
+    if(strcmp(apr_dbd_name(dbd->driver), "sqlite3")) {
+        return APR_ENOTIMPL;
+    }
+    if(session->authSchema) {
+        return APR_SUCCESS;
+    }
+
+    // Another session on this connection may have attached it already.
+    apr_dbd_results_t* res = 0;
+    int rv = apr_dbd_select(dbd->driver, pool, dbd->handle, &res, "PRAGMA database_list", 0);
+    if(rv != 0) {
+        marla_logMessagef(session->server, "Failed to list attached databases: %s",
+            apr_dbd_error(dbd->driver, dbd->handle, rv)
+        );
+        return rv;
+    }
+    int attached = 0;
+    apr_dbd_row_t* row;
+    while(-1 != apr_dbd_get_row(dbd->driver, pool, res, &row, -1)) {
+        const char* name = apr_dbd_get_entry(dbd->driver, row, 1);
+        if(name && !strcmp(name, "auth")) {
+            attached = 1;
+        }
+    }
+    if(attached) {
+        session->authSchema = "auth";
+        return APR_SUCCESS;
+    }
+
+    // Unqualified names resolve to the main database first, so user tables
+    // there would hide the attached ones.
+    rv = apr_dbd_select(dbd->driver, pool, dbd->handle, &res,
+        "select count(*) from main.sqlite_master where type = 'table' and name in ('user', 'login', 'parsegraph_user_version')", 0);
+    if(rv != 0) {
+        marla_logMessagef(session->server, "Failed to check for user tables: %s",
+            apr_dbd_error(dbd->driver, dbd->handle, rv)
+        );
+        return rv;
+    }
+    int count = 0;
+    if(0 == apr_dbd_get_row(dbd->driver, pool, res, &row, -1)) {
+        apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, &count);
+        while(-1 != apr_dbd_get_row(dbd->driver, pool, res, &row, -1));
+    }
+    if(count > 0) {
+        marla_logMessagef(session->server, "Cannot attach an auth database to a database with its own user tables.");
+        return APR_EEXIST;
+    }
+
+    int nrows;
+    const char* sql = apr_pstrcat(pool, "ATTACH DATABASE '", apr_dbd_escape(dbd->driver, pool, path, dbd->handle), "' AS auth", NULL);
+    rv = apr_dbd_query(dbd->driver, dbd->handle, &nrows, sql);
+    if(rv != 0) {
+        marla_logMessagef(session->server, "Failed to attach auth database %s: %s", path,
+            apr_dbd_error(dbd->driver, dbd->handle, rv)
+        );
+        return rv;
+    }
+    session->authSchema = "auth";
+    return APR_SUCCESS;
+}
+
+int parsegraph_Session_makeReadOnly(parsegraph_Session* session, void* data)
+{
+    ap_dbd_t* dbd = session->dbd;
+    const char* driver = apr_dbd_name(dbd->driver);
+    const char* sql;
+    if(!strcmp(driver, "sqlite3")) {
+        sql = "PRAGMA query_only = 1";
+    }
+    else if(!strcmp(driver, "pgsql")) {
+        sql = "SET SESSION CHARACTERISTICS AS TRANSACTION READ ONLY";
+    }
+    else {
+        return 0;
+    }
+    int nrows;
+    int rv = apr_dbd_query(dbd->driver, dbd->handle, &nrows, sql);
+    if(rv != 0) {
+        marla_logMessagef(session->server, "Failed to make connection read-only: %s",
+            apr_dbd_error(dbd->driver, dbd->handle, rv)
+        );
+    }
+    return rv;
+}
+
+void parsegraph_Session_enterTransaction(parsegraph_Session* session)
+{
+    int mark = session->pendingEvents ? session->pendingEvents->nelts : 0;
+    APR_ARRAY_PUSH(session->pendingEventMarks, int) = mark;
+    APR_ARRAY_PUSH(session->pendingUsernameMarks, int) = parsegraph_countPendingUsernames(session);
+    ++session->transactionDepth;
+}
+
+void parsegraph_Session_leaveTransaction(parsegraph_Session* session, int committed)
+{
+    if(session->transactionDepth <= 0) {
+        return;
+    }
+    int* mark = apr_array_pop(session->pendingEventMarks);
+    int* usernameMark = apr_array_pop(session->pendingUsernameMarks);
+    --session->transactionDepth;
+
+    if(!committed) {
+        // Events raised within a rolled back savepoint never happened.
+        if(session->pendingEvents && mark) {
+            session->pendingEvents->nelts = *mark;
+        }
+        // Nor did changes to users, which may have been remembered meanwhile.
+        parsegraph_Session_forgetUsers(session);
+        if(session->pendingUsernames && usernameMark) {
+            session->pendingUsernames->nelts = *usernameMark;
+        }
+        return;
+    }
+
+    if(session->transactionDepth == 0) {
+        parsegraph_flushPendingUsernames(session);
+        parsegraph_flushPendingEvents(session);
+    }
+}
@@ -0,0 +1,187 @@
+#include "parsegraph_SessionPool.h"
+#include "parsegraph_Statement.h"
+#include <apr_atomic.h>
+#include <apr_thread_proc.h>
+
+struct parsegraph_SessionPool {
+    apr_pool_t* pool;
+    int nsessions;
+    parsegraph_Session** sessions;
+
+    // One bit per session, set while the session is idle.
+    int nwords;
+    volatile apr_uint32_t* idle;
+
+    // Word to start the next search from, to spread contention.
+    volatile apr_uint32_t nextWord;
+
+    volatile apr_uint64_t checkouts;
+    volatile apr_uint64_t waits;
+    volatile apr_uint64_t timeouts;
+    volatile apr_uint64_t totalWait;
+    volatile apr_uint64_t maxWait;
+};
+
+static void closeSessions(parsegraph_SessionPool* sessions)
+{
+    for(int i = 0; i < sessions->nsessions; ++i) {
+        if(sessions->sessions[i]) {
+            parsegraph_Session_close(sessions->sessions[i]);
+            sessions->sessions[i] = 0;
+        }
+    }
+}
+
+parsegraph_SessionPool* parsegraph_SessionPool_new(apr_pool_t* parent, marla_Server* server, const char* driverName, const char* params, int nsessions, parsegraph_SessionWarmup warmup, void* warmupData)
+{
+    apr_pool_t* pool;
+    if(nsessions <= 0 || APR_SUCCESS != apr_pool_create(&pool, parent)) {
+        return 0;
+    }
+    parsegraph_SessionPool* sessions = apr_pcalloc(pool, sizeof(*sessions));
+    sessions->pool = pool;
+    sessions->nsessions = nsessions;
+    sessions->sessions = apr_pcalloc(pool, sizeof(parsegraph_Session*) * nsessions);
+    sessions->nwords = (nsessions + 31) / 32;
+    sessions->idle = apr_pcalloc(pool, sizeof(apr_uint32_t) * sessions->nwords);
+
+    for(int i = 0; i < nsessions; ++i) {
+        parsegraph_Session* session = parsegraph_Session_open(server, driverName, params);
+        if(!session) {
+            closeSessions(sessions);
+            apr_pool_destroy(pool);
+            return 0;
+        }
+        sessions->sessions[i] = session;
+        session->poolIndex = i;
+        parsegraph_Session_useNativeSQLite(session);
+
+        // Prepare the whole catalog now rather than on each connection's first requests.
+        int failures = parsegraph_prepareStatements(session, 0, parsegraph_Statement_COUNT - 1);
+        if(failures > 0) {
+            marla_logMessagef(server, "Session pool connection %d failed to prepare %d statement(s).", i, failures);
+        }
+        if(warmup && 0 != warmup(session, warmupData)) {
+            marla_logMessagef(server, "Session pool connection %d failed to warm up.", i);
+            closeSessions(sessions);
+            apr_pool_destroy(pool);
+            return 0;
+        }
+        sessions->idle[i / 32] |= (apr_uint32_t)1 << (i % 32);
+    }
+
+    return sessions;
+}
+
+void parsegraph_SessionPool_destroy(parsegraph_SessionPool* sessions)
+{
+    closeSessions(sessions);
+    apr_pool_destroy(sessions->pool);
+}
+
+static parsegraph_Session* tryCheckout(parsegraph_SessionPool* sessions)
+{
+    int start = apr_atomic_inc32(&sessions->nextWord) % sessions->nwords;
+    for(int n = 0; n < sessions->nwords; ++n) {
+        int word = (start + n) % sessions->nwords;
+        apr_uint32_t bits = apr_atomic_read32(&sessions->idle[word]);
+        while(bits) {
+            int bit = __builtin_ctz(bits);
+            apr_uint32_t claimed = bits & ~((apr_uint32_t)1 << bit);
+            apr_uint32_t seen = apr_atomic_cas32(&sessions->idle[word], claimed, bits);
+            if(seen == bits) {
+                return sessions->sessions[word * 32 + bit];
+            }
+            bits = seen;
+        }
+    }
+    return 0;
+}
+
+static void recordWait(parsegraph_SessionPool* sessions, apr_time_t waited)
+{
+    apr_atomic_inc64(&sessions->waits);
+    apr_atomic_add64(&sessions->totalWait, waited);
+    apr_uint64_t max = apr_atomic_read64(&sessions->maxWait);
+    while((apr_uint64_t)waited > max) {
+        apr_uint64_t seen = apr_atomic_cas64(&sessions->maxWait, waited, max);
+        if(seen == max) {
+            break;
+        }
+        max = seen;
+    }
+}
+
+int parsegraph_SessionPool_checkout(parsegraph_SessionPool* sessions, apr_interval_time_t timeout, parsegraph_Session** session)
+{
+    *session = tryCheckout(sessions);
+    if(*session) {
+        apr_atomic_inc64(&sessions->checkouts);
+        return APR_SUCCESS;
+    }
+
+    // Every session is busy: back off until one is checked in.
+    apr_time_t start = apr_time_now();
+    apr_interval_time_t delay = 0;
+    for(;;) {
+        if(delay == 0) {
+            apr_thread_yield();
+            delay = 10;
+        }
+        else {
+            apr_sleep(delay);
+            if(delay < 1000) {
+                delay *= 2;
+            }
+        }
+        *session = tryCheckout(sessions);
+        apr_time_t waited = apr_time_now() - start;
+        if(*session) {
+            apr_atomic_inc64(&sessions->checkouts);
+            recordWait(sessions, waited);
+            return APR_SUCCESS;
+        }
+        if(timeout >= 0 && waited >= timeout) {
+            apr_atomic_inc64(&sessions->timeouts);
+            recordWait(sessions, waited);
+            return APR_TIMEUP;
+        }
+    }
+}
+
+void parsegraph_SessionPool_checkin(parsegraph_SessionPool* sessions, parsegraph_Session* session)
+{
+    int i = session->poolIndex;
+    if(i < 0 || i >= sessions->nsessions || sessions->sessions[i] != session) {
+        marla_logMessagef(session->server, "Session was not checked out of this pool.");
+        return;
+    }
+
+    // Free what the last user allocated before the session is handed out again.
+    parsegraph_Session_clear(session);
+
+    volatile apr_uint32_t* word = &sessions->idle[i / 32];
+    apr_uint32_t bit = (apr_uint32_t)1 << (i % 32);
+    apr_uint32_t bits = apr_atomic_read32(word);
+    for(;;) {
+        apr_uint32_t seen = apr_atomic_cas32(word, bits | bit, bits);
+        if(seen == bits) {
+            return;
+        }
+        bits = seen;
+    }
+}
+
+int parsegraph_SessionPool_size(parsegraph_SessionPool* sessions)
+{
+    return sessions->nsessions;
+}
+
+void parsegraph_SessionPool_stats(parsegraph_SessionPool* sessions, parsegraph_SessionPoolStats* stats)
+{
+    stats->checkouts = apr_atomic_read64(&sessions->checkouts);
+    stats->waits = apr_atomic_read64(&sessions->waits);
+    stats->timeouts = apr_atomic_read64(&sessions->timeouts);
+    stats->totalWait = apr_atomic_read64(&sessions->totalWait);
+    stats->maxWait = apr_atomic_read64(&sessions->maxWait);
+}
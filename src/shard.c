@@ -0,0 +1,170 @@
+#include "parsegraph_Shards.h"
+#include "parsegraph_List.h"
+#include "parsegraph_user.h"
+#include <apr_strings.h>
+#include <string.h>
+
+struct parsegraph_Shards {
+    apr_pool_t* pool;
+    parsegraph_Session* global;
+    int nshards;
+    parsegraph_Session** shards;
+};
+
+static void closeSessions(parsegraph_Shards* shards)
+{
+    for(int i = 0; i < shards->nshards; ++i) {
+        if(shards->shards[i]) {
+            parsegraph_Session_close(shards->shards[i]);
+            shards->shards[i] = 0;
+        }
+    }
+    if(shards->global) {
+        parsegraph_Session_close(shards->global);
+        shards->global = 0;
+    }
+}
+
+// Returns shardParams with its first %d replaced by the shard's index, or
+// NULL if it has none. The rest is copied as is, since it may hold a '%'.
+static const char* formatShardParams(apr_pool_t* pool, const char* shardParams, int i)
+{
+    const char* token = strstr(shardParams, "%d");
+    if(!token) {
+        return 0;
+    }
+    return apr_psprintf(pool, "%.*s%d%s", (int)(token - shardParams), shardParams, i, token + 2);
+}
+
+parsegraph_Shards* parsegraph_Shards_open(apr_pool_t* parent, marla_Server* server, const char* driverName, const char* globalParams, const char* shardParams, int nshards)
+{
+    apr_pool_t* pool;
+    if(nshards <= 0 || !strstr(shardParams, "%d") || APR_SUCCESS != apr_pool_create(&pool, parent)) {
+        return 0;
+    }
+    parsegraph_Shards* shards = apr_pcalloc(pool, sizeof(*shards));
+    shards->pool = pool;
+    shards->nshards = nshards;
+    shards->shards = apr_pcalloc(pool, sizeof(parsegraph_Session*) * nshards);
+
+    shards->global = parsegraph_Session_open(server, driverName, globalParams);
+    if(!shards->global) {
+        apr_pool_destroy(pool);
+        return 0;
+    }
+    parsegraph_Session_useNativeSQLite(shards->global);
+    parsegraph_Session_setShards(shards->global, shards);
+
+    for(int i = 0; i < nshards; ++i) {
+        const char* params = formatShardParams(pool, shardParams, i);
+        parsegraph_Session* session = parsegraph_Session_open(server, driverName, params);
+        if(!session) {
+            marla_logMessagef(server, "Failed opening environment shard %d.", i);
+            closeSessions(shards);
+            apr_pool_destroy(pool);
+            return 0;
+        }
+        parsegraph_Session_useNativeSQLite(session);
+        shards->shards[i] = session;
+    }
+
+    return shards;
+}
+
+void parsegraph_Shards_close(parsegraph_Shards* shards)
+{
+    closeSessions(shards);
+    apr_pool_destroy(shards->pool);
+}
+
+int parsegraph_Shards_count(parsegraph_Shards* shards)
+{
+    return shards->nshards;
+}
+
+parsegraph_Session* parsegraph_Shards_global(parsegraph_Shards* shards)
+{
+    return shards->global;
+}
+
+parsegraph_Session* parsegraph_Shards_shard(parsegraph_Shards* shards, int index)
+{
+    if(index < 0 || index >= shards->nshards) {
+        return 0;
+    }
+    return shards->shards[index];
+}
+
+int parsegraph_Shards_indexFor(parsegraph_Shards* shards, parsegraph_GUID* env)
+{
+    // FNV-1a, which spreads random GUIDs evenly and is stable across builds.
+    apr_uint32_t hash = 2166136261u;
+    for(const char* c = env->value; *c; ++c) {
+        hash ^= (unsigned char)*c;
+        hash *= 16777619u;
+    }
+    return hash % shards->nshards;
+}
+
+parsegraph_Session* parsegraph_Shards_forEnvironment(parsegraph_Shards* shards, parsegraph_GUID* env)
+{
+    return shards->shards[parsegraph_Shards_indexFor(shards, env)];
+}
+
+static int upgradeTables(parsegraph_Session* session)
+{
+    if(parsegraph_OK != parsegraph_upgradeUserTables(session)) {
+        return -1;
+    }
+    if(parsegraph_List_OK != parsegraph_List_upgradeTables(session)) {
+        return -1;
+    }
+    if(parsegraph_Environment_OK != parsegraph_upgradeEnvironmentTables(session)) {
+        return -1;
+    }
+    return 0;
+}
+
+int parsegraph_Shards_upgradeTables(parsegraph_Shards* shards)
+{
+    if(0 != upgradeTables(shards->global)) {
+        marla_logMessagef(shards->global->server, "Failed upgrading the global database.");
+        return -1;
+    }
+    for(int i = 0; i < shards->nshards; ++i) {
+        if(0 != upgradeTables(shards->shards[i])) {
+            marla_logMessagef(shards->global->server, "Failed upgrading environment shard %d.", i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+parsegraph_EnvironmentStatus parsegraph_Shards_createEnvironment(parsegraph_Shards* shards, int ownerId, int environmentTypeId, parsegraph_GUID* createdEnv)
+{
+    if(APR_SUCCESS != parsegraph_generateEnvironmentGUID(shards->global, createdEnv)) {
+        marla_logMessagef(shards->global->server, "Failed generating environment GUID.");
+        return parsegraph_Environment_INTERNAL_ERROR;
+    }
+    parsegraph_Session* session = parsegraph_Shards_forEnvironment(shards, createdEnv);
+
+    const char* transactionName = "parsegraph_Shards_createEnvironment";
+    if(parsegraph_OK != parsegraph_beginTransaction(session, transactionName)) {
+        return parsegraph_Environment_INTERNAL_ERROR;
+    }
+    int rootListId;
+    if(parsegraph_List_OK != parsegraph_List_new(session, "", &rootListId)) {
+        parsegraph_rollbackTransaction(session, transactionName);
+        return parsegraph_Environment_LIST_ERROR;
+    }
+    parsegraph_EnvironmentStatus erv = parsegraph_createEnvironmentWithGUID(session, createdEnv, ownerId, rootListId, environmentTypeId);
+    if(erv != parsegraph_Environment_OK) {
+        parsegraph_rollbackTransaction(session, transactionName);
+        return erv;
+    }
+    if(parsegraph_OK != parsegraph_commitTransaction(session, transactionName)) {
+        parsegraph_rollbackTransaction(session, transactionName);
+        return parsegraph_Environment_INTERNAL_ERROR;
+    }
+    return parsegraph_Environment_OK;
+}
@@ -0,0 +1,220 @@
+#include "parsegraph_SignedLogins.h"
+#include "parsegraph_Statement.h"
+#include <apr_hash.h>
+#include <apr_strings.h>
+#include <apr_base64.h>
+#include <apr_thread_mutex.h>
+#include <apr_thread_rwlock.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <string.h>
+
+// The size of a base64 HMAC-SHA256, with its terminator.
+#define SIGNATURE_SIZE 45
+
+struct parsegraph_SignedLogins {
+    apr_pool_t* pool;
+    unsigned char* key;
+    size_t keyLen;
+    apr_interval_time_t lifetime;
+    apr_interval_time_t refreshInterval;
+
+    // Held while revocations are reloaded, so only one thread reloads them.
+    apr_thread_mutex_t* refreshLock;
+
+    // Guards the fields below.
+    apr_thread_rwlock_t* lock;
+
+    // The current login generation of each user with one, keyed by user id.
+    apr_hash_t* generations;
+    apr_pool_t* generationsPool;
+    apr_time_t refreshed;
+    int loaded;
+};
+
+parsegraph_SignedLogins* parsegraph_SignedLogins_new(apr_pool_t* parent, const unsigned char* key, size_t keyLen, apr_interval_time_t lifetime, apr_interval_time_t refreshInterval)
+{
+    apr_pool_t* pool;
+    if(!key || keyLen == 0 || APR_SUCCESS != apr_pool_create(&pool, parent)) {
+        return 0;
+    }
+    parsegraph_SignedLogins* logins = apr_pcalloc(pool, sizeof(*logins));
+    logins->pool = pool;
+    logins->key = apr_pmemdup(pool, key, keyLen);
+    logins->keyLen = keyLen;
+    logins->lifetime = lifetime;
+    logins->refreshInterval = refreshInterval;
+    if(APR_SUCCESS != apr_thread_mutex_create(&logins->refreshLock, APR_THREAD_MUTEX_DEFAULT, pool)
+        || APR_SUCCESS != apr_thread_rwlock_create(&logins->lock, pool)) {
+        apr_pool_destroy(pool);
+        return 0;
+    }
+    logins->generations = apr_hash_make(pool);
+    return logins;
+}
+
+void parsegraph_SignedLogins_destroy(parsegraph_SignedLogins* logins)
+{
+    apr_pool_destroy(logins->pool);
+}
+
+// Writes the base64 HMAC of the payload to encoded. Returns 0 on success.
+static int signPayload(parsegraph_SignedLogins* logins, const char* payload, size_t payloadLen, char encoded[SIGNATURE_SIZE])
+{
+    unsigned char mac[EVP_MAX_MD_SIZE];
+    unsigned int macLen = 0;
+    if(!HMAC(EVP_sha256(), logins->key, logins->keyLen, (const unsigned char*)payload, payloadLen, mac, &macLen)
+        || apr_base64_encode_len(macLen) > SIGNATURE_SIZE) {
+        return -1;
+    }
+    apr_base64_encode(encoded, (const char*)mac, macLen);
+    return 0;
+}
+
+const char* parsegraph_SignedLogins_sign(parsegraph_SignedLogins* logins, apr_pool_t* pool, int userId, int generation)
+{
+    apr_int64_t expires = apr_time_sec(apr_time_now() + logins->lifetime);
+    const char* payload = apr_psprintf(pool, "%d.%d.%" APR_INT64_T_FMT, userId, generation, expires);
+    char signature[SIGNATURE_SIZE];
+    if(0 != signPayload(logins, payload, strlen(payload), signature)) {
+        return 0;
+    }
+    return apr_pstrcat(pool, payload, "$", signature, NULL);
+}
+
+// Loads revocations into a new pool. The caller holds refreshLock.
+static parsegraph_UserStatus reloadRevocations(parsegraph_SignedLogins* logins, parsegraph_Session* session)
+{
+    ap_dbd_t* dbd = session->dbd;
+    apr_pool_t* pool;
+    if(APR_SUCCESS != apr_pool_create(&pool, logins->pool)) {
+        return parsegraph_ERROR;
+    }
+
+    apr_dbd_results_t* res = 0;
+    int dbrv = parsegraph_pvselect(session, pool, &res, parsegraph_Statement_user_listLoginRevocations, 0);
+    if(dbrv != 0) {
+        marla_logMessagef(session->server, "Failed to load login revocations [%s]", apr_dbd_error(dbd->driver, dbd->handle, dbrv));
+        apr_pool_destroy(pool);
+        return parsegraph_ERROR;
+    }
+    apr_hash_t* generations = apr_hash_make(pool);
+    apr_dbd_row_t* row = 0;
+    while(0 == apr_dbd_get_row(dbd->driver, pool, res, &row, -1)) {
+        int* entry = apr_palloc(pool, 2 * sizeof(int));
+        if(APR_SUCCESS != apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, &entry[0])
+            || APR_SUCCESS != apr_dbd_datum_get(dbd->driver, row, 1, APR_DBD_TYPE_INT, &entry[1])) {
+            marla_logMessagef(session->server, "Failed to read login revocation.");
+            while(-1 != apr_dbd_get_row(dbd->driver, pool, res, &row, -1));
+            apr_pool_destroy(pool);
+            return parsegraph_ERROR;
+        }
+        apr_hash_set(generations, &entry[0], sizeof(int), &entry[1]);
+    }
+
+    apr_thread_rwlock_wrlock(logins->lock);
+    apr_pool_t* oldPool = logins->generationsPool;
+    logins->generations = generations;
+    logins->generationsPool = pool;
+    logins->refreshed = apr_time_now();
+    logins->loaded = 1;
+    apr_thread_rwlock_unlock(logins->lock);
+
+    if(oldPool) {
+        apr_pool_destroy(oldPool);
+    }
+    return parsegraph_OK;
+}
+
+parsegraph_UserStatus parsegraph_SignedLogins_refresh(parsegraph_SignedLogins* logins, parsegraph_Session* session)
+{
+    apr_thread_mutex_lock(logins->refreshLock);
+    parsegraph_UserStatus rv = reloadRevocations(logins, session);
+    apr_thread_mutex_unlock(logins->refreshLock);
+    return rv;
+}
+
+parsegraph_UserStatus parsegraph_SignedLogins_prune(parsegraph_SignedLogins* logins, parsegraph_Session* session, int* pruned)
+{
+    return parsegraph_pruneLoginRevocations(session, logins->lifetime, pruned);
+}
+
+void parsegraph_SignedLogins_invalidate(parsegraph_SignedLogins* logins)
+{
+    apr_thread_rwlock_wrlock(logins->lock);
+    logins->refreshed = 0;
+    apr_thread_rwlock_unlock(logins->lock);
+}
+
+parsegraph_UserStatus parsegraph_SignedLogins_verify(parsegraph_SignedLogins* logins, parsegraph_Session* session, const char* sessionValue, int* userId)
+{
+    const char* separator = sessionValue ? strchr(sessionValue, '$') : 0;
+    if(!separator || !memchr(sessionValue, '.', separator - sessionValue)) {
+        return parsegraph_SESSION_MALFORMED;
+    }
+
+    // Check the signature before trusting anything in the payload.
+    char expected[SIGNATURE_SIZE];
+    if(0 != signPayload(logins, sessionValue, separator - sessionValue, expected)) {
+        marla_logMessagef(session->server, "Failed to sign login payload.");
+        return parsegraph_ERROR;
+    }
+    const char* signature = separator + 1;
+    size_t expectedLen = strlen(expected);
+    if(strlen(signature) != expectedLen || CRYPTO_memcmp(expected, signature, expectedLen)) {
+        return parsegraph_SESSION_DOES_NOT_MATCH;
+    }
+    int id, generation;
+    apr_int64_t expires;
+    if(3 != sscanf(sessionValue, "%d.%d.%" APR_INT64_T_FMT "$", &id, &generation, &expires)) {
+        return parsegraph_SESSION_MALFORMED;
+    }
+    apr_time_t now = apr_time_now();
+    if(apr_time_from_sec(expires) <= now) {
+        return parsegraph_SESSION_DOES_NOT_EXIST;
+    }
+
+    apr_thread_rwlock_rdlock(logins->lock);
+    int stale = logins->refreshed + logins->refreshInterval <= now;
+    int loaded = logins->loaded;
+    apr_thread_rwlock_unlock(logins->lock);
+    if(stale && !loaded) {
+        // Nothing is loaded to use meanwhile, so wait for any thread loading it.
+        apr_thread_mutex_lock(logins->refreshLock);
+        apr_thread_rwlock_rdlock(logins->lock);
+        loaded = logins->loaded;
+        apr_thread_rwlock_unlock(logins->lock);
+        if(!loaded) {
+            reloadRevocations(logins, session);
+        }
+        apr_thread_mutex_unlock(logins->refreshLock);
+    }
+    else if(stale && APR_SUCCESS == apr_thread_mutex_trylock(logins->refreshLock)) {
+        // Other threads keep using the old revocations meanwhile.
+        reloadRevocations(logins, session);
+        apr_thread_mutex_unlock(logins->refreshLock);
+    }
+
+    int current = 0;
+    apr_thread_rwlock_rdlock(logins->lock);
+    loaded = logins->loaded;
+    if(loaded) {
+        int* entry = apr_hash_get(logins->generations, &id, sizeof(int));
+        current = entry ? *entry : 0;
+    }
+    apr_thread_rwlock_unlock(logins->lock);
+    if(!loaded) {
+        // The revocations could not be loaded, so look up this user's alone.
+        parsegraph_UserStatus rv = parsegraph_getLoginGeneration(session, id, &current);
+        if(parsegraph_OK != rv) {
+            return rv;
+        }
+    }
+    if(generation < current) {
+        return parsegraph_SESSION_DOES_NOT_EXIST;
+    }
+
+    *userId = id;
+    return parsegraph_OK;
+}
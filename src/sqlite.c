@@ -0,0 +1,329 @@
+#include "parsegraph_sqlite.h"
+#include <apr_strings.h>
+#include <string.h>
+
+#ifdef HAVE_SQLITE3
+#include <sqlite3.h>
+
+struct parsegraph_SQLiteStatement {
+    sqlite3_stmt* stmt;
+
+    // One type character per parameter: 'i' for integers, 't' for text,
+    // 'b' for blobs, and 'n' for NULL.
+    char types[parsegraph_MAX_STATEMENT_ARGS];
+    int nparams;
+
+    // Set while a query or cursor holds stmt, from binding until it is reset.
+    int inUse;
+};
+
+struct parsegraph_SQLite {
+    sqlite3* db;
+    struct parsegraph_SQLiteStatement statements[parsegraph_Statement_COUNT];
+};
+
+static apr_status_t finalizeStatements(void* data)
+{
+    struct parsegraph_SQLite* native = data;
+    for(int i = 0; i < parsegraph_Statement_COUNT; ++i) {
+        if(native->statements[i].stmt) {
+            sqlite3_finalize(native->statements[i].stmt);
+            native->statements[i].stmt = 0;
+        }
+    }
+    return APR_SUCCESS;
+}
+
+/**
+ * Rewrites an apr_dbd statement into SQLite syntax, replacing each %-format
+ * parameter with ? and recording the parameter's type.
+ */
+static int translateStatement(const char* sql, char* out, struct parsegraph_SQLiteStatement* def)
+{
+    def->nparams = 0;
+    const char* c = sql;
+    while(*c) {
+        if(*c != '%') {
+            *out++ = *c++;
+            continue;
+        }
+        ++c;
+        char type;
+        switch(*c) {
+        case '%':
+            *out++ = '%';
+            ++c;
+            continue;
+        case 'd':
+        case 'i':
+            type = 'i';
+            ++c;
+            break;
+        case 's':
+            type = 't';
+            ++c;
+            break;
+        case 'p':
+            if(c[1] != 'D' || !c[2]) {
+                return -1;
+            }
+            switch(c[2]) {
+            case 'i':
+            case 'd':
+                type = 'i';
+                break;
+            case 'b':
+            case 'c':
+                type = 'b';
+                break;
+            case 'n':
+                type = 'n';
+                break;
+            default:
+                type = 't';
+                break;
+            }
+            c += 3;
+            break;
+        default:
+            return -1;
+        }
+        if(def->nparams == parsegraph_MAX_STATEMENT_ARGS) {
+            return -1;
+        }
+        def->types[def->nparams++] = type;
+        *out++ = '?';
+    }
+    *out = 0;
+    return 0;
+}
+
+int parsegraph_Session_useNativeSQLite(parsegraph_Session* session)
+{
+    if(session->sqlite) {
+        return APR_SUCCESS;
+    }
+    ap_dbd_t* dbd = session->dbd;
+    if(strcmp(apr_dbd_name(dbd->driver), "sqlite3")) {
+        return APR_ENOTIMPL;
+    }
+    sqlite3* db = apr_dbd_native_handle(dbd->driver, dbd->handle);
+    if(!db) {
+        return APR_EGENERAL;
+    }
+    struct parsegraph_SQLite* native = apr_pcalloc(session->statePool, sizeof(*native));
+    native->db = db;
+    apr_pool_cleanup_register(session->statePool, native, finalizeStatements, apr_pool_cleanup_null);
+    session->sqlite = native;
+    return APR_SUCCESS;
+}
+
+static struct parsegraph_SQLiteStatement* getNativeStatement(parsegraph_Session* session, parsegraph_StatementId id)
+{
+    struct parsegraph_SQLiteStatement* def = &session->sqlite->statements[id];
+    if(def->stmt) {
+        return def;
+    }
+
+    const char* sql = parsegraph_preparedStatementSql(session, id);
+    char* translated = malloc(strlen(sql) + 1);
+    if(!translated) {
+        return 0;
+    }
+    if(0 != translateStatement(sql, translated, def)) {
+        marla_logMessagef(session->server, "%s statement cannot be translated for SQLite.", parsegraph_nameStatement(id));
+        free(translated);
+        return 0;
+    }
+    int rv = sqlite3_prepare_v2(session->sqlite->db, translated, -1, &def->stmt, 0);
+    free(translated);
+    if(rv != SQLITE_OK) {
+        marla_logMessagef(session->server, "Failed preparing %s statement [%s]",
+            parsegraph_nameStatement(id),
+            sqlite3_errmsg(session->sqlite->db)
+        );
+        def->stmt = 0;
+        return 0;
+    }
+    return def;
+}
+
+int parsegraph_SQLite_prepare(parsegraph_Session* session, parsegraph_StatementId id)
+{
+    return getNativeStatement(session, id) ? 0 : -1;
+}
+
+/**
+ * Returns a reset statement ready for binding. A statement that is already in
+ * use by an open cursor is duplicated, and *owned is set so that the caller
+ * finalizes the copy. Otherwise the statement is marked in use until
+ * releaseStatement.
+ */
+static sqlite3_stmt* acquireStatement(parsegraph_Session* session, parsegraph_StatementId id, struct parsegraph_SQLiteStatement** defOut, int* owned)
+{
+    struct parsegraph_SQLiteStatement* def = getNativeStatement(session, id);
+    if(!def) {
+        return 0;
+    }
+    *defOut = def;
+    *owned = 0;
+    if(!def->inUse) {
+        def->inUse = 1;
+        return def->stmt;
+    }
+    sqlite3_stmt* copy = 0;
+    if(SQLITE_OK != sqlite3_prepare_v2(session->sqlite->db, sqlite3_sql(def->stmt), -1, &copy, 0)) {
+        return 0;
+    }
+    *owned = 1;
+    return copy;
+}
+
+static void releaseStatement(struct parsegraph_SQLiteStatement* def, sqlite3_stmt* stmt, int owned)
+{
+    if(owned) {
+        sqlite3_finalize(stmt);
+        return;
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    def->inUse = 0;
+}
+
+static int bindArgs(sqlite3_stmt* stmt, struct parsegraph_SQLiteStatement* def, int binary, const void** args, int nargs)
+{
+    int arg = 0;
+    for(int i = 0; i < def->nparams; ++i) {
+        int rv;
+        if(arg >= nargs) {
+            return SQLITE_RANGE;
+        }
+        const void* value = args[arg++];
+        if(!binary) {
+            // Text arguments are converted by column affinity, as apr_dbd does.
+            rv = value ? sqlite3_bind_text(stmt, i + 1, value, -1, SQLITE_STATIC) : sqlite3_bind_null(stmt, i + 1);
+        }
+        else if(!value || def->types[i] == 'n') {
+            rv = sqlite3_bind_null(stmt, i + 1);
+        }
+        else if(def->types[i] == 'i') {
+            rv = sqlite3_bind_int(stmt, i + 1, *(const int*)value);
+        }
+        else if(def->types[i] == 'b') {
+            // Blobs take the data, its size, and the table and column names.
+            if(arg + 3 > nargs) {
+                return SQLITE_RANGE;
+            }
+            apr_size_t size = *(const apr_size_t*)args[arg];
+            arg += 3;
+            rv = sqlite3_bind_blob(stmt, i + 1, value, size, SQLITE_STATIC);
+        }
+        else {
+            rv = sqlite3_bind_text(stmt, i + 1, value, -1, SQLITE_STATIC);
+        }
+        if(rv != SQLITE_OK) {
+            return rv;
+        }
+    }
+    return SQLITE_OK;
+}
+
+int parsegraph_SQLite_query(parsegraph_Session* session, parsegraph_StatementId id, int binary, int* nrows, const void** args, int nargs)
+{
+    struct parsegraph_SQLiteStatement* def;
+    int owned;
+    sqlite3_stmt* stmt = acquireStatement(session, id, &def, &owned);
+    if(!stmt) {
+        return APR_EGENERAL;
+    }
+
+    int rv = bindArgs(stmt, def, binary, args, nargs);
+    if(rv == SQLITE_OK) {
+        while(SQLITE_ROW == (rv = sqlite3_step(stmt)));
+    }
+    if(rv == SQLITE_DONE) {
+        rv = 0;
+        if(nrows) {
+            *nrows = sqlite3_changes(session->sqlite->db);
+        }
+    }
+    releaseStatement(def, stmt, owned);
+    return rv;
+}
+
+int parsegraph_SQLite_open(parsegraph_Cursor* cursor, const void** args, int nargs)
+{
+    struct parsegraph_SQLiteStatement* def;
+    sqlite3_stmt* stmt = acquireStatement(cursor->session, cursor->id, &def, &cursor->ownsStmt);
+    if(!stmt) {
+        return APR_EGENERAL;
+    }
+    cursor->stmt = stmt;
+    int rv = bindArgs(stmt, def, 1, args, nargs);
+    if(rv != SQLITE_OK) {
+        parsegraph_SQLite_close(cursor);
+    }
+    return rv;
+}
+
+int parsegraph_SQLite_next(parsegraph_Cursor* cursor)
+{
+    switch(sqlite3_step(cursor->stmt)) {
+    case SQLITE_ROW:
+        return APR_SUCCESS;
+    case SQLITE_DONE:
+        return APR_EOF;
+    default:
+        return APR_EGENERAL;
+    }
+}
+
+int parsegraph_SQLite_int(parsegraph_Cursor* cursor, int col, int* value)
+{
+    if(col >= sqlite3_column_count(cursor->stmt)) {
+        return APR_EGENERAL;
+    }
+    if(sqlite3_column_type(cursor->stmt, col) == SQLITE_NULL) {
+        return APR_ENOENT;
+    }
+    *value = sqlite3_column_int(cursor->stmt, col);
+    return APR_SUCCESS;
+}
+
+const char* parsegraph_SQLite_text(parsegraph_Cursor* cursor, int col)
+{
+    const unsigned char* text = sqlite3_column_text(cursor->stmt, col);
+    if(!text) {
+        return 0;
+    }
+    return apr_pstrmemdup(cursor->pool, (const char*)text, sqlite3_column_bytes(cursor->stmt, col));
+}
+
+void parsegraph_SQLite_close(parsegraph_Cursor* cursor)
+{
+    if(!cursor->stmt) {
+        return;
+    }
+    releaseStatement(&cursor->session->sqlite->statements[cursor->id], cursor->stmt, cursor->ownsStmt);
+    cursor->stmt = 0;
+}
+
+int parsegraph_SQLite_lastInsertId(parsegraph_Session* session, int* id)
+{
+    *id = (int)sqlite3_last_insert_rowid(session->sqlite->db);
+    return APR_SUCCESS;
+}
+
+int parsegraph_SQLite_supportsReturning(parsegraph_Session* session)
+{
+    return sqlite3_libversion_number() >= 3035000;
+}
+
+#else
+
+int parsegraph_Session_useNativeSQLite(parsegraph_Session* session)
+{
+    return APR_ENOTIMPL;
+}
+
+#endif // HAVE_SQLITE3
@@ -0,0 +1,671 @@
+#include "parsegraph_Statement.h"
+#include "parsegraph_sqlite.h"
+#include "parsegraph_SessionPool.h"
+#include <apr_strings.h>
+#include <apr_time.h>
+#include <stdarg.h>
+#include <string.h>
+
+struct parsegraph_StatementDef {
+    const char* label;
+    const char* sql;
+
+    // For INSERT statements, the new row's id column returned by
+    // parsegraph_insertReturning.
+    const char* returning;
+};
+
+static const struct parsegraph_StatementDef parsegraph_STATEMENTS[parsegraph_Statement_COUNT] = {
+    [parsegraph_Statement_lastInsertRowId] = { "parsegraph_lastInsertRowId", "SELECT last_insert_rowid()" },
+
+    [parsegraph_Statement_List_new] = { "parsegraph_List_new", "INSERT INTO list_item(value) VALUES(%s)", "id" },
+    [parsegraph_Statement_List_getID] = { "parsegraph_List_getID", "SELECT id from list_item WHERE list_id IS NULL AND value = %s" },
+    [parsegraph_Statement_List_getName] = { "parsegraph_List_getName", "SELECT value, type from list_item WHERE id = %d" },
+    [parsegraph_Statement_List_destroy] = { "parsegraph_List_destroy", "DELETE FROM list_item WHERE list_id IS NULL AND id = %d" },
+    [parsegraph_Statement_List_newItem] = { "parsegraph_List_newItem", "INSERT INTO list_item(list_id, type, value, prev, next) VALUES(%d, %d, %s, NULL, NULL)", "id" },
+    [parsegraph_Statement_List_append] = { "parsegraph_List_append", "UPDATE list_item SET next = %d WHERE list_id = %d and next IS NULL AND id IS NOT %d" },
+    [parsegraph_Statement_List_prepend] = { "parsegraph_List_prepend", "UPDATE list_item SET prev = %d WHERE list_id = %d and prev IS NULL AND id IS NOT %d" },
+    [parsegraph_Statement_List_truncate] = { "parsegraph_List_truncate", "DELETE FROM list_item WHERE list_id = %d" },
+    [parsegraph_Statement_List_getHead] = { "parsegraph_List_getHead", "SELECT id FROM list_item WHERE list_id = %d and prev IS NULL" },
+    [parsegraph_Statement_List_getTail] = { "parsegraph_List_getTail", "SELECT id FROM list_item WHERE list_id = %d and next IS NULL" },
+    [parsegraph_Statement_List_setPrev] = { "parsegraph_List_setPrev", "UPDATE list_item SET prev = %d WHERE id = %d" },
+    [parsegraph_Statement_List_setNext] = { "parsegraph_List_setNext", "UPDATE list_item SET next = %d WHERE id = %d" },
+    [parsegraph_Statement_List_getNext] = { "parsegraph_List_getNext", "SELECT next FROM list_item WHERE id = %d" },
+    [parsegraph_Statement_List_getPrev] = { "parsegraph_List_getPrev", "SELECT prev FROM list_item WHERE id = %d" },
+    [parsegraph_Statement_List_updateItem] = { "parsegraph_List_updateItem", "UPDATE list_item SET type = %d, value = %s WHERE id = %d" },
+    [parsegraph_Statement_List_removeItem] = { "parsegraph_List_removeItem", "UPDATE list_item SET next = NULL, prev = NULL WHERE id = %d" },
+    [parsegraph_Statement_List_destroyItem] = { "parsegraph_List_destroyItem", "DELETE FROM list_item WHERE id = %d" },
+    [parsegraph_Statement_List_listItems] = { "parsegraph_List_listItems", "SELECT id, next, prev, value, type FROM list_item WHERE list_id = %d" },
+    [parsegraph_Statement_List_length] = { "parsegraph_List_length", "SELECT COUNT(*) from list_item WHERE list_id IS %d" },
+    [parsegraph_Statement_List_getListId] = { "parsegraph_List_getListId", "SELECT list_id FROM list_item WHERE id = %d" },
+    [parsegraph_Statement_List_clearNext] = { "parsegraph_List_clearNext", "UPDATE list_item SET next = NULL WHERE id = %d" },
+    [parsegraph_Statement_List_clearPrev] = { "parsegraph_List_clearPrev", "UPDATE list_item SET prev = NULL WHERE id = %d" },
+    [parsegraph_Statement_List_setValue] = { "parsegraph_List_setValue", "UPDATE list_item SET value = %s WHERE id = %d" },
+    [parsegraph_Statement_List_setType] = { "parsegraph_List_setType", "UPDATE list_item SET type = %d WHERE id = %d" },
+    [parsegraph_Statement_List_reparentItems] = { "parsegraph_List_reparentItems", "UPDATE list_item SET list_id = %d WHERE list_id = %d" },
+    [parsegraph_Statement_List_setList] = { "parsegraph_List_setList", "UPDATE list_item SET list_id = %d WHERE id = %d" },
+
+    [parsegraph_Statement_user_getUser] = { "parsegraph_user_getUser", "SELECT id, password, password_salt, profile FROM \"user\" WHERE username = %s" },
+    [parsegraph_Statement_user_createNewUser] = { "parsegraph_user_createNewUser", "INSERT INTO \"user\"(username, password, password_salt) VALUES(%s, %s, %s)" },
+    [parsegraph_Statement_user_beginUserLogin] = { "parsegraph_user_beginUserLogin", "INSERT INTO login(username, selector, token_hash, created, last_seen) VALUES(%s, %s, %s, %s, %s)" },
+    [parsegraph_Statement_user_endUserLogin] = { "parsegraph_user_endUserLogin", "DELETE FROM login WHERE username = %s" },
+    [parsegraph_Statement_user_listUsers] = { "parsegraph_user_listUsers", "SELECT id, username FROM \"user\"" },
+    [parsegraph_Statement_user_listUsersAfter] = { "parsegraph_user_listUsersAfter", "SELECT id, username FROM \"user\" WHERE id > %d ORDER BY id LIMIT %d" },
+    [parsegraph_Statement_user_removeUser] = { "parsegraph_user_removeUser", "DELETE FROM \"user\" WHERE username = %s" },
+    [parsegraph_Statement_user_removeLoginRevocation] = { "parsegraph_user_removeLoginRevocation", "DELETE FROM login_revocation WHERE user_id IN (SELECT id FROM \"user\" WHERE username = %s)" },
+    [parsegraph_Statement_user_refreshUserLogin] = { "parsegraph_user_refreshUserLogin", "SELECT login.username, \"user\".id, login.token_hash, login.last_seen FROM login JOIN \"user\" ON \"user\".username = login.username WHERE selector = %s" },
+    [parsegraph_Statement_user_setUserProfile] = { "parsegraph_user_setUserProfile", "UPDATE \"user\" SET profile = %pDt WHERE username = %s" },
+    [parsegraph_Statement_user_changeUserPassword] = { "parsegraph_user_changeUserPassword", "UPDATE \"user\" SET password = %s, password_salt = %s WHERE username = %s" },
+    [parsegraph_Statement_user_grantSuperadmin] = { "parsegraph_user_grantSuperadmin", "UPDATE \"user\" SET is_super_admin = 1 WHERE username = %s" },
+    [parsegraph_Statement_user_revokeSuperadmin] = { "parsegraph_user_revokeSuperadmin", "UPDATE \"user\" SET is_super_admin = 0 WHERE username = %s" },
+    [parsegraph_Statement_user_banUser] = { "parsegraph_user_banUser", "UPDATE \"user\" SET is_banned = 1 WHERE username = %s" },
+    [parsegraph_Statement_user_unbanUser] = { "parsegraph_user_unbanUser", "UPDATE \"user\" SET is_banned = 0 WHERE username = %s" },
+    [parsegraph_Statement_user_allowSubscription] = { "parsegraph_user_allowSubscription", "UPDATE \"user\" SET allow_subscription = 1 WHERE username = %s" },
+    [parsegraph_Statement_user_disallowSubscription] = { "parsegraph_user_disallowSubscription", "UPDATE \"user\" SET allow_subscription = 0 WHERE username = %s" },
+    [parsegraph_Statement_user_loadUser] = { "parsegraph_user_loadUser", "SELECT id, username, password, password_salt, profile, is_super_admin, is_banned, allow_subscription, storage_list_id, disposed_list_id FROM \"user\" WHERE username = %s" },
+    [parsegraph_Statement_user_loadUserById] = { "parsegraph_user_loadUserById", "SELECT id, username, password, password_salt, profile, is_super_admin, is_banned, allow_subscription, storage_list_id, disposed_list_id FROM \"user\" WHERE id = %d" },
+    [parsegraph_Statement_user_revokeLogins] = { "parsegraph_user_revokeLogins", "INSERT INTO login_revocation(user_id, generation, revoked) SELECT id, %s, %s FROM \"user\" WHERE username = %s ON CONFLICT(user_id) DO UPDATE SET generation = CASE WHEN login_revocation.generation < excluded.generation THEN excluded.generation ELSE login_revocation.generation + 1 END, revoked = excluded.revoked" },
+    [parsegraph_Statement_user_getLoginGeneration] = { "parsegraph_user_getLoginGeneration", "SELECT generation FROM login_revocation WHERE user_id = %d" },
+    [parsegraph_Statement_user_listLoginRevocations] = { "parsegraph_user_listLoginRevocations", "SELECT user_id, generation FROM login_revocation" },
+    [parsegraph_Statement_user_pruneLoginRevocations] = { "parsegraph_user_pruneLoginRevocations", "DELETE FROM login_revocation WHERE revoked < %s" },
+    [parsegraph_Statement_user_touchLogin] = { "parsegraph_user_touchLogin", "UPDATE login SET last_seen = %s WHERE selector = %s" },
+    [parsegraph_Statement_user_sweepLogins] = { "parsegraph_user_sweepLogins", "DELETE FROM login WHERE id IN (SELECT id FROM login WHERE last_seen < %s LIMIT %d)" },
+
+    [parsegraph_Statement_Environment_destroyEnvironment] = { "parsegraph_Environment_destroyEnvironment", "DELETE FROM environment WHERE environment_uuid = %pDb" },
+    [parsegraph_Statement_Environment_getEnvironmentGUIDForId] = { "parsegraph_Environment_getEnvironmentGUIDForId", "SELECT environment_guid FROM environment WHERE environment_id = %d" },
+    [parsegraph_Statement_Environment_getEnvironmentIdForGUID] = { "parsegraph_Environment_getEnvironmentIdForGUID", "SELECT environment_id FROM environment WHERE environment_uuid = %pDb" },
+    [parsegraph_Statement_Environment_getEnvironmentTitleForGUID] = { "parsegraph_Environment_getEnvironmentTitleForGUID", "SELECT environment_title FROM environment WHERE environment_uuid = %pDb" },
+    [parsegraph_Statement_Environment_getEnvironmentTitleForId] = { "parsegraph_Environment_getEnvironmentTitleForId", "SELECT environment_title FROM environment WHERE environment_id = %d" },
+    [parsegraph_Statement_Environment_getSavedEnvironmentsForUser] = { "parsegraph_Environment_getSavedEnvironmentsForUser", "SELECT environment_guid, environment_title, save_date FROM saved_environment JOIN environment ON saved_environment.environment_id = environment.environment_id WHERE user_id = %d ORDER by save_date DESC" },
+    [parsegraph_Statement_Environment_saveEnvironment] = { "parsegraph_Environment_saveEnvironment", "INSERT INTO saved_environment(environment_id, user_id, save_date, client_state) VALUES(%d, %d, datetime('now'), %s)" },
+    [parsegraph_Statement_Environment_getOwnedEnvironmentsForUser] = { "parsegraph_Environment_getOwnedEnvironmentsForUser", "SELECT environment_guid, environment_title, create_date FROM environment WHERE owner = %d ORDER by create_date DESC" },
+    [parsegraph_Statement_Environment_getEnvironmentRoot] = { "parsegraph_Environment_getEnvironmentRoot", "SELECT root_list_id FROM environment WHERE environment_uuid = %pDb" },
+    [parsegraph_Statement_Environment_setEnvironmentRoot] = { "parsegraph_Environment_setEnvironmentRoot", "UPDATE environment SET root_list_id = %d WHERE environment_uuid = %pDb" },
+    [parsegraph_Statement_getMultislotItemAtIndex] = { "parsegraph_getMultislotItemAtIndex", "SELECT list_item.id FROM list_item JOIN list_item par on list_item.list_id = par.id WHERE list_item.list_id = %d AND par.type = 4 AND list_item.type = %d" },
+    [parsegraph_Statement_Environment_setStorageItemList] = { "parsegraph_Environment_setStorageItemList", "UPDATE \"user\" SET storage_list_id = %d WHERE id = %d" },
+    [parsegraph_Statement_Environment_setDisposedItemList] = { "parsegraph_Environment_setDisposedItemList", "UPDATE \"user\" SET disposed_list_id = %d WHERE id = %d" },
+    [parsegraph_Statement_Environment_setMultislotPublic] = { "parsegraph_Environment_setMultislotPublic", "INSERT INTO public_multislot(multislot_id) VALUES(%d)" },
+    [parsegraph_Statement_Environment_setMultislotPrivate] = { "parsegraph_Environment_setMultislotPrivate", "DELETE FROM public_multislot WHERE multislot_id = %d" },
+    [parsegraph_Statement_Environment_createMultislotPlot] = { "parsegraph_Environment_createMultislotPlot", "INSERT INTO multislot_plot(multislot_id, user_id, plot_index, plot_length) values(%d, %d, %d, %d)", "plot_id" },
+    [parsegraph_Statement_Environment_getMultislotInfo] = { "parsegraph_Environment_getMultislotInfo", "SELECT multislot_id, environment_guid, list_item.value FROM multislot JOIN environment ON multislot.environment_id = environment.environment_id JOIN list_item ON multislot.multislot_id = list_item.id WHERE id = %d" },
+    [parsegraph_Statement_Environment_createEnvironmentWithGUID] = { "parsegraph_Environment_createEnvironmentWithGUID", "INSERT INTO environment(environment_guid, environment_uuid, for_new_users, for_administrators, create_date, open_to_public, open_for_visits, open_for_modification, visit_count, owner, root_list_id, environment_type_id) VALUES(%s, %pDb, 0, 0, strftime('%%Y-%%m-%%dT%%H:%%M:%%f', 'now'), 0, 0, 0, 0, %d, %d, %d)", "environment_id" },
+};
+
+// Statements whose SQL differs for PostgreSQL, with the same parameters.
+static const char* parsegraph_PGSQL_STATEMENTS[parsegraph_Statement_COUNT] = {
+    [parsegraph_Statement_lastInsertRowId] = "SELECT lastval()",
+    [parsegraph_Statement_List_append] = "UPDATE list_item SET next = %d WHERE list_id = %d and next IS NULL AND id IS DISTINCT FROM %d",
+    [parsegraph_Statement_List_prepend] = "UPDATE list_item SET prev = %d WHERE list_id = %d and prev IS NULL AND id IS DISTINCT FROM %d",
+    [parsegraph_Statement_List_length] = "SELECT COUNT(*) from list_item WHERE list_id IS NOT DISTINCT FROM %d",
+    [parsegraph_Statement_Environment_saveEnvironment] = "INSERT INTO saved_environment(environment_id, user_id, save_date, client_state) VALUES(%d, %d, to_char(now() at time zone 'utc', 'YYYY-MM-DD HH24:MI:SS'), %s)",
+    [parsegraph_Statement_Environment_createEnvironmentWithGUID] = "INSERT INTO environment(environment_guid, environment_uuid, for_new_users, for_administrators, create_date, open_to_public, open_for_visits, open_for_modification, visit_count, owner, root_list_id, environment_type_id) VALUES(%s, %pDb, 0, 0, to_char(now() at time zone 'utc', 'YYYY-MM-DD\"T\"HH24:MI:SS.MS'), 0, 0, 0, 0, %d, %d, %d)",
+};
+
+static const char* dialectSql(parsegraph_Session* session, parsegraph_StatementId id)
+{
+    if(session->dialect == parsegraph_Dialect_PGSQL && parsegraph_PGSQL_STATEMENTS[id]) {
+        return parsegraph_PGSQL_STATEMENTS[id];
+    }
+    return parsegraph_STATEMENTS[id].sql;
+}
+
+const char* parsegraph_nameStatement(parsegraph_StatementId id)
+{
+    if(id < 0 || id >= parsegraph_Statement_COUNT) {
+        return "unknown statement";
+    }
+    return parsegraph_STATEMENTS[id].label;
+}
+
+const char* parsegraph_Statement_sql(parsegraph_StatementId id)
+{
+    if(id < 0 || id >= parsegraph_Statement_COUNT) {
+        return 0;
+    }
+    return parsegraph_STATEMENTS[id].sql;
+}
+
+static int detectInsertReturning(parsegraph_Session* session)
+{
+    ap_dbd_t* dbd = session->dbd;
+    const char* driver = apr_dbd_name(dbd->driver);
+    if(!strcmp(driver, "pgsql")) {
+        return 1;
+    }
+    if(strcmp(driver, "sqlite3")) {
+        return 0;
+    }
+#ifdef HAVE_SQLITE3
+    // apr_dbd's driver runs the same SQLite library as the native backend.
+    return parsegraph_SQLite_supportsReturning(session);
+#else
+    // RETURNING first appeared in SQLite 3.35.
+    apr_dbd_results_t* res = 0;
+    if(0 != apr_dbd_select(dbd->driver, session->pool, dbd->handle, &res, "SELECT sqlite_version()", 0)) {
+        return 0;
+    }
+    apr_dbd_row_t* row = 0;
+    if(0 != apr_dbd_get_row(dbd->driver, session->pool, res, &row, -1)) {
+        return 0;
+    }
+    const char* version = apr_dbd_get_entry(dbd->driver, row, 0);
+    int major = 0, minor = 0;
+    if(!version || 2 != sscanf(version, "%d.%d", &major, &minor)) {
+        return 0;
+    }
+    return major > 3 || (major == 3 && minor >= 35);
+#endif
+}
+
+int parsegraph_supportsInsertReturning(parsegraph_Session* session)
+{
+    if(session->insertReturning == 0) {
+        session->insertReturning = detectInsertReturning(session) ? 1 : -1;
+    }
+    return session->insertReturning > 0;
+}
+
+const char* parsegraph_preparedStatementSql(parsegraph_Session* session, parsegraph_StatementId id)
+{
+    const struct parsegraph_StatementDef* def = &parsegraph_STATEMENTS[id];
+    if(!def->returning || !parsegraph_supportsInsertReturning(session)) {
+        return dialectSql(session, id);
+    }
+    return apr_pstrcat(session->statePool, dialectSql(session, id), " RETURNING ", def->returning, NULL);
+}
+
+apr_dbd_prepared_t* parsegraph_getStatement(parsegraph_Session* session, parsegraph_StatementId id)
+{
+    if(id < 0 || id >= parsegraph_Statement_COUNT) {
+        marla_logMessagef(session->server, "Statement %d is not in the statement catalog.", id);
+        return 0;
+    }
+    apr_dbd_prepared_t* stmt = session->statements[id];
+    if(stmt) {
+        return stmt;
+    }
+
+    ap_dbd_t* dbd = session->dbd;
+    const struct parsegraph_StatementDef* def = &parsegraph_STATEMENTS[id];
+
+    // Use a statement already prepared on this connection by another session.
+    if(dbd->prepared) {
+        stmt = apr_hash_get(dbd->prepared, def->label, APR_HASH_KEY_STRING);
+        if(stmt) {
+            session->statements[id] = stmt;
+            return stmt;
+        }
+    }
+
+    // Published statements belong to the connection, and live as long as it
+    // does. On pgsql they are prepared on the server under their label, and
+    // stay there until the connection closes, so they may not be prepared
+    // again by a later session on the same connection.
+    apr_pool_t* pool = dbd->prepared ? dbd->pool : session->statePool;
+    int rv = apr_dbd_prepare(dbd->driver, pool, dbd->handle, parsegraph_preparedStatementSql(session, id), def->label, &stmt);
+    if(rv != 0) {
+        marla_logMessagef(session->server, "Failed preparing %s statement [%s]",
+            def->label,
+            apr_dbd_error(dbd->driver, dbd->handle, rv)
+        );
+        return 0;
+    }
+    if(dbd->prepared) {
+        apr_hash_set(dbd->prepared, def->label, APR_HASH_KEY_STRING, stmt);
+    }
+
+    session->statements[id] = stmt;
+    return stmt;
+}
+
+void parsegraph_releaseStatements(parsegraph_Session* session)
+{
+    memset(session->statements, 0, sizeof(apr_dbd_prepared_t*) * parsegraph_Statement_COUNT);
+}
+
+int parsegraph_hasStatement(parsegraph_Session* session, parsegraph_StatementId id)
+{
+    if(id < 0 || id >= parsegraph_Statement_COUNT) {
+        marla_logMessagef(session->server, "Statement %d is not in the statement catalog.", id);
+        return 0;
+    }
+#ifdef HAVE_SQLITE3
+    if(session->sqlite) {
+        // Native statements are prepared when first run, and result sets
+        // prepare their apr_dbd statement then too.
+        return 1;
+    }
+#endif
+    return parsegraph_getStatement(session, id) != 0;
+}
+
+int parsegraph_prepareStatements(parsegraph_Session* session, parsegraph_StatementId first, parsegraph_StatementId last)
+{
+    int failures = 0;
+    for(int id = first; id <= last; ++id) {
+#ifdef HAVE_SQLITE3
+        if(session->sqlite) {
+            if(0 != parsegraph_SQLite_prepare(session, id)) {
+                ++failures;
+            }
+            continue;
+        }
+#endif
+        if(!parsegraph_getStatement(session, id)) {
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+// Returns the number of arguments the given statement reads when executed.
+// Binary blob parameters read four values; every other parameter reads one.
+static int countStatementArgs(const char* sql, int binary)
+{
+    int nargs = 0;
+    for(const char* c = sql; *c; ++c) {
+        if(*c != '%') {
+            continue;
+        }
+        ++c;
+        if(*c == '%') {
+            continue;
+        }
+        if(*c == 0) {
+            break;
+        }
+        if(binary && c[0] == 'p' && c[1] == 'D' && (c[2] == 'b' || c[2] == 'c')) {
+            nargs += 4;
+        }
+        else {
+            ++nargs;
+        }
+    }
+    return nargs;
+}
+
+static void recordStatement(parsegraph_Session* session, parsegraph_StatementId id, apr_time_t elapsed, int failed, int rowsReturned, int rowsAffected)
+{
+    parsegraph_StatementStats* stats = &session->statementStats[id];
+    ++stats->calls;
+    stats->totalTime += elapsed;
+    if(elapsed > stats->maxTime) {
+        stats->maxTime = elapsed;
+    }
+    if(failed) {
+        ++stats->errors;
+    }
+    if(rowsReturned > 0) {
+        stats->rowsReturned += rowsReturned;
+    }
+    if(rowsAffected > 0) {
+        stats->rowsAffected += rowsAffected;
+    }
+}
+
+static int collectStatementArgs(parsegraph_Session* session, parsegraph_StatementId id, int binary, const void** args, va_list ap)
+{
+    int nargs = countStatementArgs(parsegraph_STATEMENTS[id].sql, binary);
+    if(nargs > parsegraph_MAX_STATEMENT_ARGS) {
+        marla_logMessagef(session->server, "%s statement has too many arguments.", parsegraph_nameStatement(id));
+        return -1;
+    }
+    for(int i = 0; i < nargs; ++i) {
+        args[i] = va_arg(ap, const void*);
+    }
+    return nargs;
+}
+
+// Returns non-zero if the statement only reads, and so may run on a reader.
+static int isReadStatement(parsegraph_StatementId id)
+{
+    // last_insert_rowid() reads state of the writer's connection.
+    if(id == parsegraph_Statement_lastInsertRowId) {
+        return 0;
+    }
+    return !strncasecmp(parsegraph_STATEMENTS[id].sql, "SELECT", 6);
+}
+
+// Checks out one of the session's readers to run the given statement, or
+// returns NULL if it should run on the session's own connection. Reads go to
+// the writer while a transaction is open so they see its uncommitted writes.
+static parsegraph_Session* checkoutReader(parsegraph_Session* session, parsegraph_StatementId id)
+{
+    if(!session->readers || session->transactionDepth > 0 || !isReadStatement(id)) {
+        return 0;
+    }
+    parsegraph_Session* reader;
+    if(APR_SUCCESS != parsegraph_SessionPool_checkout(session->readers, 0, &reader)) {
+        // Every reader is busy; the writer is idle, so use it instead of waiting.
+        return 0;
+    }
+    return reader;
+}
+
+// Runs the statement on the given session's connection, and records it in
+// the stats of origin, the session it was run for.
+static int runStatement(parsegraph_Session* session, parsegraph_Session* origin, apr_pool_t* pool, parsegraph_StatementId id, int binary, int* nrows, apr_dbd_results_t** res, int random, va_list ap)
+{
+    // The native backend prepares its own statements.
+    apr_dbd_prepared_t* stmt = 0;
+#ifdef HAVE_SQLITE3
+    if(res || !session->sqlite)
+#endif
+    {
+        stmt = parsegraph_getStatement(session, id);
+        if(!stmt) {
+            return APR_EGENERAL;
+        }
+    }
+
+    const void* args[parsegraph_MAX_STATEMENT_ARGS];
+    int nargs = collectStatementArgs(session, id, binary, args, ap);
+    if(nargs < 0) {
+        recordStatement(origin, id, 0, 1, 0, 0);
+        return APR_EGENERAL;
+    }
+
+    ap_dbd_t* dbd = session->dbd;
+    apr_time_t start = apr_time_now();
+    int rv;
+    if(res) {
+        // The native backend only serves cursors; results sets still come from apr_dbd.
+        if(binary) {
+            rv = apr_dbd_pbselect(dbd->driver, pool, dbd->handle, res, stmt, random, args);
+        }
+        else {
+            rv = apr_dbd_pselect(dbd->driver, pool, dbd->handle, res, stmt, random, nargs, (const char**)args);
+        }
+    }
+#ifdef HAVE_SQLITE3
+    else if(session->sqlite) {
+        rv = parsegraph_SQLite_query(session, id, binary, nrows, args, nargs);
+    }
+#endif
+    else {
+        if(binary) {
+            rv = apr_dbd_pbquery(dbd->driver, pool, dbd->handle, nrows, stmt, args);
+        }
+        else {
+            rv = apr_dbd_pquery(dbd->driver, pool, dbd->handle, nrows, stmt, nargs, (const char**)args);
+        }
+    }
+    apr_time_t elapsed = apr_time_now() - start;
+
+    // Sequential result sets do not know their size until they are read, so
+    // only random ones and those SQLite buffers are counted. Cursors count
+    // the rows they read instead.
+    int rowsReturned = 0;
+    if(rv == 0 && res && (random || !strcmp(apr_dbd_name(dbd->driver), "sqlite3"))) {
+        rowsReturned = apr_dbd_num_tuples(dbd->driver, *res);
+    }
+    recordStatement(origin, id, elapsed, rv != 0, rowsReturned, (rv == 0 && !res && nrows) ? *nrows : 0);
+    return rv;
+}
+
+static int parsegraph_executeStatement(parsegraph_Session* session, apr_pool_t* pool, parsegraph_StatementId id, int binary, int* nrows, apr_dbd_results_t** res, int random, va_list ap)
+{
+    // Sequential result sets may read from their connection as rows are
+    // fetched, so only those buffered by SQLite are taken from a reader.
+    parsegraph_Session* reader = 0;
+    if(res && (random || !strcmp(apr_dbd_name(session->dbd->driver), "sqlite3"))) {
+        reader = checkoutReader(session, id);
+    }
+    if(reader) {
+        int rv = runStatement(reader, session, pool, id, binary, nrows, res, random, ap);
+        parsegraph_SessionPool_checkin(session->readers, reader);
+        return rv;
+    }
+    return runStatement(session, session, pool, id, binary, nrows, res, random, ap);
+}
+
+int parsegraph_pvquery(parsegraph_Session* session, apr_pool_t* pool, int* nrows, parsegraph_StatementId id, ...)
+{
+    va_list ap;
+    va_start(ap, id);
+    int rv = parsegraph_executeStatement(session, pool, id, 0, nrows, 0, 0, ap);
+    va_end(ap);
+    return rv;
+}
+
+int parsegraph_pvselect(parsegraph_Session* session, apr_pool_t* pool, apr_dbd_results_t** res, parsegraph_StatementId id, int random, ...)
+{
+    va_list ap;
+    va_start(ap, random);
+    int rv = parsegraph_executeStatement(session, pool, id, 0, 0, res, random, ap);
+    va_end(ap);
+    return rv;
+}
+
+int parsegraph_pvbquery(parsegraph_Session* session, apr_pool_t* pool, int* nrows, parsegraph_StatementId id, ...)
+{
+    va_list ap;
+    va_start(ap, id);
+    int rv = parsegraph_executeStatement(session, pool, id, 1, nrows, 0, 0, ap);
+    va_end(ap);
+    return rv;
+}
+
+int parsegraph_pvbselect(parsegraph_Session* session, apr_pool_t* pool, apr_dbd_results_t** res, parsegraph_StatementId id, int random, ...)
+{
+    va_list ap;
+    va_start(ap, random);
+    int rv = parsegraph_executeStatement(session, pool, id, 1, 0, res, random, ap);
+    va_end(ap);
+    return rv;
+}
+
+static int openCursor(parsegraph_Cursor* cursor, parsegraph_Session* session, apr_pool_t* pool, parsegraph_StatementId id, va_list ap)
+{
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->pool = pool;
+    cursor->id = id;
+    cursor->origin = session;
+
+    // The cursor holds its reader until it is closed.
+    parsegraph_Session* reader = checkoutReader(session, id);
+    if(reader) {
+        cursor->readers = session->readers;
+        session = reader;
+    }
+
+    // The native backend prepares its own statements.
+    apr_dbd_prepared_t* stmt = 0;
+    int prepared = 1;
+#ifdef HAVE_SQLITE3
+    if(!session->sqlite)
+#endif
+    {
+        stmt = parsegraph_getStatement(session, id);
+        prepared = stmt != 0;
+    }
+    const void* args[parsegraph_MAX_STATEMENT_ARGS];
+    int nargs = prepared ? collectStatementArgs(session, id, 1, args, ap) : -1;
+    if(nargs < 0) {
+        if(prepared) {
+            recordStatement(cursor->origin, id, 0, 1, 0, 0);
+        }
+        if(reader) {
+            parsegraph_SessionPool_checkin(cursor->readers, reader);
+            cursor->readers = 0;
+        }
+        return APR_EGENERAL;
+    }
+
+    cursor->session = session;
+    cursor->start = apr_time_now();
+    int rv;
+#ifdef HAVE_SQLITE3
+    if(session->sqlite) {
+        rv = parsegraph_SQLite_open(cursor, args, nargs);
+    }
+    else
+#endif
+    {
+        ap_dbd_t* dbd = session->dbd;
+        rv = apr_dbd_pbselect(dbd->driver, pool, dbd->handle, &cursor->res, stmt, 0, args);
+    }
+    if(rv != 0) {
+        recordStatement(cursor->origin, id, apr_time_now() - cursor->start, 1, 0, 0);
+        cursor->session = 0;
+        if(reader) {
+            parsegraph_SessionPool_checkin(cursor->readers, reader);
+            cursor->readers = 0;
+        }
+    }
+    return rv;
+}
+
+int parsegraph_Cursor_open(parsegraph_Cursor* cursor, parsegraph_Session* session, apr_pool_t* pool, parsegraph_StatementId id, ...)
+{
+    va_list ap;
+    va_start(ap, id);
+    int rv = openCursor(cursor, session, pool, id, ap);
+    va_end(ap);
+    return rv;
+}
+
+int parsegraph_Cursor_next(parsegraph_Cursor* cursor)
+{
+    int rv;
+#ifdef HAVE_SQLITE3
+    if(cursor->stmt) {
+        rv = parsegraph_SQLite_next(cursor);
+    }
+    else
+#endif
+    {
+        ap_dbd_t* dbd = cursor->session->dbd;
+        rv = apr_dbd_get_row(dbd->driver, cursor->pool, cursor->res, &cursor->row, -1);
+        if(rv == -1) {
+            rv = APR_EOF;
+        }
+    }
+    if(rv == APR_SUCCESS) {
+        ++cursor->rows;
+    }
+    else if(rv != APR_EOF) {
+        cursor->failed = 1;
+    }
+    return rv;
+}
+
+int parsegraph_Cursor_int(parsegraph_Cursor* cursor, int col, int* value)
+{
+#ifdef HAVE_SQLITE3
+    if(cursor->stmt) {
+        return parsegraph_SQLite_int(cursor, col, value);
+    }
+#endif
+    ap_dbd_t* dbd = cursor->session->dbd;
+    return apr_dbd_datum_get(dbd->driver, cursor->row, col, APR_DBD_TYPE_INT, value);
+}
+
+const char* parsegraph_Cursor_text(parsegraph_Cursor* cursor, int col)
+{
+#ifdef HAVE_SQLITE3
+    if(cursor->stmt) {
+        return parsegraph_SQLite_text(cursor, col);
+    }
+#endif
+    ap_dbd_t* dbd = cursor->session->dbd;
+    return apr_dbd_get_entry(dbd->driver, cursor->row, col);
+}
+
+void parsegraph_Cursor_close(parsegraph_Cursor* cursor)
+{
+    if(!cursor->session) {
+        return;
+    }
+#ifdef HAVE_SQLITE3
+    if(cursor->stmt) {
+        parsegraph_SQLite_close(cursor);
+    }
+#endif
+    recordStatement(cursor->origin, cursor->id, apr_time_now() - cursor->start, cursor->failed, cursor->rows, 0);
+    if(cursor->readers) {
+        parsegraph_SessionPool_checkin(cursor->readers, cursor->session);
+        cursor->readers = 0;
+    }
+    cursor->session = 0;
+}
+
+int parsegraph_selectInt(parsegraph_Session* session, apr_pool_t* pool, parsegraph_StatementId id, int* value, ...)
+{
+    parsegraph_Cursor cursor;
+    va_list ap;
+    va_start(ap, value);
+    int rv = openCursor(&cursor, session, pool, id, ap);
+    va_end(ap);
+    if(rv != 0) {
+        return rv;
+    }
+
+    rv = parsegraph_Cursor_next(&cursor);
+    if(rv == APR_EOF) {
+        rv = APR_ENOENT;
+    }
+    else if(rv == APR_SUCCESS) {
+        rv = parsegraph_Cursor_int(&cursor, 0, value);
+        if(rv != APR_SUCCESS && rv != APR_ENOENT) {
+            cursor.failed = 1;
+        }
+    }
+    parsegraph_Cursor_close(&cursor);
+    return rv;
+}
+
+int parsegraph_lastInsertId(parsegraph_Session* session, int* id)
+{
+#ifdef HAVE_SQLITE3
+    if(session->sqlite) {
+        return parsegraph_SQLite_lastInsertId(session, id);
+    }
+#endif
+    return parsegraph_selectInt(session, session->pool, parsegraph_Statement_lastInsertRowId, id);
+}
+
+int parsegraph_insertReturning(parsegraph_Session* session, apr_pool_t* pool, parsegraph_StatementId id, int* rowId, ...)
+{
+    const struct parsegraph_StatementDef* def = &parsegraph_STATEMENTS[id];
+    if(!def->returning) {
+        marla_logMessagef(session->server, "%s statement does not return a row id.", def->label);
+        return APR_EGENERAL;
+    }
+
+    va_list ap;
+    va_start(ap, rowId);
+    int rv;
+    if(parsegraph_supportsInsertReturning(session)) {
+        parsegraph_Cursor cursor;
+        rv = openCursor(&cursor, session, pool, id, ap);
+        va_end(ap);
+        if(rv != 0) {
+            return rv;
+        }
+        rv = parsegraph_Cursor_next(&cursor);
+        if(rv == APR_EOF) {
+            rv = APR_ENOENT;
+        }
+        else if(rv == APR_SUCCESS) {
+            rv = parsegraph_Cursor_int(&cursor, 0, rowId);
+            if(rv == APR_SUCCESS && APR_EOF != parsegraph_Cursor_next(&cursor)) {
+                // More than one row was inserted.
+                rv = APR_EGENERAL;
+            }
+        }
+        parsegraph_Cursor_close(&cursor);
+        return rv;
+    }
+
+    int nrows = 0;
+    rv = parsegraph_executeStatement(session, pool, id, 1, &nrows, 0, 0, ap);
+    va_end(ap);
+    if(rv != 0) {
+        return rv;
+    }
+    if(nrows != 1) {
+        return nrows == 0 ? APR_ENOENT : APR_EGENERAL;
+    }
+    return parsegraph_lastInsertId(session, rowId);
+}
@@ -0,0 +1,42 @@
+#include "parsegraph_Statement.h"
+#include <string.h>
+
+parsegraph_StatementStats* parsegraph_Stats_get(parsegraph_Session* session, parsegraph_StatementId id)
+{
+    if(id < 0 || id >= parsegraph_Statement_COUNT) {
+        return 0;
+    }
+    return &session->statementStats[id];
+}
+
+void parsegraph_Stats_reset(parsegraph_Session* session)
+{
+    memset(session->statementStats, 0, sizeof(parsegraph_StatementStats) * parsegraph_Statement_COUNT);
+}
+
+/**
+ * Writes one tab-separated line per executed statement:
+ *
+ * label calls errors total_usec max_usec rows_returned rows_affected
+ *
+ * Dumps from many sessions may be appended to the same file; parsegraph_stats
+ * merges them by label.
+ */
+void parsegraph_Stats_dump(parsegraph_Session* session, FILE* sink)
+{
+    for(int id = 0; id < parsegraph_Statement_COUNT; ++id) {
+        parsegraph_StatementStats* stats = &session->statementStats[id];
+        if(stats->calls == 0) {
+            continue;
+        }
+        fprintf(sink, "%s\t%lu\t%lu\t%ld\t%ld\t%lu\t%lu\n",
+            parsegraph_nameStatement(id),
+            (unsigned long)stats->calls,
+            (unsigned long)stats->errors,
+            (long)stats->totalTime,
+            (long)stats->maxTime,
+            (unsigned long)stats->rowsReturned,
+            (unsigned long)stats->rowsAffected
+        );
+    }
+}
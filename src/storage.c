@@ -1,4 +1,5 @@
 #include "parsegraph_environment.h"
+#include "parsegraph_Statement.h"
 #include <parsegraph_user.h>
 
 parsegraph_EnvironmentStatus parsegraph_showStorageItem(parsegraph_Session* session, int userId, int itemId)
@@ -315,8 +316,7 @@ parsegraph_EnvironmentStatus parsegraph_setStorageItemList(parsegraph_Session* s
     }
 
     const char* queryName = "parsegraph_Environment_setStorageItemList";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_Environment_setStorageItemList)) {
          // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         parsegraph_rollbackTransaction(session, transactionName);
@@ -324,7 +324,8 @@ parsegraph_EnvironmentStatus parsegraph_setStorageItemList(parsegraph_Session* s
     }
 
     int nrows = 0;
-    int dbrv = apr_dbd_pvbquery(dbd->driver, pool, dbd->handle, &nrows, query, &storageItemList, &userId);
+    int dbrv = parsegraph_pvbquery(session, pool, &nrows, parsegraph_Statement_Environment_setStorageItemList, &storageItemList, &userId);
+    parsegraph_Session_forgetUsers(session);
     if(dbrv != 0) {
         marla_logMessagef(session->server,
             "%s query failed to execute: %s", queryName,
@@ -354,15 +355,15 @@ parsegraph_EnvironmentStatus parsegraph_setDisposedItemList(parsegraph_Session*
     ap_dbd_t* dbd = session->dbd;
 
     const char* queryName = "parsegraph_Environment_setDisposedItemList";
-    apr_dbd_prepared_t* query = apr_hash_get(dbd->prepared, queryName, APR_HASH_KEY_STRING);
-    if(query == NULL) {
+    if(!parsegraph_hasStatement(session, parsegraph_Statement_Environment_setDisposedItemList)) {
          // Query was not defined.
         marla_logMessagef(session->server, "%s query was not defined.", queryName);
         return parsegraph_Environment_UNDEFINED_PREPARED_STATEMENT;
     }
 
     int nrows;
-    int dbrv = apr_dbd_pvbquery(dbd->driver, pool, dbd->handle, &nrows, query, &userId, &disposedItemList);
+    int dbrv = parsegraph_pvbquery(session, pool, &nrows, parsegraph_Statement_Environment_setDisposedItemList, &disposedItemList, &userId);
+    parsegraph_Session_forgetUsers(session);
     if(dbrv != 0) {
         marla_logMessagef(session->server,
             "%s query failed to execute: %s", queryName,
@@ -382,77 +383,23 @@ parsegraph_EnvironmentStatus parsegraph_setDisposedItemList(parsegraph_Session*
 
 parsegraph_EnvironmentStatus parsegraph_getStorageItemList(parsegraph_Session* session, int userId, int* storageItemList)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
-
     const char* transactionName = "parsegraph_getStorageItemList";
     if(parsegraph_OK != parsegraph_beginTransaction(session, transactionName)) {
         return parsegraph_Environment_INTERNAL_ERROR;
     }
 
-    const char* queryName = "parsegraph_Environment_getStorageItemList";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
-         // Query was not defined.
-        marla_logMessagef(session->server,
-            "%s query was not defined.", queryName
-        );
-        parsegraph_rollbackTransaction(session, transactionName);
-        return parsegraph_Environment_UNDEFINED_PREPARED_STATEMENT;
-    }
-
-    apr_dbd_results_t* res = 0;
-    int dbrv = apr_dbd_pvbselect(
-        dbd->driver,
-        pool,
-        dbd->handle,
-        &res,
-        query,
-        0,
-        &userId
-    );
-    if(dbrv != 0) {
-        marla_logMessagef(session->server,
-            "%s query failed to execute: [%s]", queryName,
-            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
-        );
+    parsegraph_UserRecord* user;
+    switch(parsegraph_loadUserById(session, userId, &user)) {
+    case parsegraph_OK:
+        *storageItemList = user->storageListId;
+        break;
+    case parsegraph_USER_DOES_NOT_EXIST:
+        *storageItemList = -1;
+        break;
+    default:
         parsegraph_rollbackTransaction(session, transactionName);
         return parsegraph_Environment_INTERNAL_ERROR;
     }
-    apr_dbd_row_t* row = 0;
-    dbrv = apr_dbd_get_row(
-        dbd->driver,
-        pool,
-        res,
-        &row,
-        -1
-    );
-    if(dbrv != 0) {
-        *storageItemList = -1;
-    }
-    else {
-        switch(apr_dbd_datum_get(
-            dbd->driver,
-            row,
-            0,
-            APR_DBD_TYPE_INT,
-            storageItemList
-        )) {
-        case APR_SUCCESS:
-            break;
-        case APR_ENOENT:
-            *storageItemList = -1;
-            break;
-        case APR_EGENERAL:
-            marla_logMessagef(session->server,
-                "Failed to retrieve storage_list_id."
-            );
-            parsegraph_rollbackTransaction(session, transactionName);
-            return parsegraph_Environment_INTERNAL_ERROR;
-        }
-    }
 
     if(*storageItemList == -1) {
         // No list, so make one.
@@ -479,57 +426,18 @@ parsegraph_EnvironmentStatus parsegraph_getStorageItemList(parsegraph_Session* s
 
 parsegraph_EnvironmentStatus parsegraph_getDisposedItemList(parsegraph_Session* session, int userId, int* disposedItemList)
 {
-    apr_pool_t* pool = session->pool;
-    ap_dbd_t* dbd = session->dbd;
-
-    const char* queryName = "parsegraph_Environment_getDisposedItemList";
-    apr_dbd_prepared_t* query = apr_hash_get(
-        dbd->prepared, queryName, APR_HASH_KEY_STRING
-    );
-    if(query == NULL) {
-         // Query was not defined.
-        marla_logMessagef(session->server,
-            "%s query was not defined.", queryName
-        );
-        return parsegraph_Environment_UNDEFINED_PREPARED_STATEMENT;
-    }
-
-    apr_dbd_results_t* res = 0;
-    int dbrv = apr_dbd_pvbselect(dbd->driver, pool, dbd->handle, &res, query, 0, &userId);
-    if(dbrv != 0) {
-        marla_logMessagef(session->server,
-            "%s query failed to execute: [%s]", queryName,
-            apr_dbd_error(dbd->driver, dbd->handle, dbrv)
-        );
-        return parsegraph_Environment_INTERNAL_ERROR;
-    }
-    apr_dbd_row_t* row = 0;
-    dbrv = apr_dbd_get_row(dbd->driver, pool, res, &row, -1);
-    if(dbrv != 0) {
-        *disposedItemList = -1;
-        goto make_new_list;
-    }
-
-    switch(apr_dbd_datum_get(
-        dbd->driver,
-        row,
-        0,
-        APR_DBD_TYPE_INT,
-        disposedItemList
-    )) {
-    case APR_SUCCESS:
+    parsegraph_UserRecord* user;
+    switch(parsegraph_loadUserById(session, userId, &user)) {
+    case parsegraph_OK:
+        *disposedItemList = user->disposedListId;
         break;
-    case APR_ENOENT:
+    case parsegraph_USER_DOES_NOT_EXIST:
         *disposedItemList = -1;
-        goto make_new_list;
-    case APR_EGENERAL:
-        marla_logMessagef(session->server,
-            "Failed to retrieve disposed_list_id."
-        );
+        break;
+    default:
         return parsegraph_Environment_INTERNAL_ERROR;
     }
 
-make_new_list:
     if(*disposedItemList == -1) {
         // No list, so make one.
         if(parsegraph_List_OK != parsegraph_List_new(session, "", disposedItemList)) {
@@ -0,0 +1,172 @@
+#include "parsegraph_List.h"
+#include "parsegraph_Session.h"
+#include "parsegraph_Profile.h"
+#include <apr_time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_ITEMS 2000
+
+static void report(const char* backend, const char* name, int count, apr_time_t start)
+{
+    apr_time_t elapsed = apr_time_now() - start;
+    if(elapsed <= 0) {
+        elapsed = 1;
+    }
+    printf("%s\t%s\t%d\t%ld us\t%.0f ops/s\n",
+        backend, name, count, (long)elapsed,
+        (double)count * APR_USEC_PER_SEC / elapsed
+    );
+}
+
+static int runBenchmark(parsegraph_Session* session, const char* backend, int nitems)
+{
+    int listId;
+    int itemId;
+    apr_time_t start;
+
+    start = apr_time_now();
+    if(parsegraph_List_OK != parsegraph_List_new(session, "bench_list", &listId)) {
+        fprintf(stderr, "Failed creating list.\n");
+        return -1;
+    }
+    report(backend, "new", 1, start);
+
+    start = apr_time_now();
+    for(int i = 0; i < nitems; ++i) {
+        if(parsegraph_List_OK != parsegraph_List_appendItem(session, listId, 0, "bench", &itemId)) {
+            fprintf(stderr, "Failed appending item %d.\n", i);
+            return -1;
+        }
+    }
+    report(backend, "appendItem", nitems, start);
+
+    start = apr_time_now();
+    int visited = 0;
+    if(parsegraph_List_OK != parsegraph_List_getHead(session, listId, &itemId)) {
+        fprintf(stderr, "Failed getting list head.\n");
+        return -1;
+    }
+    while(itemId > 0) {
+        ++visited;
+        if(parsegraph_List_OK != parsegraph_List_getNext(session, itemId, &itemId)) {
+            fprintf(stderr, "Failed getting next item.\n");
+            return -1;
+        }
+    }
+    report(backend, "getNext", visited, start);
+
+    start = apr_time_now();
+    parsegraph_List_item** values;
+    size_t nvalues;
+    if(parsegraph_List_OK != parsegraph_List_listItems(session, listId, &values, &nvalues)) {
+        fprintf(stderr, "Failed listing items.\n");
+        return -1;
+    }
+    report(backend, "listItems", (int)nvalues, start);
+
+    start = apr_time_now();
+    size_t len;
+    for(int i = 0; i < nitems; ++i) {
+        if(parsegraph_List_OK != parsegraph_List_length(session, listId, &len)) {
+            fprintf(stderr, "Failed getting list length.\n");
+            return -1;
+        }
+    }
+    report(backend, "length", nitems, start);
+
+    start = apr_time_now();
+    if(parsegraph_List_OK != parsegraph_List_destroy(session, listId)) {
+        fprintf(stderr, "Failed destroying list.\n");
+        return -1;
+    }
+    report(backend, "destroy", 1, start);
+
+    return 0;
+}
+
+int main(int argc, const char* const* argv)
+{
+    // Initialize the APR.
+    apr_status_t rv;
+    rv = apr_app_initialize(&argc, &argv, NULL);
+    if(rv != APR_SUCCESS) {
+        fprintf(stderr, "Failed initializing APR. APR status of %d.\n", rv);
+        return -1;
+    }
+    apr_pool_t* pool;
+    rv = apr_pool_create(&pool, NULL);
+    if(rv != APR_SUCCESS) {
+        fprintf(stderr, "Failed creating memory pool. APR status of %d.\n", rv);
+        return -1;
+    }
+
+    const char* db_path = argc > 1 ? argv[1] : "tests/bench.sqlite3";
+    int nitems = argc > 2 ? atoi(argv[2]) : BENCH_ITEMS;
+
+    // Initialize DBD.
+    rv = apr_dbd_init(pool);
+    if(rv != APR_SUCCESS) {
+        fprintf(stderr, "Failed initializing DBD, APR status of %d.\n", rv);
+        return -1;
+    }
+    ap_dbd_t* dbd = apr_pcalloc(pool, sizeof(*dbd));
+    rv = apr_dbd_get_driver(pool, "sqlite3", &dbd->driver);
+    if(rv != APR_SUCCESS) {
+        fprintf(stderr, "Failed creating DBD driver, APR status of %d.\n", rv);
+        return -1;
+    }
+    rv = apr_dbd_open(dbd->driver, pool, db_path, &dbd->handle);
+    if(rv != APR_SUCCESS) {
+        fprintf(stderr, "Failed connecting to database at %s, APR status of %d.\n", db_path, rv);
+        return -1;
+    }
+    dbd->prepared = apr_hash_make(pool);
+    dbd->pool = pool;
+
+    parsegraph_Session* session = parsegraph_Session_new(pool, dbd);
+    if(parsegraph_List_OK != parsegraph_List_upgradeTables(session)) {
+        fprintf(stderr, "Failed upgrading list tables.\n");
+        return -1;
+    }
+    parsegraph_Session_destroy(session);
+
+    apr_dbd_close(dbd->driver, dbd->handle);
+
+    // Run each backend with SQLite's defaults, then again with the tuned
+    // connection profile. Each run has its own connection so that no
+    // connection settings carry over, and the journal mode, which is kept in
+    // the database file, is set either way.
+    static const char* backends[] = { "apr_dbd", "native", "apr_dbd+profile", "native+profile" };
+    parsegraph_Profile defaults;
+    parsegraph_Profile_init(&defaults);
+    defaults.journalMode = "DELETE";
+    parsegraph_Profile tuned;
+    parsegraph_Profile_init(&tuned);
+    parsegraph_Profile_tuned(&tuned);
+    int failed = 0;
+    for(int i = 0; i < 4 && !failed; ++i) {
+        session = parsegraph_Session_open(0, "sqlite3", db_path);
+        if(!session) {
+            fprintf(stderr, "Failed connecting to database at %s.\n", db_path);
+            failed = 1;
+            break;
+        }
+        if(APR_SUCCESS != parsegraph_Profile_apply(session, i < 2 ? &defaults : &tuned)) {
+            fprintf(stderr, "Failed applying connection profile.\n");
+            failed = 1;
+        }
+        else if(i % 2 == 1 && APR_SUCCESS != parsegraph_Session_useNativeSQLite(session)) {
+            fprintf(stderr, "Native SQLite backend is not available.\n");
+        }
+        else {
+            failed = runBenchmark(session, backends[i], nitems);
+        }
+        parsegraph_Session_close(session);
+    }
+
+    apr_pool_destroy(pool);
+    apr_terminate();
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,135 @@
+#include "parsegraph_environment.h"
+#include "parsegraph_List.h"
+#include "parsegraph_Session.h"
+#include "parsegraph_user.h"
+#include <apr_time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_ENVIRONMENTS 20000
+#define BENCH_BATCH 500
+
+static void report(const char* guids, const char* name, int count, apr_time_t start)
+{
+    apr_time_t elapsed = apr_time_now() - start;
+    if(elapsed <= 0) {
+        elapsed = 1;
+    }
+    printf("%s\t%s\t%d\t%ld us\t%.0f ops/s\n",
+        guids, name, count, (long)elapsed,
+        (double)count * APR_USEC_PER_SEC / elapsed
+    );
+}
+
+// Inserts nenvs environments in batches, then looks each up by GUID.
+static int runBenchmark(parsegraph_Session* session, const char* guids, int nenvs)
+{
+    ap_dbd_t* dbd = session->dbd;
+    int nrows;
+    if(0 != apr_dbd_query(dbd->driver, dbd->handle, &nrows, "delete from environment")
+        || 0 != apr_dbd_query(dbd->driver, dbd->handle, &nrows, "vacuum")) {
+        fprintf(stderr, "Failed clearing environments.\n");
+        return -1;
+    }
+
+    parsegraph_GUID* envs = malloc(sizeof(parsegraph_GUID) * nenvs);
+    apr_time_t start = apr_time_now();
+    for(int i = 0; i < nenvs; i += BENCH_BATCH) {
+        if(parsegraph_OK != parsegraph_beginTransaction(session, "bench_environment")) {
+            fprintf(stderr, "Failed beginning transaction.\n");
+            free(envs);
+            return -1;
+        }
+        for(int j = i; j < i + BENCH_BATCH && j < nenvs; ++j) {
+            if(parsegraph_Environment_OK != parsegraph_createEnvironment(session, 0, 0, 0, &envs[j])) {
+                fprintf(stderr, "Failed creating environment %d.\n", j);
+                parsegraph_rollbackTransaction(session, "bench_environment");
+                free(envs);
+                return -1;
+            }
+        }
+        if(parsegraph_OK != parsegraph_commitTransaction(session, "bench_environment")) {
+            fprintf(stderr, "Failed committing transaction.\n");
+            free(envs);
+            return -1;
+        }
+    }
+    report(guids, "createEnvironment", nenvs, start);
+
+    start = apr_time_now();
+    for(int i = 0; i < nenvs; ++i) {
+        int envId;
+        if(parsegraph_Environment_OK != parsegraph_getEnvironmentIdForGUID(session, &envs[i], &envId)) {
+            fprintf(stderr, "Failed finding environment %d.\n", i);
+            free(envs);
+            return -1;
+        }
+    }
+    report(guids, "getEnvironmentIdForGUID", nenvs, start);
+
+    free(envs);
+    return 0;
+}
+
+int main(int argc, const char* const* argv)
+{
+    // Initialize the APR.
+    apr_status_t rv;
+    rv = apr_app_initialize(&argc, &argv, NULL);
+    if(rv != APR_SUCCESS) {
+        fprintf(stderr, "Failed initializing APR. APR status of %d.\n", rv);
+        return -1;
+    }
+    apr_pool_t* pool;
+    rv = apr_pool_create(&pool, NULL);
+    if(rv != APR_SUCCESS) {
+        fprintf(stderr, "Failed creating memory pool. APR status of %d.\n", rv);
+        return -1;
+    }
+
+    const char* db_path = argc > 1 ? argv[1] : "tests/bench.sqlite3";
+    int nenvs = argc > 2 ? atoi(argv[2]) : BENCH_ENVIRONMENTS;
+
+    // Initialize DBD.
+    rv = apr_dbd_init(pool);
+    if(rv != APR_SUCCESS) {
+        fprintf(stderr, "Failed initializing DBD, APR status of %d.\n", rv);
+        return -1;
+    }
+    ap_dbd_t* dbd = apr_pcalloc(pool, sizeof(*dbd));
+    rv = apr_dbd_get_driver(pool, "sqlite3", &dbd->driver);
+    if(rv != APR_SUCCESS) {
+        fprintf(stderr, "Failed creating DBD driver, APR status of %d.\n", rv);
+        return -1;
+    }
+    rv = apr_dbd_open(dbd->driver, pool, db_path, &dbd->handle);
+    if(rv != APR_SUCCESS) {
+        fprintf(stderr, "Failed connecting to database at %s, APR status of %d.\n", db_path, rv);
+        return -1;
+    }
+    dbd->prepared = apr_hash_make(pool);
+    dbd->pool = pool;
+
+    parsegraph_Session* session = parsegraph_Session_new(pool, dbd);
+    if(parsegraph_OK != parsegraph_upgradeUserTables(session)
+        || parsegraph_List_OK != parsegraph_List_upgradeTables(session)
+        || parsegraph_Environment_OK != parsegraph_upgradeEnvironmentTables(session)) {
+        fprintf(stderr, "Failed upgrading tables.\n");
+        return -1;
+    }
+
+    // Insert with random GUIDs, then again with time-ordered ones.
+    static const char* guids[] = { "random", "time-ordered" };
+    int failed = 0;
+    for(int i = 0; i < 2 && !failed; ++i) {
+        parsegraph_Session_setTimeOrderedGUIDs(session, i == 1);
+        failed = runBenchmark(session, guids[i], nenvs);
+    }
+    parsegraph_Session_destroy(session);
+
+    apr_dbd_close(dbd->driver, dbd->handle);
+    apr_pool_destroy(pool);
+    apr_terminate();
+
+    return failed ? 1 : 0;
+}
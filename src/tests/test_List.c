@@ -1,8 +1,14 @@
 #include "parsegraph_List.h"
+#include "parsegraph_Statement.h"
+#include "parsegraph_Profile.h"
 #include "unity.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 static parsegraph_Session* session = NULL;
+static const char* testDriver = "sqlite3";
+static const char* testParams = "tests/users.sqlite3";
 
 #define TEST_NAME "test_name"
 #define TEST_VALUE "test_value A"
@@ -164,6 +170,62 @@ void test_List_insertBefore()
     TEST_ASSERT(parsegraph_List_OK == parsegraph_List_destroy(session, listId));
 }
 
+void test_List_links()
+{
+    int listId;
+    TEST_ASSERT(parsegraph_List_OK == parsegraph_List_new(session, TEST_NAME, &listId));
+
+    int ids[3];
+    TEST_ASSERT(parsegraph_List_OK == parsegraph_List_appendItem(session, listId, 0, "2", &ids[1]));
+    TEST_ASSERT(parsegraph_List_OK == parsegraph_List_insertBefore(session, ids[1], 0, "1", &ids[0]));
+    TEST_ASSERT(parsegraph_List_OK == parsegraph_List_insertAfter(session, ids[1], 0, "3", &ids[2]));
+
+    // Walk forwards from the head.
+    int itemId;
+    TEST_ASSERT(parsegraph_List_OK == parsegraph_List_getHead(session, listId, &itemId));
+    for(int i = 0; i < 3; ++i) {
+        TEST_ASSERT_EQUAL_INT(ids[i], itemId);
+        TEST_ASSERT(parsegraph_List_OK == parsegraph_List_getNext(session, itemId, &itemId));
+    }
+    TEST_ASSERT_EQUAL_INT(-1, itemId);
+
+    // Walk backwards from the tail.
+    TEST_ASSERT(parsegraph_List_OK == parsegraph_List_getTail(session, listId, &itemId));
+    for(int i = 2; i >= 0; --i) {
+        TEST_ASSERT_EQUAL_INT(ids[i], itemId);
+        TEST_ASSERT(parsegraph_List_OK == parsegraph_List_getPrev(session, itemId, &itemId));
+    }
+    TEST_ASSERT_EQUAL_INT(-1, itemId);
+
+    // Clearing a link leaves the other column alone.
+    TEST_ASSERT(parsegraph_List_OK == parsegraph_List_setNext(session, ids[1], -1));
+    TEST_ASSERT(parsegraph_List_OK == parsegraph_List_getNext(session, ids[1], &itemId));
+    TEST_ASSERT_EQUAL_INT(-1, itemId);
+    TEST_ASSERT(parsegraph_List_OK == parsegraph_List_getPrev(session, ids[1], &itemId));
+    TEST_ASSERT_EQUAL_INT(ids[0], itemId);
+
+    TEST_ASSERT(parsegraph_List_OK == parsegraph_List_destroy(session, listId));
+}
+
+void test_List_sharedConnection()
+{
+    // Later sessions on one connection use the statements it already has,
+    // which pgsql keeps on the server until the connection closes.
+    int listId;
+    for(int i = 0; i < 2; ++i) {
+        parsegraph_Session* other = parsegraph_Session_new(session->pool, session->dbd);
+        TEST_ASSERT_NOT_NULL(other);
+        TEST_ASSERT(parsegraph_List_OK == parsegraph_List_prepareStatements(other));
+        if(i == 0) {
+            TEST_ASSERT(parsegraph_List_OK == parsegraph_List_new(other, TEST_NAME, &listId));
+        }
+        else {
+            TEST_ASSERT(parsegraph_List_OK == parsegraph_List_destroy(other, listId));
+        }
+        parsegraph_Session_destroy(other);
+    }
+}
+
 void test_List_moveBefore()
 {
     int listId;
@@ -455,6 +517,228 @@ void test_List_unshiftItem()
     TEST_ASSERT_EQUAL(secondParentId, firstId);
 }
 
+void test_List_statements()
+{
+    apr_dbd_prepared_t* head = parsegraph_getStatement(session, parsegraph_Statement_List_getHead);
+    TEST_ASSERT_NOT_NULL(head);
+    TEST_ASSERT_EQUAL_PTR(head, parsegraph_getStatement(session, parsegraph_Statement_List_getHead));
+    TEST_ASSERT_EQUAL_STRING("parsegraph_List_getHead", parsegraph_nameStatement(parsegraph_Statement_List_getHead));
+    TEST_ASSERT_EQUAL_PTR(head, apr_hash_get(session->dbd->prepared, "parsegraph_List_getHead", APR_HASH_KEY_STRING));
+    TEST_ASSERT_NULL(parsegraph_getStatement(session, parsegraph_Statement_COUNT));
+}
+
+void test_List_stats()
+{
+    parsegraph_Stats_reset(session);
+
+    int listId;
+    TEST_ASSERT_EQUAL(parsegraph_List_OK, parsegraph_List_new(session, TEST_NAME, &listId));
+    int itemId;
+    TEST_ASSERT_EQUAL(parsegraph_List_OK, parsegraph_List_appendItem(session, listId, 255, TEST_VALUE, &itemId));
+    int headId;
+    TEST_ASSERT_EQUAL(parsegraph_List_OK, parsegraph_List_getHead(session, listId, &headId));
+
+    parsegraph_StatementStats* stats = parsegraph_Stats_get(session, parsegraph_Statement_List_getHead);
+    TEST_ASSERT_NOT_NULL(stats);
+    TEST_ASSERT(stats->calls >= 1);
+    TEST_ASSERT_EQUAL(0, stats->errors);
+    TEST_ASSERT(stats->rowsReturned >= 1);
+    TEST_ASSERT(stats->maxTime <= stats->totalTime);
+
+    stats = parsegraph_Stats_get(session, parsegraph_Statement_List_new);
+    TEST_ASSERT_EQUAL(1, stats->calls);
+    TEST_ASSERT_EQUAL(1, stats->rowsAffected);
+
+    FILE* sink = tmpfile();
+    TEST_ASSERT_NOT_NULL(sink);
+    parsegraph_Stats_dump(session, sink);
+    rewind(sink);
+    char line[512];
+    int found = 0;
+    while(fgets(line, sizeof(line), sink)) {
+        if(!strncmp(line, "parsegraph_List_getHead\t", strlen("parsegraph_List_getHead\t"))) {
+            found = 1;
+        }
+    }
+    fclose(sink);
+    TEST_ASSERT(found);
+
+    parsegraph_Stats_reset(session);
+    TEST_ASSERT_EQUAL(0, parsegraph_Stats_get(session, parsegraph_Statement_List_getHead)->calls);
+
+    parsegraph_List_destroy(session, listId);
+}
+
+void test_List_nestedCursors()
+{
+    int listId;
+    TEST_ASSERT_EQUAL(parsegraph_List_OK, parsegraph_List_new(session, TEST_NAME, &listId));
+    int itemId;
+    TEST_ASSERT_EQUAL(parsegraph_List_OK, parsegraph_List_appendItem(session, listId, 255, TEST_VALUE, &itemId));
+    TEST_ASSERT_EQUAL(parsegraph_List_OK, parsegraph_List_appendItem(session, listId, 255, TEST_VALUE2, &itemId));
+
+    // Reading the same statement while a cursor on it is open must not
+    // disturb the outer cursor.
+    parsegraph_Cursor outer;
+    TEST_ASSERT_EQUAL(0, parsegraph_Cursor_open(&outer, session, session->pool, parsegraph_Statement_List_listItems, &listId));
+    int rows = 0;
+    while(APR_SUCCESS == parsegraph_Cursor_next(&outer)) {
+        ++rows;
+        parsegraph_List_item** values;
+        size_t nvalues;
+        TEST_ASSERT_EQUAL(parsegraph_List_OK, parsegraph_List_listItems(session, listId, &values, &nvalues));
+        TEST_ASSERT_EQUAL(2, nvalues);
+    }
+    parsegraph_Cursor_close(&outer);
+    TEST_ASSERT_EQUAL(2, rows);
+
+    // Nor may cursors that are bound but not yet stepped, or that have read
+    // every row, have their statement taken by another.
+    TEST_ASSERT_EQUAL(0, parsegraph_Cursor_open(&outer, session, session->pool, parsegraph_Statement_List_listItems, &listId));
+    parsegraph_Cursor finished;
+    TEST_ASSERT_EQUAL(0, parsegraph_Cursor_open(&finished, session, session->pool, parsegraph_Statement_List_listItems, &listId));
+    for(rows = 0; APR_SUCCESS == parsegraph_Cursor_next(&finished); ++rows);
+    TEST_ASSERT_EQUAL(2, rows);
+    int emptyListId = -1;
+    parsegraph_Cursor inner;
+    TEST_ASSERT_EQUAL(0, parsegraph_Cursor_open(&inner, session, session->pool, parsegraph_Statement_List_listItems, &emptyListId));
+    TEST_ASSERT_EQUAL(APR_EOF, parsegraph_Cursor_next(&inner));
+    parsegraph_Cursor_close(&inner);
+    parsegraph_Cursor_close(&finished);
+    for(rows = 0; APR_SUCCESS == parsegraph_Cursor_next(&outer); ++rows);
+    parsegraph_Cursor_close(&outer);
+    TEST_ASSERT_EQUAL(2, rows);
+
+    parsegraph_List_destroy(session, listId);
+}
+
+void test_List_insertReturning()
+{
+    int listId;
+    TEST_ASSERT_EQUAL(0, parsegraph_insertReturning(session, session->pool, parsegraph_Statement_List_new, &listId, TEST_NAME));
+    TEST_ASSERT(listId > 0);
+
+    int itemId;
+    int typeId = 3;
+    const char* value;
+    TEST_ASSERT_EQUAL(0, parsegraph_insertReturning(session, session->pool, parsegraph_Statement_List_newItem, &itemId, &listId, &typeId, TEST_VALUE));
+    TEST_ASSERT(itemId > listId);
+    TEST_ASSERT(parsegraph_List_OK == parsegraph_List_getName(session, itemId, &value, &typeId));
+    TEST_ASSERT_EQUAL_STRING(TEST_VALUE, value);
+    TEST_ASSERT_EQUAL(3, typeId);
+
+    // Statements without a RETURNING clause are refused.
+    TEST_ASSERT(0 != parsegraph_insertReturning(session, session->pool, parsegraph_Statement_List_setType, &itemId, &typeId, &itemId));
+
+    TEST_ASSERT(parsegraph_List_OK == parsegraph_List_destroy(session, listId));
+}
+
+void test_List_profile()
+{
+    parsegraph_Profile profile;
+    parsegraph_Profile_init(&profile);
+    TEST_ASSERT_EQUAL(APR_SUCCESS, parsegraph_Profile_set(&profile, "synchronous", "normal"));
+    TEST_ASSERT_EQUAL_STRING("NORMAL", profile.synchronous);
+    TEST_ASSERT_EQUAL(APR_SUCCESS, parsegraph_Profile_set(&profile, "cache_size", "-4000"));
+    TEST_ASSERT_EQUAL(APR_SUCCESS, parsegraph_Profile_set(&profile, "temp_store", "MEMORY"));
+    TEST_ASSERT_EQUAL(APR_SUCCESS, parsegraph_Profile_set(&profile, "busy_timeout", "1000"));
+
+    // Values are checked before they reach SQL.
+    TEST_ASSERT_EQUAL(APR_EINVAL, parsegraph_Profile_set(&profile, "journal_mode", "WAL; DROP TABLE list_item"));
+    TEST_ASSERT_EQUAL(APR_EINVAL, parsegraph_Profile_set(&profile, "cache_size", "lots"));
+    TEST_ASSERT_EQUAL(APR_EINVAL, parsegraph_Profile_set(&profile, "page_size", "4096"));
+    TEST_ASSERT_NULL(profile.journalMode);
+
+    TEST_ASSERT_EQUAL(APR_SUCCESS, parsegraph_Profile_apply(session, &profile));
+
+    ap_dbd_t* dbd = session->dbd;
+    apr_dbd_results_t* res = 0;
+    apr_dbd_row_t* row = 0;
+    TEST_ASSERT_EQUAL(0, apr_dbd_select(dbd->driver, session->pool, dbd->handle, &res, "PRAGMA cache_size", 0));
+    TEST_ASSERT_EQUAL(0, apr_dbd_get_row(dbd->driver, session->pool, res, &row, -1));
+    TEST_ASSERT_EQUAL_STRING("-4000", apr_dbd_get_entry(dbd->driver, row, 0));
+    while(-1 != apr_dbd_get_row(dbd->driver, session->pool, res, &row, -1));
+}
+
+void test_List_sessionProfile()
+{
+    ap_dbd_t* dbd = session->dbd;
+    if(strcmp(apr_dbd_name(dbd->driver), "sqlite3")) {
+        TEST_IGNORE_MESSAGE("Connection profiles only apply to SQLite.");
+    }
+
+    // Sessions on a caller's connection get the configured profile too.
+    setenv("PARSEGRAPH_CACHE_SIZE", "-3000", 1);
+    TEST_ASSERT_EQUAL(APR_SUCCESS, parsegraph_Profile_reloadEnvironment());
+    parsegraph_Session* other = parsegraph_Session_new(session->pool, dbd);
+    TEST_ASSERT_NOT_NULL(other);
+    apr_dbd_results_t* res = 0;
+    apr_dbd_row_t* row = 0;
+    TEST_ASSERT_EQUAL(0, apr_dbd_select(dbd->driver, session->pool, dbd->handle, &res, "PRAGMA cache_size", 0));
+    TEST_ASSERT_EQUAL(0, apr_dbd_get_row(dbd->driver, session->pool, res, &row, -1));
+    TEST_ASSERT_EQUAL_STRING("-3000", apr_dbd_get_entry(dbd->driver, row, 0));
+    while(-1 != apr_dbd_get_row(dbd->driver, session->pool, res, &row, -1));
+    parsegraph_Session_destroy(other);
+
+    // Later sessions on the connection do not apply it again.
+    TEST_ASSERT_EQUAL(0, apr_dbd_select(dbd->driver, session->pool, dbd->handle, &res, "PRAGMA cache_size = -2000", 0));
+    while(-1 != apr_dbd_get_row(dbd->driver, session->pool, res, &row, -1));
+    other = parsegraph_Session_new(session->pool, dbd);
+    TEST_ASSERT_NOT_NULL(other);
+    TEST_ASSERT_EQUAL(0, apr_dbd_select(dbd->driver, session->pool, dbd->handle, &res, "PRAGMA cache_size", 0));
+    TEST_ASSERT_EQUAL(0, apr_dbd_get_row(dbd->driver, session->pool, res, &row, -1));
+    TEST_ASSERT_EQUAL_STRING("-2000", apr_dbd_get_entry(dbd->driver, row, 0));
+    while(-1 != apr_dbd_get_row(dbd->driver, session->pool, res, &row, -1));
+    parsegraph_Session_destroy(other);
+
+    // A profile that cannot be read fails the session.
+    setenv("PARSEGRAPH_CACHE_SIZE", "lots", 1);
+    TEST_ASSERT_EQUAL(APR_EINVAL, parsegraph_Profile_reloadEnvironment());
+    TEST_ASSERT_NULL(parsegraph_Session_new(session->pool, dbd));
+    unsetenv("PARSEGRAPH_CACHE_SIZE");
+    TEST_ASSERT_EQUAL(APR_SUCCESS, parsegraph_Profile_reloadEnvironment());
+}
+
+void test_List_translateSchema()
+{
+    const char* sql = "create table t(id integer primary key, value blob not null, blobs text)";
+    parsegraph_Dialect dialect = session->dialect;
+    session->dialect = parsegraph_Dialect_SQLITE;
+    TEST_ASSERT_EQUAL_STRING(sql, parsegraph_translateSchema(session, sql));
+    session->dialect = parsegraph_Dialect_PGSQL;
+    TEST_ASSERT_EQUAL_STRING("create table t(id serial primary key, value text not null, blobs text)", parsegraph_translateSchema(session, sql));
+    session->dialect = dialect;
+}
+
+static void runListTests()
+{
+    RUN_TEST(test_List_new);
+    RUN_TEST(test_List_insertAfter);
+    RUN_TEST(test_List_appendItem);
+    RUN_TEST(test_List_prependItem);
+    RUN_TEST(test_List_updateItem);
+    RUN_TEST(test_List_destroyItem);
+    RUN_TEST(test_List_listItems);
+    RUN_TEST(test_List_insertBefore);
+    RUN_TEST(test_List_links);
+    RUN_TEST(test_List_sharedConnection);
+    RUN_TEST(test_List_moveBefore);
+    RUN_TEST(test_List_moveAfter);
+    RUN_TEST(test_List_length);
+    RUN_TEST(test_List_truncate);
+    RUN_TEST(test_List_setValue);
+    RUN_TEST(test_List_setType);
+    RUN_TEST(test_List_swapItems);
+    RUN_TEST(test_List_pushItem);
+    RUN_TEST(test_List_unshiftItem);
+    RUN_TEST(test_List_statements);
+    RUN_TEST(test_List_stats);
+    RUN_TEST(test_List_insertReturning);
+    RUN_TEST(test_List_profile);
+    RUN_TEST(test_List_sessionProfile);
+    RUN_TEST(test_List_translateSchema);
+}
+
 int main(int argc, const char* const* argv)
 {
     UNITY_BEGIN();
@@ -484,18 +768,25 @@ int main(int argc, const char* const* argv)
         fprintf(stderr, "Failed initializing DBD memory");
         return -1;
     }
-    rv = apr_dbd_get_driver(pool, "sqlite3", &dbd->driver);
+    // PARSEGRAPH_TEST_DRIVER and PARSEGRAPH_TEST_PARAMS run the suite against
+    // another database, such as a throwaway PostgreSQL instance.
+    if(getenv("PARSEGRAPH_TEST_DRIVER")) {
+        testDriver = getenv("PARSEGRAPH_TEST_DRIVER");
+        testParams = getenv("PARSEGRAPH_TEST_PARAMS");
+    }
+    rv = apr_dbd_get_driver(pool, testDriver, &dbd->driver);
     if(rv != APR_SUCCESS) {
         fprintf(stderr, "Failed creating DBD driver, APR status of %d.\n", rv);
         return -1;
     }
-    const char* db_path = "tests/users.sqlite3";
+    const char* db_path = testParams;
     rv = apr_dbd_open(dbd->driver, pool, db_path, &dbd->handle);
     if(rv != APR_SUCCESS) {
         fprintf(stderr, "Failed connecting to database at %s, APR status of %d.\n", db_path, rv);
         return -1;
     }
     dbd->prepared = apr_hash_make(pool);
+    dbd->pool = pool;
 
     session = parsegraph_Session_new(pool, dbd);
 
@@ -512,23 +803,16 @@ int main(int argc, const char* const* argv)
     }
 
     // Run the tests.
-    RUN_TEST(test_List_new);
-    RUN_TEST(test_List_insertAfter);
-    RUN_TEST(test_List_appendItem);
-    RUN_TEST(test_List_prependItem);
-    RUN_TEST(test_List_updateItem);
-    RUN_TEST(test_List_destroyItem);
-    RUN_TEST(test_List_listItems);
-    RUN_TEST(test_List_insertBefore);
-    RUN_TEST(test_List_moveBefore);
-    RUN_TEST(test_List_moveAfter);
-    RUN_TEST(test_List_length);
-    RUN_TEST(test_List_truncate);
-    RUN_TEST(test_List_setValue);
-    RUN_TEST(test_List_setType);
-    RUN_TEST(test_List_swapItems);
-    RUN_TEST(test_List_pushItem);
-    RUN_TEST(test_List_unshiftItem);
+    runListTests();
+
+    parsegraph_Session_destroy(session);
+
+    // Run them again against the native SQLite backend, if it was built.
+    session = parsegraph_Session_new(pool, dbd);
+    if(APR_SUCCESS == parsegraph_Session_useNativeSQLite(session)) {
+        runListTests();
+        RUN_TEST(test_List_nestedCursors);
+    }
 
     parsegraph_Session_destroy(session);
 
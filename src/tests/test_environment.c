@@ -1,14 +1,24 @@
 #include <parsegraph_environment.h>
 #include <parsegraph_user.h>
 #include <parsegraph_List.h>
+#include <parsegraph_Worker.h>
+#include <parsegraph_SessionPool.h>
+#include <parsegraph_Shards.h>
+#include <parsegraph_Statement.h>
 #include "unity.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <poll.h>
 #include <http_log.h>
 
 static parsegraph_Session* session;
 
 static const char* TEST_USERNAME = "foodens";
 static const char* TEST_PASSWORD = "barbarbaz";
+static const char* testDriver = "sqlite3";
+static const char* testParams = "tests/users.sqlite";
 
 void test_environment()
 {
@@ -69,6 +79,72 @@ void test_environmentGUID()
     parsegraph_List_destroy(session, listId);
 }
 
+void test_binaryGUID()
+{
+    parsegraph_GUID text;
+    strcpy(text.value, "0123abcd-ef45-6789-ABCD-0f1e2d3c4b5a");
+    parsegraph_BinaryGUID bin;
+    TEST_ASSERT_EQUAL(0, parsegraph_GUID_parse(&text, &bin));
+    TEST_ASSERT_EQUAL_HEX8(0x01, bin.bytes[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xcd, bin.bytes[10]);
+    TEST_ASSERT_EQUAL_HEX8(0x5a, bin.bytes[15]);
+    parsegraph_GUID formatted;
+    parsegraph_GUID_format(&bin, &formatted);
+    TEST_ASSERT_EQUAL_STRING("0123abcd-ef45-6789-abcd-0f1e2d3c4b5a", formatted.value);
+
+    parsegraph_BinaryGUID other;
+    TEST_ASSERT_EQUAL(0, parsegraph_GUID_parse(&formatted, &other));
+    TEST_ASSERT_EQUAL(1, parsegraph_BinaryGUID_equal(&bin, &other));
+    other.bytes[15] ^= 1;
+    TEST_ASSERT_EQUAL(0, parsegraph_BinaryGUID_equal(&bin, &other));
+
+    text.value[20] = 'g';
+    TEST_ASSERT_EQUAL(-1, parsegraph_GUID_parse(&text, &bin));
+    strcpy(text.value, "0123abcd-ef45-6789-abcd");
+    TEST_ASSERT_EQUAL(-1, parsegraph_GUID_parse(&text, &bin));
+
+    // Environments are found by GUID in either case.
+    int listId;
+    TEST_ASSERT_EQUAL(parsegraph_OK, parsegraph_List_new(session, "My list", &listId));
+    parsegraph_GUID env;
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_createEnvironment(session, 0, listId, 0, &env));
+    int envId = 0;
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_getEnvironmentIdForGUID(session, &env, &envId));
+    parsegraph_GUID upper = env;
+    for(char* c = upper.value; *c; ++c) {
+        *c = toupper(*c);
+    }
+    int upperId = 0;
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_getEnvironmentIdForGUID(session, &upper, &upperId));
+    TEST_ASSERT_EQUAL(envId, upperId);
+    TEST_ASSERT_EQUAL(parsegraph_Environment_NOT_FOUND, parsegraph_getEnvironmentIdForGUID(session, &text, &upperId));
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_destroyEnvironment(session, &env));
+    parsegraph_List_destroy(session, listId);
+}
+
+void test_timeOrderedGUID()
+{
+    parsegraph_GUID first, second;
+    TEST_ASSERT_EQUAL(APR_SUCCESS, parsegraph_generateTimeOrderedGUID(&first));
+    apr_sleep(2000);
+    TEST_ASSERT_EQUAL(APR_SUCCESS, parsegraph_generateTimeOrderedGUID(&second));
+    TEST_ASSERT_EQUAL_INT('7', first.value[14]);
+    TEST_ASSERT_NOT_NULL(strchr("89ab", first.value[19]));
+    TEST_ASSERT(strcmp(first.value, second.value) < 0);
+
+    int listId;
+    TEST_ASSERT_EQUAL(parsegraph_OK, parsegraph_List_new(session, "My list", &listId));
+    parsegraph_Session_setTimeOrderedGUIDs(session, 1);
+    parsegraph_GUID env;
+    parsegraph_EnvironmentStatus erv = parsegraph_createEnvironment(session, 0, listId, 0, &env);
+    parsegraph_Session_setTimeOrderedGUIDs(session, 0);
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, erv);
+    TEST_ASSERT_EQUAL_INT('7', env.value[14]);
+    TEST_ASSERT(strcmp(second.value, env.value) < 0);
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_destroyEnvironment(session, &env));
+    parsegraph_List_destroy(session, listId);
+}
+
 void test_savedEnvironments()
 {
     int listId;
@@ -202,6 +278,311 @@ void test_enterEnvironment()
     parsegraph_List_destroy(session, listId);
 }
 
+void test_pendingEvents()
+{
+    parsegraph_GUID env;
+    memset(&env, 0, sizeof(env));
+    int itemId = 42;
+
+    // Outside of a transaction, events are delivered immediately.
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_notifyEnvironment(session, &env, parsegraph_Event_MultislotMadePublic, &itemId));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_countPendingEvents(session));
+
+    // Events are queued until the outermost commit.
+    TEST_ASSERT_EQUAL(parsegraph_OK, parsegraph_beginTransaction(session, "outer"));
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_notifyEnvironment(session, &env, parsegraph_Event_MultislotMadePublic, &itemId));
+    TEST_ASSERT_EQUAL(parsegraph_OK, parsegraph_beginTransaction(session, "inner"));
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_notifyUser(session, 1, parsegraph_Event_ItemPushedInStorage, &itemId));
+    TEST_ASSERT_EQUAL_INT(2, parsegraph_countPendingEvents(session));
+    TEST_ASSERT_EQUAL(parsegraph_OK, parsegraph_commitTransaction(session, "inner"));
+    TEST_ASSERT_EQUAL_INT(2, parsegraph_countPendingEvents(session));
+    TEST_ASSERT_EQUAL(parsegraph_OK, parsegraph_commitTransaction(session, "outer"));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_countPendingEvents(session));
+
+    // Rolled back savepoints discard only their own events.
+    TEST_ASSERT_EQUAL(parsegraph_OK, parsegraph_beginTransaction(session, "outer"));
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_notifyEnvironment(session, &env, parsegraph_Event_EnvironmentRootSet, 0));
+    TEST_ASSERT_EQUAL(parsegraph_OK, parsegraph_beginTransaction(session, "inner"));
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_notifyUser(session, 1, parsegraph_Event_MultislotPlotCreated, &itemId));
+    TEST_ASSERT_EQUAL(parsegraph_OK, parsegraph_rollbackTransaction(session, "inner"));
+    TEST_ASSERT_EQUAL_INT(1, parsegraph_countPendingEvents(session));
+    TEST_ASSERT_EQUAL(parsegraph_OK, parsegraph_rollbackTransaction(session, "outer"));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_countPendingEvents(session));
+}
+
+struct asyncState {
+    parsegraph_WorkerPool* workers;
+    int listId;
+    int itemId;
+    size_t length;
+    parsegraph_GUID env;
+    int envRoot;
+    int failures;
+};
+
+static void onRootFound(void* data, parsegraph_EnvironmentStatus rv, int rootListId)
+{
+    struct asyncState* state = data;
+    state->failures += rv != parsegraph_Environment_OK;
+    state->envRoot = rootListId;
+}
+
+static void onEnvironmentCreated(void* data, parsegraph_EnvironmentStatus rv, parsegraph_GUID* env)
+{
+    struct asyncState* state = data;
+    state->failures += rv != parsegraph_Environment_OK;
+    state->env = *env;
+    parsegraph_getEnvironmentRootAsync(state->workers, &state->env, onRootFound, state);
+}
+
+static void onLength(void* data, parsegraph_ListStatus rv, size_t length)
+{
+    struct asyncState* state = data;
+    state->failures += rv != parsegraph_List_OK;
+    state->length = length;
+}
+
+static void onItemAppended(void* data, parsegraph_ListStatus rv, int itemId)
+{
+    struct asyncState* state = data;
+    state->failures += rv != parsegraph_List_OK;
+    state->itemId = itemId;
+    parsegraph_List_lengthAsync(state->workers, state->listId, onLength, state);
+}
+
+static void onListCreated(void* data, parsegraph_ListStatus rv, int listId)
+{
+    struct asyncState* state = data;
+    state->failures += rv != parsegraph_List_OK;
+    state->listId = listId;
+    parsegraph_List_appendItemAsync(state->workers, listId, 0, "async", onItemAppended, state);
+    parsegraph_createEnvironmentAsync(state->workers, 0, listId, 0, onEnvironmentCreated, state);
+}
+
+void test_workerPool()
+{
+    struct asyncState state;
+    memset(&state, 0, sizeof(state));
+    state.workers = parsegraph_WorkerPool_new(session->pool, session->server, testDriver, testParams, 2);
+    TEST_ASSERT_NOT_NULL(state.workers);
+
+    TEST_ASSERT_EQUAL(APR_SUCCESS, parsegraph_List_newAsync(state.workers, "Async list", onListCreated, &state));
+
+    // Run the continuations as an event loop would.
+    struct pollfd pfd;
+    pfd.fd = parsegraph_WorkerPool_fd(state.workers);
+    pfd.events = POLLIN;
+    while(parsegraph_WorkerPool_pending(state.workers) > 0) {
+        TEST_ASSERT(poll(&pfd, 1, 5000) > 0);
+        parsegraph_WorkerPool_dispatch(state.workers);
+    }
+
+    TEST_ASSERT_EQUAL(0, state.failures);
+    TEST_ASSERT(state.listId > 0);
+    TEST_ASSERT(state.itemId > 0);
+    TEST_ASSERT_EQUAL(1, state.length);
+    TEST_ASSERT_EQUAL(state.listId, state.envRoot);
+
+    parsegraph_WorkerPool_destroy(state.workers);
+
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_destroyEnvironment(session, &state.env));
+    TEST_ASSERT_EQUAL(parsegraph_List_OK, parsegraph_List_destroy(session, state.listId));
+}
+
+static volatile int gateOpen;
+static volatile int gateReached;
+
+static int waitAtGate(parsegraph_Session* workerSession, void* data)
+{
+    gateReached = 1;
+    while(!gateOpen) {
+        apr_sleep(1000);
+    }
+    return 0;
+}
+
+void test_workerPoolQueueLimit()
+{
+    parsegraph_WorkerPool* workers = parsegraph_WorkerPool_new(session->pool, session->server, testDriver, testParams, 1);
+    TEST_ASSERT_NOT_NULL(workers);
+    parsegraph_WorkerPool_setQueueLimit(workers, 1);
+
+    // Hold the only worker, so that further calls wait in the queue.
+    gateOpen = 0;
+    gateReached = 0;
+    TEST_ASSERT_EQUAL(APR_SUCCESS, parsegraph_WorkerPool_submit(workers, waitAtGate, 0, 0));
+    while(!gateReached) {
+        apr_sleep(1000);
+    }
+    TEST_ASSERT_EQUAL(APR_SUCCESS, parsegraph_WorkerPool_submit(workers, waitAtGate, 0, 0));
+    TEST_ASSERT_EQUAL(APR_EAGAIN, parsegraph_WorkerPool_submit(workers, waitAtGate, 0, 0));
+
+    gateOpen = 1;
+    parsegraph_WorkerPool_destroy(workers);
+}
+
+static apr_status_t markCleared(void* data)
+{
+    *(int*)data = 1;
+    return APR_SUCCESS;
+}
+
+void test_sessionPool()
+{
+    parsegraph_SessionPool* sessions = parsegraph_SessionPool_new(session->pool, session->server, testDriver, testParams, 2, 0, 0);
+    TEST_ASSERT_NOT_NULL(sessions);
+    TEST_ASSERT_EQUAL(2, parsegraph_SessionPool_size(sessions));
+
+    parsegraph_Session* a;
+    parsegraph_Session* b;
+    parsegraph_Session* c;
+    TEST_ASSERT_EQUAL(APR_SUCCESS, parsegraph_SessionPool_checkout(sessions, 0, &a));
+    TEST_ASSERT_EQUAL(APR_SUCCESS, parsegraph_SessionPool_checkout(sessions, 0, &b));
+    TEST_ASSERT(a != b);
+
+    // Pooled sessions are usable as soon as they are checked out.
+    int listId;
+    TEST_ASSERT_EQUAL(parsegraph_List_OK, parsegraph_List_new(a, "Pooled list", &listId));
+    TEST_ASSERT_EQUAL(parsegraph_List_OK, parsegraph_List_destroy(b, listId));
+
+    // Both sessions are out, so a third checkout times out.
+    TEST_ASSERT_EQUAL(APR_TIMEUP, parsegraph_SessionPool_checkout(sessions, 1000, &c));
+
+    parsegraph_SessionPool_checkin(sessions, b);
+    TEST_ASSERT_EQUAL(APR_SUCCESS, parsegraph_SessionPool_checkout(sessions, 0, &c));
+    TEST_ASSERT(b == c);
+    parsegraph_SessionPool_checkin(sessions, a);
+    parsegraph_SessionPool_checkin(sessions, c);
+
+    parsegraph_SessionPoolStats stats;
+    parsegraph_SessionPool_stats(sessions, &stats);
+    TEST_ASSERT_EQUAL(3, stats.checkouts);
+    TEST_ASSERT_EQUAL(1, stats.timeouts);
+    TEST_ASSERT(stats.maxWait >= 1000);
+
+    // Checking a session in frees what was allocated from its pool.
+    TEST_ASSERT_EQUAL(APR_SUCCESS, parsegraph_SessionPool_checkout(sessions, 0, &a));
+    int cleared = 0;
+    apr_pool_cleanup_register(a->pool, &cleared, markCleared, apr_pool_cleanup_null);
+    parsegraph_SessionPool_checkin(sessions, a);
+    TEST_ASSERT_EQUAL_INT(1, cleared);
+
+    parsegraph_SessionPool_destroy(sessions);
+}
+
+void test_readers()
+{
+    parsegraph_SessionPool* readers = parsegraph_SessionPool_new(session->pool, session->server, testDriver, testParams, 2, parsegraph_Session_makeReadOnly, 0);
+    TEST_ASSERT_NOT_NULL(readers);
+    parsegraph_Session_setReaders(session, readers);
+
+    int listId;
+    TEST_ASSERT_EQUAL(parsegraph_List_OK, parsegraph_List_new(session, "Read list", &listId));
+    int itemId;
+    TEST_ASSERT_EQUAL(parsegraph_List_OK, parsegraph_List_appendItem(session, listId, 0, "A", &itemId));
+
+    // Committed writes are visible to the readers.
+    parsegraph_SessionPoolStats stats;
+    parsegraph_SessionPool_stats(readers, &stats);
+    apr_uint64_t checkouts = stats.checkouts;
+    parsegraph_Stats_reset(session);
+    size_t len;
+    TEST_ASSERT_EQUAL(parsegraph_List_OK, parsegraph_List_length(session, listId, &len));
+    TEST_ASSERT_EQUAL(1, len);
+    parsegraph_SessionPool_stats(readers, &stats);
+    TEST_ASSERT(stats.checkouts > checkouts);
+
+    // Reads run on a reader count toward the session they were run for.
+    parsegraph_StatementStats* statementStats = parsegraph_Stats_get(session, parsegraph_Statement_List_length);
+    TEST_ASSERT_EQUAL(1, statementStats->calls);
+    TEST_ASSERT_EQUAL(1, statementStats->rowsReturned);
+
+    // Within a transaction, reads stay on the writer and see its own writes.
+    TEST_ASSERT_EQUAL(parsegraph_OK, parsegraph_beginTransaction(session, "test_readers"));
+    checkouts = stats.checkouts;
+    TEST_ASSERT_EQUAL(parsegraph_List_OK, parsegraph_List_appendItem(session, listId, 0, "B", &itemId));
+    TEST_ASSERT_EQUAL(parsegraph_List_OK, parsegraph_List_length(session, listId, &len));
+    TEST_ASSERT_EQUAL(2, len);
+    parsegraph_SessionPool_stats(readers, &stats);
+    TEST_ASSERT_EQUAL(checkouts, stats.checkouts);
+    TEST_ASSERT_EQUAL(parsegraph_OK, parsegraph_rollbackTransaction(session, "test_readers"));
+
+    TEST_ASSERT_EQUAL(parsegraph_List_OK, parsegraph_List_destroy(session, listId));
+    parsegraph_Session_setReaders(session, 0);
+    parsegraph_SessionPool_destroy(readers);
+}
+
+static int listsEnvironment(apr_array_header_t* envs, parsegraph_GUID* env)
+{
+    for(int i = 0; i < envs->nelts; ++i) {
+        if(!strcmp(env->value, APR_ARRAY_IDX(envs, i, parsegraph_EnvironmentSummary).envGUID.value)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void test_shards()
+{
+    if(strcmp(testDriver, "sqlite3")) {
+        TEST_IGNORE_MESSAGE("Shards are tested with SQLite files.");
+    }
+    // Shard parameters must say where the index goes.
+    TEST_ASSERT_NULL(parsegraph_Shards_open(session->pool, session->server, testDriver, testParams, "tests/shard.sqlite", 3));
+
+    parsegraph_Shards* shards = parsegraph_Shards_open(session->pool, session->server, testDriver, testParams, "tests/shard-%d.sqlite", 3);
+    TEST_ASSERT_NOT_NULL(shards);
+    TEST_ASSERT_EQUAL(0, parsegraph_Shards_upgradeTables(shards));
+    parsegraph_Session* global = parsegraph_Shards_global(shards);
+
+    parsegraph_GUID env;
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_Shards_createEnvironment(shards, 0, 0, &env));
+    TEST_ASSERT_EQUAL(36, strlen(env.value));
+
+    // The environment is only in its own shard, and the global session finds it there.
+    int index = parsegraph_Shards_indexFor(shards, &env);
+    int envId;
+    for(int i = 0; i < parsegraph_Shards_count(shards); ++i) {
+        parsegraph_EnvironmentStatus erv = parsegraph_getEnvironmentIdForGUID(parsegraph_Shards_shard(shards, i), &env, &envId);
+        TEST_ASSERT_EQUAL(i == index ? parsegraph_Environment_OK : parsegraph_Environment_NOT_FOUND, erv);
+    }
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_getEnvironmentIdForGUID(global, &env, &envId));
+    int rootListId;
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_getEnvironmentRoot(global, &env, &rootListId));
+    TEST_ASSERT(rootListId > 0);
+
+    // Environments created through the global session go to their shards too.
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(global, TEST_USERNAME));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_createNewUser(global, TEST_USERNAME, TEST_PASSWORD));
+    int userId = 0;
+    TEST_ASSERT_EQUAL(parsegraph_OK, parsegraph_getIdForUsername(global, TEST_USERNAME, &userId));
+    parsegraph_GUID owned;
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_createEnvironment(global, userId, 0, 0, &owned));
+    index = parsegraph_Shards_indexFor(shards, &owned);
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_getEnvironmentIdForGUID(parsegraph_Shards_shard(shards, index), &owned, &envId));
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_getEnvironmentRoot(global, &owned, &rootListId));
+    TEST_ASSERT(rootListId > 0);
+
+    // Per-user listings are gathered from every shard.
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_saveEnvironment(global, userId, &env, ""));
+    apr_array_header_t* envs = 0;
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_listOwnedEnvironments(global, session->pool, userId, &envs));
+    TEST_ASSERT_TRUE(listsEnvironment(envs, &owned));
+    TEST_ASSERT_FALSE(listsEnvironment(envs, &env));
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_listSavedEnvironments(global, session->pool, userId, &envs));
+    TEST_ASSERT_TRUE(listsEnvironment(envs, &env));
+    TEST_ASSERT_FALSE(listsEnvironment(envs, &owned));
+
+    // Result sets cannot span shards.
+    apr_dbd_results_t* res = 0;
+    TEST_ASSERT_EQUAL(parsegraph_Environment_INTERNAL_ERROR, parsegraph_getOwnedEnvironmentGUIDs(global, userId, &res));
+
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_destroyEnvironment(global, &owned));
+    TEST_ASSERT_EQUAL(parsegraph_Environment_OK, parsegraph_destroyEnvironment(global, &env));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(global, TEST_USERNAME));
+    parsegraph_Shards_close(shards);
+}
+
 int main(int argc, const char* const* argv)
 {
     UNITY_BEGIN();
@@ -231,18 +612,25 @@ int main(int argc, const char* const* argv)
         fprintf(stderr, "Failed initializing DBD memory");
         return -1;
     }
-    rv = apr_dbd_get_driver(pool, "sqlite3", &dbd->driver);
+    // PARSEGRAPH_TEST_DRIVER and PARSEGRAPH_TEST_PARAMS run the suite against
+    // another database, such as a throwaway PostgreSQL instance.
+    if(getenv("PARSEGRAPH_TEST_DRIVER")) {
+        testDriver = getenv("PARSEGRAPH_TEST_DRIVER");
+        testParams = getenv("PARSEGRAPH_TEST_PARAMS");
+    }
+    rv = apr_dbd_get_driver(pool, testDriver, &dbd->driver);
     if(rv != APR_SUCCESS) {
         fprintf(stderr, "Failed creating DBD driver, APR status of %d.\n", rv);
         return -1;
     }
-    const char* db_path = "tests/users.sqlite";
+    const char* db_path = testParams;
     rv = apr_dbd_open(dbd->driver, pool, db_path, &dbd->handle);
     if(rv != APR_SUCCESS) {
         fprintf(stderr, "Failed connecting to database at %s, APR status of %d.\n", db_path, rv);
         return -1;
     }
     dbd->prepared = apr_hash_make(pool);
+    dbd->pool = pool;
 
     session = parsegraph_Session_new(pool, dbd);
 
@@ -286,9 +674,17 @@ int main(int argc, const char* const* argv)
     RUN_TEST(test_environment);
     RUN_TEST(test_environmentId);
     RUN_TEST(test_environmentGUID);
+    RUN_TEST(test_binaryGUID);
+    RUN_TEST(test_timeOrderedGUID);
     RUN_TEST(test_savedEnvironments);
     RUN_TEST(test_storageItems);
     RUN_TEST(test_enterEnvironment);
+    RUN_TEST(test_pendingEvents);
+    RUN_TEST(test_workerPool);
+    RUN_TEST(test_workerPoolQueueLimit);
+    RUN_TEST(test_sessionPool);
+    RUN_TEST(test_readers);
+    RUN_TEST(test_shards);
 
     parsegraph_Session_destroy(session);
 
@@ -59,6 +59,7 @@ int main(int argc, const char* const* argv)
         return -1;
     }
     dbd->prepared = apr_hash_make(pool);
+    dbd->pool = pool;
 
     session = parsegraph_Session_new(pool, dbd);
 
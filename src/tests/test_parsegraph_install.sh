@@ -15,3 +15,8 @@ test -z $PARSEGRAPH_INSTALL && die "No install script was found"
 $PARSEGRAPH_INSTALL sqlite3 test_install.$$ || die "Install script failed"
 test -e test_install.$$ || die "Installed database was not created."
 trap 'rm -f test_install.$$' TERM EXIT
+
+! test -e test_install_profile.$$ || die "Install database must not already exist"
+$PARSEGRAPH_INSTALL --profile sqlite3 test_install_profile.$$ || die "Install script failed with --profile"
+test -e test_install_profile.$$ || die "Installed database was not created with --profile."
+trap 'rm -f test_install.$$ test_install_profile.$$ test_install_profile.$$-wal test_install_profile.$$-shm' TERM EXIT
@@ -0,0 +1,28 @@
+#!/bin/bash
+# Runs the unity suites against a throwaway PostgreSQL instance that listens
+# only on a socket in a temporary directory.
+
+die() {
+    echo $* >&2
+    exit 1
+}
+
+PG_BINDIR=`pg_config --bindir 2>/dev/null`
+test -n "$PG_BINDIR" || die "PostgreSQL was not found"
+
+PGDATA=`mktemp -d /tmp/parsegraph_pgsql.XXXXXX` || die "Failed creating a data directory"
+trap '"$PG_BINDIR/pg_ctl" -D "$PGDATA" -m immediate stop >/dev/null 2>&1; rm -rf "$PGDATA"' TERM EXIT
+
+"$PG_BINDIR/initdb" -D "$PGDATA" -A trust -U parsegraph >/dev/null || die "initdb failed"
+"$PG_BINDIR/pg_ctl" -D "$PGDATA" -w -l "$PGDATA/log" \
+    -o "-k $PGDATA -c listen_addresses=''" start >/dev/null || die "PostgreSQL failed to start"
+"$PG_BINDIR/createdb" -h "$PGDATA" -U parsegraph parsegraph_test || die "createdb failed"
+
+export PARSEGRAPH_TEST_DRIVER=pgsql
+export PARSEGRAPH_TEST_PARAMS="host=$PGDATA user=parsegraph dbname=parsegraph_test"
+
+status=0
+for suite in "$@"; do
+    ./$suite || status=1
+done
+exit $status
@@ -1,12 +1,28 @@
 #include "parsegraph_user.h"
+#include "parsegraph_LoginCache.h"
+#include "parsegraph_SignedLogins.h"
+#include "parsegraph_Random.h"
+#include "parsegraph_RateLimiter.h"
+#include "parsegraph_UsernameIndex.h"
+#include "parsegraph_Profile.h"
 #include "unity.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <apr_strings.h>
+#include <apr_file_io.h>
+#include <apr_base64.h>
+#include <openssl/sha.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 static parsegraph_Session* session = NULL;
 
 static const char* TEST_USERNAME = "foodens";
 static const char* TEST_PASSWORD = "barbarbaz";
 static const char* TEST_PASSWORD2 = "zoozoobat";
+static const char* testDriver = "sqlite3";
+static const char* testParams = "tests/users.sqlite3";
 
 void test_createNewUser()
 {
@@ -190,6 +206,174 @@ void test_listUsers()
     TEST_ASSERT_EQUAL_INT(0, parsegraph_listUsers(session, &res));
 }
 
+void test_listUsersAfter()
+{
+    const char* names[] = { "pagera", "pagerb", "pagerc" };
+    for(int i = 0; i < 3; ++i) {
+        parsegraph_removeUser(session, names[i]);
+        TEST_ASSERT_EQUAL_INT(0, parsegraph_createNewUser(session, names[i], TEST_PASSWORD));
+    }
+
+    // Pages continue after the last id of the one before.
+    int afterId = 0;
+    int seen = 0;
+    int pages = 0;
+    for(;;) {
+        apr_array_header_t* users;
+        TEST_ASSERT_EQUAL_INT(0, parsegraph_listUsersAfter(session, session->pool, afterId, 2, &users));
+        if(users->nelts == 0) {
+            break;
+        }
+        TEST_ASSERT_TRUE(users->nelts <= 2);
+        for(int i = 0; i < users->nelts; ++i) {
+            parsegraph_UserSummary* user = &APR_ARRAY_IDX(users, i, parsegraph_UserSummary);
+            TEST_ASSERT_TRUE(user->id > afterId);
+            afterId = user->id;
+            if(!strncmp(user->username, "pager", 5)) {
+                ++seen;
+            }
+        }
+        ++pages;
+    }
+    TEST_ASSERT_EQUAL_INT(3, seen);
+    TEST_ASSERT_TRUE(pages >= 2);
+
+    // Pages hold at least one user and at most the maximum.
+    apr_array_header_t* users;
+    TEST_ASSERT_EQUAL_INT(parsegraph_ERROR, parsegraph_listUsersAfter(session, session->pool, 0, 0, &users));
+    TEST_ASSERT_EQUAL_INT(parsegraph_ERROR, parsegraph_listUsersAfter(session, session->pool, 0, -1, &users));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_listUsersAfter(session, session->pool, 0, 1 << 30, &users));
+    TEST_ASSERT_TRUE(users->nelts >= 3 && users->nelts <= parsegraph_USER_PAGE_MAX_SIZE);
+
+    // The iterator reads the same users in the same order.
+    parsegraph_UserIterator iter;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_UserIterator_open(&iter, session, 2));
+    parsegraph_UserSummary* user;
+    int lastId = 0;
+    seen = 0;
+    for(;;) {
+        TEST_ASSERT_EQUAL_INT(0, parsegraph_UserIterator_next(&iter, &user));
+        if(!user) {
+            break;
+        }
+        TEST_ASSERT_TRUE(user->id > lastId);
+        lastId = user->id;
+        if(!strncmp(user->username, "pager", 5)) {
+            ++seen;
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(3, seen);
+    TEST_ASSERT_EQUAL_INT(afterId, lastId);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_UserIterator_next(&iter, &user));
+    TEST_ASSERT_NULL(user);
+    parsegraph_UserIterator_close(&iter);
+
+    for(int i = 0; i < 3; ++i) {
+        TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(session, names[i]));
+    }
+}
+
+void test_UserIterator_largePages()
+{
+    // Insert more users than fit in one page, without hashing a password for each.
+    ap_dbd_t* dbd = session->dbd;
+    int nrows;
+    TEST_ASSERT_EQUAL_INT(0, apr_dbd_query(dbd->driver, dbd->handle, &nrows,
+        "delete from \"user\" where username like 'bulkuser%'"));
+    TEST_ASSERT_EQUAL_INT(0, apr_dbd_query(dbd->driver, dbd->handle, &nrows,
+        "with recursive n(i) as (select 1 union all select i + 1 from n where i < 1500) "
+        "insert into \"user\"(username) select 'bulkuser' || i from n"));
+    TEST_ASSERT_EQUAL_INT(1500, nrows);
+
+    // A page size above the maximum still reads every user.
+    parsegraph_UserIterator iter;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_UserIterator_open(&iter, session, 5000));
+    parsegraph_UserSummary* user;
+    int seen = 0;
+    for(;;) {
+        TEST_ASSERT_EQUAL_INT(0, parsegraph_UserIterator_next(&iter, &user));
+        if(!user) {
+            break;
+        }
+        if(!strncmp(user->username, "bulkuser", 8)) {
+            ++seen;
+        }
+    }
+    parsegraph_UserIterator_close(&iter);
+    TEST_ASSERT_EQUAL_INT(1500, seen);
+
+    TEST_ASSERT_EQUAL_INT(0, apr_dbd_query(dbd->driver, dbd->handle, &nrows,
+        "delete from \"user\" where username like 'bulkuser%'"));
+}
+
+void test_usernameIndex()
+{
+    const char* names[] = { "Indexalpha", "indexbeta", "indexgamma", "otheruser" };
+    for(int i = 0; i < 4; ++i) {
+        parsegraph_removeUser(session, names[i]);
+    }
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_createNewUser(session, names[0], TEST_PASSWORD));
+
+    parsegraph_UsernameIndex* index = parsegraph_UsernameIndex_new(session->pool);
+    TEST_ASSERT_NOT_NULL(index);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_UsernameIndex_load(index, session));
+    int loaded = parsegraph_UsernameIndex_size(index);
+    TEST_ASSERT_TRUE(loaded >= 1);
+
+    // Users created and removed through the session update the index.
+    parsegraph_Session_setUsernameIndex(session, index);
+    for(int i = 1; i < 4; ++i) {
+        TEST_ASSERT_EQUAL_INT(0, parsegraph_createNewUser(session, names[i], TEST_PASSWORD));
+    }
+    TEST_ASSERT_EQUAL_INT(loaded + 3, parsegraph_UsernameIndex_size(index));
+
+    // Prefixes match without regard to case, in order, up to the limit.
+    apr_array_header_t* users;
+    parsegraph_UsernameIndex_search(index, session->pool, "INDEX", 10, &users);
+    TEST_ASSERT_EQUAL_INT(3, users->nelts);
+    TEST_ASSERT_EQUAL_STRING("Indexalpha", APR_ARRAY_IDX(users, 0, parsegraph_UserSummary).username);
+    TEST_ASSERT_EQUAL_STRING("indexbeta", APR_ARRAY_IDX(users, 1, parsegraph_UserSummary).username);
+    TEST_ASSERT_EQUAL_STRING("indexgamma", APR_ARRAY_IDX(users, 2, parsegraph_UserSummary).username);
+
+    parsegraph_UserRecord* record;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_loadUser(session, "indexbeta", &record));
+    TEST_ASSERT_EQUAL_INT(record->id, APR_ARRAY_IDX(users, 1, parsegraph_UserSummary).id);
+
+    parsegraph_UsernameIndex_search(index, session->pool, "index", 2, &users);
+    TEST_ASSERT_EQUAL_INT(2, users->nelts);
+    parsegraph_UsernameIndex_search(index, session->pool, "indexz", 10, &users);
+    TEST_ASSERT_EQUAL_INT(0, users->nelts);
+
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(session, "indexbeta"));
+    parsegraph_UsernameIndex_search(index, session->pool, "indexb", 10, &users);
+    TEST_ASSERT_EQUAL_INT(0, users->nelts);
+
+    // Loading again finds the same users.
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_UsernameIndex_load(index, session));
+    TEST_ASSERT_EQUAL_INT(loaded + 2, parsegraph_UsernameIndex_size(index));
+
+    // Changes in a transaction reach the index only when it commits.
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_beginTransaction(session, "usernameIndex"));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_createNewUser(session, "indexbeta", TEST_PASSWORD));
+    TEST_ASSERT_EQUAL_INT(loaded + 2, parsegraph_UsernameIndex_size(index));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_rollbackTransaction(session, "usernameIndex"));
+    TEST_ASSERT_EQUAL_INT(loaded + 2, parsegraph_UsernameIndex_size(index));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_countPendingUsernames(session));
+
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_beginTransaction(session, "usernameIndex"));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_createNewUser(session, "indexbeta", TEST_PASSWORD));
+    TEST_ASSERT_EQUAL_INT(loaded + 2, parsegraph_UsernameIndex_size(index));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_commitTransaction(session, "usernameIndex"));
+    TEST_ASSERT_EQUAL_INT(loaded + 3, parsegraph_UsernameIndex_size(index));
+
+    for(int i = 0; i < 4; ++i) {
+        parsegraph_removeUser(session, names[i]);
+    }
+    TEST_ASSERT_EQUAL_INT(loaded - 1, parsegraph_UsernameIndex_size(index));
+    parsegraph_Session_setUsernameIndex(session, 0);
+    parsegraph_UsernameIndex_destroy(index);
+}
+
 void test_encryptPassword()
 {
     char* password_hash_encoded;
@@ -272,6 +456,14 @@ void test_refreshUserLogin()
         session, createdLogin
     ));
     TEST_ASSERT_EQUAL_STRING(TEST_USERNAME, createdLogin->username);
+
+    // Only the token's hash is stored, and it must match.
+    struct parsegraph_user_login forged = *createdLogin;
+    forged.session_token = apr_pstrdup(session->pool, createdLogin->session_token);
+    ((char*)forged.session_token)[0] = forged.session_token[0] == 'A' ? 'B' : 'A';
+    TEST_ASSERT_EQUAL_INT(parsegraph_SESSION_DOES_NOT_MATCH, parsegraph_refreshUserLogin(session, &forged));
+    forged.session_selector = "no such selector";
+    TEST_ASSERT_EQUAL_INT(parsegraph_SESSION_DOES_NOT_EXIST, parsegraph_refreshUserLogin(session, &forged));
 }
 
 void test_changeUserPassword()
@@ -411,6 +603,514 @@ void test_getIdForUsername()
     ));
 }
 
+void test_loginCache()
+{
+    parsegraph_LoginCache* cache = parsegraph_LoginCache_new(session->pool, 2, apr_time_from_sec(60));
+    TEST_ASSERT_NOT_NULL(cache);
+    parsegraph_Session_setLoginCache(session, cache);
+
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(session, TEST_USERNAME));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_createNewUser(session, TEST_USERNAME, TEST_PASSWORD));
+    int userId;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_getIdForUsername(session, TEST_USERNAME, &userId));
+
+    struct parsegraph_user_login* createdLogin;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_beginUserLogin(session, TEST_USERNAME, TEST_PASSWORD, &createdLogin));
+
+    // The first refresh queries the database, and the second is answered from the cache.
+    parsegraph_LoginCacheStats stats;
+    for(int i = 0; i < 2; ++i) {
+        createdLogin->username = 0;
+        createdLogin->userId = -1;
+        TEST_ASSERT_EQUAL_INT(0, parsegraph_refreshUserLogin(session, createdLogin));
+        TEST_ASSERT_EQUAL_STRING(TEST_USERNAME, createdLogin->username);
+        TEST_ASSERT_EQUAL_INT(userId, createdLogin->userId);
+    }
+    parsegraph_LoginCache_stats(cache, &stats);
+    TEST_ASSERT_EQUAL_INT(1, stats.hits);
+    TEST_ASSERT_EQUAL_INT(1, stats.size);
+
+    // A cached selector with the wrong token is not accepted.
+    struct parsegraph_user_login forged = *createdLogin;
+    forged.session_token = "not the token";
+    TEST_ASSERT(0 != parsegraph_refreshUserLogin(session, &forged));
+    TEST_ASSERT_NULL(forged.username);
+
+    // Ending the login removes it from the cache.
+    int loginsEnded;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_endUserLogin(session, TEST_USERNAME, &loginsEnded));
+    parsegraph_LoginCache_stats(cache, &stats);
+    TEST_ASSERT_EQUAL_INT(0, stats.size);
+    TEST_ASSERT(0 != parsegraph_refreshUserLogin(session, createdLogin));
+
+    // The least recently used login is evicted when the cache is full.
+    parsegraph_LoginCache_put(cache, "a", "token", TEST_USERNAME, userId);
+    parsegraph_LoginCache_put(cache, "b", "token", TEST_USERNAME, userId);
+    const char* username;
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_LoginCache_get(cache, session->pool, "a", "token", &username, &userId));
+    parsegraph_LoginCache_put(cache, "c", "token", TEST_USERNAME, userId);
+    TEST_ASSERT_EQUAL_INT(APR_ENOENT, parsegraph_LoginCache_get(cache, session->pool, "b", "token", &username, &userId));
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_LoginCache_get(cache, session->pool, "a", "token", &username, &userId));
+
+    // Removing the user removes the rest of its logins.
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(session, TEST_USERNAME));
+    parsegraph_LoginCache_stats(cache, &stats);
+    TEST_ASSERT_EQUAL_INT(0, stats.size);
+    TEST_ASSERT_EQUAL_INT(1, stats.evictions);
+
+    parsegraph_Session_setLoginCache(session, 0);
+    parsegraph_LoginCache_destroy(cache);
+}
+
+void test_loginCache_shared()
+{
+    parsegraph_LoginCache* cache = parsegraph_LoginCache_newShared(session->pool, 16, apr_time_from_sec(60), 0);
+    TEST_ASSERT_NOT_NULL(cache);
+
+    // A login cached by a forked child is seen by its parent.
+    pid_t child = fork();
+    TEST_ASSERT(child >= 0);
+    if(child == 0) {
+        parsegraph_LoginCache_put(cache, "selector", "token", TEST_USERNAME, 42);
+        _exit(0);
+    }
+    int status;
+    TEST_ASSERT_EQUAL_INT(child, waitpid(child, &status, 0));
+    TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+
+    const char* username;
+    int userId;
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_LoginCache_get(cache, session->pool, "selector", "token", &username, &userId));
+    TEST_ASSERT_EQUAL_STRING(TEST_USERNAME, username);
+    TEST_ASSERT_EQUAL_INT(42, userId);
+    TEST_ASSERT_EQUAL_INT(APR_ENOENT, parsegraph_LoginCache_get(cache, session->pool, "selector", "other", &username, &userId));
+
+    // Lookups are counted by the process that made them.
+    child = fork();
+    TEST_ASSERT(child >= 0);
+    if(child == 0) {
+        parsegraph_LoginCache_get(cache, session->pool, "selector", "token", &username, &userId);
+        _exit(0);
+    }
+    TEST_ASSERT_EQUAL_INT(child, waitpid(child, &status, 0));
+    parsegraph_LoginCacheStats stats;
+    parsegraph_LoginCache_stats(cache, &stats);
+    TEST_ASSERT_EQUAL_INT(1, stats.hits);
+    TEST_ASSERT_EQUAL_INT(1, stats.misses);
+
+    // Each bucket evicts by its clock rather than failing when full.
+    for(int i = 0; i < 64; ++i) {
+        parsegraph_LoginCache_put(cache, apr_psprintf(session->pool, "s%d", i), "token", TEST_USERNAME, i);
+    }
+    parsegraph_LoginCache_stats(cache, &stats);
+    TEST_ASSERT(stats.size <= 16);
+    TEST_ASSERT(stats.evictions > 0);
+
+    // Ending a user's logins in the child removes them for the parent too.
+    child = fork();
+    TEST_ASSERT(child >= 0);
+    if(child == 0) {
+        parsegraph_LoginCache_removeUser(cache, TEST_USERNAME);
+        _exit(0);
+    }
+    TEST_ASSERT_EQUAL_INT(child, waitpid(child, &status, 0));
+    parsegraph_LoginCache_stats(cache, &stats);
+    TEST_ASSERT_EQUAL_INT(0, stats.size);
+
+    parsegraph_LoginCache_destroy(cache);
+}
+
+void test_signedLogin()
+{
+    const unsigned char key[] = "test signing key";
+    parsegraph_SignedLogins* logins = parsegraph_SignedLogins_new(session->pool, key, sizeof(key) - 1, apr_time_from_sec(60), apr_time_from_sec(60));
+    TEST_ASSERT_NOT_NULL(logins);
+    parsegraph_Session_setSignedLogins(session, logins);
+
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(session, TEST_USERNAME));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_createNewUser(session, TEST_USERNAME, TEST_PASSWORD));
+    int userId;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_getIdForUsername(session, TEST_USERNAME, &userId));
+
+    const char* sessionValue;
+    TEST_ASSERT_EQUAL_INT(parsegraph_INVALID_PASSWORD, parsegraph_beginSignedUserLogin(session, TEST_USERNAME, "not the password", &sessionValue));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_beginSignedUserLogin(session, TEST_USERNAME, TEST_PASSWORD, &sessionValue));
+
+    int verifiedId = -1;
+    TEST_ASSERT_EQUAL_INT(parsegraph_OK, parsegraph_SignedLogins_verify(logins, session, sessionValue, &verifiedId));
+    TEST_ASSERT_EQUAL_INT(userId, verifiedId);
+
+    // Changing the payload invalidates the signature.
+    char* forged = apr_pstrdup(session->pool, sessionValue);
+    forged[0] = forged[0] == '9' ? '8' : '9';
+    TEST_ASSERT_EQUAL_INT(parsegraph_SESSION_DOES_NOT_MATCH, parsegraph_SignedLogins_verify(logins, session, forged, &verifiedId));
+
+    // Values from a login row are not signed values.
+    TEST_ASSERT_EQUAL_INT(parsegraph_SESSION_MALFORMED, parsegraph_SignedLogins_verify(logins, session, "selector$token", &verifiedId));
+
+    // Ending the user's logins revokes values issued before.
+    int loginsEnded;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_endUserLogin(session, TEST_USERNAME, &loginsEnded));
+    TEST_ASSERT_EQUAL_INT(parsegraph_SESSION_DOES_NOT_EXIST, parsegraph_SignedLogins_verify(logins, session, sessionValue, &verifiedId));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_beginSignedUserLogin(session, TEST_USERNAME, TEST_PASSWORD, &sessionValue));
+    TEST_ASSERT_EQUAL_INT(parsegraph_OK, parsegraph_SignedLogins_verify(logins, session, sessionValue, &verifiedId));
+
+    // Values expire.
+    parsegraph_SignedLogins* expired = parsegraph_SignedLogins_new(session->pool, key, sizeof(key) - 1, -apr_time_from_sec(1), apr_time_from_sec(60));
+    TEST_ASSERT_NOT_NULL(expired);
+    sessionValue = parsegraph_SignedLogins_sign(expired, session->pool, userId, 1);
+    TEST_ASSERT_EQUAL_INT(parsegraph_SESSION_DOES_NOT_EXIST, parsegraph_SignedLogins_verify(expired, session, sessionValue, &verifiedId));
+
+    // Revocations are kept while values issued before them may be unexpired.
+    int pruned;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_SignedLogins_prune(logins, session, &pruned));
+    int generation;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_getLoginGeneration(session, userId, &generation));
+    TEST_ASSERT_TRUE(generation > 0);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_SignedLogins_prune(expired, session, &pruned));
+    TEST_ASSERT_TRUE(pruned >= 1);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_getLoginGeneration(session, userId, &generation));
+    TEST_ASSERT_EQUAL_INT(0, generation);
+    parsegraph_SignedLogins_destroy(expired);
+
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(session, TEST_USERNAME));
+    parsegraph_Session_setSignedLogins(session, 0);
+    parsegraph_SignedLogins_destroy(logins);
+}
+
+void test_loginRevocationCleanup()
+{
+    const unsigned char key[] = "test signing key";
+    parsegraph_SignedLogins* logins = parsegraph_SignedLogins_new(session->pool, key, sizeof(key) - 1, apr_time_from_sec(60), apr_time_from_sec(60));
+    TEST_ASSERT_NOT_NULL(logins);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(session, TEST_USERNAME));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_createNewUser(session, TEST_USERNAME, TEST_PASSWORD));
+    int userId;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_getIdForUsername(session, TEST_USERNAME, &userId));
+
+    // Without signed logins, ending logins records no revocation.
+    int loginsEnded;
+    int generation;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_endUserLogin(session, TEST_USERNAME, &loginsEnded));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_getLoginGeneration(session, userId, &generation));
+    TEST_ASSERT_EQUAL_INT(0, generation);
+
+    // Sweeps without a signer prune revocations older than the revocation lifetime.
+    parsegraph_Session_setSignedLogins(session, logins);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_endUserLogin(session, TEST_USERNAME, &loginsEnded));
+    parsegraph_Session_setSignedLogins(session, 0);
+    parsegraph_Session_setRevocationLifetime(session, apr_time_from_sec(60));
+    int swept;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_sweepExpiredLogins(session, 100, 0, &swept));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_getLoginGeneration(session, userId, &generation));
+    TEST_ASSERT_TRUE(generation > 0);
+    ap_dbd_t* dbd = session->dbd;
+    int nrows;
+    TEST_ASSERT_EQUAL_INT(0, apr_dbd_query(dbd->driver, dbd->handle, &nrows, "update login_revocation set revoked = revoked - 120"));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_sweepExpiredLogins(session, 100, 0, &swept));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_getLoginGeneration(session, userId, &generation));
+    TEST_ASSERT_EQUAL_INT(0, generation);
+    parsegraph_Session_setRevocationLifetime(session, 0);
+
+    // Removing the user without a signer removes its revocation.
+    parsegraph_Session_setSignedLogins(session, logins);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_endUserLogin(session, TEST_USERNAME, &loginsEnded));
+    parsegraph_Session_setSignedLogins(session, 0);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(session, TEST_USERNAME));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_getLoginGeneration(session, userId, &generation));
+    TEST_ASSERT_EQUAL_INT(0, generation);
+    parsegraph_SignedLogins_destroy(logins);
+}
+
+static void ageLogins(int seconds)
+{
+    ap_dbd_t* dbd = session->dbd;
+    int nrows;
+    const char* sql = apr_psprintf(session->pool, "update login set last_seen = last_seen - %d", seconds);
+    TEST_ASSERT_EQUAL_INT(0, apr_dbd_query(dbd->driver, dbd->handle, &nrows, sql));
+}
+
+void test_loginExpiry()
+{
+    parsegraph_Session_setLoginExpiry(session, apr_time_from_sec(60));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(session, TEST_USERNAME));
+
+    // Sweep logins left by earlier tests.
+    int swept;
+    ageLogins(120);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_sweepExpiredLogins(session, 100, 0, &swept));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_createNewUser(session, TEST_USERNAME, TEST_PASSWORD));
+
+    struct parsegraph_user_login* createdLogin;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_beginUserLogin(session, TEST_USERNAME, TEST_PASSWORD, &createdLogin));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_refreshUserLogin(session, createdLogin));
+
+    // Using a login keeps it alive.
+    ageLogins(50);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_refreshUserLogin(session, createdLogin));
+    ageLogins(50);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_refreshUserLogin(session, createdLogin));
+
+    // An unused login expires, and is swept in batches.
+    for(int i = 0; i < 2; ++i) {
+        TEST_ASSERT_EQUAL_INT(0, parsegraph_beginUserLogin(session, TEST_USERNAME, TEST_PASSWORD, &createdLogin));
+    }
+    ageLogins(61);
+    TEST_ASSERT_EQUAL_INT(parsegraph_SESSION_DOES_NOT_EXIST, parsegraph_refreshUserLogin(session, createdLogin));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_beginUserLogin(session, TEST_USERNAME, TEST_PASSWORD, &createdLogin));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_sweepExpiredLogins(session, 1, 2, &swept));
+    TEST_ASSERT_EQUAL_INT(2, swept);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_sweepExpiredLogins(session, 2, 0, &swept));
+    TEST_ASSERT_EQUAL_INT(1, swept);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_refreshUserLogin(session, createdLogin));
+
+    parsegraph_Session_setLoginExpiry(session, 0);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(session, TEST_USERNAME));
+}
+
+static const char* storedPasswordHash()
+{
+    ap_dbd_t* dbd = session->dbd;
+    apr_dbd_results_t* res = 0;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_getUser(session, &res, TEST_USERNAME));
+    apr_dbd_row_t* row = 0;
+    TEST_ASSERT_EQUAL_INT(0, apr_dbd_get_row(dbd->driver, session->pool, res, &row, -1));
+    const char* hash = apr_pstrdup(session->pool, apr_dbd_get_entry(dbd->driver, row, 1));
+    while(-1 != apr_dbd_get_row(dbd->driver, session->pool, res, &row, -1));
+    return hash;
+}
+
+void test_passwordRehash()
+{
+    int iterations = session->passwordIterations;
+    parsegraph_Session_setPasswordIterations(session, 1000);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(session, TEST_USERNAME));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_createNewUser(session, TEST_USERNAME, TEST_PASSWORD));
+    TEST_ASSERT_EQUAL_STRING_LEN("$pbkdf2-sha256$1000$", storedPasswordHash(), 20);
+
+    // A login with a stronger setting rehashes the password.
+    parsegraph_Session_setPasswordIterations(session, 2000);
+    struct parsegraph_user_login* createdLogin;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_beginUserLogin(session, TEST_USERNAME, TEST_PASSWORD, &createdLogin));
+    TEST_ASSERT_EQUAL_STRING_LEN("$pbkdf2-sha256$2000$", storedPasswordHash(), 20);
+
+    // Hashes in the older format still log in, and are moved to the current one.
+    const char* salt = "c2FsdHNhbHRzYWx0";
+    char* input = apr_pstrcat(session->pool, TEST_PASSWORD, salt, NULL);
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256((const unsigned char*)input, strlen(input), digest);
+    char* legacy = apr_palloc(session->pool, apr_base64_encode_len(SHA256_DIGEST_LENGTH));
+    apr_base64_encode(legacy, (const char*)digest, SHA256_DIGEST_LENGTH);
+    ap_dbd_t* dbd = session->dbd;
+    int nrows;
+    TEST_ASSERT_EQUAL_INT(0, apr_dbd_query(dbd->driver, dbd->handle, &nrows, apr_psprintf(session->pool,
+        "update \"user\" set password = '%s', password_salt = '%s' where username = '%s'", legacy, salt, TEST_USERNAME)));
+    TEST_ASSERT_EQUAL_INT(parsegraph_INVALID_PASSWORD, parsegraph_beginUserLogin(session, TEST_USERNAME, "not the password", &createdLogin));
+    TEST_ASSERT_EQUAL_STRING(legacy, storedPasswordHash());
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_beginUserLogin(session, TEST_USERNAME, TEST_PASSWORD, &createdLogin));
+    TEST_ASSERT_EQUAL_STRING_LEN("$pbkdf2-sha256$2000$", storedPasswordHash(), 20);
+
+    parsegraph_Session_setPasswordIterations(session, iterations);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(session, TEST_USERNAME));
+}
+
+void test_loadUser()
+{
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(session, TEST_USERNAME));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_createNewUser(session, TEST_USERNAME, TEST_PASSWORD));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_grantSuperadmin(session, TEST_USERNAME));
+
+    parsegraph_UserRecord* user;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_loadUser(session, TEST_USERNAME, &user));
+    TEST_ASSERT_EQUAL_STRING(TEST_USERNAME, user->username);
+    TEST_ASSERT_EQUAL_STRING(storedPasswordHash(), user->passwordHash);
+    TEST_ASSERT_EQUAL_INT(1, user->isSuperAdmin);
+    TEST_ASSERT_EQUAL_INT(0, user->isBanned);
+    TEST_ASSERT_EQUAL_INT(-1, user->storageListId);
+    TEST_ASSERT_EQUAL_INT(-1, user->disposedListId);
+
+    parsegraph_UserRecord* byId;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_loadUserById(session, user->id, &byId));
+    TEST_ASSERT_EQUAL_STRING(TEST_USERNAME, byId->username);
+    TEST_ASSERT_EQUAL_INT(parsegraph_USER_DOES_NOT_EXIST, parsegraph_loadUser(session, "nobody", &user));
+
+    // Memoized users are loaded once, and forgotten when changed through the session.
+    parsegraph_Session_beginUserMemo(session);
+    parsegraph_UserRecord* first;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_loadUser(session, TEST_USERNAME, &first));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_loadUserById(session, first->id, &user));
+    TEST_ASSERT_EQUAL_PTR(first, user);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_loadUser(session, TEST_USERNAME, &user));
+    TEST_ASSERT_EQUAL_PTR(first, user);
+
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_banUser(session, TEST_USERNAME));
+    int isBanned = 0;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_isBanned(session, TEST_USERNAME, &isBanned));
+    TEST_ASSERT_EQUAL_INT(1, isBanned);
+    parsegraph_Session_endUserMemo(session);
+
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(session, TEST_USERNAME));
+}
+
+void test_rateLimiter()
+{
+    parsegraph_RateLimiter* limiter = parsegraph_RateLimiter_new(session->pool, 4, 2, apr_time_from_sec(60));
+    TEST_ASSERT_NOT_NULL(limiter);
+
+    // Each key has its own bucket, and kinds keep equal keys apart.
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_RateLimiter_take(limiter, "username", "a", 1));
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_RateLimiter_take(limiter, "username", "a", 1));
+    TEST_ASSERT_EQUAL_INT(APR_EAGAIN, parsegraph_RateLimiter_take(limiter, "username", "a", 1));
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_RateLimiter_take(limiter, "address", "a", 1));
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_RateLimiter_takeUser(limiter, "join", 1));
+
+    parsegraph_RateLimiterStats stats;
+    parsegraph_RateLimiter_stats(limiter, &stats);
+    TEST_ASSERT_EQUAL_INT(4, stats.allowed);
+    TEST_ASSERT_EQUAL_INT(1, stats.limited);
+    TEST_ASSERT_EQUAL_INT(0, stats.evictions);
+    TEST_ASSERT_EQUAL_INT(3, stats.size);
+
+    // Memory is fixed, so new keys give up the least recently used buckets.
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_RateLimiter_takeUser(limiter, "join", 2));
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_RateLimiter_takeUser(limiter, "join", 3));
+    parsegraph_RateLimiter_stats(limiter, &stats);
+    TEST_ASSERT_EQUAL_INT(1, stats.evictions);
+    TEST_ASSERT_EQUAL_INT(4, stats.size);
+
+    parsegraph_RateLimiter_clear(limiter);
+    parsegraph_RateLimiter_stats(limiter, &stats);
+    TEST_ASSERT_EQUAL_INT(0, stats.size);
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_RateLimiter_take(limiter, "username", "a", 1));
+
+    // Peeking takes no token, and gives new keys no bucket.
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_RateLimiter_peek(limiter, "username", "a", 1));
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_RateLimiter_peek(limiter, "username", "a", 1));
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_RateLimiter_peek(limiter, "username", "b", 1));
+    parsegraph_RateLimiter_stats(limiter, &stats);
+    TEST_ASSERT_EQUAL_INT(1, stats.size);
+
+    // Limited logins are refused before the password is checked.
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(session, TEST_USERNAME));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_createNewUser(session, TEST_USERNAME, TEST_PASSWORD));
+    parsegraph_Session_setLoginLimiter(session, limiter);
+    parsegraph_Session_setRemoteAddress(session, "192.0.2.1");
+    struct parsegraph_user_login* createdLogin = 0;
+    TEST_ASSERT_EQUAL_INT(parsegraph_INVALID_PASSWORD, parsegraph_beginUserLogin(session, TEST_USERNAME, TEST_PASSWORD2, &createdLogin));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_beginUserLogin(session, TEST_USERNAME, TEST_PASSWORD, &createdLogin));
+    TEST_ASSERT_EQUAL_INT(parsegraph_RATE_LIMITED, parsegraph_beginUserLogin(session, TEST_USERNAME, TEST_PASSWORD, &createdLogin));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_isSeriousUserError(parsegraph_RATE_LIMITED));
+
+    // The address is limited across usernames, and the refusal spends none
+    // of the other username's attempts.
+    TEST_ASSERT_EQUAL_INT(parsegraph_RATE_LIMITED, parsegraph_beginUserLogin(session, "someoneelse", TEST_PASSWORD, &createdLogin));
+    for(int i = 0; i < 2; ++i) {
+        TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_RateLimiter_take(limiter, "username", "someoneelse", strlen("someoneelse")));
+    }
+    parsegraph_RateLimiter_logStats(limiter, session->server, "login");
+
+    parsegraph_Session_setLoginLimiter(session, 0);
+    parsegraph_Session_setRemoteAddress(session, 0);
+    parsegraph_RateLimiter_destroy(limiter);
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(session, TEST_USERNAME));
+}
+
+void test_randomBytes()
+{
+    unsigned char first[32], second[32];
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_randomBytes(first, sizeof first));
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_randomBytes(second, sizeof second));
+    TEST_ASSERT_NOT_EQUAL(0, memcmp(first, second, sizeof first));
+
+    // Requests may span refills, or exceed the buffer.
+    unsigned char large[10000];
+    for(int i = 0; i < 3; ++i) {
+        TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_randomBytes(large, 3000));
+    }
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_randomBytes(large, sizeof large));
+
+    // A forked child does not repeat its parent's bytes.
+    int fds[2];
+    TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+    pid_t child = fork();
+    if(child == 0) {
+        parsegraph_randomBytes(first, sizeof first);
+        _exit(write(fds[1], first, sizeof first) == sizeof first ? 0 : 1);
+    }
+    close(fds[1]);
+    TEST_ASSERT_EQUAL_INT(sizeof second, read(fds[0], second, sizeof second));
+    close(fds[0]);
+    int status;
+    TEST_ASSERT_EQUAL_INT(child, waitpid(child, &status, 0));
+    TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_randomBytes(first, sizeof first));
+    TEST_ASSERT_NOT_EQUAL(0, memcmp(first, second, sizeof first));
+}
+
+static int countTables(parsegraph_Session* authSession, const char* schema)
+{
+    ap_dbd_t* dbd = authSession->dbd;
+    apr_dbd_results_t* res = 0;
+    const char* sql = apr_pstrcat(authSession->pool, "select count(*) from ", schema, ".sqlite_master where name in ('user', 'login')", NULL);
+    TEST_ASSERT_EQUAL_INT(0, apr_dbd_select(dbd->driver, authSession->pool, dbd->handle, &res, sql, 0));
+    apr_dbd_row_t* row;
+    int count = -1;
+    TEST_ASSERT_EQUAL_INT(0, apr_dbd_get_row(dbd->driver, authSession->pool, res, &row, -1));
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, &count));
+    while(-1 != apr_dbd_get_row(dbd->driver, authSession->pool, res, &row, -1));
+    return count;
+}
+
+void test_authDatabase()
+{
+    if(strcmp(testDriver, "sqlite3")) {
+        TEST_IGNORE_MESSAGE("Auth databases are attached only to SQLite.");
+    }
+    apr_file_remove("tests/content.sqlite3", session->pool);
+    apr_file_remove("tests/auth.sqlite3", session->pool);
+    parsegraph_Session* authSession = parsegraph_Session_open(0, "sqlite3", "tests/content.sqlite3");
+    TEST_ASSERT_NOT_NULL(authSession);
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_Session_attachAuthDatabase(authSession, "tests/auth.sqlite3"));
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_upgradeUserTables(authSession));
+
+    // The user tables are only in the auth database.
+    TEST_ASSERT_EQUAL_INT(0, countTables(authSession, "main"));
+    TEST_ASSERT_EQUAL_INT(2, countTables(authSession, "auth"));
+
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_createNewUser(authSession, TEST_USERNAME, TEST_PASSWORD));
+    int userId = -1;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_getIdForUsername(authSession, TEST_USERNAME, &userId));
+    TEST_ASSERT(userId != -1);
+
+    // Sessions created while the profile names the auth database attach it,
+    // or use it if their connection already has it.
+    setenv("PARSEGRAPH_AUTH_DATABASE", "tests/auth.sqlite3", 1);
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_Profile_reloadEnvironment());
+    parsegraph_Session* shared = parsegraph_Session_new(session->pool, authSession->dbd);
+    parsegraph_Session* opened = parsegraph_Session_open(0, "sqlite3", "tests/content.sqlite3");
+    parsegraph_Session* reused = parsegraph_Session_new(session->pool, opened->dbd);
+    unsetenv("PARSEGRAPH_AUTH_DATABASE");
+    TEST_ASSERT_EQUAL_INT(APR_SUCCESS, parsegraph_Profile_reloadEnvironment());
+    TEST_ASSERT_NOT_NULL(shared);
+    TEST_ASSERT_NOT_NULL(opened);
+    TEST_ASSERT_EQUAL_STRING("auth", shared->authSchema);
+    TEST_ASSERT_EQUAL_STRING("auth", opened->authSchema);
+
+    // Later sessions on a connection use the database the first attached.
+    TEST_ASSERT_NOT_NULL(reused);
+    TEST_ASSERT_EQUAL_STRING("auth", reused->authSchema);
+    parsegraph_Session_destroy(reused);
+    userId = -1;
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_getIdForUsername(opened, TEST_USERNAME, &userId));
+    TEST_ASSERT(userId != -1);
+    parsegraph_Session_destroy(shared);
+    parsegraph_Session_close(opened);
+
+    TEST_ASSERT_EQUAL_INT(0, parsegraph_removeUser(authSession, TEST_USERNAME));
+
+    parsegraph_Session_close(authSession);
+}
+
 int main(int argc, const char* const* argv)
 {
     UNITY_BEGIN();
@@ -441,18 +1141,25 @@ int main(int argc, const char* const* argv)
         fprintf(stderr, "Failed initializing DBD memory");
         return -1;
     }
-    rv = apr_dbd_get_driver(pool, "sqlite3", &dbd->driver);
+    // PARSEGRAPH_TEST_DRIVER and PARSEGRAPH_TEST_PARAMS run the suite against
+    // another database, such as a throwaway PostgreSQL instance.
+    if(getenv("PARSEGRAPH_TEST_DRIVER")) {
+        testDriver = getenv("PARSEGRAPH_TEST_DRIVER");
+        testParams = getenv("PARSEGRAPH_TEST_PARAMS");
+    }
+    rv = apr_dbd_get_driver(pool, testDriver, &dbd->driver);
     if(rv != APR_SUCCESS) {
         fprintf(stderr, "Failed creating DBD driver, APR status of %d.\n", rv);
         return -1;
     }
-    const char* db_path = "tests/users.sqlite3";
+    const char* db_path = testParams;
     rv = apr_dbd_open(dbd->driver, pool, db_path, &dbd->handle);
     if(rv != APR_SUCCESS) {
         fprintf(stderr, "Failed connecting to database at %s, APR status of %d.\n", db_path, rv);
         return -1;
     }
     dbd->prepared = apr_hash_make(pool);
+    dbd->pool = pool;
 
     session = parsegraph_Session_new(pool, dbd);
 
@@ -473,6 +1180,9 @@ int main(int argc, const char* const* argv)
     RUN_TEST(test_disallowInvalidPasswords);
     RUN_TEST(test_disallowInvalidUsernames);
     RUN_TEST(test_listUsers);
+    RUN_TEST(test_listUsersAfter);
+    RUN_TEST(test_UserIterator_largePages);
+    RUN_TEST(test_usernameIndex);
     RUN_TEST(test_encryptPassword);
     RUN_TEST(test_loginActuallyWorks);
     RUN_TEST(test_removeUser);
@@ -487,6 +1197,16 @@ int main(int argc, const char* const* argv)
     RUN_TEST(test_allowSubscription);
 
     RUN_TEST(test_getIdForUsername);
+    RUN_TEST(test_loginCache);
+    RUN_TEST(test_loginCache_shared);
+    RUN_TEST(test_signedLogin);
+    RUN_TEST(test_loginRevocationCleanup);
+    RUN_TEST(test_loginExpiry);
+    RUN_TEST(test_passwordRehash);
+    RUN_TEST(test_loadUser);
+    RUN_TEST(test_randomBytes);
+    RUN_TEST(test_rateLimiter);
+    RUN_TEST(test_authDatabase);
 
     parsegraph_Session_destroy(session);
 
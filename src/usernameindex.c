@@ -0,0 +1,285 @@
+#include "parsegraph_UsernameIndex.h"
+#include <apr_strings.h>
+#include <apr_thread_rwlock.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+struct parsegraph_UsernameEntry {
+    char* username;
+    int userId;
+};
+
+// Usernames are validated to at most this many bytes.
+#define USERNAME_MAX 64
+
+// A change to the session's index held until its outermost transaction commits.
+struct parsegraph_PendingUsername {
+    char username[USERNAME_MAX + 1];
+    int userId;
+    int removed;
+};
+
+struct parsegraph_UsernameIndex {
+    apr_pool_t* pool;
+
+    // Guards the fields below.
+    apr_thread_rwlock_t* lock;
+
+    // Sorted by compareUsernames, and allocated with malloc along with the names.
+    struct parsegraph_UsernameEntry* entries;
+    int size;
+    int capacity;
+};
+
+// Orders names without regard to case, and names equal but for case by their bytes.
+static int compareUsernames(const char* a, const char* b)
+{
+    int rv = strcasecmp(a, b);
+    return rv ? rv : strcmp(a, b);
+}
+
+static int compareEntries(const void* a, const void* b)
+{
+    return compareUsernames(((const struct parsegraph_UsernameEntry*)a)->username, ((const struct parsegraph_UsernameEntry*)b)->username);
+}
+
+static void freeEntries(struct parsegraph_UsernameEntry* entries, int size)
+{
+    for(int i = 0; i < size; ++i) {
+        free(entries[i].username);
+    }
+    free(entries);
+}
+
+static apr_status_t cleanupIndex(void* data)
+{
+    parsegraph_UsernameIndex* index = data;
+    freeEntries(index->entries, index->size);
+    index->entries = 0;
+    index->size = 0;
+    index->capacity = 0;
+    return APR_SUCCESS;
+}
+
+parsegraph_UsernameIndex* parsegraph_UsernameIndex_new(apr_pool_t* parent)
+{
+    apr_pool_t* pool;
+    if(APR_SUCCESS != apr_pool_create(&pool, parent)) {
+        return 0;
+    }
+    parsegraph_UsernameIndex* index = apr_pcalloc(pool, sizeof(*index));
+    index->pool = pool;
+    if(APR_SUCCESS != apr_thread_rwlock_create(&index->lock, pool)) {
+        apr_pool_destroy(pool);
+        return 0;
+    }
+    apr_pool_cleanup_register(pool, index, cleanupIndex, apr_pool_cleanup_null);
+    return index;
+}
+
+void parsegraph_UsernameIndex_destroy(parsegraph_UsernameIndex* index)
+{
+    apr_pool_destroy(index->pool);
+}
+
+// Returns the position of the first entry not ordered before the given name.
+static int lowerBound(parsegraph_UsernameIndex* index, const char* username, int (*compare)(const char*, const char*))
+{
+    int lo = 0;
+    int hi = index->size;
+    while(lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if(compare(index->entries[mid].username, username) < 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+parsegraph_UserStatus parsegraph_UsernameIndex_load(parsegraph_UsernameIndex* index, parsegraph_Session* session)
+{
+    parsegraph_UserIterator iter;
+    parsegraph_UserStatus rv = parsegraph_UserIterator_open(&iter, session, 1024);
+    if(parsegraph_OK != rv) {
+        return rv;
+    }
+    struct parsegraph_UsernameEntry* entries = 0;
+    int size = 0;
+    int capacity = 0;
+    for(;;) {
+        parsegraph_UserSummary* user;
+        rv = parsegraph_UserIterator_next(&iter, &user);
+        if(parsegraph_OK != rv || !user) {
+            break;
+        }
+        if(size == capacity) {
+            int newCapacity = capacity ? capacity * 2 : 1024;
+            struct parsegraph_UsernameEntry* grown = realloc(entries, newCapacity * sizeof(*entries));
+            if(!grown) {
+                rv = parsegraph_ERROR;
+                break;
+            }
+            entries = grown;
+            capacity = newCapacity;
+        }
+        entries[size].username = strdup(user->username);
+        if(!entries[size].username) {
+            rv = parsegraph_ERROR;
+            break;
+        }
+        entries[size].userId = user->id;
+        ++size;
+    }
+    parsegraph_UserIterator_close(&iter);
+    if(parsegraph_OK != rv) {
+        marla_logMessagef(session->server, "Failed to load the username index.");
+        freeEntries(entries, size);
+        return rv;
+    }
+    qsort(entries, size, sizeof(*entries), compareEntries);
+
+    apr_thread_rwlock_wrlock(index->lock);
+    struct parsegraph_UsernameEntry* oldEntries = index->entries;
+    int oldSize = index->size;
+    index->entries = entries;
+    index->size = size;
+    index->capacity = capacity;
+    apr_thread_rwlock_unlock(index->lock);
+
+    freeEntries(oldEntries, oldSize);
+    return parsegraph_OK;
+}
+
+void parsegraph_UsernameIndex_add(parsegraph_UsernameIndex* index, const char* username, int userId)
+{
+    apr_thread_rwlock_wrlock(index->lock);
+    int pos = lowerBound(index, username, compareUsernames);
+    if(pos < index->size && !strcmp(index->entries[pos].username, username)) {
+        index->entries[pos].userId = userId;
+        apr_thread_rwlock_unlock(index->lock);
+        return;
+    }
+    char* copy = strdup(username);
+    if(!copy) {
+        apr_thread_rwlock_unlock(index->lock);
+        return;
+    }
+    if(index->size == index->capacity) {
+        int newCapacity = index->capacity ? index->capacity * 2 : 64;
+        struct parsegraph_UsernameEntry* grown = realloc(index->entries, newCapacity * sizeof(*grown));
+        if(!grown) {
+            free(copy);
+            apr_thread_rwlock_unlock(index->lock);
+            return;
+        }
+        index->entries = grown;
+        index->capacity = newCapacity;
+    }
+    memmove(&index->entries[pos + 1], &index->entries[pos], (index->size - pos) * sizeof(*index->entries));
+    index->entries[pos].username = copy;
+    index->entries[pos].userId = userId;
+    ++index->size;
+    apr_thread_rwlock_unlock(index->lock);
+}
+
+void parsegraph_UsernameIndex_remove(parsegraph_UsernameIndex* index, const char* username)
+{
+    apr_thread_rwlock_wrlock(index->lock);
+    int pos = lowerBound(index, username, compareUsernames);
+    if(pos < index->size && !strcmp(index->entries[pos].username, username)) {
+        free(index->entries[pos].username);
+        memmove(&index->entries[pos], &index->entries[pos + 1], (index->size - pos - 1) * sizeof(*index->entries));
+        --index->size;
+    }
+    apr_thread_rwlock_unlock(index->lock);
+}
+
+void parsegraph_UsernameIndex_search(parsegraph_UsernameIndex* index, apr_pool_t* pool, const char* prefix, int limit, apr_array_header_t** users)
+{
+    *users = apr_array_make(pool, limit > 0 ? limit : 1, sizeof(parsegraph_UserSummary));
+    size_t prefixLen = strlen(prefix);
+
+    apr_thread_rwlock_rdlock(index->lock);
+    // Names starting with the prefix follow every name ordered before it.
+    for(int i = lowerBound(index, prefix, strcasecmp); i < index->size && (*users)->nelts < limit; ++i) {
+        struct parsegraph_UsernameEntry* entry = &index->entries[i];
+        if(strncasecmp(entry->username, prefix, prefixLen)) {
+            break;
+        }
+        parsegraph_UserSummary* user = apr_array_push(*users);
+        user->id = entry->userId;
+        user->username = apr_pstrdup(pool, entry->username);
+    }
+    apr_thread_rwlock_unlock(index->lock);
+}
+
+int parsegraph_UsernameIndex_size(parsegraph_UsernameIndex* index)
+{
+    apr_thread_rwlock_rdlock(index->lock);
+    int size = index->size;
+    apr_thread_rwlock_unlock(index->lock);
+    return size;
+}
+
+static void applyUsername(parsegraph_UsernameIndex* index, const char* username, int userId, int removed)
+{
+    if(removed) {
+        parsegraph_UsernameIndex_remove(index, username);
+    }
+    else {
+        parsegraph_UsernameIndex_add(index, username, userId);
+    }
+}
+
+static void queueUsername(parsegraph_Session* session, const char* username, int userId, int removed)
+{
+    if(!session->usernameIndex) {
+        return;
+    }
+    if(session->transactionDepth == 0) {
+        applyUsername(session->usernameIndex, username, userId, removed);
+        return;
+    }
+    if(strlen(username) > USERNAME_MAX) {
+        return;
+    }
+    if(!session->pendingUsernames) {
+        session->pendingUsernames = apr_array_make(session->statePool, 8, sizeof(struct parsegraph_PendingUsername));
+    }
+    struct parsegraph_PendingUsername* pending = apr_array_push(session->pendingUsernames);
+    strcpy(pending->username, username);
+    pending->userId = userId;
+    pending->removed = removed;
+}
+
+void parsegraph_indexUsername(parsegraph_Session* session, const char* username, int userId)
+{
+    queueUsername(session, username, userId, 0);
+}
+
+void parsegraph_unindexUsername(parsegraph_Session* session, const char* username)
+{
+    queueUsername(session, username, 0, 1);
+}
+
+int parsegraph_countPendingUsernames(parsegraph_Session* session)
+{
+    return session->pendingUsernames ? session->pendingUsernames->nelts : 0;
+}
+
+void parsegraph_flushPendingUsernames(parsegraph_Session* session)
+{
+    apr_array_header_t* pending = session->pendingUsernames;
+    if(!pending) {
+        return;
+    }
+    for(int i = 0; i < pending->nelts && session->usernameIndex; ++i) {
+        struct parsegraph_PendingUsername* change = &APR_ARRAY_IDX(pending, i, struct parsegraph_PendingUsername);
+        applyUsername(session->usernameIndex, change->username, change->userId, change->removed);
+    }
+    apr_array_clear(pending);
+}
@@ -0,0 +1,344 @@
+#include "parsegraph_Worker.h"
+#include <apr_thread_proc.h>
+#include <apr_thread_mutex.h>
+#include <apr_thread_cond.h>
+#include <apr_strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct parsegraph_Job {
+    parsegraph_WorkFunction work;
+    parsegraph_Continuation done;
+    void* data;
+    int status;
+
+    // Holds the job's results until its continuation has run. It is
+    // unmanaged so that the loop's thread may destroy it.
+    apr_pool_t* pool;
+
+    struct parsegraph_Job* next;
+};
+
+struct parsegraph_Worker {
+    parsegraph_WorkerPool* workers;
+    apr_thread_t* thread;
+    parsegraph_Session* session;
+};
+
+struct parsegraph_WorkerPool {
+    apr_pool_t* pool;
+    marla_Server* server;
+    apr_thread_mutex_t* lock;
+    apr_thread_cond_t* ready;
+
+    // Jobs waiting for a worker, and jobs waiting for their continuation.
+    struct parsegraph_Job* queueHead;
+    struct parsegraph_Job* queueTail;
+    struct parsegraph_Job* doneHead;
+    struct parsegraph_Job* doneTail;
+    int pending;
+    int stopping;
+
+    // Jobs waiting for a worker, and the most that may wait, or 0 for no limit.
+    int queued;
+    int queueLimit;
+
+    // Written by workers when doneHead becomes non-empty; read by the loop.
+    int wakeFds[2];
+
+    int nworkers;
+    struct parsegraph_Worker* threads;
+};
+
+static void completeJob(parsegraph_WorkerPool* workers, struct parsegraph_Job* job)
+{
+    job->next = 0;
+    apr_thread_mutex_lock(workers->lock);
+    int wasEmpty = workers->doneHead == 0;
+    if(workers->doneTail) {
+        workers->doneTail->next = job;
+    }
+    else {
+        workers->doneHead = job;
+    }
+    workers->doneTail = job;
+    apr_thread_mutex_unlock(workers->lock);
+
+    if(wasEmpty) {
+        char c = 1;
+        while(write(workers->wakeFds[1], &c, 1) < 0 && errno == EINTR);
+    }
+}
+
+static void* APR_THREAD_FUNC runWorker(apr_thread_t* thread, void* arg)
+{
+    struct parsegraph_Worker* worker = arg;
+    parsegraph_WorkerPool* workers = worker->workers;
+    for(;;) {
+        apr_thread_mutex_lock(workers->lock);
+        while(!workers->queueHead && !workers->stopping) {
+            apr_thread_cond_wait(workers->ready, workers->lock);
+        }
+        struct parsegraph_Job* job = workers->queueHead;
+        if(job) {
+            workers->queueHead = job->next;
+            if(!workers->queueHead) {
+                workers->queueTail = 0;
+            }
+            --workers->queued;
+        }
+        apr_thread_mutex_unlock(workers->lock);
+
+        if(!job) {
+            // Stopping, and the queue is drained.
+            break;
+        }
+        // Allocate the job's results from its own pool, so the worker's
+        // session does not grow with every job it runs.
+        parsegraph_Session* session = worker->session;
+        apr_pool_t* sessionPool = session->pool;
+        if(APR_SUCCESS == apr_pool_create_unmanaged(&job->pool)) {
+            session->pool = job->pool;
+            job->status = job->work(session, job->data);
+            session->pool = sessionPool;
+        }
+        else {
+            marla_logMessagef(workers->server, "Failed creating a pool for a worker job.");
+            job->pool = 0;
+            job->status = -1;
+        }
+        completeJob(workers, job);
+    }
+    apr_thread_exit(thread, APR_SUCCESS);
+    return 0;
+}
+
+// How long a worker waits for another connection's SQLite lock, unless the profile sets it.
+#define WORKER_BUSY_TIMEOUT 5000
+
+// Workers write concurrently, so give SQLite connections a busy timeout
+// rather than failing at once with SQLITE_BUSY.
+static int setBusyTimeout(parsegraph_Session* session)
+{
+    ap_dbd_t* dbd = session->dbd;
+    if(strcmp(apr_dbd_name(dbd->driver), "sqlite3")) {
+        return 0;
+    }
+    apr_dbd_results_t* res = 0;
+    apr_dbd_row_t* row;
+    int timeout = 0;
+    if(0 == apr_dbd_select(dbd->driver, session->pool, dbd->handle, &res, "PRAGMA busy_timeout", 0)) {
+        if(0 == apr_dbd_get_row(dbd->driver, session->pool, res, &row, -1)) {
+            apr_dbd_datum_get(dbd->driver, row, 0, APR_DBD_TYPE_INT, &timeout);
+            while(-1 != apr_dbd_get_row(dbd->driver, session->pool, res, &row, -1));
+        }
+    }
+    if(timeout > 0) {
+        return 0;
+    }
+    int rv = apr_dbd_select(dbd->driver, session->pool, dbd->handle, &res, apr_psprintf(session->pool, "PRAGMA busy_timeout = %d", WORKER_BUSY_TIMEOUT), 0);
+    if(rv == 0) {
+        while(-1 != apr_dbd_get_row(dbd->driver, session->pool, res, &row, -1));
+    }
+    return rv;
+}
+
+static int openWorker(parsegraph_WorkerPool* workers, struct parsegraph_Worker* worker, const char* driverName, const char* params)
+{
+    worker->workers = workers;
+    worker->session = parsegraph_Session_open(workers->server, driverName, params);
+    if(!worker->session) {
+        return -1;
+    }
+    if(0 != setBusyTimeout(worker->session)) {
+        marla_logMessagef(workers->server, "Failed setting the busy timeout of a worker.");
+        return -1;
+    }
+    parsegraph_Session_useNativeSQLite(worker->session);
+    return 0;
+}
+
+static void stopWorkers(parsegraph_WorkerPool* workers)
+{
+    apr_thread_mutex_lock(workers->lock);
+    workers->stopping = 1;
+    apr_thread_cond_broadcast(workers->ready);
+    apr_thread_mutex_unlock(workers->lock);
+
+    for(int i = 0; i < workers->nworkers; ++i) {
+        struct parsegraph_Worker* worker = &workers->threads[i];
+        if(worker->thread) {
+            apr_status_t threadrv;
+            apr_thread_join(&threadrv, worker->thread);
+            worker->thread = 0;
+        }
+    }
+}
+
+static void freeWorkerPool(parsegraph_WorkerPool* workers)
+{
+    for(int i = 0; i < workers->nworkers; ++i) {
+        if(workers->threads[i].session) {
+            parsegraph_Session_close(workers->threads[i].session);
+        }
+    }
+    if(workers->wakeFds[0] >= 0) {
+        close(workers->wakeFds[0]);
+        close(workers->wakeFds[1]);
+    }
+    apr_pool_destroy(workers->pool);
+}
+
+parsegraph_WorkerPool* parsegraph_WorkerPool_new(apr_pool_t* parent, marla_Server* server, const char* driverName, const char* params, int nworkers)
+{
+    apr_pool_t* pool;
+    if(nworkers <= 0 || APR_SUCCESS != apr_pool_create(&pool, parent)) {
+        return 0;
+    }
+    parsegraph_WorkerPool* workers = apr_pcalloc(pool, sizeof(*workers));
+    workers->pool = pool;
+    workers->server = server;
+    workers->wakeFds[0] = -1;
+    workers->wakeFds[1] = -1;
+    workers->nworkers = nworkers;
+    workers->threads = apr_pcalloc(pool, sizeof(struct parsegraph_Worker) * nworkers);
+
+    if(APR_SUCCESS != apr_thread_mutex_create(&workers->lock, APR_THREAD_MUTEX_DEFAULT, pool)
+        || APR_SUCCESS != apr_thread_cond_create(&workers->ready, pool)) {
+        marla_logMessagef(server, "Failed creating worker pool locks.");
+        apr_pool_destroy(pool);
+        return 0;
+    }
+
+    if(0 != pipe(workers->wakeFds)) {
+        marla_logMessagef(server, "Failed creating worker pool wakeup pipe.");
+        workers->wakeFds[0] = -1;
+        apr_pool_destroy(pool);
+        return 0;
+    }
+    for(int i = 0; i < 2; ++i) {
+        fcntl(workers->wakeFds[i], F_SETFL, fcntl(workers->wakeFds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(workers->wakeFds[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    for(int i = 0; i < nworkers; ++i) {
+        struct parsegraph_Worker* worker = &workers->threads[i];
+        if(0 != openWorker(workers, worker, driverName, params)
+            || APR_SUCCESS != apr_thread_create(&worker->thread, 0, runWorker, worker, pool)) {
+            marla_logMessagef(server, "Failed starting worker %d.", i);
+            worker->thread = 0;
+            stopWorkers(workers);
+            freeWorkerPool(workers);
+            return 0;
+        }
+    }
+
+    return workers;
+}
+
+void parsegraph_WorkerPool_destroy(parsegraph_WorkerPool* workers)
+{
+    stopWorkers(workers);
+
+    // Continuations may read results from the worker sessions, so run them
+    // before the sessions are destroyed.
+    parsegraph_WorkerPool_dispatch(workers);
+
+    freeWorkerPool(workers);
+}
+
+int parsegraph_WorkerPool_submit(parsegraph_WorkerPool* workers, parsegraph_WorkFunction work, parsegraph_Continuation done, void* data)
+{
+    struct parsegraph_Job* job = malloc(sizeof(*job));
+    if(!job) {
+        return APR_ENOMEM;
+    }
+    job->work = work;
+    job->done = done;
+    job->data = data;
+    job->status = 0;
+    job->pool = 0;
+    job->next = 0;
+
+    apr_thread_mutex_lock(workers->lock);
+    if(workers->stopping) {
+        apr_thread_mutex_unlock(workers->lock);
+        free(job);
+        return APR_EINVAL;
+    }
+    if(workers->queueLimit > 0 && workers->queued >= workers->queueLimit) {
+        apr_thread_mutex_unlock(workers->lock);
+        free(job);
+        return APR_EAGAIN;
+    }
+    if(workers->queueTail) {
+        workers->queueTail->next = job;
+    }
+    else {
+        workers->queueHead = job;
+    }
+    workers->queueTail = job;
+    ++workers->queued;
+    ++workers->pending;
+    apr_thread_cond_signal(workers->ready);
+    apr_thread_mutex_unlock(workers->lock);
+    return APR_SUCCESS;
+}
+
+void parsegraph_WorkerPool_setQueueLimit(parsegraph_WorkerPool* workers, int limit)
+{
+    apr_thread_mutex_lock(workers->lock);
+    workers->queueLimit = limit;
+    apr_thread_mutex_unlock(workers->lock);
+}
+
+int parsegraph_WorkerPool_fd(parsegraph_WorkerPool* workers)
+{
+    return workers->wakeFds[0];
+}
+
+int parsegraph_WorkerPool_dispatch(parsegraph_WorkerPool* workers)
+{
+    // Drain the wakeup pipe before taking the completed jobs, so a job
+    // completed after this point always leaves the pipe readable.
+    char buf[64];
+    while(read(workers->wakeFds[0], buf, sizeof(buf)) > 0);
+
+    apr_thread_mutex_lock(workers->lock);
+    struct parsegraph_Job* job = workers->doneHead;
+    workers->doneHead = 0;
+    workers->doneTail = 0;
+    apr_thread_mutex_unlock(workers->lock);
+
+    int count = 0;
+    while(job) {
+        struct parsegraph_Job* next = job->next;
+        if(job->done) {
+            job->done(job->data, job->status);
+        }
+        if(job->pool) {
+            apr_pool_destroy(job->pool);
+        }
+        free(job);
+        job = next;
+        ++count;
+    }
+
+    if(count > 0) {
+        apr_thread_mutex_lock(workers->lock);
+        workers->pending -= count;
+        apr_thread_mutex_unlock(workers->lock);
+    }
+    return count;
+}
+
+int parsegraph_WorkerPool_pending(parsegraph_WorkerPool* workers)
+{
+    apr_thread_mutex_lock(workers->lock);
+    int pending = workers->pending;
+    apr_thread_mutex_unlock(workers->lock);
+    return pending;
+}